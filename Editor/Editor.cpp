@@ -565,16 +565,20 @@ void EditorComponent::Load()
 			{
 				const Scene& scene = wiRenderer::GetScene();
 
+				// The temporary model only references the scene, it doesn't take shares of the meshes:
 				Model* fullModel = new Model;
 				for(auto& x : scene.models)
 				{
 					if (x != nullptr)
 					{
-						fullModel->Add(x);
+						fullModel->Add(x, false);
 					}
 				}
 				fullModel->Serialize(archive);
 
+				// The file is written on a background thread, so saving doesn't stall the editor:
+				archive.CloseAsync();
+
 				// Clear out the temporary model so that resources won't be deleted on destruction:
 				fullModel->objects.clear();
 				fullModel->lights.clear();
@@ -637,7 +641,7 @@ void EditorComponent::Load()
 
 				loader->addLoadingFunction([=] {
 					wiRenderer::LoadModel(dir, file);
-				});
+				}, LoadingScreenComponent::getFileWeight(fileName));
 				loader->onFinished([=] {
 					main->activateComponent(this);
 					worldWnd->UpdateFromRenderer();
@@ -1208,7 +1212,7 @@ void EditorComponent::Update(float dt)
 				Model* model = new Model;
 				for (auto& x : selected)
 				{
-					model->Add(x->object);
+					model->Add(x->object, false);
 					model->Add(x->light);
 					model->Add(x->decal);
 					model->Add(x->forceField);
@@ -1221,6 +1225,7 @@ void EditorComponent::Update(float dt)
 				model->decals.clear();
 				model->meshes.clear();
 				model->materials.clear();
+				model->armatures.clear();
 				model->forces.clear();
 				SAFE_DELETE(model);
 			}
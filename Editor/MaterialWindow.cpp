@@ -63,7 +63,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	normalMapSlider->SetPos(XMFLOAT2(x, y += step));
 	normalMapSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->normalMapStrength = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(normalMapSlider);
 
@@ -73,7 +76,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	roughnessSlider->SetPos(XMFLOAT2(x, y += step));
 	roughnessSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->roughness = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(roughnessSlider);
 
@@ -83,7 +89,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	reflectanceSlider->SetPos(XMFLOAT2(x, y += step));
 	reflectanceSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->reflectance = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(reflectanceSlider);
 
@@ -93,7 +102,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	metalnessSlider->SetPos(XMFLOAT2(x, y += step));
 	metalnessSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->metalness = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(metalnessSlider);
 
@@ -103,7 +115,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	alphaSlider->SetPos(XMFLOAT2(x, y += step));
 	alphaSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->alpha = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(alphaSlider);
 
@@ -123,7 +138,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	refractionIndexSlider->SetPos(XMFLOAT2(x, y += step));
 	refractionIndexSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->refractionIndex = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(refractionIndexSlider);
 
@@ -133,7 +151,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	emissiveSlider->SetPos(XMFLOAT2(x, y += step));
 	emissiveSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->emissive = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(emissiveSlider);
 
@@ -143,7 +164,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	sssSlider->SetPos(XMFLOAT2(x, y += step));
 	sssSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->subsurfaceScattering = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(sssSlider);
 
@@ -153,7 +177,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	pomSlider->SetPos(XMFLOAT2(x, y += step));
 	pomSlider->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->parallaxOcclusionMapping = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(pomSlider);
 
@@ -183,7 +210,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	texMulSliderX->SetPos(XMFLOAT2(x, y += step));
 	texMulSliderX->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->texMulAdd.x = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(texMulSliderX);
 
@@ -193,7 +223,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	texMulSliderY->SetPos(XMFLOAT2(x, y += step));
 	texMulSliderY->OnSlide([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->texMulAdd.y = args.fValue;
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(texMulSliderY);
 
@@ -205,7 +238,10 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 	colorPicker->SetEnabled(true);
 	colorPicker->OnColorChanged([&](wiEventArgs args) {
 		if (material != nullptr)
+		{
 			material->baseColor = XMFLOAT3(powf(args.color.x, 1.f / 2.2f), powf(args.color.y, 1.f / 2.2f), powf(args.color.z, 1.f / 2.2f));
+			material->SetDirty();
+		}
 	});
 	materialWindow->AddWidget(colorPicker);
 
@@ -285,6 +321,7 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 			material->normalMap = nullptr;
 			material->normalMapName = "";
 			texture_normal_Button->SetText("");
+			material->SetDirty();
 		}
 		else
 		{
@@ -310,6 +347,7 @@ MaterialWindow::MaterialWindow(wiGUI* gui) : GUI(gui)
 				material->normalMap = (Texture2D*)wiResourceManager::GetGlobal()->add(fileName);
 				material->normalMapName = fileName;
 				texture_normal_Button->SetText(wiHelper::GetFileNameFromPath(material->normalMapName));
+				material->SetDirty();
 			}
 		}
 	});
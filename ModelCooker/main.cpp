@@ -0,0 +1,618 @@
+// ModelCooker.cpp : Command line tool that converts models into cooked .wimf archives.
+//
+// Usage: ModelCooker [-f] [-c] [-j threads] [-o output_directory] [-b frames] input_directory [input_directory ...]
+//	-f	cook every model, even if its content hash didn't change since the last run
+//	-c	write LZ4 block compressed archives
+//	-j	number of worker threads (default: hardware concurrency)
+//	-o	write the cooked models here instead of next to the source files
+//	-b	load the cooked models into one scene and render it for this many frames without presenting, then print
+//		the CPU time of the frame preparation, the recorded draw calls and state changes and the per-frame uploads
+//		with the render queue unsorted, sorted, and recorded in parallel, and check that the parallel recording is
+//		submitted in the serial order, then the frame time and physics latency with the physics step run serially
+//		and overlapped with the rendering. Before that, the time it takes to load the shaders from wiRenderer::SHADERPATH
+//		is printed, with an empty and with a filled shader cache. Last, the meshes are written into streaming chunks (in a
+//		"streaming" directory next to the first cooked model) and the camera flies through the scene while they are streamed
+//
+// A cooked model has its vertex arrays, index optimization and bounds precomputed, so loading it
+// only copies the serialized data into the final arrays.
+
+#include "WickedEngine.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace wiGraphicsTypes;
+
+// The content hash manifest is written to every output directory:
+static const char* MANIFEST_NAME = "ModelCooker.manifest";
+
+struct CookJob
+{
+	string inputDirectory;
+	string outputDirectory;
+	string name;
+	uint64_t hash;
+};
+
+static uint64_t HashBytes(const BYTE* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	// FNV-1a
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= (uint64_t)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static bool FileExists(const string& fileName)
+{
+	ifstream file(fileName);
+	return file.is_open();
+}
+
+// Hash every source file that the model loader could read for this model:
+static uint64_t HashModel(const string& directory, const string& name)
+{
+	static const char* extensions[] = { ".wimf", ".wia", ".wim", ".wi", ".wio", ".wiact", ".wil", ".wid", ".wiw" };
+
+	// The archive version is part of the hash, so that models are recooked when the format changes:
+	uint64_t version = wiArchive::GetCurrentVersion();
+	uint64_t hash = HashBytes((const BYTE*)&version, sizeof(version));
+	for (auto& ext : extensions)
+	{
+		string fileName = directory + name + ext;
+		if (!FileExists(fileName))
+		{
+			continue;
+		}
+		BYTE* data;
+		size_t size;
+		if (wiHelper::readByteData(fileName, &data, size))
+		{
+			hash = HashBytes(data, size, hash);
+			delete[] data;
+		}
+	}
+	return hash;
+}
+
+// One line per model: the hash, a tab, then the key (the paths can contain spaces)
+static void LoadManifest(const string& directory, unordered_map<string, uint64_t>& manifest)
+{
+	ifstream file(directory + MANIFEST_NAME);
+	string line;
+	while (getline(file, line))
+	{
+		size_t tab = line.find('\t');
+		if (tab == string::npos || tab + 1 >= line.length())
+		{
+			continue;
+		}
+		manifest[line.substr(tab + 1)] = strtoull(line.substr(0, tab).c_str(), nullptr, 10);
+	}
+}
+
+static void SaveManifest(const string& directory, const unordered_map<string, uint64_t>& manifest)
+{
+	ofstream file(directory + MANIFEST_NAME, ios::trunc);
+	for (auto& x : manifest)
+	{
+		file << x.second << "\t" << x.first << endl;
+	}
+}
+
+static string MakeDirectory(const string& path)
+{
+	if (path.empty())
+	{
+		return path;
+	}
+	char last = path.back();
+	return (last == '/' || last == '\\') ? path : path + "/";
+}
+
+static bool compress = false;
+
+// The render target binds, clears and draws of a frame: their order must not depend on how the frame was recorded
+static vector<GraphicsDevice_Null::Command> GetSubmissionOrder(const vector<GraphicsDevice_Null::Command>& commands)
+{
+	vector<GraphicsDevice_Null::Command> order;
+	for (auto& x : commands)
+	{
+		switch (x.type)
+		{
+		case GraphicsDevice_Null::COMMAND_BIND_RENDERTARGETS:
+		case GraphicsDevice_Null::COMMAND_CLEAR_DEPTHSTENCIL:
+		case GraphicsDevice_Null::COMMAND_DRAW:
+		case GraphicsDevice_Null::COMMAND_DRAW_INDEXED:
+		case GraphicsDevice_Null::COMMAND_DRAW_INSTANCED:
+		case GraphicsDevice_Null::COMMAND_DRAW_INDEXED_INSTANCED:
+			order.push_back(x);
+			break;
+		default:
+			break;
+		}
+	}
+	return order;
+}
+
+static bool IsSameOrder(const vector<GraphicsDevice_Null::Command>& a, const vector<GraphicsDevice_Null::Command>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(GraphicsDevice_Null::Command)) == 0);
+}
+
+// Renders the frames and returns the submission order of the last one
+static vector<GraphicsDevice_Null::Command> RenderFrames(int frameCount, const string& label)
+{
+	GraphicsDevice_Null* device = static_cast<GraphicsDevice_Null*>(wiRenderer::GetDevice());
+	const GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE;
+	const float dt = 1.0f / 60.0f;
+
+	double updateTime = 0, renderTime = 0;
+	GraphicsDevice_Null::Stats totals;
+	wiRenderer::ShadowCullingStats shadowTotals;
+	wiTimer timer;
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		timer.record();
+		wiRenderer::UpdatePerFrameData(dt);
+		wiRenderer::ExtractFramePacket();
+		double updated = timer.elapsed();
+
+		device->PresentBegin();
+		wiRenderer::UpdateRenderData(threadID);
+		wiRenderer::DrawForShadowMap(threadID);
+		wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
+		wiRenderer::DrawWorld(wiRenderer::getCamera(), false, threadID, SHADERTYPE_DEFERRED, nullptr, false, false);
+		device->PresentEnd();
+
+		updateTime += updated;
+		renderTime += timer.elapsed() - updated;
+		totals.Add(device->GetFrameStats());
+
+		const wiRenderer::ShadowCullingStats& shadowStats = wiRenderer::GetShadowCullingStats();
+		shadowTotals.cullingTime += shadowStats.cullingTime;
+		shadowTotals.views += shadowStats.views;
+		shadowTotals.viewsCulled += shadowStats.viewsCulled;
+		shadowTotals.viewsReused += shadowStats.viewsReused;
+		shadowTotals.viewsSkipped += shadowStats.viewsSkipped;
+	}
+
+	cout << label << ":" << endl;
+	cout << "  UpdatePerFrameData + ExtractFramePacket: " << updateTime / frameCount << " ms, UpdateRenderData + DrawForShadowMap + DrawWorld: " << renderTime / frameCount << " ms" << endl;
+	cout << "  Per frame: " << totals.drawCalls / frameCount << " draw calls, " << totals.stateChanges / frameCount << " state changes ("
+		<< totals.redundantStateChanges / frameCount << " redundant), " << totals.resourceBinds / frameCount << " resource binds, "
+		<< totals.bytesUploaded / frameCount / 1024 << " KB uploaded, " << totals.commands / frameCount << " commands" << endl;
+	cout << "  Shadow culling: " << shadowTotals.cullingTime / frameCount << " ms, " << shadowTotals.views / frameCount << " views ("
+		<< shadowTotals.viewsCulled / frameCount << " culled, " << shadowTotals.viewsReused / frameCount << " reused, "
+		<< shadowTotals.viewsSkipped / frameCount << " skipped)" << endl;
+	const wiUploadAllocator::Stats& uploadStats = wiRenderer::GetUploadStats();
+	cout << "  Uploads: " << uploadStats.frameBytes / 1024 << " KB in " << uploadStats.frameAllocations << " allocations and "
+		<< uploadStats.framePages << " pages per frame, " << uploadStats.highWaterMark / 1024 << " KB high-water mark, "
+		<< uploadStats.pages << " pages (" << uploadStats.pageBytes / 1024 << " KB), " << totals.invalidMappings << " invalid deferred mappings" << endl;
+
+	return GetSubmissionOrder(device->GetFrameCommands());
+}
+
+// Simulates and renders the frames with the physics step either before the update or overlapped with the rendering
+static void PhysicsFrames(int frameCount, bool pipelined, const string& label)
+{
+	GraphicsDevice_Null* device = static_cast<GraphicsDevice_Null*>(wiRenderer::GetDevice());
+	const GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE;
+	const float dt = 1.0f / 60.0f;
+
+	// The latency is measured from the start of a physics step to the end of the frame that shows its results.
+	//	The results are applied by the fixed update of the next frame in both cases:
+	double latency = 0, lastStepStart = 0;
+	wiTimer timer;
+	timer.record();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		double stepStart = 0;
+		if (pipelined)
+		{
+			wiRenderer::EndPhysicsStep();
+		}
+		wiRenderer::FixedUpdate();
+		if (!pipelined)
+		{
+			stepStart = timer.elapsed();
+			wiRenderer::SynchronizeWithPhysicsEngine(dt);
+		}
+		wiRenderer::UpdatePerFrameData(dt);
+		wiRenderer::ExtractFramePacket();
+		if (pipelined)
+		{
+			stepStart = timer.elapsed();
+			wiRenderer::BeginPhysicsStep(dt);
+		}
+
+		device->PresentBegin();
+		wiRenderer::UpdateRenderData(threadID);
+		wiRenderer::DrawForShadowMap(threadID);
+		wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
+		wiRenderer::DrawWorld(wiRenderer::getCamera(), false, threadID, SHADERTYPE_DEFERRED, nullptr, false, false);
+		device->PresentEnd();
+
+		if (frame > 0)
+		{
+			latency += timer.elapsed() - lastStepStart;
+		}
+		lastStepStart = stepStart;
+	}
+	wiRenderer::EndPhysicsStep();
+	double frameTime = timer.elapsed() / frameCount;
+
+	cout << label << ":" << endl;
+	cout << "  Frame: " << frameTime << " ms (" << (frameTime > 0 ? 1000.0 / frameTime : 0) << " fps), physics latency: "
+		<< (frameCount > 1 ? latency / (frameCount - 1) : 0) << " ms" << endl;
+}
+
+// Writes the meshes into chunks, then flies the camera through the scene with a small stream in distance and prints
+//	how the meshes were streamed in and out along the way
+static void StreamingFrames(int frameCount, const string& directory)
+{
+	GraphicsDevice_Null* device = static_cast<GraphicsDevice_Null*>(wiRenderer::GetDevice());
+	const GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE;
+	const float dt = 1.0f / 60.0f;
+
+	CreateDirectoryA(directory.c_str(), nullptr);
+
+	XMFLOAT3 sceneMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 sceneMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (Model* model : wiRenderer::GetScene().models)
+	{
+		wiStreaming::CreateChunks(model, directory);
+		for (Object* object : model->objects)
+		{
+			if (object->mesh != nullptr)
+			{
+				sceneMin = wiMath::Min(sceneMin, object->bounds.getMin());
+				sceneMax = wiMath::Max(sceneMax, object->bounds.getMax());
+			}
+		}
+	}
+	if (sceneMin.x > sceneMax.x)
+	{
+		cout << "Streaming: no meshes" << endl;
+		return;
+	}
+
+	// The camera moves along the diagonal of the scene, seeing about a quarter of it at a time:
+	const float sceneSize = wiMath::Distance(sceneMin, sceneMax);
+	wiStreaming::SetStreamInDistance(sceneSize * 0.25f);
+	wiStreaming::SetStreamOutDistance(sceneSize * 0.35f);
+
+	// An object is missing if it is in the stream in distance, but its mesh is not resident yet:
+	uint64_t missing = 0, inRange = 0;
+	size_t peakResidentBytes = 0;
+	double frameTime = 0;
+	wiTimer timer;
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		const float t = frameCount > 1 ? (float)frame / (float)(frameCount - 1) : 0;
+		Camera* camera = wiRenderer::getCamera();
+		camera->Clear();
+		camera->Translate(wiMath::Lerp(sceneMin, sceneMax, t));
+
+		timer.record();
+		wiRenderer::UpdatePerFrameData(dt);
+		wiRenderer::ExtractFramePacket();
+
+		device->PresentBegin();
+		wiRenderer::UpdateRenderData(threadID);
+		wiRenderer::DrawForShadowMap(threadID);
+		wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
+		wiRenderer::DrawWorld(wiRenderer::getCamera(), false, threadID, SHADERTYPE_DEFERRED, nullptr, false, false);
+		device->PresentEnd();
+		frameTime += timer.elapsed();
+
+		for (Model* model : wiRenderer::GetScene().models)
+		{
+			for (Object* object : model->objects)
+			{
+				if (!object->directory.empty() && object->mesh != nullptr &&
+					wiMath::Distance(camera->translation, object->bounds.getCenter()) - object->bounds.getRadius() < sceneSize * 0.25f)
+				{
+					inRange++;
+					missing += object->loaded ? 0 : 1;
+				}
+			}
+		}
+		peakResidentBytes = max(peakResidentBytes, wiStreaming::GetStats().residentBytes);
+	}
+
+	const wiStreaming::Stats& stats = wiStreaming::GetStats();
+	cout << "Streaming camera path:" << endl;
+	cout << "  Frame: " << frameTime / frameCount << " ms, " << stats.streamableMeshes << " streamable meshes, " << stats.streamedIn << " streamed in, "
+		<< stats.streamedOut << " streamed out, " << stats.cancelled << " cancelled" << endl;
+	cout << "  Resident: " << peakResidentBytes / 1024 << " KB peak, " << stats.residentBytes / 1024 << " KB at the end, latency: "
+		<< stats.averageLatency << " ms average, " << stats.maxLatency << " ms max, not yet resident in range: " << missing << " of " << inRange << " object frames" << endl;
+}
+
+// Reloads the shaders with an empty and with a filled shader cache and prints how long the main thread was blocked
+//	and when the startup shaders were ready
+static void ShaderStartup()
+{
+	wiShaderCache* cache = wiShaderCache::GetGlobal();
+	for (int warm = 0; warm < 2; ++warm)
+	{
+		wiTimer timer;
+		if (warm)
+		{
+			// The cache that the cold start wrote is read back from the file:
+			wiArchive::WaitForAsyncSaves();
+			timer.record();
+			cache->Open(cache->GetFileName());
+		}
+		else
+		{
+			cache->Clear();
+		}
+		cache->ResetStats();
+		wiRenderer::ReloadShaders();
+		const double blockedTime = timer.elapsed();
+		wiRenderer::WaitForShaders();
+		const wiRenderer::ShaderLoadingStats& loadingStats = wiRenderer::GetShaderLoadingStats();
+		const wiShaderCache::Stats cacheStats = cache->GetStats();
+
+		cout << (warm ? "Warm" : "Cold") << " shader startup: " << blockedTime << " ms on the main thread, " << loadingStats.requested << " shaders ready after "
+			<< loadingStats.startupTime << " ms (" << cacheStats.hits << " from the cache, " << cacheStats.misses + cacheStats.stale << " from the shader files, "
+			<< loadingStats.failed << " failed)" << endl;
+	}
+}
+
+static void RenderBenchmark(const vector<pair<string, string> >& models, int frameCount)
+{
+	if (frameCount < 1)
+	{
+		return;
+	}
+
+	wiRenderer::SetUpStaticComponents();
+	ShaderStartup();
+	// Every frame is rendered with the final shaders, the permutations are not loaded on their first use:
+	wiRenderer::WaitForShaders(true);
+	for (auto& x : models)
+	{
+		wiRenderer::LoadModel(x.first, x.second);
+	}
+
+	cout << "Rendering " << models.size() << " models for " << frameCount << " frames" << endl;
+
+	// The same frames with the render queue in submission order and sorted, to compare the state changes:
+	wiRenderer::SetShadowMapSkippingEnabled(false);
+	wiRenderer::SetParallelRecordingEnabled(false);
+	wiRenderer::SetRenderQueueSortingEnabled(false);
+	RenderFrames(frameCount, "Unsorted render queue");
+	wiRenderer::SetRenderQueueSortingEnabled(true);
+	vector<GraphicsDevice_Null::Command> serialOrder = RenderFrames(frameCount, "Sorted render queue");
+
+	// The shadow maps recorded on worker threads must be submitted in the same order as when they are recorded serially:
+	wiRenderer::SetParallelRecordingEnabled(true);
+	vector<GraphicsDevice_Null::Command> parallelOrder = RenderFrames(frameCount, "Parallel recording");
+	cout << "Parallel recording submission order: " << (IsSameOrder(serialOrder, parallelOrder) ? "same as serial" : "DIFFERENT from serial") << " ("
+		<< parallelOrder.size() << " render target binds, clears and draws)" << endl;
+
+	// The camera and the scene don't move, so after the first frame the shadow maps don't have to be rendered again:
+	wiRenderer::SetShadowMapSkippingEnabled(true);
+	RenderFrames(frameCount, "Shadow map skipping");
+
+	// The physics step run serially and overlapped with the rendering of the frame:
+	if (wiRenderer::physicsEngine == nullptr)
+	{
+		wiRenderer::physicsEngine = new wiBULLET;
+	}
+	PhysicsFrames(frameCount, false, "Serial physics");
+	PhysicsFrames(frameCount, true, "Pipelined physics");
+
+	// The mesh streaming with a moving camera, the chunks are written next to the first cooked model:
+	wiRenderer::SetMeshStreamingEnabled(true);
+	StreamingFrames(frameCount, models.front().first + "streaming/");
+}
+
+static bool Cook(const CookJob& job)
+{
+	// An edited legacy model is cooked from its source files, not from the cooked archive of the last run
+	//	(that is next to them when the output directory is the input directory):
+	Model* model = new Model;
+	model->LoadFromDisk(job.inputDirectory, job.name, "", FileExists(job.inputDirectory + job.name + ".wio"));
+	model->Cook();
+
+	bool success;
+	{
+		wiArchive archive(job.outputDirectory + job.name + ".wimf", false);
+		success = archive.IsOpen();
+		if (success)
+		{
+			archive.SetCompressionEnabled(compress);
+			model->Serialize(archive);
+		}
+	}
+
+	SAFE_DELETE(model);
+	return success;
+}
+
+int main(int argc, char* argv[])
+{
+	bool force = false;
+	int benchmarkFrames = 0;
+	unsigned int threadCount = thread::hardware_concurrency();
+	string outputDirectory;
+	vector<string> inputDirectories;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		string arg = argv[i];
+		if (!arg.compare("-f"))
+		{
+			force = true;
+		}
+		else if (!arg.compare("-c"))
+		{
+			compress = true;
+		}
+		else if (!arg.compare("-j") && i + 1 < argc)
+		{
+			threadCount = (unsigned int)atoi(argv[++i]);
+		}
+		else if (!arg.compare("-o") && i + 1 < argc)
+		{
+			outputDirectory = MakeDirectory(argv[++i]);
+		}
+		else if (!arg.compare("-b") && i + 1 < argc)
+		{
+			benchmarkFrames = atoi(argv[++i]);
+		}
+		else
+		{
+			inputDirectories.push_back(MakeDirectory(arg));
+		}
+	}
+
+	if (inputDirectories.empty())
+	{
+		cout << "Usage: ModelCooker [-f] [-c] [-j threads] [-o output_directory] [-b frames] input_directory [input_directory ...]" << endl;
+		return 1;
+	}
+
+	// The loader creates GPU resources for materials and meshes, but nothing is drawn with them, so the null device is enough:
+	wiRenderer::InitNullDevice();
+
+	// Model loading dispatches jobs, the job system must exist before the cook threads start using it:
+	wiJobSystem::Initialize();
+
+	// Cooked models are written with compressed index lists:
+	Mesh::SetIndexCompressionEnabled(true);
+
+	// Gather the models. Legacy models are identified by their object file, the rest by their archive:
+	vector<CookJob> jobs;
+	vector<pair<string, string> > cookedModels;
+	unordered_map<string, unordered_map<string, uint64_t> > manifests;
+	for (auto& inputDirectory : inputDirectories)
+	{
+		string outDir = outputDirectory.empty() ? inputDirectory : outputDirectory;
+		if (manifests.find(outDir) == manifests.end())
+		{
+			LoadManifest(outDir, manifests[outDir]);
+		}
+
+		vector<string> files;
+		wiHelper::GetFilesInDirectory(files, inputDirectory);
+		vector<string> names;
+		for (auto& file : files)
+		{
+			string fileName = wiHelper::GetFileNameFromPath(file);
+			size_t dot = fileName.rfind('.');
+			if (dot == string::npos)
+			{
+				continue;
+			}
+			string ext = wiHelper::toUpper(fileName.substr(dot));
+			string name = fileName.substr(0, dot);
+			if ((!ext.compare(".WIMF") || !ext.compare(".WIO")) && find(names.begin(), names.end(), name) == names.end())
+			{
+				names.push_back(name);
+			}
+		}
+
+		for (auto& name : names)
+		{
+			CookJob job;
+			job.inputDirectory = inputDirectory;
+			job.outputDirectory = outDir;
+			job.name = name;
+			job.hash = HashModel(inputDirectory, name);
+			cookedModels.push_back(make_pair(outDir, name));
+
+			auto& manifest = manifests[outDir];
+			auto it = manifest.find(inputDirectory + name);
+			if (!force && it != manifest.end() && it->second == job.hash && FileExists(outDir + name + ".wimf"))
+			{
+				cout << "Up to date: " << inputDirectory << name << endl;
+				continue;
+			}
+			jobs.push_back(job);
+		}
+	}
+
+	// Cook in parallel:
+	atomic<size_t> nextJob(0);
+	atomic<int> failed(0);
+	mutex resultLock;
+	vector<thread> workers;
+	if (threadCount == 0 || threadCount > (unsigned int)jobs.size())
+	{
+		threadCount = (unsigned int)jobs.size();
+	}
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		workers.push_back(thread([&] {
+			size_t jobIndex;
+			while ((jobIndex = nextJob.fetch_add(1)) < jobs.size())
+			{
+				const CookJob& job = jobs[jobIndex];
+
+				wiTimer timer;
+				timer.record();
+				bool success = Cook(job);
+				double elapsed = timer.elapsed();
+
+				lock_guard<mutex> lock(resultLock);
+				if (success)
+				{
+					// If the output is written over the source, the cooked file is the new source:
+					manifests[job.outputDirectory][job.inputDirectory + job.name] =
+						job.inputDirectory.compare(job.outputDirectory) ? job.hash : HashModel(job.inputDirectory, job.name);
+					cout << "Cooked: " << job.inputDirectory << job.name << " (" << (int)elapsed << " ms)" << endl;
+				}
+				else
+				{
+					failed++;
+					cout << "Failed: " << job.inputDirectory << job.name << endl;
+				}
+			}
+		}));
+	}
+	for (auto& x : workers)
+	{
+		x.join();
+	}
+
+	for (auto& x : manifests)
+	{
+		SaveManifest(x.first, x.second);
+	}
+
+	cout << jobs.size() - failed << " cooked, " << failed << " failed" << endl;
+
+	const wiIndexCodec::Stats& indexStats = wiIndexCodec::GetStats();
+	if (indexStats.encodedIndices > 0)
+	{
+		cout << "Indices: " << indexStats.encodedIndices << " compressed from " << indexStats.encodedIndices * sizeof(uint32_t) / 1024 << " KB to "
+			<< indexStats.encodedBytes / 1024 << " KB" << endl;
+	}
+	if (indexStats.decodedIndices > 0)
+	{
+		cout << "Index decoding: " << (int)indexStats.GetDecodeThroughput() << " MB/s" << endl;
+	}
+
+	if (benchmarkFrames > 0 && failed == 0)
+	{
+		RenderBenchmark(cookedModels, benchmarkFrames);
+	}
+
+	wiArchive::ShutdownAsyncSaves();
+
+	return failed > 0 ? 1 : 0;
+}
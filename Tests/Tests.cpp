@@ -1,6 +1,1144 @@
 #include "stdafx.h"
 #include "Tests.h"
 
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+using namespace std;
+
+// Writes a 1 GB synthetic archive and compares loading it with and without memory mapping. The results are posted to the backlog.
+static void ArchiveBenchmark()
+{
+	const string fileName = "archive_benchmark.wiarchive";
+	const size_t blockSize = 64 * 1024 * 1024;
+	const size_t blockCount = 16;
+
+	{
+		vector<uint8_t> block(blockSize);
+		for (size_t i = 0; i < blockSize; ++i)
+		{
+			block[i] = (uint8_t)i;
+		}
+		wiArchive archive(fileName, false);
+		archive << blockCount;
+		for (size_t i = 0; i < blockCount; ++i)
+		{
+			archive << block;
+		}
+	}
+
+	// Loading copies every block into its final array, like the bulk arrays of a mesh:
+	vector<uint8_t> destination(blockSize);
+	for (int mapping = 0; mapping < 2; ++mapping)
+	{
+		wiArchive::SetMemoryMappingEnabled(mapping != 0);
+
+		wiTimer timer;
+		timer.record();
+		bool isMapped;
+		{
+			wiArchive archive(fileName, true);
+			isMapped = archive.IsMemoryMapped();
+			size_t count;
+			archive >> count;
+			for (size_t i = 0; i < count; ++i)
+			{
+				uint64_t size;
+				archive >> size;
+				const void* view = archive.ReadView((size_t)size);
+				if (view == nullptr || size > destination.size())
+				{
+					break;
+				}
+				memcpy(destination.data(), view, (size_t)size);
+			}
+		}
+		double elapsed = timer.elapsed();
+
+		stringstream ss("");
+		ss << "Archive load (" << (isMapped ? "memory mapped" : "copied") << "): " << (int)elapsed << " ms, "
+			<< (int)((double)(blockSize * blockCount) / (1024.0 * 1024.0) / (elapsed / 1000.0)) << " MB/s";
+		wiBackLog::post(ss.str().c_str());
+	}
+	wiArchive::SetMemoryMappingEnabled(true);
+
+	// Element by element serialization compared to the bulk array operations, with an index list:
+	const size_t indexCount = 32 * 1024 * 1024;
+	const double indexMB = (double)(indexCount * sizeof(uint32_t)) / (1024.0 * 1024.0);
+	vector<uint32_t> indices(indexCount);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		indices[i] = (uint32_t)i;
+	}
+	for (int bulk = 0; bulk < 2; ++bulk)
+	{
+		wiTimer timer;
+		timer.record();
+		{
+			wiArchive archive(fileName, false);
+			archive.BeginSection("indices");
+			if (bulk)
+			{
+				archive.WriteArray(indices);
+			}
+			else
+			{
+				archive << indices.size();
+				for (auto& x : indices)
+				{
+					archive << x;
+				}
+			}
+			archive.EndSection();
+		}
+		double writeTime = timer.elapsed();
+
+		vector<uint32_t> result;
+		timer.record();
+		{
+			wiArchive archive(fileName, true);
+			archive.BeginSection("indices");
+			if (bulk)
+			{
+				archive.ReadArray(result);
+			}
+			else
+			{
+				size_t count;
+				archive >> count;
+				result.resize(count);
+				for (auto& x : result)
+				{
+					archive >> x;
+				}
+			}
+			archive.EndSection();
+		}
+		double readTime = timer.elapsed();
+
+		stringstream ss("");
+		ss << "Index array " << (bulk ? "bulk" : "per element") << ": write " << (int)(indexMB / (writeTime / 1000.0)) << " MB/s, read "
+			<< (int)(indexMB / (readTime / 1000.0)) << " MB/s" << (result == indices ? "" : " (MISMATCH!)");
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	// Stepping over a section doesn't touch its data:
+	{
+		wiTimer timer;
+		timer.record();
+		wiArchive archive(fileName, true);
+		archive.SkipSection();
+		stringstream ss("");
+		ss << "Index array section skipped: " << timer.elapsed() << " ms";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	remove(fileName.c_str());
+}
+
+// Saves the scene repeatedly, like an autosave would, and measures how long the calling thread is blocked:
+static void AsyncSaveBenchmark()
+{
+	const string fileName = "save_benchmark.wimf";
+	const int saveCount = 16;
+
+	wiRenderer::LoadModel("../models/Stormtrooper/", "Stormtrooper");
+	const Scene& scene = wiRenderer::GetScene();
+
+	for (int async = 0; async < 2; ++async)
+	{
+		double totalStall = 0;
+		double maxStall = 0;
+		size_t fileSize = 0;
+
+		wiTimer completionTimer;
+		completionTimer.record();
+		for (int i = 0; i < saveCount; ++i)
+		{
+			wiTimer timer;
+			timer.record();
+			{
+				wiArchive archive(fileName, false);
+				for (auto& x : scene.models)
+				{
+					x->Serialize(archive);
+				}
+				if (async)
+				{
+					archive.CloseAsync();
+				}
+			}
+			double stall = timer.elapsed();
+			totalStall += stall;
+			maxStall = max(maxStall, stall);
+		}
+		wiArchive::WaitForAsyncSaves();
+		double completion = completionTimer.elapsed();
+
+		ifstream file(fileName, ios::binary | ios::ate);
+		if (file.is_open())
+		{
+			fileSize = (size_t)file.tellg();
+		}
+
+		stringstream ss("");
+		ss << (async ? "Async" : "Blocking") << " save of " << fileSize / 1024 << " KB x " << saveCount << ": average stall " << totalStall / saveCount
+			<< " ms, max stall " << maxStall << " ms, all written in " << (int)completion << " ms";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	remove(fileName.c_str());
+}
+
+// Saves every sample model uncompressed and compressed, then compares the file sizes and the full load times
+static void CompressionBenchmark()
+{
+	struct SampleModel
+	{
+		const char* directory;
+		const char* name;
+	};
+	const SampleModel sampleModels[] = {
+		{ "../models/Stormtrooper/", "Stormtrooper" },
+		{ "../models/Emitter/", "emitter" },
+		{ "../models/Emitter/", "forces" },
+		{ "../models/SoftBody/", "flag" },
+		{ "../models/Sample/", "scene" },
+	};
+	for (auto& sample : sampleModels)
+	{
+		// Written next to the model, so that the textures are found when it is loaded:
+		const string fileName = string(sample.directory) + "compression_benchmark.wimf";
+
+		Model* model = new Model;
+		model->LoadFromDisk(sample.directory, sample.name, "");
+
+		size_t fileSize[2] = {};
+		double loadTime[2] = {};
+		for (int compressed = 0; compressed < 2; ++compressed)
+		{
+			{
+				wiArchive archive(fileName, false);
+				archive.SetCompressionEnabled(compressed != 0);
+				model->Serialize(archive);
+			}
+
+			ifstream file(fileName, ios::binary | ios::ate);
+			if (file.is_open())
+			{
+				fileSize[compressed] = (size_t)file.tellg();
+			}
+			file.close();
+
+			wiTimer timer;
+			timer.record();
+			Model* loaded = new Model;
+			{
+				wiArchive archive(fileName, true);
+				loaded->Serialize(archive);
+			}
+			loadTime[compressed] = timer.elapsed();
+			SAFE_DELETE(loaded);
+		}
+
+		SAFE_DELETE(model);
+
+		stringstream ss("");
+		ss << sample.name << ": " << fileSize[0] / 1024 << " KB -> " << fileSize[1] / 1024 << " KB (ratio "
+			<< (fileSize[1] > 0 ? (double)fileSize[0] / (double)fileSize[1] : 0) << "), load " << loadTime[0] << " ms -> " << loadTime[1] << " ms";
+		wiBackLog::post(ss.str().c_str());
+
+		remove(fileName.c_str());
+	}
+}
+
+// 16 threads request an overlapping set of textures at the same time. Every texture must be loaded once and shared by all of them.
+static void ResourceConcurrencyTest()
+{
+	const int threadCount = 16;
+
+	vector<string> files;
+	wiHelper::GetFilesInDirectory(files, "../models/Sample/textures/");
+	vector<string> textures;
+	for (auto& x : files)
+	{
+		string ext = wiHelper::toUpper(x.substr(x.length() - 3));
+		if (!ext.compare("PNG") || !ext.compare("JPG") || !ext.compare("DDS"))
+		{
+			textures.push_back(x);
+		}
+	}
+
+	// A separate manager, so that the results are not affected by the textures that are already loaded:
+	wiResourceManager* manager = new wiResourceManager;
+
+	vector<vector<void*> > results(threadCount, vector<void*>(textures.size(), nullptr));
+	wiTimer timer;
+	timer.record();
+	vector<thread> threads;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		threads.push_back(thread([&, i] {
+			// Every thread starts at a different texture, and half of them use the asynchronous interface:
+			vector<shared_future<void*> > futures(textures.size());
+			for (size_t j = 0; j < textures.size(); ++j)
+			{
+				size_t index = (j + i * 3) % textures.size();
+				if (i % 2 == 0)
+				{
+					results[i][index] = manager->add(textures[index]);
+				}
+				else
+				{
+					futures[index] = manager->addAsync(textures[index]);
+				}
+			}
+			if (i % 2 != 0)
+			{
+				for (size_t j = 0; j < textures.size(); ++j)
+				{
+					results[i][j] = wiResourceManager::WaitForLoad(futures[j]);
+				}
+			}
+		}));
+	}
+	for (auto& x : threads)
+	{
+		x.join();
+	}
+	double elapsed = timer.elapsed();
+
+	int mismatches = 0;
+	int loaded = 0;
+	for (size_t j = 0; j < textures.size(); ++j)
+	{
+		if (results[0][j] != nullptr)
+		{
+			loaded++;
+		}
+		for (int i = 1; i < threadCount; ++i)
+		{
+			if (results[i][j] != results[0][j])
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	const wiResourceManager::Stats& stats = manager->GetStats();
+	stringstream ss("");
+	ss << threadCount << " threads requested " << textures.size() << " textures in " << (int)elapsed << " ms: " << stats.loads << " loads (expected "
+		<< loaded << "), " << stats.sharedLoads << " waited for an in-flight load, " << stats.hits << " hits, " << mismatches << " mismatches";
+	wiBackLog::post(ss.str().c_str());
+
+	// Every request holds a reference:
+	for (auto& x : textures)
+	{
+		for (int i = 0; i < threadCount; ++i)
+		{
+			manager->del(x);
+		}
+	}
+	SAFE_DELETE(manager);
+}
+
+// Compares resource table lookups with interned wiHashString keys and std::string keys
+static void HashStringBenchmark()
+{
+	const int nameCount = 100000;
+	const int lookupRounds = 10;
+
+	vector<string> names(nameCount);
+	for (int i = 0; i < nameCount; ++i)
+	{
+		stringstream ss("");
+		ss << "../models/Sample/textures/texture_" << i << ".dds";
+		names[i] = ss.str();
+	}
+
+	wiTimer timer;
+	stringstream ss("");
+
+	// The first construction interns the strings, the second only finds them:
+	vector<wiHashString> keys;
+	keys.reserve(nameCount);
+	timer.record();
+	for (auto& x : names)
+	{
+		keys.push_back(wiHashString(x));
+	}
+	ss << "wiHashString: interning " << (int)(timer.elapsed() * 1000000.0 / nameCount) << " ns/string";
+	timer.record();
+	for (auto& x : names)
+	{
+		wiHashString key(x);
+	}
+	ss << ", construction of interned " << (int)(timer.elapsed() * 1000000.0 / nameCount) << " ns/string";
+	wiBackLog::post(ss.str().c_str());
+
+	unordered_map<wiHashString, int> hashMap;
+	unordered_map<string, int> stringMap;
+	for (int i = 0; i < nameCount; ++i)
+	{
+		hashMap[keys[i]] = i;
+		stringMap[names[i]] = i;
+	}
+
+	int found = 0;
+	timer.record();
+	for (int round = 0; round < lookupRounds; ++round)
+	{
+		for (auto& x : keys)
+		{
+			found += hashMap.find(x) != hashMap.end() ? 1 : 0;
+		}
+	}
+	double hashTime = timer.elapsed();
+	timer.record();
+	for (int round = 0; round < lookupRounds; ++round)
+	{
+		for (auto& x : names)
+		{
+			found += stringMap.find(x) != stringMap.end() ? 1 : 0;
+		}
+	}
+	double stringTime = timer.elapsed();
+	timer.record();
+	for (int round = 0; round < lookupRounds * nameCount; ++round)
+	{
+		found += hashMap.find(wiHashLiteral("../models/Sample/textures/texture_0.dds")) != hashMap.end() ? 1 : 0;
+	}
+	double literalTime = timer.elapsed();
+
+	const double lookups = (double)lookupRounds * nameCount;
+	ss.str("");
+	ss << "Lookup: wiHashString " << (int)(hashTime * 1000000.0 / lookups) << " ns, std::string " << (int)(stringTime * 1000000.0 / lookups)
+		<< " ns, literal " << (int)(literalTime * 1000000.0 / lookups) << " ns (" << found << " found)";
+	wiBackLog::post(ss.str().c_str());
+
+	wiHashString::Stats stats = wiHashString::GetStats();
+	ss.str("");
+	ss << "Interned strings: " << stats.strings << " (" << stats.bytes / 1024 << " KB), collisions: " << stats.collisions;
+	wiBackLog::post(ss.str().c_str());
+}
+
+// Drives the memory budget of a separate resource manager with synthetic resource sizes
+static void ResourceBudgetTest()
+{
+	const int resourceCount = 64;
+	const size_t MB = 1024 * 1024;
+	const double gracePeriod = 50;
+
+	wiResourceManager* manager = new wiResourceManager;
+	manager->SetMemoryBudget(32 * MB);
+	manager->SetGracePeriod(gracePeriod);
+
+	// The synthetic resources are DYNAMIC, so the manager doesn't destroy their data:
+	static char data[resourceCount];
+	vector<string> names(resourceCount);
+	size_t totalBytes = 0;
+	for (int i = 0; i < resourceCount; ++i)
+	{
+		stringstream ss("");
+		ss << "synthetic_" << i;
+		names[i] = ss.str();
+		size_t size = (1 + i % 4) * MB;
+		manager->Register(names[i], &data[i], wiResourceManager::DYNAMIC, size);
+		totalBytes += size;
+	}
+
+	const wiResourceManager::Stats& stats = manager->GetStats();
+	stringstream ss("");
+	ss << "Registered " << resourceCount << " resources (" << totalBytes / MB << " MB), budget: " << manager->GetMemoryBudget() / MB
+		<< " MB, resident: " << stats.residentBytes / MB << " MB, evictions: " << stats.evictions << " (expected 0, everything is referenced)";
+	wiBackLog::post(ss.str().c_str());
+
+	// Released resources are cached, and not evicted until the grace period ends:
+	for (auto& x : names)
+	{
+		manager->del(x);
+	}
+	manager->Update();
+	ss.str("");
+	ss << "Released all, resident: " << stats.residentBytes / MB << " MB, evictions: " << stats.evictions << " (expected 0, grace period)";
+	wiBackLog::post(ss.str().c_str());
+
+	// The first ones are requested again, they are hits and become the most recently used:
+	const int revived = 8;
+	for (int i = 0; i < revived; ++i)
+	{
+		manager->get(names[i], true);
+		manager->del(names[i]);
+	}
+	this_thread::sleep_for(chrono::milliseconds((int)gracePeriod + 10));
+	manager->Update();
+
+	int survivors = 0;
+	for (int i = 0; i < revived; ++i)
+	{
+		survivors += manager->get(names[i]) != nullptr ? 1 : 0;
+	}
+	ss.str("");
+	ss << "After the grace period, resident: " << stats.residentBytes / MB << " MB (budget " << manager->GetMemoryBudget() / MB << " MB), evictions: "
+		<< stats.evictions << ", recently used survivors: " << survivors << "/" << revived << ", hits: " << stats.hits;
+	wiBackLog::post(ss.str().c_str());
+
+	// Evicted resources are loaded again on demand:
+	vector<string> files;
+	wiHelper::GetFilesInDirectory(files, "../models/Sample/textures/");
+	for (auto& x : files)
+	{
+		string ext = wiHelper::toUpper(x.substr(x.length() - 3));
+		if (!ext.compare("PNG") || !ext.compare("JPG") || !ext.compare("DDS"))
+		{
+			manager->SetMemoryBudget(1);
+			manager->SetGracePeriod(0);
+			bool first = manager->add(x) != nullptr;
+			manager->del(x);
+			manager->Update();
+			bool evicted = manager->get(x) == nullptr;
+			bool second = manager->add(x) != nullptr;
+			manager->del(x, true);
+			ss.str("");
+			ss << "Reload on demand (" << wiHelper::GetFileNameFromPath(x) << "): loaded " << first << ", evicted " << evicted << ", reloaded " << second
+				<< ", misses: " << stats.misses << ", loads: " << stats.loads;
+			wiBackLog::post(ss.str().c_str());
+			break;
+		}
+	}
+
+	SAFE_DELETE(manager);
+}
+
+// Loads the sample models one after the other like the old single loader thread, then with the loading screen's parallel tasks
+static void LoadingBenchmark()
+{
+	struct SampleModel
+	{
+		const char* directory;
+		const char* name;
+	};
+	const SampleModel sampleModels[] = {
+		{ "../models/Stormtrooper/", "Stormtrooper" },
+		{ "../models/Emitter/", "emitter" },
+		{ "../models/Emitter/", "forces" },
+		{ "../models/SoftBody/", "flag" },
+		{ "../models/Sample/", "scene" },
+	};
+	const int modelCount = (int)(sizeof(sampleModels) / sizeof(sampleModels[0]));
+
+	wiTimer timer;
+	stringstream ss("");
+
+	vector<Model*> models(modelCount, nullptr);
+	timer.record();
+	for (int i = 0; i < modelCount; ++i)
+	{
+		models[i] = new Model;
+		models[i]->LoadFromDisk(sampleModels[i].directory, sampleModels[i].name, "");
+	}
+	const double serialTime = timer.elapsed();
+	for (auto& x : models)
+	{
+		SAFE_DELETE(x);
+	}
+	ss << "Serial loading of " << modelCount << " models: " << (int)serialTime << " ms";
+	wiBackLog::post(ss.str().c_str());
+
+	const uint32_t concurrencies[] = { 2, 0 };
+	for (uint32_t maxConcurrency : concurrencies)
+	{
+		LoadingScreenComponent* loader = new LoadingScreenComponent;
+		loader->setMaxConcurrency(maxConcurrency);
+		for (int i = 0; i < modelCount; ++i)
+		{
+			const SampleModel& sample = sampleModels[i];
+			loader->addLoadingFunction([&models, &sample, i] {
+				models[i] = new Model;
+				models[i]->LoadFromDisk(sample.directory, sample.name, "");
+			}, LoadingScreenComponent::getFileWeight(string(sample.directory) + sample.name + ".wimf"));
+		}
+		atomic<bool> finished(false);
+		loader->onFinished([&] {
+			finished = true;
+		});
+
+		// The weighted percentage is sampled while waiting, it should grow steadily instead of jumping by whole models:
+		vector<int> progress;
+		timer.record();
+		loader->Start();
+		while (!finished.load())
+		{
+			int percentage = loader->getPercentageComplete();
+			if (progress.empty() || progress.back() != percentage)
+			{
+				progress.push_back(percentage);
+			}
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+		const double elapsed = timer.elapsed();
+		SAFE_DELETE(loader);
+		for (auto& x : models)
+		{
+			SAFE_DELETE(x);
+		}
+
+		ss.str("");
+		ss.precision(2);
+		ss << "Parallel loading (max concurrency: " << maxConcurrency << "): " << (int)elapsed << " ms, speedup " << fixed << serialTime / elapsed
+			<< ", progress samples:";
+		for (int x : progress)
+		{
+			ss << " " << x;
+		}
+		wiBackLog::post(ss.str().c_str());
+	}
+}
+
+// Measures the job system: the overhead of empty jobs, ParallelFor scaling with the worker count and nested fork/join
+static void JobSystemBenchmark()
+{
+	const uint32_t emptyJobs = 100000;
+	const uint32_t elementCount = 1 << 22;
+	const uint32_t forkDepth = 16;
+	const uint32_t hardwareThreads = max(1u, thread::hardware_concurrency());
+
+	wiTimer timer;
+	stringstream ss("");
+
+	// Empty jobs, the cost of scheduling alone:
+	{
+		wiJobSystem::Counter counter;
+		timer.record();
+		for (uint32_t i = 0; i < emptyJobs; ++i)
+		{
+			wiJobSystem::Execute(counter, [] {});
+		}
+		wiJobSystem::Wait(counter);
+		ss << "Empty job: " << (int)(timer.elapsed() * 1000000.0 / emptyJobs) << " ns/job with " << wiJobSystem::GetWorkerCount() << " workers";
+		wiBackLog::post(ss.str().c_str());
+	}
+
+	// ParallelFor over the same work with an increasing number of workers:
+	vector<float> data(elementCount);
+	double serialTime = 0;
+	for (uint32_t workers = 1; workers <= hardwareThreads; workers *= 2)
+	{
+		wiJobSystem::Initialize(workers);
+		timer.record();
+		wiJobSystem::ParallelFor(elementCount, 4096, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				float x = (float)i;
+				for (int j = 0; j < 16; ++j)
+				{
+					x = sqrtf(x * 1.0001f + 1.0f);
+				}
+				data[i] = x;
+			}
+		});
+		double elapsed = timer.elapsed();
+		if (workers == 1)
+		{
+			serialTime = elapsed;
+		}
+		ss.str("");
+		ss.precision(2);
+		ss << "ParallelFor " << workers << " workers: " << (int)elapsed << " ms, speedup " << fixed << serialTime / elapsed;
+		wiBackLog::post(ss.str().c_str());
+	}
+	wiJobSystem::Initialize();
+
+	// Every job forks two children and waits for them until the depth is reached, the waits execute the children:
+	atomic<uint32_t> leaves(0);
+	function<void(uint32_t)> fork = [&](uint32_t depth) {
+		if (depth == forkDepth)
+		{
+			leaves++;
+			return;
+		}
+		wiJobSystem::Counter counter;
+		wiJobSystem::Execute(counter, [&, depth] { fork(depth + 1); });
+		wiJobSystem::Execute(counter, [&, depth] { fork(depth + 1); });
+		wiJobSystem::Wait(counter);
+	};
+	timer.record();
+	fork(0);
+	double elapsed = timer.elapsed();
+	ss.str("");
+	ss << "Fork/join depth " << forkDepth << ": " << (int)elapsed << " ms, " << leaves.load() << " leaves (expected " << (1u << forkDepth) << ")";
+	wiBackLog::post(ss.str().c_str());
+
+	// Dependencies: the second stage starts after the first one, the third after the second:
+	atomic<uint32_t> firstStage(0);
+	bool secondStage = false;
+	bool ordered = false;
+	wiJobSystem::Counter first, second, third;
+	wiJobSystem::Dispatch(first, 64, 1, [&](uint32_t i) { firstStage++; });
+	wiJobSystem::ExecuteAfter(first, second, [&] { secondStage = firstStage.load() == 64; });
+	wiJobSystem::ExecuteAfter(second, third, [&] { ordered = secondStage; });
+	wiJobSystem::Wait(third);
+	ss.str("");
+	ss << "Dependencies: " << (ordered ? "ok" : "FAILED");
+	wiBackLog::post(ss.str().c_str());
+}
+
+// Process CPU time (user and kernel) in milliseconds
+static double GetProcessCPUTime()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+	return (double)(kernel.QuadPart + user.QuadPart) / 10000.0;
+}
+
+// The lock that wiSpinLock used to be, for comparison:
+class BusySpinLock
+{
+	std::atomic_flag lck = ATOMIC_FLAG_INIT;
+public:
+	void lock()
+	{
+		while (lck.test_and_set(std::memory_order_acquire)) {}
+	}
+	void unlock()
+	{
+		lck.clear(std::memory_order_release);
+	}
+};
+
+// Runs threadCount threads that increment a shared counter under the lock, returns the wall clock and the process CPU time in ms
+template<typename LockType>
+static void MeasureLock(LockType& lock, int threadCount, int iterations, double& wallTime, double& cpuTime)
+{
+	uint64_t sharedCounter = 0;
+	double cpuBegin = GetProcessCPUTime();
+	wiTimer timer;
+	timer.record();
+	vector<thread> threads;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		threads.push_back(thread([&] {
+			volatile uint32_t work = 0;
+			for (int j = 0; j < iterations; ++j)
+			{
+				lock.lock();
+				sharedCounter++;
+				lock.unlock();
+				// Some work outside of the lock:
+				for (int k = 0; k < 50; ++k)
+				{
+					work = work + k;
+				}
+			}
+		}));
+	}
+	for (auto& x : threads)
+	{
+		x.join();
+	}
+	wallTime = timer.elapsed();
+	cpuTime = GetProcessCPUTime() - cpuBegin;
+	if (sharedCounter != (uint64_t)threadCount * iterations)
+	{
+		wiBackLog::post("Lock benchmark: the counter is wrong, the lock is broken!");
+	}
+}
+
+// Compares the throughput and the CPU time of the locks with 2-32 threads
+static void SpinLockBenchmark()
+{
+	const int totalIterations = 2000000;
+
+	for (int threadCount = 2; threadCount <= 32; threadCount *= 2)
+	{
+		const int iterations = totalIterations / threadCount;
+		stringstream ss("");
+		ss << threadCount << " threads:";
+
+		double wallTime, cpuTime;
+		{
+			BusySpinLock lock;
+			MeasureLock(lock, threadCount, iterations, wallTime, cpuTime);
+			ss << " busy spin " << (int)(totalIterations / wallTime) << " ops/ms, " << (int)cpuTime << " ms CPU /";
+		}
+		{
+			std::mutex lock;
+			MeasureLock(lock, threadCount, iterations, wallTime, cpuTime);
+			ss << " std::mutex " << (int)(totalIterations / wallTime) << " ops/ms, " << (int)cpuTime << " ms CPU /";
+		}
+		{
+			wiSpinLock lock;
+			MeasureLock(lock, threadCount, iterations, wallTime, cpuTime);
+			const wiSpinLock::Stats& stats = lock.GetStats();
+			ss << " wiSpinLock " << (int)(totalIterations / wallTime) << " ops/ms, " << (int)cpuTime << " ms CPU (contended: " << stats.contended
+				<< ", acquired spinning: " << stats.spinAcquired << ", parked: " << stats.parked << ")";
+		}
+		wiBackLog::post(ss.str().c_str());
+	}
+}
+
+// Packs world matrices into instance data: scalar transposes (as RenderMeshes used to), SIMD transposes,
+//	and SIMD transposes written straight into the mapped dynamic vertex buffer pool
+static void InstancePackingBenchmark()
+{
+	const int instanceCount = 100000;
+	const int rounds = 10;
+	const int chunkSize = 4096;
+
+	vector<XMFLOAT4X4> worlds(instanceCount);
+	for (int i = 0; i < instanceCount; ++i)
+	{
+		XMStoreFloat4x4(&worlds[i], XMMatrixRotationY((float)i) * XMMatrixTranslation((float)(i % 100), 0, (float)(i / 100)));
+	}
+	vector<Instance> instances(instanceCount);
+	const XMFLOAT3 color(1, 1, 1);
+
+	wiTimer timer;
+	timer.record();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (int i = 0; i < instanceCount; ++i)
+		{
+			const XMFLOAT4X4& m = worlds[i];
+			instances[i].mat0 = XMFLOAT4A(m._11, m._21, m._31, m._41);
+			instances[i].mat1 = XMFLOAT4A(m._12, m._22, m._32, m._42);
+			instances[i].mat2 = XMFLOAT4A(m._13, m._23, m._33, m._43);
+			instances[i].color_dither = XMFLOAT4A(color.x, color.y, color.z, 0);
+		}
+	}
+	double scalarTime = timer.elapsed();
+
+	timer.record();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (int i = 0; i < instanceCount; ++i)
+		{
+			instances[i].Create(XMLoadFloat4x4(&worlds[i]), 0, color);
+		}
+	}
+	double simdTime = timer.elapsed();
+
+	wiGraphicsTypes::GraphicsDevice* device = wiRenderer::GetDevice();
+	timer.record();
+	for (int round = 0; round < rounds; ++round)
+	{
+		for (int i = 0; i < instanceCount; i += chunkSize)
+		{
+			const int count = min(chunkSize, instanceCount - i);
+			UINT offset;
+			Instance* mapped = (Instance*)device->AllocateFromRingBuffer(wiRenderer::dynamicVertexBufferPool, sizeof(Instance) * count, offset, GRAPHICSTHREAD_IMMEDIATE);
+			for (int j = 0; j < count; ++j)
+			{
+				mapped[j].Create(XMLoadFloat4x4(&worlds[i + j]), 0, color);
+			}
+			device->InvalidateBufferAccess(wiRenderer::dynamicVertexBufferPool, GRAPHICSTHREAD_IMMEDIATE);
+		}
+	}
+	double mappedTime = timer.elapsed();
+
+	const double packed = (double)instanceCount * rounds;
+	const double megabytes = packed * sizeof(Instance) / (1024.0 * 1024.0);
+	stringstream ss("");
+	ss << "Instance packing: scalar " << (int)(packed / scalarTime) << " instances/ms (" << (int)(megabytes / scalarTime * 1000) << " MB/s), SIMD "
+		<< (int)(packed / simdTime) << " instances/ms (" << (int)(megabytes / simdTime * 1000) << " MB/s), SIMD into the ring buffer "
+		<< (int)(packed / mappedTime) << " instances/ms (" << (int)(megabytes / mappedTime * 1000) << " MB/s)";
+	wiBackLog::post(ss.str().c_str());
+}
+
+static void MaterialTableBenchmark()
+{
+	const int materialCount = 10000;
+	const int changedCount = 100;
+	const GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE;
+
+	vector<Material*> materials(materialCount);
+	for (int i = 0; i < materialCount; ++i)
+	{
+		materials[i] = new Material;
+		materials[i]->roughness = (float)i / (float)materialCount;
+	}
+
+	// Every new material is dirty, so the whole table is uploaded first:
+	wiRenderer::ExtractMaterialTable();
+	wiRenderer::UpdateMaterialTable(threadID);
+	const wiRenderer::MaterialTableStats allStats = wiRenderer::GetMaterialTableStats();
+
+	wiRenderer::ExtractMaterialTable();
+	wiRenderer::UpdateMaterialTable(threadID);
+	const wiRenderer::MaterialTableStats cleanStats = wiRenderer::GetMaterialTableStats();
+
+	for (int i = 0; i < materialCount; i += materialCount / changedCount)
+	{
+		materials[i]->roughness = 0.5f;
+		materials[i]->SetDirty();
+	}
+	wiRenderer::ExtractMaterialTable();
+	wiRenderer::UpdateMaterialTable(threadID);
+	const wiRenderer::MaterialTableStats changedStats = wiRenderer::GetMaterialTableStats();
+
+	// What it costs to find the changed materials by comparing all of them every frame:
+	vector<ShaderMaterial> cached(materialCount);
+	wiTimer timer;
+	int changed = 0;
+	for (int i = 0; i < materialCount; ++i)
+	{
+		ShaderMaterial current;
+		materials[i]->CreateShaderMaterial(current);
+		if (memcmp(&cached[i], &current, sizeof(ShaderMaterial)) != 0)
+		{
+			cached[i] = current;
+			changed++;
+		}
+	}
+	double compareTime = timer.elapsed();
+
+	for (Material* material : materials)
+	{
+		delete material;
+	}
+
+	stringstream ss("");
+	ss << "Material table with " << allStats.materials << " materials:" << endl;
+	ss << "  all dirty: " << allStats.updateTime << " ms, " << allStats.uploads << " uploads, " << allStats.uploadedBytes / 1024 << " KB" << endl;
+	ss << "  none dirty: " << cleanStats.updateTime << " ms, " << cleanStats.uploads << " uploads" << endl;
+	ss << "  " << changedStats.updatedMaterials << " dirty: " << changedStats.updateTime << " ms, " << changedStats.uploads << " uploads, "
+		<< changedStats.uploadedBytes << " bytes" << endl;
+	ss << "  comparing every material: " << compareTime << " ms (" << changed << " changed)";
+	wiBackLog::post(ss.str().c_str());
+}
+
+static void EntityArrayBenchmark()
+{
+	const int lightCount = 4096;
+	const int decalCount = 1024;
+	const int rounds = 100;
+
+	vector<Light*> lightObjects;
+	CulledList lights;
+	for (int i = 0; i < lightCount; ++i)
+	{
+		Light* light = new Light;
+		lightObjects.push_back(light);
+		light->SetType((Light::LightType)(i % Light::LIGHTTYPE_COUNT));
+		light->translation = XMFLOAT3((float)(i % 64), 2, (float)(i / 64));
+		light->enerDis = XMFLOAT4(1, 10, XM_PIDIV4, 0);
+		light->radius = light->width = light->height = 1;
+		lights.push_front(light);
+	}
+	list<Decal*> decals;
+	for (int i = 0; i < decalCount; ++i)
+	{
+		decals.push_back(new Decal(XMFLOAT3((float)(i % 32), 0, (float)(i / 32)), XMFLOAT3(2, 2, 2)));
+	}
+
+	ShaderEntityType* entityArray = (ShaderEntityType*)_mm_malloc(sizeof(ShaderEntityType) * (lightCount + decalCount), 16);
+	XMMATRIX* matrixArray = (XMMATRIX*)_mm_malloc(sizeof(XMMATRIX) * decalCount, 16);
+	const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 10, -10, 1), XMVectorSet(32, 0, 32, 1), XMVectorSet(0, 1, 0, 0));
+	UINT matrixCount;
+
+	// The first build computes the inverse matrices of the decals, the later ones reuse them:
+	wiTimer timer;
+	UINT entityCount = wiRenderer::BuildEntityArray(lights, decals, view, entityArray, lightCount + decalCount, matrixArray, decalCount, matrixCount);
+	double firstTime = timer.elapsed();
+
+	timer.record();
+	for (int round = 0; round < rounds; ++round)
+	{
+		wiRenderer::BuildEntityArray(lights, decals, view, entityArray, lightCount + decalCount, matrixArray, decalCount, matrixCount);
+	}
+	double parallelTime = timer.elapsed() / rounds;
+	const uint32_t workerCount = wiJobSystem::GetWorkerCount();
+
+	wiJobSystem::Initialize(1);
+	timer.record();
+	for (int round = 0; round < rounds; ++round)
+	{
+		wiRenderer::BuildEntityArray(lights, decals, view, entityArray, lightCount + decalCount, matrixArray, decalCount, matrixCount);
+	}
+	double serialTime = timer.elapsed() / rounds;
+	wiJobSystem::Initialize();
+
+	_mm_free(entityArray);
+	_mm_free(matrixArray);
+	for (Light* x : lightObjects)
+	{
+		delete x;
+	}
+	for (Decal* x : decals)
+	{
+		delete x;
+	}
+
+	stringstream ss("");
+	ss << "Entity array of " << entityCount << " entities (" << lightCount << " lights, " << decalCount << " decals):" << endl;
+	ss << "  first build: " << firstTime << " ms" << endl;
+	ss << "  " << workerCount << " workers: " << parallelTime << " ms, 1 worker: " << serialTime << " ms";
+	wiBackLog::post(ss.str().c_str());
+}
+
+// Uploads a frame worth of data through an upload allocator with small pages and through one ring buffer of the same size
+static void UploadAllocatorBenchmark()
+{
+	using namespace wiGraphicsTypes;
+
+	const int allocationCount = 10000;
+	const size_t pageSize = 256 * 1024;
+	const GRAPHICSTHREAD threadID = GRAPHICSTHREAD_IMMEDIATE;
+	GraphicsDevice* device = wiRenderer::GetDevice();
+
+	// From a few instances to a soft body mesh, and one upload that is bigger than a page:
+	vector<size_t> sizes(allocationCount);
+	size_t totalSize = 0;
+	for (int i = 0; i < allocationCount; ++i)
+	{
+		sizes[i] = 64 * (1 + (i * 7919) % 64);
+		if (i == allocationCount / 2)
+		{
+			sizes[i] = pageSize * 3;
+		}
+		totalSize += sizes[i];
+	}
+	vector<uint8_t> data(pageSize * 3);
+
+	wiUploadAllocator allocator;
+	allocator.Initialize(device, BIND_VERTEX_BUFFER, pageSize);
+	unordered_map<GPUBuffer*, size_t> pageEnds;
+	int overlaps = 0;
+	wiTimer timer;
+	for (size_t size : sizes)
+	{
+		const wiUploadAllocator::Allocation allocation = allocator.Upload(data.data(), size, threadID);
+		size_t& end = pageEnds[allocation.buffer];
+		if (allocation.offset < end)
+		{
+			overlaps++;
+		}
+		end = allocation.offset + size;
+	}
+	double allocatorTime = timer.elapsed();
+	const wiUploadAllocator::Stats stats = allocator.GetStats();
+	allocator.Release();
+
+	// The ring buffer starts over when it is full and overwrites the data of the same frame:
+	GPURingBuffer ring;
+	GPUBufferDesc desc;
+	desc.ByteWidth = (UINT)(pageSize * 4);
+	desc.Usage = USAGE_DYNAMIC;
+	desc.BindFlags = BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+	device->CreateBuffer(&desc, nullptr, &ring);
+	const uint64_t generation = ring.GetGeneration();
+	timer.record();
+	for (size_t size : sizes)
+	{
+		device->AppendRingBuffer(&ring, data.data(), min(size, (size_t)desc.ByteWidth - 1), threadID);
+	}
+	double ringTime = timer.elapsed();
+	const uint64_t wraps = ring.GetGeneration() - generation - 1; // the first append of the frame also starts it over
+
+	stringstream ss("");
+	ss << allocationCount << " uploads, " << totalSize / 1024 << " KB:" << endl;
+	ss << "  upload allocator: " << allocatorTime << " ms, " << stats.pagesCreated << " pages created (" << stats.pageBytes / 1024 << " KB), "
+		<< overlaps << " overlapping allocations" << endl;
+	ss << "  " << desc.ByteWidth / 1024 << " KB ring buffer: " << ringTime << " ms, wrapped " << wraps << " times over the data of the frame";
+	wiBackLog::post(ss.str().c_str());
+}
+
+// Reads every compiled shader through a shader cache of its own (the engine's cache is not changed): cold from the shader
+//	files, warm from the cache file with and without validating the files, and checks the bytecode against the files.
+//	The time it took the renderer to load its startup shaders is posted too.
+static void ShaderCacheBenchmark()
+{
+	vector<string> files;
+	wiHelper::GetFilesInDirectory(files, wiRenderer::SHADERPATH);
+	vector<string> shaders;
+	for (auto& file : files)
+	{
+		const string upper = wiHelper::toUpper(file);
+		if (upper.length() > 4 && !upper.compare(upper.length() - 4, 4, ".CSO"))
+		{
+			shaders.push_back(file);
+		}
+	}
+	const string cacheName = wiRenderer::SHADERPATH + "benchmark.wicache";
+	remove(cacheName.c_str());
+
+	wiTimer timer;
+	vector<BYTE> bytecode;
+	double coldTime;
+	wiShaderCache::Stats coldStats;
+	{
+		wiShaderCache cache;
+		cache.Open(cacheName);
+		timer.record();
+		for (auto& x : shaders)
+		{
+			cache.GetBytecode(x, bytecode);
+		}
+		coldTime = timer.elapsed();
+		coldStats = cache.GetStats();
+		cache.Save();
+	}
+	wiArchive::WaitForAsyncSaves();
+
+	double warmTimes[2];
+	wiShaderCache::Stats warmStats[2];
+	int mismatches = 0;
+	for (int validation = 1; validation >= 0; --validation)
+	{
+		wiShaderCache cache;
+		cache.SetValidationEnabled(validation != 0);
+		timer.record();
+		cache.Open(cacheName);
+		for (auto& x : shaders)
+		{
+			cache.GetBytecode(x, bytecode);
+		}
+		warmTimes[validation] = timer.elapsed();
+		warmStats[validation] = cache.GetStats();
+
+		if (validation)
+		{
+			for (auto& x : shaders)
+			{
+				BYTE* data;
+				size_t dataSize;
+				if (cache.GetBytecode(x, bytecode) && wiHelper::readByteData(x, &data, dataSize))
+				{
+					if (dataSize != bytecode.size() || memcmp(data, bytecode.data(), dataSize) != 0)
+					{
+						mismatches++;
+					}
+					delete[] data;
+				}
+			}
+		}
+	}
+	remove(cacheName.c_str());
+
+	const wiRenderer::ShaderLoadingStats& loadingStats = wiRenderer::GetShaderLoadingStats();
+
+	stringstream ss("");
+	ss << shaders.size() << " shaders, " << coldStats.missBytes / 1024 << " KB of bytecode:" << endl;
+	ss << "  cold (shader files): " << coldTime << " ms, " << coldStats.misses << " files read" << endl;
+	ss << "  warm (cache file, validated): " << warmTimes[1] << " ms (open: " << warmStats[1].openTime << " ms), " << warmStats[1].hits << " hits, "
+		<< warmStats[1].misses + warmStats[1].stale << " files read, " << mismatches << " mismatching shaders" << endl;
+	ss << "  warm (cache file, not validated): " << warmTimes[0] << " ms, " << warmStats[0].hits << " hits" << endl;
+	ss << "Renderer startup: " << loadingStats.startupTime << " ms to load " << loadingStats.requested - loadingStats.permutations
+		<< " shaders on the job system, " << loadingStats.permutations << " permutations loaded on first use, " << loadingStats.failed << " failed";
+	wiBackLog::post(ss.str().c_str());
+}
+
 
 Tests::Tests()
 {
@@ -54,6 +1192,20 @@ TestsRenderer::TestsRenderer()
 	testSelector->AddItem("Lua Script");
 	testSelector->AddItem("Soft Body");
 	testSelector->AddItem("Emitter");
+	testSelector->AddItem("Archive Benchmark");
+	testSelector->AddItem("Async Save Benchmark");
+	testSelector->AddItem("Compression Benchmark");
+	testSelector->AddItem("Resource Concurrency Test");
+	testSelector->AddItem("Hash String Benchmark");
+	testSelector->AddItem("Resource Budget Test");
+	testSelector->AddItem("Job System Benchmark");
+	testSelector->AddItem("Loading Benchmark");
+	testSelector->AddItem("Spin Lock Benchmark");
+	testSelector->AddItem("Instance Packing Benchmark");
+	testSelector->AddItem("Material Table Benchmark");
+	testSelector->AddItem("Entity Array Benchmark");
+	testSelector->AddItem("Upload Allocator Benchmark");
+	testSelector->AddItem("Shader Cache Benchmark");
 	testSelector->OnSelect([=](wiEventArgs args) {
 
 		wiRenderer::ClearWorld();
@@ -84,6 +1236,62 @@ TestsRenderer::TestsRenderer()
 		case 4:
 			wiRenderer::LoadModel("../models/Emitter/", "emitter")->Translate(XMFLOAT3(0, 2, 2));
 			break;
+		case 5:
+			ArchiveBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 6:
+			AsyncSaveBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 7:
+			CompressionBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 8:
+			ResourceConcurrencyTest();
+			wiBackLog::Toggle();
+			break;
+		case 9:
+			HashStringBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 10:
+			ResourceBudgetTest();
+			wiBackLog::Toggle();
+			break;
+		case 11:
+			JobSystemBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 12:
+			LoadingBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 13:
+			SpinLockBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 14:
+			InstancePackingBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 15:
+			MaterialTableBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 16:
+			EntityArrayBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 17:
+			UploadAllocatorBenchmark();
+			wiBackLog::Toggle();
+			break;
+		case 18:
+			ShaderCacheBenchmark();
+			wiBackLog::Toggle();
+			break;
 		}
 
 	});
@@ -94,15 +94,12 @@ void DeferredRenderableComponent::Render()
 {
 	if (getThreadingCount() > 1)
 	{
-		for (auto workerThread : workerThreads)
+		wiJobSystem::Counter counter;
+		for (auto& task : workerTasks)
 		{
-			workerThread->wakeup();
-		}
-
-		for (auto workerThread : workerThreads)
-		{
-			workerThread->wait();
+			wiJobSystem::Execute(counter, task);
 		}
+		wiJobSystem::Wait(counter);
 
 		wiRenderer::GetDevice()->ExecuteDeferredContexts();
 	}
@@ -125,7 +122,7 @@ void DeferredRenderableComponent::RenderScene(GRAPHICSTHREAD threadID)
 {
 	wiProfiler::GetInstance().BeginRange("Opaque Scene", wiProfiler::DOMAIN_GPU, threadID);
 
-	wiRenderer::UpdateCameraCB(wiRenderer::getCamera(), threadID);
+	wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
 
 	wiImageEffects fx((float)wiRenderer::GetInternalResolution().x, (float)wiRenderer::GetInternalResolution().y);
 
@@ -306,13 +303,13 @@ void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short valu
 
 	switch (value){
 	case 2:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
@@ -321,24 +318,24 @@ void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short valu
 			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_SCENE);
 			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
+		});
 		break;
 	case 3:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			RenderShadows(GRAPHICSTHREAD_SCENE);
 			RenderScene(GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
@@ -347,24 +344,24 @@ void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short valu
 			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_MISC1);
 			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_MISC1);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
+		});
 		break;
 	case 4:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			RenderShadows(GRAPHICSTHREAD_SCENE);
 			RenderScene(GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
@@ -372,8 +369,8 @@ void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short valu
 			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
 			RenderSecondaryScene(rtGBuffer, GetFinalRT(), GRAPHICSTHREAD_MISC1);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1); 
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
@@ -381,7 +378,7 @@ void DeferredRenderableComponent::setPreferredThreadingCount(unsigned short valu
 			wiRenderer::UpdateGBuffer(rtGBuffer.GetTexture(0), rtGBuffer.GetTexture(1), rtGBuffer.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
 			RenderComposition(GetFinalRT(), rtGBuffer, GRAPHICSTHREAD_MISC2);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
-		}));
+		});
 		break;
 	};
 }
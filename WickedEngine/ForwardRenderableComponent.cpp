@@ -69,16 +69,12 @@ void ForwardRenderableComponent::Render()
 {
 	if (getThreadingCount() > 1)
 	{
-
-		for (auto workerThread : workerThreads)
-		{
-			workerThread->wakeup();
-		}
-
-		for (auto workerThread : workerThreads)
+		wiJobSystem::Counter counter;
+		for (auto& task : workerTasks)
 		{
-			workerThread->wait();
+			wiJobSystem::Execute(counter, task);
 		}
+		wiJobSystem::Wait(counter);
 
 		wiRenderer::GetDevice()->ExecuteDeferredContexts();
 	}
@@ -100,7 +96,7 @@ void ForwardRenderableComponent::RenderScene(GRAPHICSTHREAD threadID)
 {
 	wiProfiler::GetInstance().BeginRange("Opaque Scene", wiProfiler::DOMAIN_GPU, threadID);
 
-	wiRenderer::UpdateCameraCB(wiRenderer::getCamera(), threadID);
+	wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
 
 	rtMain.Activate(threadID, 0, 0, 0, 0);
 	{
@@ -146,13 +142,13 @@ void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value
 
 	switch (value) {
 	case 2:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
@@ -161,24 +157,24 @@ void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value
 			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_SCENE);
 			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
+		});
 		break;
 	case 3:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			RenderShadows(GRAPHICSTHREAD_SCENE);
 			RenderScene(GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
@@ -187,24 +183,24 @@ void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value
 			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
 			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
+		});
 		break;
 	case 4:
-		workerThreads.push_back(new wiTaskThread([&]
+		workerTasks.push_back([&]
 		{
 			RenderFrameSetUp(GRAPHICSTHREAD_REFLECTIONS);
 			RenderReflections(GRAPHICSTHREAD_REFLECTIONS);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_REFLECTIONS);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_SCENE);
 			RenderShadows(GRAPHICSTHREAD_SCENE);
 			RenderScene(GRAPHICSTHREAD_SCENE);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_SCENE);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC1);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC1);
@@ -212,8 +208,8 @@ void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value
 			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC1);
 			RenderSecondaryScene(rtMain, rtMain, GRAPHICSTHREAD_MISC1);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC1);
-		}));
-		workerThreads.push_back(new wiTaskThread([&]
+		});
+		workerTasks.push_back([&]
 		{
 			wiRenderer::BindPersistentState(GRAPHICSTHREAD_MISC2);
 			wiImage::BindPersistentState(GRAPHICSTHREAD_MISC2);
@@ -221,7 +217,7 @@ void ForwardRenderableComponent::setPreferredThreadingCount(unsigned short value
 			wiRenderer::UpdateGBuffer(rtMain.GetTexture(0), rtMain.GetTexture(1), rtMain.GetTexture(2), nullptr, nullptr, GRAPHICSTHREAD_MISC2);
 			RenderComposition(rtMain, rtMain, GRAPHICSTHREAD_MISC2);
 			wiRenderer::GetDevice()->FinishCommandList(GRAPHICSTHREAD_MISC2);
-		}));
+		});
 		break;
 	};
 
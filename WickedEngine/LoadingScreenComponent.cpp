@@ -1,17 +1,21 @@
 #include "LoadingScreenComponent.h"
 #include "MainComponent.h"
 
+#include <fstream>
+
 using namespace std;
 
 LoadingScreenComponent::LoadingScreenComponent() : Renderable2DComponent()
 {
 	loaders.clear();
 	finish = nullptr;
+	maxConcurrency = 0;
 }
 
 
 LoadingScreenComponent::~LoadingScreenComponent()
 {
+	joinWorkers();
 }
 
 bool LoadingScreenComponent::isActive()
@@ -26,12 +30,36 @@ bool LoadingScreenComponent::isActive()
 	return false;
 }
 
-void LoadingScreenComponent::addLoadingFunction(function<void()> loadingFunction)
+int LoadingScreenComponent::addLoadingFunction(function<void()> loadingFunction, float weight, const vector<int>& dependencies)
+{
+	if (loadingFunction == nullptr)
+	{
+		return -1;
+	}
+	return addLoadingFunctionWithProgress([=](atomic<float>& progress) {
+		loadingFunction();
+	}, weight, dependencies);
+}
+
+int LoadingScreenComponent::addLoadingFunctionWithProgress(function<void(atomic<float>&)> loadingFunction, float weight, const vector<int>& dependencies)
 {
-	if (loadingFunction != nullptr)
+	if (loadingFunction == nullptr)
+	{
+		return -1;
+	}
+
+	// Only earlier tasks can be dependencies, so there can't be cycles:
+	const int index = (int)loaders.size();
+	vector<int> validDependencies;
+	for (int x : dependencies)
 	{
-		loaders.push_back(LoaderTask(loadingFunction));
+		if (x >= 0 && x < index)
+		{
+			validDependencies.push_back(x);
+		}
 	}
+	loaders.push_back(LoaderTask(loadingFunction, weight > 0 ? weight : 0, validDependencies));
+	return index;
 }
 
 void LoadingScreenComponent::addLoadingComponent(RenderableComponent* component, MainComponent* main)
@@ -52,46 +80,125 @@ void LoadingScreenComponent::onFinished(function<void()> finishFunction)
 		finish = finishFunction;
 }
 
-void LoadingScreenComponent::waitForFinish()
-{
-	worker.join();
-	if (finish != nullptr)
-		finish();
-}
-
-void LoadingScreenComponent::doLoadingTasks()
+int LoadingScreenComponent::getPercentageComplete()
 {
-	std::vector<thread> loaderThreads(0);
+	float totalWeight = 0;
+	float completed = 0;
 
 	for (LoaderTask& x : loaders)
 	{
-		x.active.store(true);
-		loaderThreads.push_back(thread(x.functionBody));
+		float progress = x.progress.load();
+		progress = progress < 0 ? 0 : (progress > 1 ? 1 : progress);
+		totalWeight += x.weight;
+		completed += x.weight * progress;
 	}
 
-	int i = 0;
-	for (thread& x : loaderThreads)
+	if (totalWeight <= 0)
 	{
-		x.join();
-		loaders[i].active.store(false);
-		i++;
+		return isActive() ? 0 : 100;
 	}
+	return (int)(completed / totalWeight * 100.f);
 }
 
-int LoadingScreenComponent::getPercentageComplete()
+float LoadingScreenComponent::getFileWeight(const string& fileName)
 {
-	const int numberOfLoaders = (int)loaders.size();
-	int completed = 0;
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		return 1.0f;
+	}
+	// Small files still have a cost to open and parse:
+	float megabytes = (float)file.tellg() / (1024.0f * 1024.0f);
+	return megabytes > 0.01f ? megabytes : 0.01f;
+}
 
-	for (LoaderTask& x : loaders)
+void LoadingScreenComponent::runWorker()
+{
+	unique_lock<mutex> lock(locker);
+	while (true)
 	{
-		if (!x.active.load())
+		// Take the first task whose dependencies are finished:
+		int index = -1;
+		bool allFinished = true;
+		for (size_t i = 0; i < loaders.size(); ++i)
 		{
-			completed++;
+			LoaderTask& task = loaders[i];
+			allFinished = allFinished && task.finished;
+			if (index >= 0 || task.started)
+			{
+				continue;
+			}
+			bool ready = true;
+			for (int x : task.dependencies)
+			{
+				ready = ready && loaders[x].finished;
+			}
+			if (ready)
+			{
+				index = (int)i;
+			}
+		}
+
+		if (index < 0)
+		{
+			if (allFinished)
+			{
+				return;
+			}
+			// The remaining tasks wait for the running ones:
+			taskFinished.wait(lock);
+			continue;
+		}
+
+		LoaderTask& task = loaders[index];
+		task.started = true;
+		lock.unlock();
+		task.functionBody(task.progress);
+		task.progress.store(1);
+		lock.lock();
+
+		task.finished = true;
+		task.active.store(false);
+		taskFinished.notify_all();
+
+		bool lastTask = true;
+		for (auto& x : loaders)
+		{
+			lastTask = lastTask && x.finished;
+		}
+		if (lastTask)
+		{
+			// The finish function may stop the component, which clears the tasks and the function itself:
+			function<void()> finishFunction = finish;
+			lock.unlock();
+			if (finishFunction != nullptr)
+			{
+				finishFunction();
+			}
+			return;
 		}
 	}
+}
 
-	return (int)(((float)completed / (float)numberOfLoaders)*100.f);
+void LoadingScreenComponent::joinWorkers()
+{
+	for (auto& x : workers)
+	{
+		if (!x.joinable())
+		{
+			continue;
+		}
+		if (x.get_id() == this_thread::get_id())
+		{
+			// The finish function started the loading again:
+			x.detach();
+		}
+		else
+		{
+			x.join();
+		}
+	}
+	workers.clear();
 }
 
 void LoadingScreenComponent::Unload()
@@ -101,15 +208,48 @@ void LoadingScreenComponent::Unload()
 
 void LoadingScreenComponent::Start()
 {
-	worker = thread(&LoadingScreenComponent::doLoadingTasks, this);
-	thread(&LoadingScreenComponent::waitForFinish, this).detach();
+	joinWorkers();
+
+	for (LoaderTask& x : loaders)
+	{
+		x.progress.store(0);
+		x.active.store(true);
+		x.started = false;
+		x.finished = false;
+	}
+
+	if (loaders.empty())
+	{
+		if (finish != nullptr)
+		{
+			workers.push_back(thread(finish));
+		}
+	}
+	else
+	{
+		// Without a limit there is a thread for every task that can run, but not more than the hardware threads:
+		uint32_t threadCount = maxConcurrency;
+		if (threadCount == 0)
+		{
+			threadCount = max(1u, thread::hardware_concurrency());
+		}
+		threadCount = min(threadCount, (uint32_t)loaders.size());
+		for (uint32_t i = 0; i < threadCount; ++i)
+		{
+			workers.push_back(thread(&LoadingScreenComponent::runWorker, this));
+		}
+	}
 
 	Renderable2DComponent::Start();
 }
 
 void LoadingScreenComponent::Stop()
 {
-	loaders.clear();
+	{
+		// The threads that are still running look at the tasks:
+		lock_guard<mutex> lock(locker);
+		loaders.clear();
+	}
 	finish = nullptr;
 
 	Renderable2DComponent::Stop();
@@ -1,9 +1,11 @@
 #pragma once
 #include "Renderable2DComponent.h"
 
-#include <thread>
 #include <functional>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 class MainComponent;
 
@@ -13,47 +15,76 @@ class LoadingScreenComponent :
 private:
 	struct LoaderTask
 	{
-		std::function< void() > functionBody;
+		std::function< void(std::atomic<float>&) > functionBody;
+		float weight;
+		std::vector<int> dependencies;
+		std::atomic<float> progress;
 		std::atomic_bool active;
+		// Scheduler state, guarded by the locker:
+		bool started;
+		bool finished;
 
-		LoaderTask(std::function< void() > functionBody) :functionBody(functionBody)
+		LoaderTask(std::function< void(std::atomic<float>&) > functionBody, float weight, const std::vector<int>& dependencies)
+			:functionBody(functionBody), weight(weight), dependencies(dependencies), started(false), finished(false)
 		{
+			progress.store(0);
 			active.store(false);
 		}
 		LoaderTask(const LoaderTask& l)
 		{
 			functionBody = l.functionBody;
+			weight = l.weight;
+			dependencies = l.dependencies;
+			progress.store(l.progress.load());
 			active.store(l.active.load());
+			started = l.started;
+			finished = l.finished;
 		}
 	};
 	std::vector< LoaderTask > loaders;
-	void doLoadingTasks();
 
-	void waitForFinish();
 	std::function<void()> finish;
-	std::thread worker;
+	uint32_t maxConcurrency;
+
+	// The loading tasks run on their own threads instead of the job system, so that the blocking file reads don't take
+	//	the workers from the frames, and a job system wait can't run a whole loading task inline. There are at most
+	//	maxConcurrency threads, each of them takes the next task whose dependencies are finished:
+	std::mutex locker;
+	std::condition_variable taskFinished;
+	std::vector<std::thread> workers;
+	void runWorker();
+	void joinWorkers();
 public:
 	LoadingScreenComponent();
 	virtual ~LoadingScreenComponent();
 
 	//Add a loading task which should be executed
 	//use std::bind( YourFunctionPointer )
-	void addLoadingFunction(std::function<void()> loadingFunction);
+	//	weight: estimated cost of the task relative to the others (for example the file size), the percentage is weighted by it
+	//	dependencies: indices of earlier tasks that must finish before this one starts
+	//	returns the index of the task (-1 if the function is empty)
+	int addLoadingFunction(std::function<void()> loadingFunction, float weight = 1.0f, const std::vector<int>& dependencies = std::vector<int>());
+	//Same as above, but the function reports its own progress in the [0,1] range through the parameter
+	int addLoadingFunctionWithProgress(std::function<void(std::atomic<float>&)> loadingFunction, float weight = 1.0f, const std::vector<int>& dependencies = std::vector<int>());
 	//Helper for loading a whole renderable component
 	void addLoadingComponent(RenderableComponent* component, MainComponent* main);
 	//Set a function that should be called when the loading finishes
 	//use std::bind( YourFunctionPointer )
 	void onFinished(std::function<void()> finishFunction);
-	//Get percentage of finished loading tasks (values 0-100)
+	//Limit the number of tasks running at the same time, so that they don't thrash the disk (0: one for every hardware thread)
+	void setMaxConcurrency(uint32_t value) { maxConcurrency = value; }
+	//Get percentage of finished loading tasks weighted by their cost and progress (values 0-100)
 	int getPercentageComplete();
 	//See if the loading is currently running
 	bool isActive();
-	
+	//Loading weight from the file size (in megabytes), for tasks that mostly read one file
+	static float getFileWeight(const std::string& fileName);
+
 	//Start Executing the tasks and mark the loading as active
 	virtual void Start() override;
 	//Clear all tasks
 	virtual void Stop() override;
-	
+
 	virtual void Unload() override;
 };
 
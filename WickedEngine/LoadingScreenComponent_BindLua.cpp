@@ -33,6 +33,8 @@ Luna<LoadingScreenComponent_BindLua>::FunctionType LoadingScreenComponent_BindLu
 
 	lunamethod(LoadingScreenComponent_BindLua, AddLoadingTask),
 	lunamethod(LoadingScreenComponent_BindLua, OnFinished),
+	lunamethod(LoadingScreenComponent_BindLua, SetMaxConcurrency),
+	lunamethod(LoadingScreenComponent_BindLua, GetPercentageComplete),
 	{ NULL, NULL }
 };
 Luna<LoadingScreenComponent_BindLua>::PropertyType LoadingScreenComponent_BindLua::properties[] = {
@@ -62,7 +64,8 @@ int LoadingScreenComponent_BindLua::AddLoadingTask(lua_State* L)
 		LoadingScreenComponent* loading = dynamic_cast<LoadingScreenComponent*>(component);
 		if (loading != nullptr)
 		{
-			loading->addLoadingFunction(bind(&wiLua::RunText,wiLua::GetGlobal(),task));
+			float weight = argc > 1 ? wiLua::SGetFloat(L, 2) : 1.0f;
+			loading->addLoadingFunction(bind(&wiLua::RunText,wiLua::GetGlobal(),task), weight);
 		}
 		else
 			wiLua::SError(L, "AddLoader(string taskScript) component is not a LoadingScreenComponent!");
@@ -89,6 +92,34 @@ int LoadingScreenComponent_BindLua::OnFinished(lua_State* L)
 		wiLua::SError(L, "OnFinished(string taskScript) not enough arguments!");
 	return 0;
 }
+int LoadingScreenComponent_BindLua::SetMaxConcurrency(lua_State* L)
+{
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		LoadingScreenComponent* loading = dynamic_cast<LoadingScreenComponent*>(component);
+		if (loading != nullptr)
+		{
+			loading->setMaxConcurrency((uint32_t)wiLua::SGetInt(L, 1));
+		}
+		else
+			wiLua::SError(L, "SetMaxConcurrency(int value) component is not a LoadingScreenComponent!");
+	}
+	else
+		wiLua::SError(L, "SetMaxConcurrency(int value) not enough arguments!");
+	return 0;
+}
+int LoadingScreenComponent_BindLua::GetPercentageComplete(lua_State* L)
+{
+	LoadingScreenComponent* loading = dynamic_cast<LoadingScreenComponent*>(component);
+	if (loading != nullptr)
+	{
+		wiLua::SSetInt(L, loading->getPercentageComplete());
+		return 1;
+	}
+	wiLua::SError(L, "GetPercentageComplete() component is not a LoadingScreenComponent!");
+	return 0;
+}
 
 void LoadingScreenComponent_BindLua::Bind()
 {
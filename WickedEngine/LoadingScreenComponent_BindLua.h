@@ -17,6 +17,8 @@ public:
 
 	int AddLoadingTask(lua_State* L);
 	int OnFinished(lua_State* L);
+	int SetMaxConcurrency(lua_State* L);
+	int GetPercentageComplete(lua_State* L);
 
 	static void Bind();
 };
@@ -13,6 +13,7 @@
 #include "wiFrameRate.h"
 #include "wiProfiler.h"
 #include "wiInitializer.h"
+#include "wiArchive.h"
 
 using namespace std;
 
@@ -28,6 +29,7 @@ MainComponent::MainComponent()
 	activeComponent = new RenderableComponent();
 
 	setFrameSkip(true);
+	setFramePipelining(false);
 	setTargetFrameRate(60);
 	setApplicationControlLostThreshold(10);
 
@@ -44,6 +46,8 @@ MainComponent::~MainComponent()
 	{
 		activeComponent->Unload();
 	}
+
+	wiArchive::ShutdownAsyncSaves();
 }
 
 void MainComponent::Initialize()
@@ -93,6 +97,14 @@ void MainComponent::Run()
 	const double elapsedTime = max(0, timer.elapsed() / 1000.0);
 	timer.record();
 
+	if (framePipelining)
+	{
+		// The fixed update reads the results of the step that was started in the previous frame:
+		wiProfiler::GetInstance().BeginRange("Physics Wait", wiProfiler::DOMAIN_CPU);
+		wiRenderer::EndPhysicsStep();
+		wiProfiler::GetInstance().EndRange(); // Physics Wait
+	}
+
 	// Fixed time update:
 	wiProfiler::GetInstance().BeginRange("Fixed Update", wiProfiler::DOMAIN_CPU);
 	if (frameskip)
@@ -113,9 +125,12 @@ void MainComponent::Run()
 	}
 	wiProfiler::GetInstance().EndRange(); // Fixed Update
 
-	wiProfiler::GetInstance().BeginRange("Physics", wiProfiler::DOMAIN_CPU);
-	wiRenderer::SynchronizeWithPhysicsEngine((float)elapsedTime);
-	wiProfiler::GetInstance().EndRange(); // Physics
+	if (!framePipelining)
+	{
+		wiProfiler::GetInstance().BeginRange("Physics", wiProfiler::DOMAIN_CPU);
+		wiRenderer::SynchronizeWithPhysicsEngine((float)elapsedTime);
+		wiProfiler::GetInstance().EndRange(); // Physics
+	}
 
 	wiLua::GetGlobal()->SetDeltaTime(elapsedTime);
 
@@ -124,6 +139,14 @@ void MainComponent::Run()
 	Update((float)elapsedTime);
 	wiProfiler::GetInstance().EndRange(); // Update
 
+	if (framePipelining)
+	{
+		// The frame packet is extracted, so the step can overlap the rendering:
+		wiProfiler::GetInstance().BeginRange("Physics", wiProfiler::DOMAIN_CPU);
+		wiRenderer::BeginPhysicsStep((float)elapsedTime);
+		wiProfiler::GetInstance().EndRange(); // Physics
+	}
+
 	wiProfiler::GetInstance().BeginRange("Render", wiProfiler::DOMAIN_CPU);
 	Render();
 	wiProfiler::GetInstance().EndRange(); // Render
@@ -147,6 +170,9 @@ void MainComponent::Update(float dt)
 	getActiveComponent()->Update(dt);
 
 	wiLua::GetGlobal()->Update();
+
+	// The frame is rendered from this state, the scripts can't change it anymore:
+	wiRenderer::ExtractFramePacket();
 }
 
 void MainComponent::FixedUpdate()
@@ -14,6 +14,7 @@ class MainComponent
 private:
 	RenderableComponent* activeComponent;
 	bool frameskip;
+	bool framePipelining;
 	int targetFrameRate;
 	double targetFrameRateInv;
 	int applicationControlLostThreshold;
@@ -40,6 +41,9 @@ public:
 	void	setTargetFrameRate(int value){ targetFrameRate = value; targetFrameRateInv = 1.0 / (double)targetFrameRate; }
 	int		getTargetFrameRate(){ return targetFrameRate; }
 	void	setApplicationControlLostThreshold(int value){ applicationControlLostThreshold = value; }
+	// The physics step runs on a worker while the frame is rendered and it is synchronized at the start of the next frame
+	void	setFramePipelining(bool value){ framePipelining = value; }
+	bool	getFramePipelining(){ return framePipelining; }
 
 	// Initializes all engine components
 	virtual void Initialize();
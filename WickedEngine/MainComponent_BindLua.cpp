@@ -16,6 +16,7 @@ Luna<MainComponent_BindLua>::FunctionType MainComponent_BindLua::methods[] = {
 	lunamethod(MainComponent_BindLua, GetActiveComponent),
 	lunamethod(MainComponent_BindLua, SetActiveComponent),
 	lunamethod(MainComponent_BindLua, SetFrameSkip),
+	lunamethod(MainComponent_BindLua, SetFramePipelining),
 	lunamethod(MainComponent_BindLua, SetInfoDisplay),
 	lunamethod(MainComponent_BindLua, SetWatermarkDisplay),
 	lunamethod(MainComponent_BindLua, SetFPSDisplay),
@@ -214,6 +215,23 @@ int MainComponent_BindLua::SetFrameSkip(lua_State *L)
 		wiLua::SError(L, "SetFrameSkip(bool enabled) not enought arguments!");
 	return 0;
 }
+int MainComponent_BindLua::SetFramePipelining(lua_State *L)
+{
+	if (component == nullptr)
+	{
+		wiLua::SError(L, "SetFramePipelining(bool enabled) component is empty!");
+		return 0;
+	}
+
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		component->setFramePipelining(wiLua::SGetBool(L, 1));
+	}
+	else
+		wiLua::SError(L, "SetFramePipelining(bool enabled) not enough arguments!");
+	return 0;
+}
 int MainComponent_BindLua::SetInfoDisplay(lua_State *L)
 {
 	if (component == nullptr)
@@ -15,10 +15,6 @@ Renderable3DComponent::Renderable3DComponent() : Renderable2DComponent()
 }
 Renderable3DComponent::~Renderable3DComponent()
 {
-	for (auto& wt : workerThreads)
-	{
-		delete wt;
-	}
 }
 
 wiRenderTarget
@@ -274,7 +270,7 @@ void Renderable3DComponent::RenderReflections(GRAPHICSTHREAD threadID)
 
 	if (wiRenderer::IsRequestedReflectionRendering())
 	{
-		wiRenderer::UpdateCameraCB(wiRenderer::getRefCamera(), threadID);
+		wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().reflectionCamera, threadID);
 
 		rtReflection.Activate(threadID); {
 			// reverse clipping if underwater
@@ -336,7 +332,7 @@ void Renderable3DComponent::RenderSecondaryScene(wiRenderTarget& mainRT, wiRende
 	}
 	wiRenderer::GetDevice()->EventEnd(threadID);
 
-	wiRenderer::UpdateCameraCB(wiRenderer::getCamera(), threadID);
+	wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
 
 	if (getStereogramEnabled())
 	{
@@ -684,10 +680,5 @@ void Renderable3DComponent::RenderColorGradedComposition()
 
 void Renderable3DComponent::setPreferredThreadingCount(unsigned short value)
 {
-	for (auto& wt : workerThreads)
-	{
-		delete wt;
-	}
-
-	workerThreads.clear();
+	workerTasks.clear();
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 #include "Renderable2DComponent.h"
-#include "wiTaskThread.h"
+#include "wiJobSystem.h"
 #include "wiRenderer.h"
 #include "wiWaterPlane.h"
 #include "wiGraphicsDevice.h"
@@ -68,7 +68,8 @@ protected:
 
 	virtual void ResizeBuffers() override;
 
-	std::vector<wiTaskThread*> workerThreads;
+	// With multithreaded rendering, every task records a command list on the job system
+	std::vector<std::function<void()> > workerTasks;
 
 	virtual void RenderFrameSetUp(GRAPHICSTHREAD threadID);
 	virtual void RenderReflections(GRAPHICSTHREAD threadID);
@@ -119,7 +120,7 @@ public:
 
 	inline UINT getMSAASampleCount() { return msaaSampleCount; }
 
-	inline unsigned int getThreadingCount(){ return (unsigned int)workerThreads.size(); }
+	inline unsigned int getThreadingCount(){ return (unsigned int)workerTasks.size(); }
 
 	inline void setLightShaftQuality(float value){ lightShaftQuality = value; }
 	inline void setBloomDownSample(float value){ bloomDownSample = value; }
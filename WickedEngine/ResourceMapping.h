@@ -62,6 +62,9 @@
 
 #define TEXSLOT_COUNT		TEXSLOT_UNIQUE1
 
+// The material table is persistent, so it is outside of the range that is unbound every frame:
+#define SBSLOT_MATERIALARRAY		31
+
 // Skinning:
 #define SKINNINGSLOT_IN_VERTEX_POS	0
 #define SKINNINGSLOT_IN_VERTEX_NOR	1
@@ -119,6 +119,21 @@ struct ShaderEntityType
 	inline float GetEmissive() { return energy; }
 };
 
+// An entry of the material table, the MaterialCB of a draw holds its index:
+struct ShaderMaterial
+{
+	float4 baseColor; // + alpha (.w)
+	float4 texMulAdd;
+	float roughness;
+	float reflectance;
+	float metalness;
+	float emissive;
+	float refractionIndex;
+	float subsurfaceScattering;
+	float normalMapStrength;
+	float parallaxOcclusionMapping;
+};
+
 
 // Tiled rendering params:
 #define TILED_CULLING_BLOCKSIZE	16
@@ -127,6 +142,10 @@ struct ShaderEntityType
 
 #define MATRIXARRAY_COUNT	128
 
+// Material table params:
+#define MATERIALARRAY_INDEX_IMPOSTOR	0
+#define MATERIALARRAY_INITIAL_COUNT		1024
+
 
 // MIP Generator params:
 #define GENERATEMIPCHAIN_1D_BLOCK_SIZE 32
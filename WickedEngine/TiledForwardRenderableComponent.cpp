@@ -21,7 +21,7 @@ TiledForwardRenderableComponent::~TiledForwardRenderableComponent()
 void TiledForwardRenderableComponent::RenderScene(GRAPHICSTHREAD threadID)
 {
 
-	wiRenderer::UpdateCameraCB(wiRenderer::getCamera(), threadID);
+	wiRenderer::UpdateCameraCB(wiRenderer::GetFramePacket().camera, threadID);
 
 	wiProfiler::GetInstance().BeginRange("Z-Prepass", wiProfiler::DOMAIN_GPU, threadID);
 	rtMain.Activate(threadID, 0, 0, 0, 0, true); // depth prepass
@@ -19,19 +19,21 @@
 #include "wiFont.h"
 #include "wiFrameRate.h"
 #include "wiCpuInfo.h"
+#include "wiJobSystem.h"
 #include "wiLoader.h"
+#include "wiStreaming.h"
 #include "wiEmittedParticle.h"
 #include "wiHairParticle.h"
 #include "wiRenderer.h"
 #include "wiDirectInput.h"
 #include "wiXInput.h"
 #include "wiRawInput.h"
-#include "wiTaskThread.h"
 #include "wiMath.h"
 #include "wiLensFlare.h"
 #include "wiSound.h"
 #include "wiThreadSafeManager.h"
 #include "wiResourceManager.h"
+#include "wiShaderCache.h"
 #include "wiTimer.h"
 #include "wiHelper.h"
 #include "wiInputManager.h"
@@ -53,6 +55,8 @@
 #include "wiWindowRegistration.h"
 #include "wiTranslator.h"
 #include "wiArchive.h"
+#include "wiIndexCodec.h"
+#include "wiLZ4.h"
 #include "wiSpinLock.h"
 #include "wiRectPacker.h"
 #include "wiProfiler.h"
@@ -17,17 +17,21 @@
 
 CBUFFER(MaterialCB, CBSLOT_RENDERER_MATERIAL)
 {
-	float4		g_xMat_baseColor;
-	float4		g_xMat_texMulAdd;
-	float		g_xMat_roughness;
-	float		g_xMat_reflectance;
-	float		g_xMat_metalness;
-	float		g_xMat_emissive;
-	float		g_xMat_refractionIndex;
-	float		g_xMat_subsurfaceScattering;
-	float		g_xMat_normalMapStrength;
-	float		g_xMat_parallaxOcclusionMapping;
+	uint		g_xMat_materialIndex;
+	uint3		g_xMat_padding;
 };
+STRUCTUREDBUFFER(MaterialArray, ShaderMaterial, SBSLOT_MATERIALARRAY);
+
+#define g_xMat_baseColor					MaterialArray[g_xMat_materialIndex].baseColor
+#define g_xMat_texMulAdd					MaterialArray[g_xMat_materialIndex].texMulAdd
+#define g_xMat_roughness					MaterialArray[g_xMat_materialIndex].roughness
+#define g_xMat_reflectance					MaterialArray[g_xMat_materialIndex].reflectance
+#define g_xMat_metalness					MaterialArray[g_xMat_materialIndex].metalness
+#define g_xMat_emissive						MaterialArray[g_xMat_materialIndex].emissive
+#define g_xMat_refractionIndex				MaterialArray[g_xMat_materialIndex].refractionIndex
+#define g_xMat_subsurfaceScattering			MaterialArray[g_xMat_materialIndex].subsurfaceScattering
+#define g_xMat_normalMapStrength			MaterialArray[g_xMat_materialIndex].normalMapStrength
+#define g_xMat_parallaxOcclusionMapping		MaterialArray[g_xMat_materialIndex].parallaxOcclusionMapping
 
 // DEFINITIONS
 //////////////////
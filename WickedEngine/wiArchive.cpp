@@ -1,32 +1,257 @@
 #include "wiArchive.h"
 #include "wiHelper.h"
+#include "wiJobSystem.h"
+#include "wiLZ4.h"
 
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
 
 using namespace std;
 
 // this should always be only INCREMENTED and only if a new serialization is implemeted somewhere!
-uint64_t __archiveVersion = 12;
+uint64_t __archiveVersion = 16;
 // this is the version number of which below the archive is not compatible with the current version
 uint64_t __archiveVersionBarrier = 1;
 
 // version history is logged in ArchiveVersionHistory.txt file!
 
-wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMode),pos(0),DATA(nullptr),dataSize(0),fileName(fileName)
+static bool memoryMapping = true;
+
+// Header flags (version 16+):
+enum ARCHIVE_FLAGS
+{
+	ARCHIVE_FLAG_COMPRESSED = 1 << 0,
+};
+// The version and the flags are never compressed:
+static const size_t HEADER_SIZE = sizeof(uint64_t) * 2;
+// The rest is split into independently compressed blocks of this size:
+static const size_t COMPRESSION_BLOCK_SIZE = 256 * 1024;
+// Set in the block size when the block didn't compress and is stored as is:
+static const uint32_t BLOCK_STORED = 0x80000000;
+// The most that a compressed byte can decompress to:
+static const uint64_t LZ4_MAX_EXPANSION = 255;
+
+// The compressed file layout: version, flags, uncompressed size, block size, block count, block sizes (uint32), block data
+static char* CompressArchive(const char* data, size_t size, size_t& resultSize)
+{
+	const size_t payloadSize = size - HEADER_SIZE;
+	const size_t blockCount = (payloadSize + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE;
+
+	vector<vector<uint8_t> > blocks(blockCount);
+	vector<uint32_t> blockSizes(blockCount);
+	if (blockCount > 0)
+	{
+		wiJobSystem::Counter counter;
+		wiJobSystem::Dispatch(counter, (uint32_t)blockCount, 1, [&](uint32_t i) {
+			const uint8_t* src = (const uint8_t*)data + HEADER_SIZE + i * COMPRESSION_BLOCK_SIZE;
+			const size_t srcSize = min(COMPRESSION_BLOCK_SIZE, payloadSize - i * COMPRESSION_BLOCK_SIZE);
+			vector<uint8_t>& block = blocks[i];
+			block.resize(wiLZ4::GetMaxCompressedSize(srcSize));
+			size_t compressedSize = wiLZ4::Compress(src, srcSize, block.data(), block.size());
+			if (compressedSize == 0 || compressedSize >= srcSize)
+			{
+				block.assign(src, src + srcSize);
+				blockSizes[i] = (uint32_t)srcSize | BLOCK_STORED;
+			}
+			else
+			{
+				block.resize(compressedSize);
+				blockSizes[i] = (uint32_t)compressedSize;
+			}
+		});
+		wiJobSystem::Wait(counter);
+	}
+
+	resultSize = HEADER_SIZE + sizeof(uint64_t) * 3 + sizeof(uint32_t) * blockCount;
+	for (auto& x : blocks)
+	{
+		resultSize += x.size();
+	}
+	char* result = new char[resultSize];
+	char* dst = result;
+
+	memcpy(dst, data, HEADER_SIZE);
+	uint64_t flags;
+	memcpy(&flags, dst + sizeof(uint64_t), sizeof(flags));
+	flags |= ARCHIVE_FLAG_COMPRESSED;
+	memcpy(dst + sizeof(uint64_t), &flags, sizeof(flags));
+	dst += HEADER_SIZE;
+
+	uint64_t table[] = { (uint64_t)payloadSize, (uint64_t)COMPRESSION_BLOCK_SIZE, (uint64_t)blockCount };
+	memcpy(dst, table, sizeof(table));
+	dst += sizeof(table);
+	if (blockCount > 0)
+	{
+		memcpy(dst, blockSizes.data(), sizeof(uint32_t) * blockCount);
+		dst += sizeof(uint32_t) * blockCount;
+	}
+	for (auto& x : blocks)
+	{
+		memcpy(dst, x.data(), x.size());
+		dst += x.size();
+	}
+
+	return result;
+}
+
+// Writes the file under a temporary name and replaces the destination with it when complete:
+static bool WriteFileAtomic(const string& fileName, const char* data, size_t size)
+{
+	string tempName = fileName + ".tmp";
+	{
+		ofstream file(tempName, ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file.write(data, (streamsize)size);
+		if (!file.good())
+		{
+			file.close();
+			remove(tempName.c_str());
+			return false;
+		}
+	}
+#ifndef WINSTORE_SUPPORT
+	return MoveFileExA(tempName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	remove(fileName.c_str());
+	return rename(tempName.c_str(), fileName.c_str()) == 0;
+#endif
+}
+
+// Background writer of CloseAsync():
+struct AsyncSave
+{
+	string fileName;
+	char* data;
+	size_t size;
+	bool compressed;
+	vector<promise<bool> > promises;
+};
+static mutex asyncLock;
+static condition_variable asyncWakeup;
+static condition_variable asyncFinished;
+static deque<AsyncSave*> asyncQueue;
+static bool asyncBusy = false;
+static bool asyncRunning = false;
+static thread asyncThread;
+
+static void AsyncWriterFunc()
+{
+	while (true)
+	{
+		AsyncSave* save;
+		{
+			unique_lock<mutex> lock(asyncLock);
+			while (asyncRunning && asyncQueue.empty())
+			{
+				asyncWakeup.wait(lock);
+			}
+			if (asyncQueue.empty())
+			{
+				return;
+			}
+			save = asyncQueue.front();
+			asyncQueue.pop_front();
+			asyncBusy = true;
+		}
+
+		bool success;
+		if (save->compressed)
+		{
+			size_t size;
+			char* data = CompressArchive(save->data, save->size, size);
+			success = WriteFileAtomic(save->fileName, data, size);
+			SAFE_DELETE_ARRAY(data);
+		}
+		else
+		{
+			success = WriteFileAtomic(save->fileName, save->data, save->size);
+		}
+		for (auto& x : save->promises)
+		{
+			x.set_value(success);
+		}
+		SAFE_DELETE_ARRAY(save->data);
+		SAFE_DELETE(save);
+
+		{
+			lock_guard<mutex> lock(asyncLock);
+			asyncBusy = false;
+		}
+		asyncFinished.notify_all();
+	}
+}
+
+// The writer compresses on the job system, so it can't be stopped during the static destruction, the program must call
+//	wiArchive::ShutdownAsyncSaves() before it exits. If it didn't, the thread is abandoned instead of terminating the program:
+//	an unfinished save only leaves its temporary file behind.
+static struct AsyncWriterGuard
+{
+	~AsyncWriterGuard()
+	{
+		if (asyncThread.joinable())
+		{
+			asyncThread.detach();
+		}
+	}
+} asyncWriterGuard;
+
+wiArchive::wiArchive(const std::string& fileName, bool readMode):version(0),readMode(readMode),pos(0),DATA(nullptr),dataSize(0),mapped(false),view(false),compressed(false),failed(false),fileName(fileName)
 {
 	if (!fileName.empty())
 	{
 		if (readMode)
 		{
-			ifstream file(fileName, ios::binary | ios::ate);
-			if (file.is_open())
+#ifndef WINSTORE_SUPPORT
+			// Map the file, so it is not copied into memory as a whole and the OS can page it in as it is read:
+			if (memoryMapping)
+			{
+				HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+				if (file != INVALID_HANDLE_VALUE)
+				{
+					LARGE_INTEGER fileSize;
+					if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+					{
+						HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+						if (mapping != nullptr)
+						{
+							// The view keeps the mapping and the file alive:
+							DATA = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+							if (DATA != nullptr)
+							{
+								dataSize = (size_t)fileSize.QuadPart;
+								mapped = true;
+							}
+							CloseHandle(mapping);
+						}
+					}
+					CloseHandle(file);
+				}
+			}
+#endif
+
+			if (!mapped)
+			{
+				ifstream file(fileName, ios::binary | ios::ate);
+				if (file.is_open())
+				{
+					dataSize = (size_t)file.tellg();
+					file.seekg(0, file.beg);
+					DATA = new char[(size_t)dataSize];
+					file.read(DATA, dataSize);
+					file.close();
+				}
+			}
+
+			if (DATA != nullptr)
 			{
-				dataSize = (size_t)file.tellg();
-				file.seekg(0, file.beg);
-				DATA = new char[(size_t)dataSize];
-				file.read(DATA, dataSize);
-				file.close();
 				(*this) >> version;
 				if (version < __archiveVersionBarrier)
 				{
@@ -44,6 +269,52 @@ wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMo
 					Close();
 				}
 			}
+
+			if (DATA != nullptr && version >= 16)
+			{
+				uint64_t flags;
+				(*this) >> flags;
+				if (flags & ARCHIVE_FLAG_COMPRESSED)
+				{
+					compressed = true;
+					if (!_decompress())
+					{
+						failed = true;
+						wiHelper::messageBox("The archive is corrupted: " + fileName, "Error!");
+						Close();
+					}
+				}
+			}
+
+			if (DATA != nullptr && version >= 15)
+			{
+				// The table of contents is at the end, its position is after the header:
+				uint64_t tocOffset;
+				(*this) >> tocOffset;
+				if (tocOffset > 0 && tocOffset < dataSize)
+				{
+					size_t dataStart = pos;
+					pos = (size_t)tocOffset;
+					size_t sectionCount;
+					(*this) >> sectionCount;
+					// Every entry takes at least three 8 byte fields:
+					if (_canRead(sectionCount, 3 * sizeof(uint64_t)))
+					{
+						sections.resize(sectionCount);
+						for (auto& x : sections)
+						{
+							(*this) >> x.name;
+							(*this) >> x.offset;
+							(*this) >> x.size;
+						}
+					}
+					if (failed)
+					{
+						sections.clear();
+					}
+					pos = dataStart;
+				}
+			}
 		}
 		else
 		{
@@ -51,6 +322,8 @@ wiArchive::wiArchive(const std::string& fileName, bool readMode):readMode(readMo
 			dataSize = 128; // this will grow if necessary anyway...
 			DATA = new char[dataSize];
 			(*this) << version;
+			(*this) << (uint64_t)0; // flags, filled when saving
+			(*this) << (uint64_t)0; // table of contents offset, filled when saving
 		}
 	}
 }
@@ -61,6 +334,16 @@ wiArchive::~wiArchive()
 	Close();
 }
 
+uint64_t wiArchive::GetCurrentVersion()
+{
+	return __archiveVersion;
+}
+
+void wiArchive::SetMemoryMappingEnabled(bool value)
+{
+	memoryMapping = value;
+}
+
 bool wiArchive::IsOpen()
 {
 	// when it is open, DATA is not null because it contains the version number at least!
@@ -69,10 +352,24 @@ bool wiArchive::IsOpen()
 
 void wiArchive::Close()
 {
+	if (view)
+	{
+		// The memory is owned by the parent archive:
+		DATA = nullptr;
+		view = false;
+	}
 	if (!readMode && !fileName.empty())
 	{
 		SaveFile(fileName);
 	}
+#ifndef WINSTORE_SUPPORT
+	if (mapped)
+	{
+		UnmapViewOfFile(DATA);
+		DATA = nullptr;
+		mapped = false;
+	}
+#endif
 	SAFE_DELETE_ARRAY(DATA);
 }
 
@@ -83,15 +380,129 @@ bool wiArchive::SaveFile(const std::string& fileName)
 		return false;
 	}
 
-	ofstream file(fileName, ios::binary | ios::trunc);
-	if (file.is_open())
+	// The table of contents is appended to the data only in the file, so the archive can still be written after saving:
+	size_t dataEnd = _writeTableOfContents();
+	bool success;
+	if (compressed)
 	{
-		file.write(DATA, (streamsize)pos);
-		file.close();
-		return true;
+		size_t size;
+		char* data = CompressArchive(DATA, pos, size);
+		success = WriteFileAtomic(fileName, data, size);
+		SAFE_DELETE_ARRAY(data);
+	}
+	else
+	{
+		success = WriteFileAtomic(fileName, DATA, pos);
 	}
+	pos = dataEnd;
+	return success;
+}
 
-	return false;
+future<bool> wiArchive::CloseAsync()
+{
+	promise<bool> result;
+	future<bool> completion = result.get_future();
+
+	if (readMode || fileName.empty() || pos <= 0)
+	{
+		Close();
+		result.set_value(false);
+		return completion;
+	}
+
+	_writeTableOfContents();
+
+	// The archive memory is handed over to the writer:
+	AsyncSave* save = new AsyncSave;
+	save->fileName = fileName;
+	save->data = DATA;
+	save->size = pos;
+	save->compressed = compressed;
+	save->promises.push_back(move(result));
+	DATA = nullptr;
+	dataSize = 0;
+	pos = 0;
+	fileName.clear();
+
+	{
+		lock_guard<mutex> lock(asyncLock);
+		if (!asyncRunning)
+		{
+			asyncRunning = true;
+			asyncThread = thread(AsyncWriterFunc);
+		}
+
+		bool superseded = false;
+		for (auto& x : asyncQueue)
+		{
+			if (!x->fileName.compare(save->fileName))
+			{
+				swap(x->data, save->data);
+				x->size = save->size;
+				x->compressed = save->compressed;
+				for (auto& y : save->promises)
+				{
+					x->promises.push_back(move(y));
+				}
+				SAFE_DELETE_ARRAY(save->data);
+				SAFE_DELETE(save);
+				superseded = true;
+				break;
+			}
+		}
+		if (!superseded)
+		{
+			asyncQueue.push_back(save);
+		}
+	}
+	asyncWakeup.notify_one();
+
+	return completion;
+}
+
+void wiArchive::WaitForAsyncSaves()
+{
+	unique_lock<mutex> lock(asyncLock);
+	while (asyncBusy || !asyncQueue.empty())
+	{
+		asyncFinished.wait(lock);
+	}
+}
+
+void wiArchive::ShutdownAsyncSaves()
+{
+	{
+		lock_guard<mutex> lock(asyncLock);
+		asyncRunning = false;
+	}
+	asyncWakeup.notify_all();
+	// The writer finishes the queued saves before it returns:
+	if (asyncThread.joinable())
+	{
+		asyncThread.join();
+	}
+}
+
+size_t wiArchive::_writeTableOfContents()
+{
+	size_t dataEnd = pos;
+	if (!readMode && version >= 15)
+	{
+		uint64_t tocOffset = 0;
+		if (!sections.empty())
+		{
+			tocOffset = (uint64_t)dataEnd;
+			(*this) << sections.size();
+			for (auto& x : sections)
+			{
+				(*this) << x.name;
+				(*this) << x.offset;
+				(*this) << x.size;
+			}
+		}
+		memcpy(DATA + HEADER_SIZE, &tocOffset, sizeof(tocOffset));
+	}
+	return dataEnd;
 }
 
 string wiArchive::GetSourceDirectory()
@@ -103,3 +514,227 @@ string wiArchive::GetSourceFileName()
 {
 	return fileName;
 }
+
+void wiArchive::BeginSection(const std::string& name)
+{
+	if (!HasSections())
+	{
+		return;
+	}
+
+	if (readMode)
+	{
+		uint64_t size;
+		(*this) >> size;
+		if (!_canRead(size))
+		{
+			size = 0;
+		}
+		openSections.push_back(pos + (size_t)size);
+	}
+	else
+	{
+		(*this) << (uint64_t)0; // size, filled by EndSection
+		Section section;
+		section.name = name;
+		section.offset = (uint64_t)pos;
+		section.size = 0;
+		openSections.push_back(sections.size());
+		sections.push_back(section);
+	}
+}
+
+void wiArchive::EndSection()
+{
+	if (!HasSections() || openSections.empty())
+	{
+		return;
+	}
+
+	if (readMode)
+	{
+		// Anything that was not read from the section is skipped:
+		pos = openSections.back();
+	}
+	else
+	{
+		Section& section = sections[openSections.back()];
+		section.size = (uint64_t)pos - section.offset;
+		memcpy(DATA + section.offset - sizeof(uint64_t), &section.size, sizeof(section.size));
+	}
+	openSections.pop_back();
+}
+
+bool wiArchive::SkipSection()
+{
+	if (!readMode || !HasSections())
+	{
+		return false;
+	}
+
+	uint64_t size;
+	(*this) >> size;
+	if (_canRead(size))
+	{
+		pos += (size_t)size;
+	}
+	return true;
+}
+
+void wiArchive::SetFailed()
+{
+	failed = true;
+	pos = dataSize;
+}
+
+bool wiArchive::CheckReadCount(uint64_t count, size_t minElementSize)
+{
+	size_t end = dataSize;
+	if (readMode && HasSections() && !openSections.empty())
+	{
+		end = min(end, openSections.back());
+	}
+	if (pos <= end && count <= (uint64_t)((end - pos) / max(minElementSize, (size_t)1)))
+	{
+		return true;
+	}
+	SetFailed();
+	return false;
+}
+
+bool wiArchive::ReadSection(wiArchive& reader)
+{
+	if (!readMode || !HasSections())
+	{
+		return false;
+	}
+
+	uint64_t size;
+	(*this) >> size;
+	const bool valid = _canRead(size);
+	if (!valid)
+	{
+		size = 0;
+	}
+
+	reader.Close();
+	reader.version = version;
+	reader.readMode = true;
+	reader.DATA = DATA + pos;
+	reader.dataSize = (size_t)size;
+	reader.pos = 0;
+	reader.view = true;
+	reader.failed = !valid;
+	reader.fileName = fileName;
+	reader.sections.clear();
+	reader.openSections.clear();
+
+	pos += (size_t)size;
+	return true;
+}
+
+void wiArchive::_reserve(size_t required)
+{
+	size_t newSize = dataSize * 2;
+	if (newSize < required)
+	{
+		newSize = required;
+	}
+	char* NEWDATA = new char[newSize];
+	if (DATA != nullptr)
+	{
+		memcpy(NEWDATA, DATA, pos);
+	}
+	dataSize = newSize;
+	SAFE_DELETE_ARRAY(DATA);
+	DATA = NEWDATA;
+}
+
+bool wiArchive::_decompress()
+{
+	uint64_t payloadSize, blockSize, blockCount;
+	(*this) >> payloadSize;
+	(*this) >> blockSize;
+	(*this) >> blockCount;
+	// The sizes are checked before anything is allocated for them. The block count is bounded by the file size, because the
+	//	block size table is in the file, and the writer never uses bigger blocks than COMPRESSION_BLOCK_SIZE:
+	if (blockSize == 0 || blockSize > COMPRESSION_BLOCK_SIZE || !_canRead(blockCount, sizeof(uint32_t)))
+	{
+		return false;
+	}
+	if (payloadSize > blockCount * blockSize || blockCount != (payloadSize + blockSize - 1) / blockSize)
+	{
+		return false;
+	}
+
+	vector<uint32_t> blockSizes((size_t)blockCount);
+	vector<size_t> blockOffsets((size_t)blockCount);
+	for (size_t i = 0; i < blockSizes.size(); ++i)
+	{
+		_read(blockSizes[i]);
+	}
+	size_t offset = pos;
+	for (size_t i = 0; i < blockSizes.size(); ++i)
+	{
+		blockOffsets[i] = offset;
+		offset += blockSizes[i] & ~BLOCK_STORED;
+	}
+	if (offset > dataSize)
+	{
+		return false;
+	}
+	// LZ4 can't expand the data more than 255 times, so the compressed blocks in the file bound the decompressed size too:
+	if (payloadSize > (uint64_t)(offset - pos) * LZ4_MAX_EXPANSION)
+	{
+		return false;
+	}
+
+	char* image = new char[HEADER_SIZE + (size_t)payloadSize];
+	memcpy(image, DATA, HEADER_SIZE);
+
+	atomic<bool> corrupted(false);
+	if (blockCount > 0)
+	{
+		wiJobSystem::Counter counter;
+		wiJobSystem::Dispatch(counter, (uint32_t)blockCount, 1, [&](uint32_t i) {
+			const uint8_t* src = (const uint8_t*)DATA + blockOffsets[i];
+			const size_t srcSize = blockSizes[i] & ~BLOCK_STORED;
+			uint8_t* dst = (uint8_t*)image + HEADER_SIZE + i * blockSize;
+			const size_t dstSize = (size_t)min(blockSize, payloadSize - i * blockSize);
+			if (blockSizes[i] & BLOCK_STORED)
+			{
+				if (srcSize != dstSize)
+				{
+					corrupted = true;
+					return;
+				}
+				memcpy(dst, src, dstSize);
+			}
+			else if (!wiLZ4::Decompress(src, srcSize, dst, dstSize))
+			{
+				corrupted = true;
+			}
+		});
+		wiJobSystem::Wait(counter);
+	}
+	if (corrupted)
+	{
+		SAFE_DELETE_ARRAY(image);
+		return false;
+	}
+
+	// The compressed file data is replaced:
+	if (mapped)
+	{
+#ifndef WINSTORE_SUPPORT
+		UnmapViewOfFile(DATA);
+#endif
+		DATA = nullptr;
+		mapped = false;
+	}
+	SAFE_DELETE_ARRAY(DATA);
+	DATA = image;
+	dataSize = HEADER_SIZE + (size_t)payloadSize;
+	pos = HEADER_SIZE;
+	return true;
+}
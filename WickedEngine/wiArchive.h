@@ -3,6 +3,9 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
+#include <type_traits>
+#include <future>
 
 class wiArchive
 {
@@ -12,24 +15,120 @@ private:
 	size_t pos;
 	char* DATA;
 	size_t dataSize;
+	bool mapped; // DATA is a read only view of the file
+	bool view; // DATA belongs to an other archive (section reader)
+	bool compressed; // the file is LZ4 block compressed
+	bool failed; // read mode: a read went past the end of the data
 
 	std::string fileName; // save to this file on closing if not empty
+
+public:
+	// A named range of the archive, listed in the table of contents (version 15+)
+	struct Section
+	{
+		std::string name;
+		uint64_t offset;	// position of the first byte of the section data
+		uint64_t size;		// byte size of the section data
+	};
+private:
+	std::vector<Section> sections;		// table of contents
+	std::vector<size_t> openSections;	// write mode: index of the unfinished sections, read mode: end position of the entered sections
+
 public:
 	wiArchive(const std::string& fileName, bool readMode = true);
 	~wiArchive();
 
 	uint64_t GetVersion() { return version; }
+	// The version that new archives are written with
+	static uint64_t GetCurrentVersion();
+	// Read mode archives map the file into memory instead of copying it when possible (default: enabled)
+	static void SetMemoryMappingEnabled(bool value);
+	bool IsMemoryMapped() { return mapped; }
+	// Write mode: the file is saved with LZ4 block compression (default: disabled). Read mode: tells if the file was compressed.
+	//	Compressed archives are split into independent blocks that are compressed and decompressed in parallel on the job system.
+	void SetCompressionEnabled(bool value) { compressed = value; }
+	bool IsCompressed() { return compressed; }
 	bool IsReadMode() { return readMode; }
 	bool IsOpen();
+	// Read mode: tells if the archive is truncated or corrupted, because a read went past the end of the data.
+	//	The failed read and every read after it return zeroes (empty strings and arrays), so it can be tested after reading everything
+	bool IsFailed() const { return failed; }
+	// Read mode: marks the archive failed, for example when a reader of one of its sections failed
+	void SetFailed();
+	// Read mode: checks a count that was read from the archive, before allocating for it. The elements take at least
+	//	minElementSize bytes each, they must fit in the rest of the innermost section (or of the archive). Otherwise the archive is failed.
+	bool CheckReadCount(uint64_t count, size_t minElementSize);
 	void Close();
 	bool SaveFile(const std::string& fileName);
+	// Write mode: closes the archive without waiting for the file write. The data is handed over to a background thread, so the archive
+	//	memory is not copied and a new archive can be serialized meanwhile. The file is written under a temporary name and renamed
+	//	when complete, so an interrupted save never leaves a partial file behind. The result is true when the file was written.
+	//	An earlier save of the same file that didn't start yet is replaced by this one (both futures get the result of this).
+	std::future<bool> CloseAsync();
+	// Blocks until every asynchronous save is written
+	static void WaitForAsyncSaves();
+	// Writes the remaining asynchronous saves and stops the background thread. Call it before the program exits, while the
+	//	job system is still running (a later CloseAsync() starts the thread again)
+	static void ShutdownAsyncSaves();
 	std::string GetSourceDirectory();
 	std::string GetSourceFileName();
 
+	// Sections (version 15+): the data serialized between BeginSection and EndSection is prefixed with its size and is listed in the
+	//	table of contents at the end of the file. Readers can step over sections they don't need, and data that a newer writer appended
+	//	to a section is skipped. Older archives don't have sections, for them these are no-ops, so the same code can read any version.
+	//	Sections can be nested.
+	void BeginSection(const std::string& name);
+	void EndSection();
+	// Read mode: steps over the next section without reading it. Returns false if the archive has no sections.
+	bool SkipSection();
+	// Read mode: steps over the next section and sets up the reader to read that section independently of this archive
+	//	(for example on an other thread). The reader uses the memory of this archive, so this must stay open while the reader is used.
+	//	Returns false if the archive has no sections.
+	bool ReadSection(wiArchive& reader);
+	// The table of contents, in the order that the sections were finished (nested sections precede their parent)
+	const std::vector<Section>& GetSections() const { return sections; }
+	bool HasSections() const { return version >= 15; }
+
 	// It could be templated but we have to be extremely careful of different datasizes on different platforms
 	// because serialized data should be interchangeable!
 	// So providing exact copy operations for exact types enforces platform agnosticism
 
+	// Bulk operations: the element count, then the elements in their in-memory layout with a single copy.
+	//	Only use them for types that have the same layout on every platform (fixed size fields, no padding, no pointers)!
+	template<typename T>
+	void WriteArray(const T* data, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be bulk serialized!");
+		_write((uint64_t)count);
+		if (count > 0)
+		{
+			_write(*data, (uint64_t)count);
+		}
+	}
+	template<typename T>
+	void WriteArray(const std::vector<T>& data)
+	{
+		WriteArray(data.data(), data.size());
+	}
+	template<typename T>
+	void ReadArray(std::vector<T>& data)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be bulk serialized!");
+		uint64_t count;
+		_read(count);
+		// The count is checked before allocating, a corrupted one can be anything:
+		if (!_canRead(count, sizeof(T)))
+		{
+			data.clear();
+			return;
+		}
+		data.resize((size_t)count);
+		if (count > 0)
+		{
+			_read(data[0], count);
+		}
+	}
+
 	// Write operations
 	wiArchive& operator<<(bool data)
 	{
@@ -106,6 +205,11 @@ public:
 		_write(data);
 		return *this;
 	}
+	wiArchive& operator<<(const std::vector<uint8_t>& data)
+	{
+		WriteArray(data);
+		return *this;
+	}
 	wiArchive& operator<<(const std::string& data)
 	{
 		uint64_t len = (uint64_t)(data.length() + 1); // +1 for the null-terminator
@@ -204,18 +308,40 @@ public:
 		_read(data);
 		return *this;
 	}
+	wiArchive& operator >> (std::vector<uint8_t>& data)
+	{
+		ReadArray(data);
+		return *this;
+	}
 	wiArchive& operator >> (std::string& data)
 	{
 		uint64_t len;
 		_read(len);
-		char* str = new char[(size_t)len];
-		memset(str, '\0', (size_t)(sizeof(char)*len));
-		_read(*str, len);
-		data = std::string(str);
-		delete[] str;
+		// The length includes the null-terminator:
+		const char* str = (const char*)ReadView((size_t)len);
+		if (str == nullptr)
+		{
+			data.clear();
+			return *this;
+		}
+		data.assign(str, strnlen(str, (size_t)len));
 		return *this;
 	}
 
+	// Read mode only: returns the next size bytes without copying them and steps over them.
+	//	The memory is valid until the archive is closed. Use it for bulk copying data that is stored with its in-memory layout.
+	//	Returns nullptr if the archive doesn't have that many bytes left.
+	const void* ReadView(size_t size)
+	{
+		if (!_canRead(size))
+		{
+			return nullptr;
+		}
+		const void* view = DATA + pos;
+		pos += size;
+		return view;
+	}
+
 
 
 private:
@@ -224,6 +350,15 @@ private:
 	// Any specific type serialization should be implemented by hand
 	// But these can be used as helper functions inside this class
 
+	// Read mode: replaces the compressed file data with the decompressed archive, returns false if the data is corrupted
+	bool _decompress();
+
+	// Write mode: appends the table of contents for saving, returns the end position of the serialized data
+	size_t _writeTableOfContents();
+
+	// Grows the write buffer geometrically, so that many small writes don't reallocate often
+	void _reserve(size_t required);
+
 	// Write data using memory operations
 	template<typename T>
 	void _write(const T& data, uint64_t count = 1)
@@ -232,20 +367,34 @@ private:
 		size_t _right = pos + _size;
 		if (_right > dataSize)
 		{
-			char* NEWDATA = new char[_right * 2];
-			memcpy(NEWDATA, DATA, dataSize);
-			dataSize = _right * 2;
-			SAFE_DELETE_ARRAY(DATA);
-			DATA = NEWDATA;
+			_reserve(_right);
 		}
 		memcpy(reinterpret_cast<void*>((uint64_t)DATA + (uint64_t)pos), &data, _size);
 		pos = _right;
 	}
 
+	// Read mode: checks that count elements of elementSize bytes are left to read, otherwise the archive is failed
+	//	and it stays at the end, so the following reads fail as well
+	bool _canRead(uint64_t count, size_t elementSize = 1)
+	{
+		if (pos <= dataSize && count <= (uint64_t)((dataSize - pos) / elementSize))
+		{
+			return true;
+		}
+		failed = true;
+		pos = dataSize;
+		return false;
+	}
+
 	// Read data using memory operations
 	template<typename T>
 	void _read(T& data, uint64_t count = 1)
 	{
+		if (!_canRead(count, sizeof(data)))
+		{
+			memset(&data, 0, (size_t)(sizeof(data)*count));
+			return;
+		}
 		memcpy(&data, reinterpret_cast<void*>((uint64_t)DATA + (uint64_t)pos), (size_t)(sizeof(data)*count));
 		pos += (size_t)(sizeof(data)*count);
 	}
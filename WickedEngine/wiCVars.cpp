@@ -25,14 +25,14 @@ wiCVars* wiCVars::GetGlobal()
 }
 
 
-const wiCVars::Variable wiCVars::get(const std::string& name)
+const wiCVars::Variable wiCVars::get(const wiHashString& name)
 {
 	container::iterator it = variables.find(name);
 	if(it!=variables.end())
 		return it->second;
 	else return Variable::Invalid();
 }
-bool wiCVars::set(const std::string& name, const std::string& value)
+bool wiCVars::set(const wiHashString& name, const std::string& value)
 {
 	if (!get(name).isValid())
 		return false;
@@ -40,21 +40,21 @@ bool wiCVars::set(const std::string& name, const std::string& value)
 	LOCK();
 	container::iterator it = variables.find(name);
 	if (it != variables.end())
-		variables[name].data = value;
+		it->second.data = value;
 	UNLOCK();
 
 	return true;
 }
-bool wiCVars::add(const std::string& name, const std::string& value, Data_Type newType)
+bool wiCVars::add(const wiHashString& name, const std::string& value, Data_Type newType)
 {
 	if(get(name).isValid())
 		return false;
 	LOCK();
-	variables.insert< pair<string,Variable> >( pair<string,Variable>(name,Variable(value,newType)) );
+	variables.insert(pair<wiHashString,Variable>(name,Variable(value,newType)));
 	UNLOCK();
 	return true;
 } 
-bool wiCVars::del(const std::string& name)
+bool wiCVars::del(const wiHashString& name)
 {
 	if (!get(name).isValid())
 		return false;
@@ -2,9 +2,10 @@
 #include "CommonInclude.h"
 #include "wiHelper.h"
 #include "wiThreadSafeManager.h"
+#include "wiHashString.h"
 
 #include <string>
-#include <map>
+#include <unordered_map>
 
 class wiCVars : public wiThreadSafeManager
 {
@@ -78,7 +79,7 @@ private:
 			return Variable("", EMPTY);
 		}
 	};
-	typedef std::map<std::string,Variable> container;
+	typedef std::unordered_map<wiHashString,Variable> container;
 	container variables;
 
 	static wiCVars* globalVars;
@@ -87,10 +88,10 @@ public:
 	~wiCVars();
 	static wiCVars* GetGlobal();
 
-	const Variable get(const std::string& name);
-	bool set(const std::string& name, const std::string& value);
-	bool add(const std::string& name, const std::string& value, Data_Type newType = Data_Type::TEXT); 
-	bool del(const std::string& name);
+	const Variable get(const wiHashString& name);
+	bool set(const wiHashString& name, const std::string& value);
+	bool add(const wiHashString& name, const std::string& value, Data_Type newType = Data_Type::TEXT); 
+	bool del(const wiHashString& name);
 	bool CleanUp();
 };
 
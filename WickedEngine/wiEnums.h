@@ -9,8 +9,18 @@ enum GRAPHICSTHREAD
 	GRAPHICSTHREAD_MISC1,
 	GRAPHICSTHREAD_MISC2,
 	GRAPHICSTHREAD_MISC3,
+	// the work items of wiRenderer::RecordParallel are recorded on these
+	GRAPHICSTHREAD_WORKER0,
+	GRAPHICSTHREAD_WORKER1,
+	GRAPHICSTHREAD_WORKER2,
+	GRAPHICSTHREAD_WORKER3,
+	GRAPHICSTHREAD_WORKER4,
+	GRAPHICSTHREAD_WORKER5,
+	GRAPHICSTHREAD_WORKER6,
+	GRAPHICSTHREAD_WORKER7,
 	GRAPHICSTHREAD_COUNT
 };
+static const int GRAPHICSTHREAD_WORKER_COUNT = GRAPHICSTHREAD_COUNT - GRAPHICSTHREAD_WORKER0;
 
 // Do not alter order or value because it is bound to lua manually!
 enum RENDERTYPE
@@ -86,6 +96,7 @@ enum RBTYPES
 	RBTYPE_ENTITYINDEXLIST_TRANSPARENT,
 	RBTYPE_VOXELSCENE,
 	RBTYPE_MATRIXARRAY,
+	RBTYPE_MATERIALARRAY,
 	RBTYPE_LAST
 };
 
@@ -15,7 +15,6 @@ using namespace wiGraphicsTypes;
 #define WHITESPACE_SIZE 3
 
 std::string			wiFont::FONTPATH = "fonts/";
-GPURingBuffer		*wiFont::vertexBuffer = nullptr;
 GPUBuffer			*wiFont::indexBuffer = nullptr;
 VertexLayout		*wiFont::vertexLayout = nullptr;
 VertexShader		*wiFont::vertexShader = nullptr;
@@ -45,18 +44,6 @@ void wiFont::Initialize()
 }
 
 
-void wiFont::LoadVertexBuffer()
-{
-	GPUBufferDesc bd;
-	ZeroMemory(&bd, sizeof(bd));
-	bd.Usage = USAGE_DYNAMIC;
-	bd.ByteWidth = 1024 * 1024; // just allocate 1MB to font renderer ring buffer..
-	bd.BindFlags = BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = CPU_ACCESS_WRITE;
-
-	vertexBuffer = new GPURingBuffer;
-	wiRenderer::GetDevice()->CreateBuffer(&bd, NULL, vertexBuffer);
-}
 void wiFont::LoadIndices()
 {
 	uint16_t indices[MAX_TEXT * 6];
@@ -168,7 +155,6 @@ void wiFont::SetUpStaticComponents()
 {
 	SetUpStates();
 	LoadShaders();
-	LoadVertexBuffer();
 	LoadIndices();
 
 	// add default font:
@@ -182,7 +168,6 @@ void wiFont::CleanUpStatic()
 
 	vertexList.clear();
 
-	SAFE_DELETE(vertexBuffer);
 	SAFE_DELETE(indexBuffer);
 	SAFE_DELETE(vertexLayout);
 	SAFE_DELETE(vertexShader);
@@ -191,10 +176,6 @@ void wiFont::CleanUpStatic()
 	SAFE_DELETE(rasterizerState_Scissor);
 	SAFE_DELETE(rasterizerState);
 	SAFE_DELETE(depthStencilState);
-	SAFE_DELETE(vertexBuffer);
-	SAFE_DELETE(vertexBuffer);
-	SAFE_DELETE(vertexBuffer);
-	SAFE_DELETE(vertexBuffer);
 }
 
 
@@ -287,7 +268,12 @@ void wiFont::Draw(GRAPHICSTHREAD threadID, bool scissorTest)
 
 	ModifyGeo(text, newProps, style);
 
-
+	// The vertices are written into the upload allocator of the renderer, it isn't there before the renderer is set up:
+	const wiUploadAllocator::Allocation vertexAllocation = wiRenderer::uploadAllocator.Upload(vertexList.data(), sizeof(Vertex) * text.length() * 4, threadID);
+	if (!vertexAllocation.IsValid())
+	{
+		return;
+	}
 
 	GraphicsDevice* device = wiRenderer::GetDevice();
 	device->EventBegin("Font", threadID);
@@ -303,16 +289,14 @@ void wiFont::Draw(GRAPHICSTHREAD threadID, bool scissorTest)
 
 	device->BindBlendState(blendState, threadID);
 
-	UINT vboffset = device->AppendRingBuffer(vertexBuffer, vertexList.data(), sizeof(Vertex) * text.length() * 4, threadID);
-
 	const GPUBuffer* vbs[] = {
-		vertexBuffer,
+		vertexAllocation.buffer,
 	};
 	const UINT strides[] = {
 		sizeof(Vertex),
 	};
 	const UINT offsets[] = {
-		vboffset,
+		vertexAllocation.offset,
 	};
 	device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
 
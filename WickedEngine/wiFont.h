@@ -48,7 +48,6 @@ protected:
 		ALIGN_16
 	};
 	static std::vector<Vertex> vertexList;
-	static wiGraphicsTypes::GPURingBuffer       *vertexBuffer;
 	static wiGraphicsTypes::GPUBuffer           *indexBuffer;
 
 	static wiGraphicsTypes::VertexLayout		*vertexLayout;
@@ -63,7 +62,6 @@ protected:
 public:
 	static void LoadShaders();
 private:
-	static void LoadVertexBuffer();
 	static void LoadIndices();
 
 
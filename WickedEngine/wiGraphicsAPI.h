@@ -4,5 +4,6 @@
 #include "wiGraphicsDescriptors.h"
 #include "wiGraphicsResource.h"
 #include "wiGraphicsDevice.h"
+#include "wiGraphicsDevice_Null.h"
 
 #endif // _GRAPHICS_API_H_
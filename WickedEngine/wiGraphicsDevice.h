@@ -7,6 +7,9 @@
 #include "wiGraphicsDescriptors.h"
 #include "wiGraphicsResource.h"
 
+#include <vector>
+#include <algorithm>
+
 namespace wiGraphicsTypes
 {
 
@@ -20,10 +23,38 @@ namespace wiGraphicsTypes
 		bool RESOLUTIONCHANGED;
 		static FORMAT BACKBUFFER_FORMAT;
 		bool TESSELLATION, MULTITHREADED_RENDERING, CONSERVATIVE_RASTERIZATION, RASTERIZER_ORDERED_VIEWS, UNORDEREDACCESSTEXTURE_LOAD_EXT;
+
+		// The dynamic buffers that the deferred threads discarded in their current command lists
+		std::vector<const GPUBuffer*> discardedBuffers[GRAPHICSTHREAD_COUNT];
+		// The command lists that the deferred threads finished
+		uint64_t commandListCounts[GRAPHICSTHREAD_COUNT];
+		// A deferred thread can only map a dynamic buffer without discarding it (no overwrite) after it discarded the buffer
+		//	in the same command list, because the command list can't see the contents that were written outside of it.
+		//	Returns true if this mapping has to discard. FinishCommandList() starts a new command list with EndCommandList()
+		bool IsDiscardRequired(const GPUBuffer* buffer, GRAPHICSTHREAD threadID)
+		{
+			if (threadID == GRAPHICSTHREAD_IMMEDIATE)
+			{
+				return false;
+			}
+			std::vector<const GPUBuffer*>& discarded = discardedBuffers[threadID];
+			if (std::find(discarded.begin(), discarded.end(), buffer) != discarded.end())
+			{
+				return false;
+			}
+			discarded.push_back(buffer);
+			return true;
+		}
+		void EndCommandList(GRAPHICSTHREAD threadID)
+		{
+			discardedBuffers[threadID].clear();
+			commandListCounts[threadID]++;
+		}
 	public:
 		GraphicsDevice() 
 			:FRAMECOUNT(0), VSYNC(true), SCREENWIDTH(0), SCREENHEIGHT(0), FULLSCREEN(false), RESOLUTIONCHANGED(false),
-			TESSELLATION(false), MULTITHREADED_RENDERING(false), CONSERVATIVE_RASTERIZATION(false),RASTERIZER_ORDERED_VIEWS(false), UNORDEREDACCESSTEXTURE_LOAD_EXT(false)
+			TESSELLATION(false), MULTITHREADED_RENDERING(false), CONSERVATIVE_RASTERIZATION(false),RASTERIZER_ORDERED_VIEWS(false), UNORDEREDACCESSTEXTURE_LOAD_EXT(false),
+			commandListCounts()
 		{}
 
 		virtual HRESULT CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *ppBuffer) = 0;
@@ -49,10 +80,15 @@ namespace wiGraphicsTypes
 
 		virtual void ExecuteDeferredContexts() = 0;
 		virtual void FinishCommandList(GRAPHICSTHREAD thread) = 0;
+		// Executes the finished command list of a deferred thread on the destination thread (immediate or deferred), the state of the destination is kept
+		virtual void ExecuteCommandList(GRAPHICSTHREAD thread, GRAPHICSTHREAD destination) = 0;
 
 		bool GetVSyncEnabled() { return VSYNC; }
 		void SetVSyncEnabled(bool value) { VSYNC = value; }
 		uint64_t GetFrameCount() { return FRAMECOUNT; }
+		// Changes when the deferred thread finishes its command list. The data that it wrote into discarded dynamic buffers
+		//	before that is not visible in its next command list
+		uint64_t GetCommandListCount(GRAPHICSTHREAD thread) { return commandListCounts[thread]; }
 
 		int GetScreenWidth() { return SCREENWIDTH; }
 		int GetScreenHeight() { return SCREENHEIGHT; }
@@ -145,8 +181,13 @@ namespace wiGraphicsTypes
 		virtual void CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, const Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID) = 0;
 		virtual void MSAAResolve(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID) = 0;
 		virtual void UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize = -1) = 0;
+		// Updates dataSize bytes of a default usage buffer starting at dataOffset, data points to the new contents of the range
+		virtual void UpdateBufferRange(GPUBuffer* buffer, const void* data, UINT dataOffset, UINT dataSize, GRAPHICSTHREAD threadID) = 0;
 		// Returns the starting byte offset of the appended data
 		virtual UINT AppendRingBuffer(GPURingBuffer* buffer, const void* data, size_t dataSize, GRAPHICSTHREAD threadID) = 0;
+		// Returns a pointer to write dataSize bytes into the (dynamic) buffer directly, the buffer must be closed with InvalidateBufferAccess before it is used
+		virtual void* AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID) = 0;
+		virtual void InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID) = 0;
 		virtual bool DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID, bool async = true) = 0;
 		virtual void SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID) = 0;
 		virtual void QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID) = 0;
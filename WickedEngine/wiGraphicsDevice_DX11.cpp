@@ -2690,6 +2690,16 @@ void GraphicsDevice_DX11::FinishCommandList(GRAPHICSTHREAD thread)
 	if (thread == GRAPHICSTHREAD_IMMEDIATE)
 		return;
 	deviceContexts[thread]->FinishCommandList(true, &commandLists[thread]);
+	EndCommandList(thread);
+}
+void GraphicsDevice_DX11::ExecuteCommandList(GRAPHICSTHREAD thread, GRAPHICSTHREAD destination)
+{
+	assert(thread != GRAPHICSTHREAD_IMMEDIATE && thread != destination);
+	if (commandLists[thread] == nullptr)
+		return;
+	deviceContexts[destination]->ExecuteCommandList(commandLists[thread], true);
+	commandLists[thread]->Release();
+	commandLists[thread] = nullptr;
 }
 
 void GraphicsDevice_DX11::BindViewports(UINT NumViewports, const ViewPort *pViewports, GRAPHICSTHREAD threadID) 
@@ -3241,6 +3251,26 @@ void GraphicsDevice_DX11::UpdateBuffer(GPUBuffer* buffer, const void* data, GRAP
 		deviceContexts[threadID]->UpdateSubresource(buffer->resource_DX11, 0, &box, data, 0, 0);
 	}
 }
+void GraphicsDevice_DX11::UpdateBufferRange(GPUBuffer* buffer, const void* data, UINT dataOffset, UINT dataSize, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage == USAGE_DEFAULT && "Only DEFAULT GPUBuffer ranges can be updated!");
+	assert(!(buffer->desc.BindFlags & BIND_CONSTANT_BUFFER) && "Constant buffers can only be updated as a whole!");
+	assert(dataOffset + dataSize <= buffer->desc.ByteWidth && "Data range is out of the buffer!");
+
+	if (dataSize == 0)
+	{
+		return;
+	}
+
+	D3D11_BOX box = {};
+	box.left = dataOffset;
+	box.right = dataOffset + dataSize;
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+	deviceContexts[threadID]->UpdateSubresource(buffer->resource_DX11, 0, &box, data, 0, 0);
+}
 UINT GraphicsDevice_DX11::AppendRingBuffer(GPURingBuffer* buffer, const void* data, size_t dataSize, GRAPHICSTHREAD threadID)
 {
 	assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
@@ -3253,14 +3283,13 @@ UINT GraphicsDevice_DX11::AppendRingBuffer(GPURingBuffer* buffer, const void* da
 
 	dataSize = min(buffer->desc.ByteWidth, dataSize);
 
-	size_t position = buffer->byteOffset;
-	bool wrap = position + dataSize > buffer->desc.ByteWidth || buffer->residentFrame != FRAMECOUNT;
-	position = wrap ? 0 : position;
+	bool wrap;
+	size_t position = buffer->Reserve(dataSize, FRAMECOUNT, wrap);
 
 	if (buffer->desc.Usage == USAGE_DYNAMIC)
 	{
-		// Issue buffer rename (realloc) on wrap, otherwise just append data:
-		D3D11_MAP mapping = wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+		// Issue buffer rename (realloc) on wrap or on the first mapping in a deferred command list, otherwise just append data:
+		D3D11_MAP mapping = IsDiscardRequired(buffer, threadID) || wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
 		D3D11_MAPPED_SUBRESOURCE mappedResource;
 		HRESULT hr = deviceContexts[threadID]->Map(buffer->resource_DX11, 0, mapping, 0, &mappedResource);
 		assert(SUCCEEDED(hr) && "GPUBuffer mapping failed!");
@@ -3278,13 +3307,38 @@ UINT GraphicsDevice_DX11::AppendRingBuffer(GPURingBuffer* buffer, const void* da
 		box.back = 1;
 		deviceContexts[threadID]->UpdateSubresource(buffer->resource_DX11, 0, &box, data, 0, 0);
 	}
-	
-	// TODO: contention?
-	buffer->byteOffset = position + dataSize;
-	buffer->residentFrame = FRAMECOUNT;
 
 	return static_cast<UINT>(position);
 }
+void* GraphicsDevice_DX11::AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage == USAGE_DYNAMIC && (buffer->desc.CPUAccessFlags & CPU_ACCESS_WRITE) && "Ringbuffer must be writable by the CPU!");
+	assert(buffer->desc.ByteWidth > dataSize && "Data of the required size cannot fit!");
+
+	if (dataSize == 0)
+	{
+		offsetIntoBuffer = 0xFFFFFFFF;
+		return nullptr;
+	}
+
+	dataSize = min(buffer->desc.ByteWidth, dataSize);
+
+	bool wrap;
+	size_t position = buffer->Reserve(dataSize, FRAMECOUNT, wrap);
+
+	// Issue buffer rename (realloc) on wrap or on the first mapping in a deferred command list, otherwise just append data:
+	D3D11_MAP mapping = IsDiscardRequired(buffer, threadID) || wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	HRESULT hr = deviceContexts[threadID]->Map(buffer->resource_DX11, 0, mapping, 0, &mappedResource);
+	assert(SUCCEEDED(hr) && "GPUBuffer mapping failed!");
+
+	offsetIntoBuffer = static_cast<UINT>(position);
+	return reinterpret_cast<void*>(reinterpret_cast<size_t>(mappedResource.pData) + position);
+}
+void GraphicsDevice_DX11::InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID)
+{
+	deviceContexts[threadID]->Unmap(buffer->resource_DX11, 0);
+}
 bool GraphicsDevice_DX11::DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID, bool async)
 {
 	assert(bufferToDownload->desc.ByteWidth <= bufferDest->desc.ByteWidth);
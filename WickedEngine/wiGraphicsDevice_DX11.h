@@ -58,6 +58,7 @@ namespace wiGraphicsTypes
 
 		virtual void ExecuteDeferredContexts() override;
 		virtual void FinishCommandList(GRAPHICSTHREAD thread) override;
+		virtual void ExecuteCommandList(GRAPHICSTHREAD thread, GRAPHICSTHREAD destination) override;
 
 		virtual void SetResolution(int width, int height) override;
 
@@ -126,7 +127,10 @@ namespace wiGraphicsTypes
 		virtual void CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, const Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID) override;
 		virtual void MSAAResolve(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID) override;
 		virtual void UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize = -1) override;
+		virtual void UpdateBufferRange(GPUBuffer* buffer, const void* data, UINT dataOffset, UINT dataSize, GRAPHICSTHREAD threadID) override;
 		virtual UINT AppendRingBuffer(GPURingBuffer* buffer, const void* data, size_t dataSize, GRAPHICSTHREAD threadID) override;
+		virtual void* AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID) override;
+		virtual void InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID) override;
 		virtual bool DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID, bool async = true) override;
 		virtual void SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID) override;
 		virtual void QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID) override;
@@ -0,0 +1,884 @@
+#include "wiGraphicsDevice_Null.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+
+using namespace std;
+
+namespace wiGraphicsTypes
+{
+
+void GraphicsDevice_Null::ThreadState::ResetState()
+{
+	for (int i = 0; i < STAGE_COUNT; ++i)
+	{
+		shaders[i] = nullptr;
+	}
+	vertexLayout = nullptr;
+	primitiveTopology = -1;
+	blendState = nullptr;
+	depthStencilState = nullptr;
+	stencilRef = 0;
+	rasterizerState = nullptr;
+}
+
+GraphicsDevice_Null::GraphicsDevice_Null(int width, int height) :GraphicsDevice(), recording(true), nextID(1)
+{
+	SCREENWIDTH = width;
+	SCREENHEIGHT = height;
+	VSYNC = false;
+
+	// Multithreaded rendering is supported, because every graphics thread records on its own. The rest of the optional
+	//	features are reported as missing, so that the renderer takes its widely supported paths:
+	TESSELLATION = false;
+	MULTITHREADED_RENDERING = true;
+
+	backBufferDesc.Width = SCREENWIDTH;
+	backBufferDesc.Height = SCREENHEIGHT;
+	backBufferDesc.Format = GetBackBufferFormat();
+	backBufferDesc.BindFlags = BIND_RENDER_TARGET;
+	backBufferDesc.SampleDesc.Count = 1;
+	backBufferID = CreateID();
+
+	for (int i = 0; i < GRAPHICSTHREAD_COUNT; ++i)
+	{
+		threads[i].commands.reserve(4096);
+	}
+}
+GraphicsDevice_Null::~GraphicsDevice_Null()
+{
+}
+
+void GraphicsDevice_Null::Record(GRAPHICSTHREAD threadID, COMMAND_TYPE type, SHADERSTAGE stage, int slot, uint32_t resource, uint32_t arg0, uint32_t arg1)
+{
+	ThreadState& thread = threads[threadID];
+	thread.stats.commands++;
+	if (recording)
+	{
+		Command command;
+		command.type = (uint8_t)type;
+		command.stage = (uint8_t)stage;
+		command.slot = (uint16_t)max(slot, 0);
+		command.resource = resource;
+		command.arg0 = arg0;
+		command.arg1 = arg1;
+		thread.commands.push_back(command);
+	}
+}
+void GraphicsDevice_Null::RecordState(GRAPHICSTHREAD threadID, COMMAND_TYPE type, SHADERSTAGE stage, const void*& current, const void* state, uint32_t resource, uint32_t arg0)
+{
+	ThreadState& thread = threads[threadID];
+	if (current == state)
+	{
+		thread.stats.redundantStateChanges++;
+	}
+	else
+	{
+		thread.stats.stateChanges++;
+		current = state;
+	}
+	Record(threadID, type, stage, 0, resource, arg0);
+}
+
+uint32_t GraphicsDevice_Null::GetUAVID(const GPUUnorderedResource* resource)
+{
+	// Every unordered resource is a buffer or a texture, the ID is stored in the shader resource part:
+	return GetID(dynamic_cast<const GPUResource*>(resource));
+}
+uint64_t GraphicsDevice_Null::GetTextureSize(UINT width, UINT height, UINT depth, UINT arraySize, UINT mipLevels)
+{
+	// Estimated with 4 bytes per texel, the format is not taken into account:
+	uint64_t size = 0;
+	for (UINT mip = 0; mip < max(mipLevels, 1u); ++mip)
+	{
+		size += (uint64_t)max(width >> mip, 1u) * max(height >> mip, 1u) * max(depth >> mip, 1u) * 4;
+	}
+	return size * max(arraySize, 1u);
+}
+
+
+void GraphicsDevice_Null::SetResolution(int width, int height)
+{
+	if (width != SCREENWIDTH || height != SCREENHEIGHT)
+	{
+		SCREENWIDTH = width;
+		SCREENHEIGHT = height;
+		backBufferDesc.Width = width;
+		backBufferDesc.Height = height;
+		RESOLUTIONCHANGED = true;
+	}
+}
+
+Texture2D GraphicsDevice_Null::GetBackBuffer()
+{
+	Texture2D result;
+	result.desc = backBufferDesc;
+	result.resource_Null = backBufferID;
+	return result;
+}
+
+HRESULT GraphicsDevice_Null::CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *ppBuffer)
+{
+	ppBuffer->desc = *pDesc;
+	ppBuffer->shadow_Null.resize(pDesc->ByteWidth);
+	if (pInitialData != nullptr && pInitialData->pSysMem != nullptr)
+	{
+		memcpy(ppBuffer->shadow_Null.data(), pInitialData->pSysMem, pDesc->ByteWidth);
+	}
+	ppBuffer->resource_Null = CreateID();
+
+	resourceStats.buffers++;
+	resourceStats.bufferBytes += pDesc->ByteWidth;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture1D(const Texture1DDesc* pDesc, const SubresourceData *pInitialData, Texture1D **ppTexture1D)
+{
+	if ((*ppTexture1D) == nullptr)
+	{
+		(*ppTexture1D) = new Texture1D;
+	}
+	(*ppTexture1D)->desc = *pDesc;
+	if ((*ppTexture1D)->desc.MipLevels == 0)
+	{
+		(*ppTexture1D)->desc.MipLevels = (UINT)log2((*ppTexture1D)->desc.Width);
+	}
+	(*ppTexture1D)->resource_Null = CreateID();
+
+	resourceStats.textures++;
+	resourceStats.textureBytes += GetTextureSize(pDesc->Width, 1, 1, pDesc->ArraySize, (*ppTexture1D)->desc.MipLevels);
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture2D(const Texture2DDesc* pDesc, const SubresourceData *pInitialData, Texture2D **ppTexture2D)
+{
+	if ((*ppTexture2D) == nullptr)
+	{
+		(*ppTexture2D) = new Texture2D;
+	}
+	(*ppTexture2D)->desc = *pDesc;
+	if ((*ppTexture2D)->desc.MipLevels == 0)
+	{
+		(*ppTexture2D)->desc.MipLevels = (UINT)log2(max((*ppTexture2D)->desc.Width, (*ppTexture2D)->desc.Height));
+	}
+	(*ppTexture2D)->resource_Null = CreateID();
+
+	resourceStats.textures++;
+	resourceStats.textureBytes += GetTextureSize(pDesc->Width, pDesc->Height, 1, pDesc->ArraySize, (*ppTexture2D)->desc.MipLevels)
+		* max(pDesc->SampleDesc.Count, 1u);
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateTexture3D(const Texture3DDesc* pDesc, const SubresourceData *pInitialData, Texture3D **ppTexture3D)
+{
+	if ((*ppTexture3D) == nullptr)
+	{
+		(*ppTexture3D) = new Texture3D;
+	}
+	(*ppTexture3D)->desc = *pDesc;
+	if ((*ppTexture3D)->desc.MipLevels == 0)
+	{
+		(*ppTexture3D)->desc.MipLevels = (UINT)log2(max((*ppTexture3D)->desc.Width, max((*ppTexture3D)->desc.Height, (*ppTexture3D)->desc.Depth)));
+	}
+	(*ppTexture3D)->resource_Null = CreateID();
+
+	resourceStats.textures++;
+	resourceStats.textureBytes += GetTextureSize(pDesc->Width, pDesc->Height, pDesc->Depth, 1, (*ppTexture3D)->desc.MipLevels);
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateInputLayout(const VertexLayoutDesc *pInputElementDescs, UINT NumElements,
+	const void *pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, VertexLayout *pInputLayout)
+{
+	if (pInputElementDescs == nullptr || NumElements == 0)
+	{
+		return E_FAIL;
+	}
+	pInputLayout->resource_Null = CreateID();
+	resourceStats.states++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateShader(const void *pShaderBytecode, SIZE_T BytecodeLength, uint32_t& resource)
+{
+	if (pShaderBytecode == nullptr || BytecodeLength == 0)
+	{
+		return E_FAIL;
+	}
+	resource = CreateID();
+	resourceStats.shaders++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateVertexShader(const void *pShaderBytecode, SIZE_T BytecodeLength, VertexShader *pVertexShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pVertexShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreatePixelShader(const void *pShaderBytecode, SIZE_T BytecodeLength, PixelShader *pPixelShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pPixelShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreateGeometryShader(const void *pShaderBytecode, SIZE_T BytecodeLength, GeometryShader *pGeometryShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pGeometryShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreateHullShader(const void *pShaderBytecode, SIZE_T BytecodeLength, HullShader *pHullShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pHullShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreateDomainShader(const void *pShaderBytecode, SIZE_T BytecodeLength, DomainShader *pDomainShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pDomainShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreateComputeShader(const void *pShaderBytecode, SIZE_T BytecodeLength, ComputeShader *pComputeShader)
+{
+	return CreateShader(pShaderBytecode, BytecodeLength, pComputeShader->resource_Null);
+}
+HRESULT GraphicsDevice_Null::CreateBlendState(const BlendStateDesc *pBlendStateDesc, BlendState *pBlendState)
+{
+	pBlendState->desc = *pBlendStateDesc;
+	pBlendState->resource_Null = CreateID();
+	resourceStats.states++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateDepthStencilState(const DepthStencilStateDesc *pDepthStencilStateDesc, DepthStencilState *pDepthStencilState)
+{
+	pDepthStencilState->desc = *pDepthStencilStateDesc;
+	pDepthStencilState->resource_Null = CreateID();
+	resourceStats.states++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateRasterizerState(const RasterizerStateDesc *pRasterizerStateDesc, RasterizerState *pRasterizerState)
+{
+	pRasterizerState->desc = *pRasterizerStateDesc;
+	pRasterizerState->resource_Null = CreateID();
+	resourceStats.states++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateSamplerState(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState)
+{
+	pSamplerState->desc = *pSamplerDesc;
+	pSamplerState->resource_Null = CreateID();
+	resourceStats.states++;
+	return S_OK;
+}
+HRESULT GraphicsDevice_Null::CreateQuery(const GPUQueryDesc *pDesc, GPUQuery *pQuery)
+{
+	pQuery->desc = *pDesc;
+	pQuery->async_frameshift = pQuery->desc.async_latency;
+	pQuery->resource_DX11.resize(pQuery->desc.async_latency + 1, nullptr);
+	pQuery->active.resize(pQuery->desc.async_latency + 1, 0);
+	pQuery->resource_Null = CreateID();
+	return S_OK;
+}
+
+
+void GraphicsDevice_Null::PresentBegin()
+{
+	LOCK();
+
+	Record(GRAPHICSTHREAD_IMMEDIATE, COMMAND_BIND_RENDERTARGETS, STAGE_PS, 0, backBufferID, 1);
+	Record(GRAPHICSTHREAD_IMMEDIATE, COMMAND_CLEAR_RENDERTARGET, STAGE_PS, 0, backBufferID);
+	threads[GRAPHICSTHREAD_IMMEDIATE].stats.renderTargetChanges++;
+}
+void GraphicsDevice_Null::PresentEnd()
+{
+	// Close the frame. The deferred threads were already executed into the immediate log, but their counters are still separate:
+	frameCommands.swap(threads[GRAPHICSTHREAD_IMMEDIATE].commands);
+	threads[GRAPHICSTHREAD_IMMEDIATE].commands.clear();
+	frameStats.Reset();
+	for (int i = 0; i < GRAPHICSTHREAD_COUNT; ++i)
+	{
+		frameStats.Add(threads[i].stats);
+		threads[i].stats.Reset();
+	}
+
+	threads[GRAPHICSTHREAD_IMMEDIATE].ResetState();
+
+	FRAMECOUNT++;
+
+	RESOLUTIONCHANGED = false;
+
+	UNLOCK();
+}
+
+void GraphicsDevice_Null::ExecuteDeferredContexts()
+{
+	vector<Command>& immediate = threads[GRAPHICSTHREAD_IMMEDIATE].commands;
+	for (int i = 0; i < GRAPHICSTHREAD_COUNT; i++)
+	{
+		if (i != GRAPHICSTHREAD_IMMEDIATE && !threads[i].commands.empty())
+		{
+			immediate.insert(immediate.end(), threads[i].commands.begin(), threads[i].commands.end());
+			threads[i].commands.clear();
+		}
+	}
+}
+void GraphicsDevice_Null::FinishCommandList(GRAPHICSTHREAD thread)
+{
+	if (thread == GRAPHICSTHREAD_IMMEDIATE)
+		return;
+	EndCommandList(thread);
+	threads[thread].discardedBuffers.clear();
+}
+void GraphicsDevice_Null::ExecuteCommandList(GRAPHICSTHREAD thread, GRAPHICSTHREAD destination)
+{
+	assert(thread != GRAPHICSTHREAD_IMMEDIATE && thread != destination);
+	vector<Command>& commands = threads[destination].commands;
+	commands.insert(commands.end(), threads[thread].commands.begin(), threads[thread].commands.end());
+	threads[thread].commands.clear();
+}
+
+void GraphicsDevice_Null::BindViewports(UINT NumViewports, const ViewPort *pViewports, GRAPHICSTHREAD threadID)
+{
+	assert(NumViewports <= 6);
+	Record(threadID, COMMAND_BIND_VIEWPORTS, STAGE_PS, 0, 0, NumViewports);
+}
+void GraphicsDevice_Null::BindRenderTargetsUAVs(UINT NumViews, Texture* const *ppRenderTargets, Texture2D* depthStencilTexture, GPUUnorderedResource* const *ppUAVs, int slotUAV, int countUAV,
+	GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	BindRenderTargets(NumViews, ppRenderTargets, depthStencilTexture, threadID, arrayIndex);
+	for (int i = 0; i < countUAV; ++i)
+	{
+		Record(threadID, COMMAND_BIND_UAV, STAGE_PS, slotUAV + i, ppUAVs == nullptr ? 0 : GetUAVID(ppUAVs[i]));
+	}
+}
+void GraphicsDevice_Null::BindRenderTargets(UINT NumViews, Texture* const *ppRenderTargets, Texture2D* depthStencilTexture, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	// The first render target and the depth buffer identify the pass well enough:
+	uint32_t renderTarget = (NumViews > 0 && ppRenderTargets != nullptr) ? GetID(ppRenderTargets[0]) : 0;
+	Record(threadID, COMMAND_BIND_RENDERTARGETS, STAGE_PS, max(arrayIndex, 0), renderTarget, NumViews, GetID(depthStencilTexture));
+	threads[threadID].stats.renderTargetChanges++;
+}
+void GraphicsDevice_Null::ClearRenderTarget(Texture* pTexture, const FLOAT ColorRGBA[4], GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	Record(threadID, COMMAND_CLEAR_RENDERTARGET, STAGE_PS, max(arrayIndex, 0), GetID(pTexture));
+}
+void GraphicsDevice_Null::ClearDepthStencil(Texture2D* pTexture, UINT ClearFlags, FLOAT Depth, UINT8 Stencil, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	Record(threadID, COMMAND_CLEAR_DEPTHSTENCIL, STAGE_PS, max(arrayIndex, 0), GetID(pTexture), ClearFlags, Stencil);
+}
+void GraphicsDevice_Null::BindResourcePS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_PS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourceVS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_VS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourceGS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_GS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourceDS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_DS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourceHS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_HS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourceCS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_RESOURCE, STAGE_CS, slot, GetID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindResourcesPS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourcePS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindResourcesVS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourceVS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindResourcesGS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourceGS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindResourcesDS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourceDS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindResourcesHS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourceHS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindResourcesCS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindResourceCS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::BindUnorderedAccessResourceCS(const GPUUnorderedResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_UAV, STAGE_CS, slot, GetUAVID(resource), (uint32_t)arrayIndex);
+}
+void GraphicsDevice_Null::BindUnorderedAccessResourcesCS(const GPUUnorderedResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		BindUnorderedAccessResourceCS(resources[i], slot + i, threadID);
+	}
+}
+void GraphicsDevice_Null::UnBindResources(int slot, int num, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_UNBIND_RESOURCES, STAGE_PS, slot, 0, num);
+}
+void GraphicsDevice_Null::UnBindUnorderedAccessResources(int slot, int num, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_UNBIND_UAVS, STAGE_CS, slot, 0, num);
+}
+void GraphicsDevice_Null::BindSamplerPS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_PS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindSamplerVS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_VS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindSamplerGS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_GS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindSamplerHS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_HS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindSamplerDS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_DS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindSamplerCS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_SAMPLER, STAGE_CS, slot, GetID(sampler));
+}
+void GraphicsDevice_Null::BindConstantBufferPS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_PS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindConstantBufferVS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_VS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindConstantBufferGS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_GS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindConstantBufferDS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_DS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindConstantBufferHS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_HS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindConstantBufferCS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_CONSTANTBUFFER, STAGE_CS, slot, GetID(buffer));
+}
+void GraphicsDevice_Null::BindVertexBuffers(const GPUBuffer* const *vertexBuffers, int slot, int count, const UINT* strides, const UINT* offsets, GRAPHICSTHREAD threadID)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		threads[threadID].stats.resourceBinds++;
+		Record(threadID, COMMAND_BIND_VERTEXBUFFER, STAGE_VS, slot + i, vertexBuffers == nullptr ? 0 : GetID(vertexBuffers[i]),
+			strides == nullptr ? 0 : strides[i], offsets == nullptr ? 0 : offsets[i]);
+	}
+}
+void GraphicsDevice_Null::BindIndexBuffer(const GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, UINT offset, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.resourceBinds++;
+	Record(threadID, COMMAND_BIND_INDEXBUFFER, STAGE_VS, 0, GetID(indexBuffer), (uint32_t)format, offset);
+}
+void GraphicsDevice_Null::BindPrimitiveTopology(PRIMITIVETOPOLOGY type, GRAPHICSTHREAD threadID)
+{
+	ThreadState& thread = threads[threadID];
+	if (thread.primitiveTopology == (int)type)
+	{
+		thread.stats.redundantStateChanges++;
+	}
+	else
+	{
+		thread.stats.stateChanges++;
+		thread.primitiveTopology = (int)type;
+	}
+	Record(threadID, COMMAND_BIND_PRIMITIVETOPOLOGY, STAGE_VS, 0, 0, (uint32_t)type);
+}
+void GraphicsDevice_Null::BindVertexLayout(const VertexLayout* layout, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_VERTEXLAYOUT, STAGE_VS, threads[threadID].vertexLayout, layout, GetID(layout));
+}
+void GraphicsDevice_Null::BindBlendState(const BlendState* state, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_BLENDSTATE, STAGE_PS, threads[threadID].blendState, state, GetID(state));
+}
+void GraphicsDevice_Null::BindBlendStateEx(const BlendState* state, const XMFLOAT4& blendFactor, UINT sampleMask, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_BLENDSTATE, STAGE_PS, threads[threadID].blendState, state, GetID(state), sampleMask);
+}
+void GraphicsDevice_Null::BindDepthStencilState(const DepthStencilState* state, UINT stencilRef, GRAPHICSTHREAD threadID)
+{
+	ThreadState& thread = threads[threadID];
+	// A different stencil reference is a state change too:
+	const void* current = thread.stencilRef == stencilRef ? thread.depthStencilState : nullptr;
+	RecordState(threadID, COMMAND_BIND_DEPTHSTENCILSTATE, STAGE_PS, current, state, GetID(state), stencilRef);
+	thread.depthStencilState = state;
+	thread.stencilRef = stencilRef;
+}
+void GraphicsDevice_Null::BindRasterizerState(const RasterizerState* state, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_RASTERIZERSTATE, STAGE_PS, threads[threadID].rasterizerState, state, GetID(state));
+}
+void GraphicsDevice_Null::BindPS(const PixelShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_PS, threads[threadID].shaders[STAGE_PS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::BindVS(const VertexShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_VS, threads[threadID].shaders[STAGE_VS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::BindGS(const GeometryShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_GS, threads[threadID].shaders[STAGE_GS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::BindHS(const HullShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_HS, threads[threadID].shaders[STAGE_HS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::BindDS(const DomainShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_DS, threads[threadID].shaders[STAGE_DS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::BindCS(const ComputeShader* shader, GRAPHICSTHREAD threadID)
+{
+	RecordState(threadID, COMMAND_BIND_SHADER, STAGE_CS, threads[threadID].shaders[STAGE_CS], shader, GetID(shader));
+}
+void GraphicsDevice_Null::Draw(int vertexCount, UINT startVertexLocation, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	threads[threadID].stats.primitives += vertexCount;
+	Record(threadID, COMMAND_DRAW, STAGE_VS, 0, 0, vertexCount, 1);
+}
+void GraphicsDevice_Null::DrawIndexed(int indexCount, UINT startIndexLocation, UINT baseVertexLocation, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	threads[threadID].stats.primitives += indexCount;
+	Record(threadID, COMMAND_DRAW_INDEXED, STAGE_VS, 0, 0, indexCount, 1);
+}
+void GraphicsDevice_Null::DrawInstanced(int vertexCount, int instanceCount, UINT startVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	threads[threadID].stats.primitives += (uint64_t)vertexCount * instanceCount;
+	Record(threadID, COMMAND_DRAW_INSTANCED, STAGE_VS, 0, 0, vertexCount, instanceCount);
+}
+void GraphicsDevice_Null::DrawIndexedInstanced(int indexCount, int instanceCount, UINT startIndexLocation, UINT baseVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	threads[threadID].stats.primitives += (uint64_t)indexCount * instanceCount;
+	Record(threadID, COMMAND_DRAW_INDEXED_INSTANCED, STAGE_VS, 0, 0, indexCount, instanceCount);
+}
+void GraphicsDevice_Null::DrawInstancedIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	Record(threadID, COMMAND_DRAW_INSTANCED_INDIRECT, STAGE_VS, 0, GetID(args), args_offset);
+}
+void GraphicsDevice_Null::DrawIndexedInstancedIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.drawCalls++;
+	Record(threadID, COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT, STAGE_VS, 0, GetID(args), args_offset);
+}
+void GraphicsDevice_Null::Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.dispatches++;
+	Record(threadID, COMMAND_DISPATCH, STAGE_CS, threadGroupCountZ, 0, threadGroupCountX, threadGroupCountY);
+}
+void GraphicsDevice_Null::DispatchIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID)
+{
+	threads[threadID].stats.dispatches++;
+	Record(threadID, COMMAND_DISPATCH_INDIRECT, STAGE_CS, 0, GetID(args), args_offset);
+}
+void GraphicsDevice_Null::GenerateMips(Texture* texture, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_GENERATE_MIPS, STAGE_PS, 0, GetID(texture));
+}
+void GraphicsDevice_Null::CopyTexture2D(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_COPY_TEXTURE, STAGE_PS, 0, GetID(pDst), GetID(pSrc));
+}
+void GraphicsDevice_Null::CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, const Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_COPY_TEXTURE, STAGE_PS, dstMip, GetID(pDst), GetID(pSrc), srcMip);
+}
+void GraphicsDevice_Null::MSAAResolve(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID)
+{
+	assert(pDst != nullptr && pSrc != nullptr);
+	Record(threadID, COMMAND_MSAA_RESOLVE, STAGE_PS, 0, GetID(pDst), GetID(pSrc));
+}
+void GraphicsDevice_Null::UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize)
+{
+	assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
+	assert((int)buffer->desc.ByteWidth >= dataSize || dataSize < 0 && "Data size is too big!");
+
+	if (dataSize == 0)
+	{
+		return;
+	}
+
+	size_t size = dataSize < 0 ? buffer->desc.ByteWidth : min((size_t)buffer->desc.ByteWidth, (size_t)dataSize);
+	memcpy(buffer->shadow_Null.data(), data, size);
+
+	threads[threadID].stats.bytesUploaded += size;
+	Record(threadID, COMMAND_UPDATE_BUFFER, STAGE_PS, 0, GetID(buffer), (uint32_t)size);
+}
+void GraphicsDevice_Null::UpdateBufferRange(GPUBuffer* buffer, const void* data, UINT dataOffset, UINT dataSize, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage == USAGE_DEFAULT && "Only DEFAULT GPUBuffer ranges can be updated!");
+	assert(!(buffer->desc.BindFlags & BIND_CONSTANT_BUFFER) && "Constant buffers can only be updated as a whole!");
+	assert(dataOffset + dataSize <= buffer->desc.ByteWidth && "Data range is out of the buffer!");
+
+	if (dataSize == 0)
+	{
+		return;
+	}
+
+	memcpy(buffer->shadow_Null.data() + dataOffset, data, dataSize);
+
+	threads[threadID].stats.bytesUploaded += dataSize;
+	Record(threadID, COMMAND_UPDATE_BUFFER, STAGE_PS, 0, GetID(buffer), dataSize, dataOffset);
+}
+UINT GraphicsDevice_Null::AppendRingBuffer(GPURingBuffer* buffer, const void* data, size_t dataSize, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage != USAGE_IMMUTABLE && "Cannot update IMMUTABLE GPUBuffer!");
+	assert(buffer->desc.ByteWidth > dataSize && "Data of the required size cannot fit!");
+
+	if (dataSize == 0)
+	{
+		return 0xFFFFFFFF;
+	}
+
+	dataSize = min((size_t)buffer->desc.ByteWidth, dataSize);
+
+	// The same wrapping as the other devices, so the returned offsets match:
+	bool wrap;
+	size_t position = buffer->Reserve(dataSize, FRAMECOUNT, wrap);
+	MapRingBuffer(buffer, wrap, threadID);
+
+	memcpy(buffer->shadow_Null.data() + position, data, dataSize);
+
+	threads[threadID].stats.bytesUploaded += dataSize;
+	Record(threadID, COMMAND_APPEND_RINGBUFFER, STAGE_PS, 0, GetID(buffer), (uint32_t)dataSize, (uint32_t)position);
+
+	return static_cast<UINT>(position);
+}
+void* GraphicsDevice_Null::AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID)
+{
+	assert(buffer->desc.Usage == USAGE_DYNAMIC && (buffer->desc.CPUAccessFlags & CPU_ACCESS_WRITE) && "Ringbuffer must be writable by the CPU!");
+	assert(buffer->desc.ByteWidth > dataSize && "Data of the required size cannot fit!");
+
+	if (dataSize == 0)
+	{
+		offsetIntoBuffer = 0xFFFFFFFF;
+		return nullptr;
+	}
+
+	dataSize = min((size_t)buffer->desc.ByteWidth, dataSize);
+
+	bool wrap;
+	size_t position = buffer->Reserve(dataSize, FRAMECOUNT, wrap);
+	MapRingBuffer(buffer, wrap, threadID);
+
+	// The caller writes into the shadow copy, it is counted as uploaded now:
+	threads[threadID].stats.bytesUploaded += dataSize;
+	Record(threadID, COMMAND_APPEND_RINGBUFFER, STAGE_PS, 0, GetID(buffer), (uint32_t)dataSize, (uint32_t)position);
+
+	offsetIntoBuffer = static_cast<UINT>(position);
+	return buffer->shadow_Null.data() + position;
+}
+void GraphicsDevice_Null::InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID)
+{
+}
+bool GraphicsDevice_Null::MapRingBuffer(GPURingBuffer* buffer, bool wrap, GRAPHICSTHREAD threadID)
+{
+	const bool discard = IsDiscardRequired(buffer, threadID) || wrap;
+	if (threadID == GRAPHICSTHREAD_IMMEDIATE)
+	{
+		return discard;
+	}
+
+	// A deferred command list only sees the contents that it wrote after discarding the buffer:
+	ThreadState& thread = threads[threadID];
+	const uint32_t id = GetID(buffer);
+	if (discard)
+	{
+		thread.discardedBuffers.push_back(id);
+	}
+	else if (find(thread.discardedBuffers.begin(), thread.discardedBuffers.end(), id) == thread.discardedBuffers.end())
+	{
+		thread.stats.invalidMappings++;
+		assert(0 && "Deferred no overwrite mapping without a discard in the command list!");
+	}
+	return discard;
+}
+bool GraphicsDevice_Null::DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID, bool async)
+{
+	assert(bufferToDownload->desc.ByteWidth <= bufferDest->desc.ByteWidth);
+	assert(bufferDest->desc.Usage & USAGE_STAGING);
+	assert(dataDest != nullptr);
+
+	// Nothing writes the buffers on the GPU, so the download returns what was uploaded:
+	memcpy(bufferDest->shadow_Null.data(), bufferToDownload->shadow_Null.data(), bufferToDownload->desc.ByteWidth);
+	memcpy(dataDest, bufferDest->shadow_Null.data(), bufferToDownload->desc.ByteWidth);
+
+	Record(threadID, COMMAND_DOWNLOAD_BUFFER, STAGE_PS, 0, GetID(bufferToDownload), bufferToDownload->desc.ByteWidth, GetID(bufferDest));
+	return true;
+}
+void GraphicsDevice_Null::SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_SET_SCISSORRECTS, STAGE_PS, 0, 0, numRects);
+}
+
+void GraphicsDevice_Null::QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	query->active[query->async_frameshift] = true;
+	Record(threadID, COMMAND_QUERY_BEGIN, STAGE_PS, 0, GetID(query));
+}
+void GraphicsDevice_Null::QueryEnd(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	query->active[query->async_frameshift] = true;
+	Record(threadID, COMMAND_QUERY_END, STAGE_PS, 0, GetID(query));
+}
+bool GraphicsDevice_Null::QueryRead(GPUQuery *query, GRAPHICSTHREAD threadID)
+{
+	query->async_frameshift = (query->async_frameshift + 1) % (query->desc.async_latency + 1);
+	const int _readQueryID = query->async_frameshift;
+
+	if (!query->active[_readQueryID])
+	{
+		return true;
+	}
+
+	assert(threadID == GRAPHICSTHREAD_IMMEDIATE && "A query can only be read on the immediate graphics thread!");
+
+	// Everything is visible, so occlusion culling doesn't remove anything. The timestamps are reported as disjoint,
+	//	so that they are not used for measuring GPU time:
+	switch (query->desc.Type)
+	{
+	case GPU_QUERY_TYPE_TIMESTAMP:
+		query->result_timestamp = 0;
+		break;
+	case GPU_QUERY_TYPE_TIMESTAMP_DISJOINT:
+		query->result_disjoint = TRUE;
+		query->result_timestamp_frequency = 1;
+		break;
+	case GPU_QUERY_TYPE_OCCLUSION:
+		query->result_passed_sample_count = 1;
+		query->result_passed = TRUE;
+		break;
+	case GPU_QUERY_TYPE_OCCLUSION_PREDICATE:
+	default:
+		query->result_passed = TRUE;
+		break;
+	}
+
+	query->active[_readQueryID] = false;
+
+	return true;
+}
+
+
+HRESULT GraphicsDevice_Null::CreateTextureFromFile(const std::string& fileName, Texture2D **ppTexture, bool mipMaps, GRAPHICSTHREAD threadID)
+{
+	ifstream file(fileName, ios::binary);
+	if (!file.is_open())
+	{
+		return E_FAIL;
+	}
+
+	// Only the dimensions are read from the header, the image is not decoded. Unknown formats get a placeholder size:
+	Texture2DDesc desc;
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.Format = FORMAT_R8G8B8A8_UNORM;
+	desc.BindFlags = BIND_SHADER_RESOURCE;
+	desc.SampleDesc.Count = 1;
+
+	uint8_t header[32] = {};
+	file.read((char*)header, sizeof(header));
+	if (file.gcount() >= 24 && !memcmp(header, "\x89PNG", 4))
+	{
+		// The IHDR chunk comes first, with big endian width and height:
+		desc.Width = ((uint32_t)header[16] << 24) | ((uint32_t)header[17] << 16) | ((uint32_t)header[18] << 8) | (uint32_t)header[19];
+		desc.Height = ((uint32_t)header[20] << 24) | ((uint32_t)header[21] << 16) | ((uint32_t)header[22] << 8) | (uint32_t)header[23];
+	}
+	else if (file.gcount() >= 32 && !memcmp(header, "DDS ", 4))
+	{
+		// The DDS_HEADER follows the magic number, with little endian height, width, pitch, depth and mip count:
+		uint32_t mipCount;
+		memcpy(&desc.Height, header + 12, sizeof(uint32_t));
+		memcpy(&desc.Width, header + 16, sizeof(uint32_t));
+		memcpy(&mipCount, header + 28, sizeof(uint32_t));
+		desc.MipLevels = max(mipCount, 1u);
+	}
+	if (mipMaps && desc.MipLevels == 1)
+	{
+		desc.MipLevels = 0;
+	}
+
+	(*ppTexture) = nullptr;
+	return CreateTexture2D(&desc, nullptr, ppTexture);
+}
+HRESULT GraphicsDevice_Null::SaveTexturePNG(const std::string& fileName, Texture2D *pTexture, GRAPHICSTHREAD threadID)
+{
+	// There are no texture contents to save:
+	return E_FAIL;
+}
+HRESULT GraphicsDevice_Null::SaveTextureDDS(const std::string& fileName, Texture *pTexture, GRAPHICSTHREAD threadID)
+{
+	return E_FAIL;
+}
+
+void GraphicsDevice_Null::EventBegin(const std::string& name, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_EVENT_BEGIN, STAGE_PS, 0, 0);
+}
+void GraphicsDevice_Null::EventEnd(GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_EVENT_END, STAGE_PS, 0, 0);
+}
+void GraphicsDevice_Null::SetMarker(const std::string& name, GRAPHICSTHREAD threadID)
+{
+	Record(threadID, COMMAND_SET_MARKER, STAGE_PS, 0, 0);
+}
+
+}
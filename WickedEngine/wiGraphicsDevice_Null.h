@@ -0,0 +1,305 @@
+#ifndef _GRAPHICSDEVICE_NULL_H_
+#define _GRAPHICSDEVICE_NULL_H_
+
+#include "CommonInclude.h"
+#include "wiGraphicsDevice.h"
+
+#include <atomic>
+#include <vector>
+
+namespace wiGraphicsTypes
+{
+
+	// Graphics device without a GPU, for running the renderer headless (tools, servers, benchmarks of the CPU side of a frame).
+	//	Resources are only descriptors with an ID, buffers also keep a CPU copy of their contents so that updates and downloads
+	//	behave like on a real device. Every command is recorded into a compact log per graphics thread and counted, and
+	//	presenting closes the frame: the log and the counters of the last presented frame can be inspected after that.
+	class GraphicsDevice_Null : public GraphicsDevice
+	{
+	public:
+		enum COMMAND_TYPE
+		{
+			COMMAND_BIND_VIEWPORTS,
+			COMMAND_BIND_RENDERTARGETS,
+			COMMAND_CLEAR_RENDERTARGET,
+			COMMAND_CLEAR_DEPTHSTENCIL,
+			COMMAND_BIND_RESOURCE,
+			COMMAND_BIND_UAV,
+			COMMAND_UNBIND_RESOURCES,
+			COMMAND_UNBIND_UAVS,
+			COMMAND_BIND_SAMPLER,
+			COMMAND_BIND_CONSTANTBUFFER,
+			COMMAND_BIND_VERTEXBUFFER,
+			COMMAND_BIND_INDEXBUFFER,
+			COMMAND_BIND_PRIMITIVETOPOLOGY,
+			COMMAND_BIND_VERTEXLAYOUT,
+			COMMAND_BIND_BLENDSTATE,
+			COMMAND_BIND_DEPTHSTENCILSTATE,
+			COMMAND_BIND_RASTERIZERSTATE,
+			COMMAND_BIND_SHADER,
+			COMMAND_DRAW,
+			COMMAND_DRAW_INDEXED,
+			COMMAND_DRAW_INSTANCED,
+			COMMAND_DRAW_INDEXED_INSTANCED,
+			COMMAND_DRAW_INSTANCED_INDIRECT,
+			COMMAND_DRAW_INDEXED_INSTANCED_INDIRECT,
+			COMMAND_DISPATCH,
+			COMMAND_DISPATCH_INDIRECT,
+			COMMAND_GENERATE_MIPS,
+			COMMAND_COPY_TEXTURE,
+			COMMAND_MSAA_RESOLVE,
+			COMMAND_UPDATE_BUFFER,
+			COMMAND_APPEND_RINGBUFFER,
+			COMMAND_DOWNLOAD_BUFFER,
+			COMMAND_SET_SCISSORRECTS,
+			COMMAND_QUERY_BEGIN,
+			COMMAND_QUERY_END,
+			COMMAND_EVENT_BEGIN,
+			COMMAND_EVENT_END,
+			COMMAND_SET_MARKER,
+			COMMAND_TYPE_COUNT
+		};
+		enum SHADERSTAGE
+		{
+			STAGE_VS,
+			STAGE_PS,
+			STAGE_GS,
+			STAGE_HS,
+			STAGE_DS,
+			STAGE_CS,
+			STAGE_COUNT
+		};
+
+		// One recorded command in 16 bytes. Resources are referenced by their ID (0: none), the arguments depend on the type,
+		//	for example the vertex/index and instance counts of draws or the byte count of buffer updates.
+		struct Command
+		{
+			uint8_t type;		// COMMAND_TYPE
+			uint8_t stage;		// SHADERSTAGE of binds
+			uint16_t slot;
+			uint32_t resource;
+			uint32_t arg0;
+			uint32_t arg1;
+		};
+
+		struct Stats
+		{
+			uint64_t commands;
+			uint64_t drawCalls;				// including the indirect ones
+			uint64_t primitives;			// vertices or indices times instances of the direct draws
+			uint64_t dispatches;
+			uint64_t stateChanges;			// pipeline state binds (shaders, layout, topology, blend, depth and rasterizer states)
+			uint64_t redundantStateChanges;	// pipeline state binds of the state that was already bound
+			uint64_t resourceBinds;			// bound resources, samplers, constant buffers and vertex/index buffers
+			uint64_t renderTargetChanges;
+			uint64_t bytesUploaded;
+			uint64_t invalidMappings;		// no overwrite mappings on a deferred thread without a discard in its command list (fail on DX11)
+
+			Stats() { Reset(); }
+			void Reset()
+			{
+				commands = drawCalls = primitives = dispatches = stateChanges = redundantStateChanges = resourceBinds = renderTargetChanges = bytesUploaded = invalidMappings = 0;
+			}
+			void Add(const Stats& other)
+			{
+				commands += other.commands;
+				drawCalls += other.drawCalls;
+				primitives += other.primitives;
+				dispatches += other.dispatches;
+				stateChanges += other.stateChanges;
+				redundantStateChanges += other.redundantStateChanges;
+				resourceBinds += other.resourceBinds;
+				renderTargetChanges += other.renderTargetChanges;
+				bytesUploaded += other.bytesUploaded;
+				invalidMappings += other.invalidMappings;
+			}
+		};
+
+		// Resources created since the device was created. Texture memory is estimated, only buffers are allocated.
+		struct ResourceStats
+		{
+			std::atomic<uint32_t> buffers;
+			std::atomic<uint32_t> textures;
+			std::atomic<uint32_t> shaders;
+			std::atomic<uint32_t> states;
+			std::atomic<uint64_t> bufferBytes;
+			std::atomic<uint64_t> textureBytes;
+
+			ResourceStats() :buffers(0), textures(0), shaders(0), states(0), bufferBytes(0), textureBytes(0) {}
+		};
+
+	private:
+		// Every graphics thread records on its own, like the deferred contexts of other devices:
+		struct ThreadState
+		{
+			std::vector<Command> commands;
+			Stats stats;
+
+			// The bound pipeline state, to tell the redundant binds apart:
+			const void* shaders[STAGE_COUNT];
+			const void* vertexLayout;
+			int primitiveTopology;
+			const void* blendState;
+			const void* depthStencilState;
+			UINT stencilRef;
+			const void* rasterizerState;
+
+			// The ring buffers mapped with discard in the current command list:
+			std::vector<uint32_t> discardedBuffers;
+
+			ThreadState() { ResetState(); }
+			void ResetState();
+		};
+		ThreadState threads[GRAPHICSTHREAD_COUNT];
+		bool recording;
+
+		std::atomic<uint32_t> nextID;
+		Texture2DDesc backBufferDesc;
+		uint32_t backBufferID;
+
+		std::vector<Command> frameCommands;
+		Stats frameStats;
+		ResourceStats resourceStats;
+
+		uint32_t CreateID() { return nextID.fetch_add(1); }
+
+		void Record(GRAPHICSTHREAD threadID, COMMAND_TYPE type, SHADERSTAGE stage, int slot, uint32_t resource, uint32_t arg0 = 0, uint32_t arg1 = 0);
+		void RecordState(GRAPHICSTHREAD threadID, COMMAND_TYPE type, SHADERSTAGE stage, const void*& current, const void* state, uint32_t resource, uint32_t arg0 = 0);
+
+		template<typename T>
+		static uint32_t GetID(const T* resource) { return resource == nullptr ? 0 : resource->resource_Null; }
+		static uint32_t GetUAVID(const GPUUnorderedResource* resource);
+		static uint64_t GetTextureSize(UINT width, UINT height, UINT depth, UINT arraySize, UINT mipLevels);
+
+		HRESULT CreateShader(const void *pShaderBytecode, SIZE_T BytecodeLength, uint32_t& resource);
+		// Maps the ring buffer like the DX11 device would (returns if it was discarded) and checks the deferred mapping rule
+		bool MapRingBuffer(GPURingBuffer* buffer, bool wrap, GRAPHICSTHREAD threadID);
+
+	public:
+		GraphicsDevice_Null(int width = 1920, int height = 1080);
+
+		~GraphicsDevice_Null();
+
+		virtual HRESULT CreateBuffer(const GPUBufferDesc *pDesc, const SubresourceData* pInitialData, GPUBuffer *ppBuffer) override;
+		virtual HRESULT CreateTexture1D(const Texture1DDesc* pDesc, const SubresourceData *pInitialData, Texture1D **ppTexture1D) override;
+		virtual HRESULT CreateTexture2D(const Texture2DDesc* pDesc, const SubresourceData *pInitialData, Texture2D **ppTexture2D) override;
+		virtual HRESULT CreateTexture3D(const Texture3DDesc* pDesc, const SubresourceData *pInitialData, Texture3D **ppTexture3D) override;
+		virtual HRESULT CreateInputLayout(const VertexLayoutDesc *pInputElementDescs, UINT NumElements,
+			const void *pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, VertexLayout *pInputLayout) override;
+		virtual HRESULT CreateVertexShader(const void *pShaderBytecode, SIZE_T BytecodeLength, VertexShader *pVertexShader) override;
+		virtual HRESULT CreatePixelShader(const void *pShaderBytecode, SIZE_T BytecodeLength, PixelShader *pPixelShader) override;
+		virtual HRESULT CreateGeometryShader(const void *pShaderBytecode, SIZE_T BytecodeLength, GeometryShader *pGeometryShader) override;
+		virtual HRESULT CreateHullShader(const void *pShaderBytecode, SIZE_T BytecodeLength, HullShader *pHullShader) override;
+		virtual HRESULT CreateDomainShader(const void *pShaderBytecode, SIZE_T BytecodeLength, DomainShader *pDomainShader) override;
+		virtual HRESULT CreateComputeShader(const void *pShaderBytecode, SIZE_T BytecodeLength, ComputeShader *pComputeShader) override;
+		virtual HRESULT CreateBlendState(const BlendStateDesc *pBlendStateDesc, BlendState *pBlendState) override;
+		virtual HRESULT CreateDepthStencilState(const DepthStencilStateDesc *pDepthStencilStateDesc, DepthStencilState *pDepthStencilState) override;
+		virtual HRESULT CreateRasterizerState(const RasterizerStateDesc *pRasterizerStateDesc, RasterizerState *pRasterizerState) override;
+		virtual HRESULT CreateSamplerState(const SamplerDesc *pSamplerDesc, Sampler *pSamplerState) override;
+		virtual HRESULT CreateQuery(const GPUQueryDesc *pDesc, GPUQuery *pQuery) override;
+
+		virtual void PresentBegin() override;
+		virtual void PresentEnd() override;
+
+		virtual void ExecuteDeferredContexts() override;
+		virtual void FinishCommandList(GRAPHICSTHREAD thread) override;
+		virtual void ExecuteCommandList(GRAPHICSTHREAD thread, GRAPHICSTHREAD destination) override;
+
+		virtual void SetResolution(int width, int height) override;
+
+		virtual Texture2D GetBackBuffer() override;
+
+		///////////////Thread-sensitive////////////////////////
+
+		virtual void BindViewports(UINT NumViewports, const ViewPort *pViewports, GRAPHICSTHREAD threadID) override;
+		virtual void BindRenderTargetsUAVs(UINT NumViews, Texture* const *ppRenderTargets, Texture2D* depthStencilTexture, GPUUnorderedResource* const *ppUAVs, int slotUAV, int countUAV,
+			GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindRenderTargets(UINT NumViews, Texture* const *ppRenderTargets, Texture2D* depthStencilTexture, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void ClearRenderTarget(Texture* pTexture, const FLOAT ColorRGBA[4], GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void ClearDepthStencil(Texture2D* pTexture, UINT ClearFlags, FLOAT Depth, UINT8 Stencil, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourcePS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourceVS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourceGS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourceDS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourceHS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourceCS(const GPUResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindResourcesPS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindResourcesVS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindResourcesGS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindResourcesDS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindResourcesHS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindResourcesCS(const GPUResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void BindUnorderedAccessResourceCS(const GPUUnorderedResource* resource, int slot, GRAPHICSTHREAD threadID, int arrayIndex = -1) override;
+		virtual void BindUnorderedAccessResourcesCS(const GPUUnorderedResource *const* resources, int slot, int count, GRAPHICSTHREAD threadID) override;
+		virtual void UnBindResources(int slot, int num, GRAPHICSTHREAD threadID) override;
+		virtual void UnBindUnorderedAccessResources(int slot, int num, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerPS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerVS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerGS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerHS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerDS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindSamplerCS(const Sampler* sampler, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferPS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferVS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferGS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferDS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferHS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindConstantBufferCS(const GPUBuffer* buffer, int slot, GRAPHICSTHREAD threadID) override;
+		virtual void BindVertexBuffers(const GPUBuffer* const *vertexBuffers, int slot, int count, const UINT* strides, const UINT* offsets, GRAPHICSTHREAD threadID) override;
+		virtual void BindIndexBuffer(const GPUBuffer* indexBuffer, const INDEXBUFFER_FORMAT format, UINT offset, GRAPHICSTHREAD threadID) override;
+		virtual void BindPrimitiveTopology(PRIMITIVETOPOLOGY type, GRAPHICSTHREAD threadID) override;
+		virtual void BindVertexLayout(const VertexLayout* layout, GRAPHICSTHREAD threadID) override;
+		virtual void BindBlendState(const BlendState* state, GRAPHICSTHREAD threadID) override;
+		virtual void BindBlendStateEx(const BlendState* state, const XMFLOAT4& blendFactor, UINT sampleMask, GRAPHICSTHREAD threadID) override;
+		virtual void BindDepthStencilState(const DepthStencilState* state, UINT stencilRef, GRAPHICSTHREAD threadID) override;
+		virtual void BindRasterizerState(const RasterizerState* state, GRAPHICSTHREAD threadID) override;
+		virtual void BindPS(const PixelShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void BindVS(const VertexShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void BindGS(const GeometryShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void BindHS(const HullShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void BindDS(const DomainShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void BindCS(const ComputeShader* shader, GRAPHICSTHREAD threadID) override;
+		virtual void Draw(int vertexCount, UINT startVertexLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexed(int indexCount, UINT startIndexLocation, UINT baseVertexLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawInstanced(int vertexCount, int instanceCount, UINT startVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexedInstanced(int indexCount, int instanceCount, UINT startIndexLocation, UINT baseVertexLocation, UINT startInstanceLocation, GRAPHICSTHREAD threadID) override;
+		virtual void DrawInstancedIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void DrawIndexedInstancedIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ, GRAPHICSTHREAD threadID) override;
+		virtual void DispatchIndirect(const GPUBuffer* args, UINT args_offset, GRAPHICSTHREAD threadID) override;
+		virtual void GenerateMips(Texture* texture, GRAPHICSTHREAD threadID) override;
+		virtual void CopyTexture2D(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID) override;
+		virtual void CopyTexture2D_Region(Texture2D* pDst, UINT dstMip, UINT dstX, UINT dstY, const Texture2D* pSrc, UINT srcMip, GRAPHICSTHREAD threadID) override;
+		virtual void MSAAResolve(Texture2D* pDst, const Texture2D* pSrc, GRAPHICSTHREAD threadID) override;
+		virtual void UpdateBuffer(GPUBuffer* buffer, const void* data, GRAPHICSTHREAD threadID, int dataSize = -1) override;
+		virtual void UpdateBufferRange(GPUBuffer* buffer, const void* data, UINT dataOffset, UINT dataSize, GRAPHICSTHREAD threadID) override;
+		virtual UINT AppendRingBuffer(GPURingBuffer* buffer, const void* data, size_t dataSize, GRAPHICSTHREAD threadID) override;
+		virtual void* AllocateFromRingBuffer(GPURingBuffer* buffer, size_t dataSize, UINT& offsetIntoBuffer, GRAPHICSTHREAD threadID) override;
+		virtual void InvalidateBufferAccess(GPUBuffer* buffer, GRAPHICSTHREAD threadID) override;
+		virtual bool DownloadBuffer(GPUBuffer* bufferToDownload, GPUBuffer* bufferDest, void* dataDest, GRAPHICSTHREAD threadID, bool async = true) override;
+		virtual void SetScissorRects(UINT numRects, const Rect* rects, GRAPHICSTHREAD threadID) override;
+		virtual void QueryBegin(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+		virtual void QueryEnd(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+		virtual bool QueryRead(GPUQuery *query, GRAPHICSTHREAD threadID) override;
+
+		virtual HRESULT CreateTextureFromFile(const std::string& fileName, Texture2D **ppTexture, bool mipMaps, GRAPHICSTHREAD threadID) override;
+		virtual HRESULT SaveTexturePNG(const std::string& fileName, Texture2D *pTexture, GRAPHICSTHREAD threadID) override;
+		virtual HRESULT SaveTextureDDS(const std::string& fileName, Texture *pTexture, GRAPHICSTHREAD threadID) override;
+
+		virtual void EventBegin(const std::string& name, GRAPHICSTHREAD threadID) override;
+		virtual void EventEnd(GRAPHICSTHREAD threadID) override;
+		virtual void SetMarker(const std::string& name, GRAPHICSTHREAD threadID) override;
+
+		// Enable or disable the command log. The counters are always updated.
+		void SetRecordingEnabled(bool value) { recording = value; }
+		bool IsRecordingEnabled() const { return recording; }
+
+		// The commands and counters of the last presented frame, in the order the immediate thread executed them
+		const std::vector<Command>& GetFrameCommands() const { return frameCommands; }
+		const Stats& GetFrameStats() const { return frameStats; }
+		const ResourceStats& GetResourceStats() const { return resourceStats; }
+	};
+
+}
+
+#endif // _GRAPHICSDEVICE_NULL_H_
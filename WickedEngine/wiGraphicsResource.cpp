@@ -6,6 +6,7 @@ namespace wiGraphicsTypes
 	VertexShader::VertexShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	VertexShader::~VertexShader()
 	{
@@ -15,6 +16,7 @@ namespace wiGraphicsTypes
 	PixelShader::PixelShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	PixelShader::~PixelShader()
 	{
@@ -24,6 +26,7 @@ namespace wiGraphicsTypes
 	GeometryShader::GeometryShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	GeometryShader::~GeometryShader()
 	{
@@ -33,6 +36,7 @@ namespace wiGraphicsTypes
 	DomainShader::DomainShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	DomainShader::~DomainShader()
 	{
@@ -42,6 +46,7 @@ namespace wiGraphicsTypes
 	HullShader::HullShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	HullShader::~HullShader()
 	{
@@ -51,6 +56,7 @@ namespace wiGraphicsTypes
 	ComputeShader::ComputeShader()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	ComputeShader::~ComputeShader()
 	{
@@ -60,6 +66,7 @@ namespace wiGraphicsTypes
 	Sampler::Sampler()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	Sampler::~Sampler()
 	{
@@ -69,14 +76,20 @@ namespace wiGraphicsTypes
 	GPUResource::GPUResource()
 	{
 		SAFE_INIT(SRV_DX11);
+		resource_Null = 0;
 	}
 	GPUResource::~GPUResource()
+	{
+		ReleaseSRV();
+	}
+	void GPUResource::ReleaseSRV()
 	{
 		SAFE_RELEASE(SRV_DX11);
 		for (auto& x : additionalSRVs_DX11)
 		{
 			SAFE_RELEASE(x);
 		}
+		additionalSRVs_DX11.clear();
 	}
 
 	GPUUnorderedResource::GPUUnorderedResource()
@@ -84,12 +97,17 @@ namespace wiGraphicsTypes
 		SAFE_INIT(UAV_DX11);
 	}
 	GPUUnorderedResource::~GPUUnorderedResource()
+	{
+		ReleaseUAV();
+	}
+	void GPUUnorderedResource::ReleaseUAV()
 	{
 		SAFE_RELEASE(UAV_DX11);
 		for (auto& x : additionalUAVs_DX11)
 		{
 			SAFE_RELEASE(x);
 		}
+		additionalUAVs_DX11.clear();
 	}
 
 	GPUBuffer::GPUBuffer() : GPUResource(), GPUUnorderedResource()
@@ -100,10 +118,20 @@ namespace wiGraphicsTypes
 	{
 		SAFE_RELEASE(resource_DX11);
 	}
+	void GPUBuffer::Release()
+	{
+		ReleaseSRV();
+		ReleaseUAV();
+		SAFE_RELEASE(resource_DX11);
+		shadow_Null.clear();
+		shadow_Null.shrink_to_fit();
+		resource_Null = 0;
+	}
 
 	VertexLayout::VertexLayout()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	VertexLayout::~VertexLayout()
 	{
@@ -113,6 +141,7 @@ namespace wiGraphicsTypes
 	BlendState::BlendState()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	BlendState::~BlendState()
 	{
@@ -122,6 +151,7 @@ namespace wiGraphicsTypes
 	DepthStencilState::DepthStencilState()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	DepthStencilState::~DepthStencilState()
 	{
@@ -131,6 +161,7 @@ namespace wiGraphicsTypes
 	RasterizerState::RasterizerState()
 	{
 		SAFE_INIT(resource_DX11);
+		resource_Null = 0;
 	}
 	RasterizerState::~RasterizerState()
 	{
@@ -214,6 +245,7 @@ namespace wiGraphicsTypes
 
 	GPUQuery::GPUQuery()
 	{
+		resource_Null = 0;
 		async_frameshift = 0;
 	}
 	GPUQuery::~GPUQuery()
@@ -3,6 +3,7 @@
 
 #include "CommonInclude.h"
 #include "wiGraphicsDescriptors.h"
+#include "wiSpinLock.h"
 
 #include <vector>
 
@@ -32,108 +33,129 @@ struct ID3D11Predicate;
 namespace wiGraphicsTypes
 {
 	class GraphicsDevice_DX11;
+	class GraphicsDevice_Null;
 
 	class VertexShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11VertexShader*		resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		VertexShader();
 		~VertexShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class PixelShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11PixelShader*		resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		PixelShader();
 		~PixelShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class GeometryShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11GeometryShader*	resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		GeometryShader();
 		~GeometryShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class HullShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11HullShader*		resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		HullShader();
 		~HullShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class DomainShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DomainShader*		resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		DomainShader();
 		~DomainShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class ComputeShader
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11ComputeShader*	resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		ComputeShader();
 		~ComputeShader();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class Sampler
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11SamplerState*	resource_DX11;
+		uint32_t				resource_Null;
 		SamplerDesc desc;
 	public:
 		Sampler();
 		~Sampler();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 		SamplerDesc GetDesc() { return desc; }
 	};
 
 	class GPUResource
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11ShaderResourceView*			SRV_DX11;					// main resource SRV
 		std::vector<ID3D11ShaderResourceView*>	additionalSRVs_DX11;		// can be used for sub-resources if requested
 
 	protected:
+		uint32_t							resource_Null;				// resource ID of the null device
+
 		GPUResource();
 		virtual ~GPUResource();
+
+		void ReleaseSRV();
 	};
 
 	class GPUUnorderedResource
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11UnorderedAccessView*			UAV_DX11;					// main resource UAV
 		std::vector<ID3D11UnorderedAccessView*>	additionalUAVs_DX11;		// can be used for sub-resources if requested
@@ -141,87 +163,125 @@ namespace wiGraphicsTypes
 	protected:
 		GPUUnorderedResource();
 		virtual ~GPUUnorderedResource();
+
+		void ReleaseUAV();
 	};
 
 	class GPUBuffer : public GPUResource, public GPUUnorderedResource
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Buffer*		resource_DX11;
+		std::vector<uint8_t> shadow_Null;	// CPU copy of the contents for the null device
 		GPUBufferDesc desc;
 	public:
 		GPUBuffer();
 		virtual ~GPUBuffer();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		// Frees the GPU memory, after this the buffer can be created again
+		void Release();
+
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 		GPUBufferDesc GetDesc() { return desc; }
 	};
 
 	class GPURingBuffer : public GPUBuffer
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		size_t byteOffset;
 		uint64_t residentFrame;
+		uint64_t generation;
+		wiSpinLock lock; // threads recording in parallel append to the same buffer
+
+		// Reserves dataSize bytes and returns their position, wrap is set if the buffer starts over
+		size_t Reserve(size_t dataSize, uint64_t frame, bool& wrap)
+		{
+			const size_t byteWidth = GetDesc().ByteWidth;
+			lock.lock();
+			size_t position = byteOffset;
+			wrap = position + dataSize > byteWidth || residentFrame != frame;
+			position = wrap ? 0 : position;
+			byteOffset = position + dataSize;
+			residentFrame = frame;
+			if (wrap)
+			{
+				generation++;
+			}
+			lock.unlock();
+			return position;
+		}
 	public:
-		GPURingBuffer() : byteOffset(0), residentFrame(0) {}
+		GPURingBuffer() : byteOffset(0), residentFrame(0), generation(0) {}
 		virtual ~GPURingBuffer() {}
 
 		// The next appending to buffer will start at this offset
 		size_t GetByteOffset() { return byteOffset; }
+		// Incremented when the buffer wraps around (at least once every frame), data from older generations is overwritten
+		uint64_t GetGeneration() { return generation; }
 	};
 
 	class VertexLayout
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11InputLayout*	resource_DX11;
+		uint32_t				resource_Null;
 	public:
 		VertexLayout();
 		~VertexLayout();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 	};
 
 	class BlendState
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11BlendState*	resource_DX11;
+		uint32_t				resource_Null;
 		BlendStateDesc desc;
 	public:
 		BlendState();
 		~BlendState();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 		BlendStateDesc GetDesc() { return desc; }
 	};
 
 	class DepthStencilState
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DepthStencilState*	resource_DX11;
+		uint32_t				resource_Null;
 		DepthStencilStateDesc desc;
 	public:
 		DepthStencilState();
 		~DepthStencilState();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 		DepthStencilStateDesc GetDesc() { return desc; }
 	};
 
 	class RasterizerState
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11RasterizerState*	resource_DX11;
+		uint32_t				resource_Null;
 		RasterizerStateDesc desc;
 	public:
 		RasterizerState();
 		~RasterizerState();
 
-		bool IsValid() { return resource_DX11 != nullptr; }
+		bool IsValid() { return resource_DX11 != nullptr || resource_Null != 0; }
 		RasterizerStateDesc GetDesc() { return desc; }
 	};
 
@@ -236,6 +296,7 @@ namespace wiGraphicsTypes
 	class Texture : public GPUResource, public GPUUnorderedResource
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11RenderTargetView*				RTV_DX11;
 		std::vector<ID3D11RenderTargetView*>		additionalRTVs_DX11;
@@ -261,6 +322,7 @@ namespace wiGraphicsTypes
 	class Texture1D : public Texture
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Texture1D*			texture1D_DX11;
 		Texture1DDesc				desc;
@@ -274,6 +336,7 @@ namespace wiGraphicsTypes
 	class Texture2D : public Texture
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11DepthStencilView*				DSV_DX11;
 		std::vector<ID3D11DepthStencilView*>		additionalDSVs_DX11;
@@ -289,6 +352,7 @@ namespace wiGraphicsTypes
 	class Texture3D : public Texture
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		ID3D11Texture3D*			texture3D_DX11;
 		Texture3DDesc				desc;
@@ -305,8 +369,10 @@ namespace wiGraphicsTypes
 	class GPUQuery
 	{
 		friend class GraphicsDevice_DX11;
+		friend class GraphicsDevice_Null;
 	private:
 		std::vector<ID3D11Query*>		resource_DX11;
+		uint32_t					resource_Null;
 		std::vector<int>					active;
 		GPUQueryDesc				desc;
 		int							async_frameshift;
@@ -314,7 +380,7 @@ namespace wiGraphicsTypes
 		GPUQuery();
 		virtual ~GPUQuery();
 
-		bool IsValid() { return resource_DX11[0] != nullptr; }
+		bool IsValid() { return (!resource_DX11.empty() && resource_DX11[0] != nullptr) || resource_Null != 0; }
 		GPUQueryDesc GetDesc() { return desc; }
 
 		BOOL	result_passed;
@@ -1,23 +1,130 @@
 #include "wiHashString.h"
+#include "wiHelper.h"
+
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
 
 using namespace std;
 
-hash<std::string> hasher;
+// The interning table, strings are never removed from it. It is split into shards by the hash, and the lookups only take
+//	a shared lock, so that threads constructing strings at the same time don't serialize on one lock:
+struct InternTable
+{
+	static const size_t SHARD_COUNT = 16;
+	struct Shard
+	{
+		shared_timed_mutex locker;
+		unordered_multimap<uint64_t, const string*> strings;
+		wiHashString::Stats stats;
+
+		Shard()
+		{
+			stats.strings = 0;
+			stats.bytes = 0;
+			stats.collisions = 0;
+		}
+	};
+	Shard shards[SHARD_COUNT];
 
-wiHashString::wiHashString(const char* value):wiHashString(string(value))
+	Shard& GetShard(uint64_t hash) { return shards[hash % SHARD_COUNT]; }
+};
+static InternTable& GetInternTable()
 {
+	// Constructed on first use, so that static wiHashStrings work in any initialization order
+	static InternTable* table = new InternTable;
+	return *table;
 }
-wiHashString::wiHashString(const std::string& value)
+
+// Returns the interned string that equals the value, or nullptr. The shard must be locked:
+static const string* FindInterned(InternTable::Shard& shard, uint64_t hash, const char* value, size_t length)
 {
-	str = value;
-	hash = hasher(str);
+	auto range = shard.strings.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const string& x = *it->second;
+		if (x.length() == length && !x.compare(0, length, value, length))
+		{
+			return it->second;
+		}
+	}
+	return nullptr;
 }
 
-bool operator==(const wiHashString& a, const wiHashString& b)
+wiHashString::wiHashString(const char* value)
+{
+	size_t length = strlen(value);
+	hash = Hash(value, length);
+	Intern(value, length);
+}
+wiHashString::wiHashString(const std::string& value)
+{
+	hash = Hash(value.c_str(), value.length());
+	Intern(value.c_str(), value.length());
+}
+wiHashString::wiHashString(const char* value, uint64_t precomputedHash)
 {
-	return a.GetHash() == b.GetHash();
+	hash = precomputedHash;
+	Intern(value, strlen(value));
 }
 
 wiHashString::~wiHashString()
 {
 }
+
+void wiHashString::Intern(const char* value, size_t length)
+{
+	InternTable::Shard& shard = GetInternTable().GetShard(hash);
+
+	// Most strings are interned already:
+	{
+		shared_lock<shared_timed_mutex> lock(shard.locker);
+		str = FindInterned(shard, hash, value, length);
+		if (str != nullptr)
+		{
+			return;
+		}
+	}
+
+	// An other thread could insert it between the two locks, so it is looked up again:
+	lock_guard<shared_timed_mutex> lock(shard.locker);
+	str = FindInterned(shard, hash, value, length);
+	if (str != nullptr)
+	{
+		return;
+	}
+
+	auto existing = shard.strings.find(hash);
+	if (existing != shard.strings.end())
+	{
+		shard.stats.collisions++;
+#ifdef _DEBUG
+		stringstream ss("");
+		ss << "wiHashString collision: \"" << string(value, length) << "\" and \"" << *existing->second << "\" have the same hash!";
+		wiHelper::messageBox(ss.str(), "Warning!");
+#endif
+	}
+
+	str = new string(value, length);
+	shard.strings.insert(make_pair(hash, str));
+	shard.stats.strings++;
+	shard.stats.bytes += length;
+}
+
+wiHashString::Stats wiHashString::GetStats()
+{
+	InternTable& table = GetInternTable();
+	Stats stats;
+	stats.strings = 0;
+	stats.bytes = 0;
+	stats.collisions = 0;
+	for (auto& shard : table.shards)
+	{
+		shared_lock<shared_timed_mutex> lock(shard.locker);
+		stats.strings += shard.stats.strings;
+		stats.bytes += shard.stats.bytes;
+		stats.collisions += shard.stats.collisions;
+	}
+	return stats;
+}
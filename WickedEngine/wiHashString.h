@@ -2,22 +2,74 @@
 #include "CommonInclude.h"
 
 #include <string>
+#include <functional>
+#include <type_traits>
 
+// Interned string with a 64-bit FNV-1a hash as its ID.
+//	Every distinct string is stored once in a global table, so copies are cheap and equality compares the ID first,
+//	then the interned pointer, which tells apart different strings with the same hash. Debug builds report hash collisions.
 class wiHashString
 {
 private:
-	std::string str;
-	size_t hash;
+	const std::string* str;	// interned, valid for the lifetime of the program
+	uint64_t hash;
+
+	void Intern(const char* value, size_t length);
 public:
+	// FNV-1a, evaluated at compile time for constant arguments
+	static constexpr uint64_t Hash(const char* value, size_t length)
+	{
+		uint64_t result = 14695981039346656037ull;
+		for (size_t i = 0; i < length; ++i)
+		{
+			result ^= (uint64_t)(uint8_t)value[i];
+			result *= 1099511628211ull;
+		}
+		return result;
+	}
+	static constexpr uint64_t Hash(const char* value)
+	{
+		uint64_t result = 14695981039346656037ull;
+		for (; *value != 0; ++value)
+		{
+			result ^= (uint64_t)(uint8_t)*value;
+			result *= 1099511628211ull;
+		}
+		return result;
+	}
+
 	wiHashString(const char* value = "");
 	wiHashString(const std::string& value);
+	// The hash must be Hash(value), this skips computing it (see wiHashLiteral)
+	wiHashString(const char* value, uint64_t precomputedHash);
 	~wiHashString();
 
-	const std::string& GetString() const { return str; }
-	size_t GetHash() const { return hash; }
+	const std::string& GetString() const { return *str; }
+	size_t GetHash() const { return (size_t)hash; }
+	uint64_t GetID() const { return hash; }
+	// The interned string, equal strings have the same pointer
+	const std::string* GetInterned() const { return str; }
+
+	struct Stats
+	{
+		size_t strings;		// distinct strings in the interning table
+		size_t bytes;		// character data of them
+		size_t collisions;	// different strings that have the same hash
+	};
+	static Stats GetStats();
 };
 
-bool operator==(const wiHashString& a, const wiHashString& b);
+inline bool operator==(const wiHashString& a, const wiHashString& b)
+{
+	return a.GetID() == b.GetID() && a.GetInterned() == b.GetInterned();
+}
+inline bool operator!=(const wiHashString& a, const wiHashString& b)
+{
+	return !(a == b);
+}
+
+// The string literal is hashed at compile time and interned once when this is first evaluated, the next evaluations cost nothing
+#define wiHashLiteral(literal) ([]() -> const wiHashString& { static const wiHashString id(literal, std::integral_constant<uint64_t, wiHashString::Hash(literal)>::value); return id; }())
 
 namespace std
 {
@@ -30,4 +82,3 @@ namespace std
 		}
 	};
 }
-
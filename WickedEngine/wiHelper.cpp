@@ -43,6 +43,19 @@ namespace wiHelper
 		return false;
 	}
 
+	bool GetFileStamp(const std::string& fileName, uint64_t& size, uint64_t& lastWriteTime)
+	{
+		wstring wfileName = wstring(fileName.begin(), fileName.end());
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExW(wfileName.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			return false;
+		}
+		size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+		lastWriteTime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+
 	void messageBox(const std::string& msg, const std::string& caption){
 #ifndef WINSTORE_SUPPORT
 		MessageBoxA(wiWindowRegistration::GetInstance()->GetRegisteredWindow(), msg.c_str(), caption.c_str(), 0);
@@ -12,6 +12,9 @@ namespace wiHelper
 
 	bool readByteData(const std::string& fileName, BYTE** data, size_t& dataSize);
 
+	// Gets the size and the last modification time of a file without opening it, returns false if it doesn't exist
+	bool GetFileStamp(const std::string& fileName, uint64_t& size, uint64_t& lastWriteTime);
+
 	void messageBox(const std::string& msg, const std::string& caption = "Warning!");
 
 	void screenshot(const std::string& name = "");
@@ -0,0 +1,87 @@
+#include "wiIndexCodec.h"
+#include "wiTimer.h"
+#include "wiSpinLock.h"
+
+using namespace std;
+
+namespace wiIndexCodec
+{
+	Stats stats;
+	wiSpinLock statsLock;
+
+	void Encode(const uint32_t* indices, size_t count, std::vector<uint8_t>& output)
+	{
+		const size_t start = output.size();
+		output.reserve(start + count * 2);
+
+		uint32_t prev = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			int32_t delta = (int32_t)(indices[i] - prev);
+			uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31); // zigzag
+			prev = indices[i];
+
+			while (value >= 0x80)
+			{
+				output.push_back((uint8_t)(value | 0x80));
+				value >>= 7;
+			}
+			output.push_back((uint8_t)value);
+		}
+
+		statsLock.lock();
+		stats.encodedIndices += count;
+		stats.encodedBytes += output.size() - start;
+		statsLock.unlock();
+	}
+
+	bool Decode(const uint8_t* data, size_t size, uint32_t* indices, size_t count, size_t vertexCount)
+	{
+		wiTimer timer;
+		timer.record();
+
+		const uint8_t* end = data + size;
+		uint32_t prev = 0;
+		size_t i = 0;
+		for (; i < count && data < end; ++i)
+		{
+			uint32_t value = *data++;
+			if (value >= 0x80)
+			{
+				// Multi-byte values are rare after vertex cache optimization, so they are kept out of the fast path:
+				value &= 0x7F;
+				uint32_t shift = 7;
+				uint8_t byte;
+				do
+				{
+					if (data >= end || shift > 28)
+					{
+						return false;
+					}
+					byte = *data++;
+					value |= (uint32_t)(byte & 0x7F) << shift;
+					shift += 7;
+				} while (byte >= 0x80);
+			}
+			prev += (uint32_t)((value >> 1) ^ (0u - (value & 1))); // zigzag
+			if (prev >= vertexCount)
+			{
+				break;
+			}
+			indices[i] = prev;
+		}
+
+		double elapsed = timer.elapsed();
+		statsLock.lock();
+		stats.decodedIndices += i;
+		stats.decodeTime += elapsed;
+		statsLock.unlock();
+
+		return i == count;
+	}
+
+	const Stats& GetStats()
+	{
+		return stats;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <vector>
+
+// Compact encoding for triangle index lists.
+//	Every index is stored as the zigzag encoded difference from the previous index in a variable length integer,
+//	so the indices of vertex cache optimized meshes mostly take one byte instead of four.
+namespace wiIndexCodec
+{
+	struct Stats
+	{
+		uint64_t encodedIndices;
+		uint64_t encodedBytes;
+		uint64_t decodedIndices;
+		double decodeTime;	// milliseconds
+
+		Stats() :encodedIndices(0), encodedBytes(0), decodedIndices(0), decodeTime(0) {}
+		// Decode throughput of the uncompressed index data in MB/s
+		double GetDecodeThroughput() const { return decodeTime > 0 ? (double)(decodedIndices * sizeof(uint32_t)) / (1024.0 * 1024.0) / (decodeTime / 1000.0) : 0; }
+	};
+
+	// Appends the encoded indices to the output
+	void Encode(const uint32_t* indices, size_t count, std::vector<uint8_t>& output);
+	// Decodes count indices into the output array, returns false if the data is corrupted
+	//	or an index doesn't refer to one of the vertexCount vertices
+	bool Decode(const uint8_t* data, size_t size, uint32_t* indices, size_t count, size_t vertexCount);
+
+	const Stats& GetStats();
+};
+
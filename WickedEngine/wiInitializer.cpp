@@ -8,6 +8,7 @@
 #include "wiCpuInfo.h"
 #include "wiSound.h"
 #include "wiHelper.h"
+#include "wiJobSystem.h"
 
 using namespace std;
 
@@ -19,6 +20,7 @@ namespace wiInitializer
 		wiBackLog::Initialize();
 		wiFrameRate::Initialize();
 		wiCpuInfo::Initialize();
+		wiJobSystem::Initialize();
 
 		wiRenderer::SetUpStaticComponents();
 		wiLensFlare::Initialize();
@@ -0,0 +1,397 @@
+#include "wiJobSystem.h"
+
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+
+using namespace std;
+
+namespace wiJobSystem
+{
+	struct WorkQueue
+	{
+		mutex locker;
+		deque<Job> jobs;
+	};
+
+	// Worker i owns queue i, queue 0 is shared by the threads outside of the pool (the thread calling Wait() is the first worker).
+	vector<unique_ptr<WorkQueue> > queues;
+	vector<thread> workers;
+	uint32_t workerCount = 0;
+	atomic<bool> running(false);
+	// Guards the creation and the destruction of the workers, the jobs can be added from any thread before the first Initialize():
+	mutex initLocker;
+
+	thread_local uint32_t ownQueue = 0;
+
+	atomic<uint32_t> pendingJobs(0);	// every unfinished job, including the continuations that didn't start yet
+	atomic<uint32_t> queuedJobs(0);		// jobs in the queues
+
+	mutex sleepLocker;
+	condition_variable wakeup;
+	atomic<uint32_t> sleepingWorkers(0);
+
+	// The threads in Wait() sleep while the workers execute the last jobs, they are woken up when a job finishes or is added:
+	mutex waitLocker;
+	condition_variable jobsChanged;
+	atomic<uint32_t> waitingThreads(0);
+
+	void NotifyWaiting()
+	{
+		if (waitingThreads.load() > 0)
+		{
+			lock_guard<mutex> lock(waitLocker);
+			jobsChanged.notify_all();
+		}
+	}
+
+	void Push(Job&& job)
+	{
+		{
+			WorkQueue& queue = *queues[ownQueue];
+			lock_guard<mutex> lock(queue.locker);
+			queue.jobs.push_back(move(job));
+		}
+		queuedJobs++;
+
+		// A worker that is going to sleep either sees the new job or is woken up here:
+		if (sleepingWorkers.load() > 0)
+		{
+			lock_guard<mutex> lock(sleepLocker);
+			wakeup.notify_one();
+		}
+		NotifyWaiting();
+	}
+
+	bool Pop(Job& job)
+	{
+		if (queuedJobs.load() == 0)
+		{
+			return false;
+		}
+
+		// The newest job of the own queue is the most likely to have its data in the cache, and to be the one that is waited for:
+		{
+			WorkQueue& queue = *queues[ownQueue];
+			lock_guard<mutex> lock(queue.locker);
+			if (!queue.jobs.empty())
+			{
+				job = move(queue.jobs.back());
+				queue.jobs.pop_back();
+				queuedJobs--;
+				return true;
+			}
+		}
+
+		// Steal the oldest job of an other queue. The search starts at a different queue for every worker to spread the contention:
+		for (uint32_t i = 1; i < workerCount; ++i)
+		{
+			uint32_t index = (ownQueue + i) % workerCount;
+			WorkQueue& queue = *queues[index];
+			lock_guard<mutex> lock(queue.locker);
+			if (!queue.jobs.empty())
+			{
+				job = move(queue.jobs.front());
+				queue.jobs.pop_front();
+				queuedJobs--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Finish(Job& job)
+	{
+		Counter* counter = job.counter;
+		if (counter != nullptr)
+		{
+			// The lock is also taken by Wait(counter) before it returns, so the counter outlives this:
+			vector<Job> continuations;
+			{
+				lock_guard<mutex> lock(counter->locker);
+				if (--counter->pending == 0)
+				{
+					continuations.swap(counter->continuations);
+				}
+			}
+			for (auto& x : continuations)
+			{
+				Push(move(x));
+			}
+		}
+		pendingJobs--;
+		NotifyWaiting();
+	}
+
+	bool RunOne()
+	{
+		Job job;
+		if (!Pop(job))
+		{
+			return false;
+		}
+		job.task();
+		Finish(job);
+		return true;
+	}
+
+	void WorkerFunc(uint32_t index)
+	{
+		ownQueue = index;
+		while (true)
+		{
+			if (RunOne())
+			{
+				continue;
+			}
+
+			unique_lock<mutex> lock(sleepLocker);
+			sleepingWorkers++;
+			while (running && queuedJobs.load() == 0)
+			{
+				wakeup.wait(lock);
+			}
+			sleepingWorkers--;
+			if (!running)
+			{
+				return;
+			}
+		}
+	}
+
+	// Stops the workers, initLocker must be held:
+	void ShutDown()
+	{
+		if (!running.load())
+		{
+			return;
+		}
+
+		Wait();
+		{
+			lock_guard<mutex> lock(sleepLocker);
+			running.store(false);
+		}
+		wakeup.notify_all();
+		for (auto& x : workers)
+		{
+			x.join();
+		}
+		workers.clear();
+		queues.clear();
+	}
+	// Creates the workers, initLocker must be held:
+	void CreateWorkers(uint32_t count)
+	{
+		if (count == 0)
+		{
+			count = thread::hardware_concurrency();
+		}
+		workerCount = count < 1 ? 1 : count;
+
+		for (uint32_t i = 0; i < workerCount; ++i)
+		{
+			queues.push_back(unique_ptr<WorkQueue>(new WorkQueue));
+		}
+
+		// The queues are ready before the other threads can see that the system is running:
+		running.store(true);
+		for (uint32_t i = 1; i < workerCount; ++i) // the thread calling Wait() is the first worker
+		{
+			workers.push_back(thread(WorkerFunc, i));
+		}
+	}
+	// Creates the workers with the default count on the first use, if Initialize() wasn't called:
+	void EnsureInitialized()
+	{
+		if (!running.load())
+		{
+			lock_guard<mutex> lock(initLocker);
+			if (!running.load())
+			{
+				CreateWorkers(0);
+			}
+		}
+	}
+
+	void Initialize(uint32_t count)
+	{
+		lock_guard<mutex> lock(initLocker);
+		ShutDown();
+		CreateWorkers(count);
+	}
+	void CleanUp()
+	{
+		lock_guard<mutex> lock(initLocker);
+		ShutDown();
+	}
+
+	uint32_t GetWorkerCount()
+	{
+		EnsureInitialized();
+		return workerCount;
+	}
+
+	void Execute(const std::function<void()>& job)
+	{
+		EnsureInitialized();
+
+		pendingJobs++;
+		Job newJob;
+		newJob.task = job;
+		newJob.counter = nullptr;
+		Push(move(newJob));
+	}
+
+	void Execute(Counter& counter, const std::function<void()>& job)
+	{
+		EnsureInitialized();
+
+		counter.pending++;
+		pendingJobs++;
+		Job newJob;
+		newJob.task = job;
+		newJob.counter = &counter;
+		Push(move(newJob));
+	}
+
+	void ExecuteAfter(Counter& dependency, Counter& counter, const std::function<void()>& job)
+	{
+		EnsureInitialized();
+
+		counter.pending++;
+		pendingJobs++;
+		Job newJob;
+		newJob.task = job;
+		newJob.counter = &counter;
+		{
+			lock_guard<mutex> lock(dependency.locker);
+			if (dependency.pending.load() > 0)
+			{
+				dependency.continuations.push_back(move(newJob));
+				return;
+			}
+		}
+		Push(move(newJob));
+	}
+
+	void Dispatch(uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t)>& job)
+	{
+		if (jobCount == 0)
+		{
+			return;
+		}
+		if (groupSize == 0)
+		{
+			groupSize = 1;
+		}
+
+		for (uint32_t groupStart = 0; groupStart < jobCount; groupStart += groupSize)
+		{
+			uint32_t groupEnd = groupStart + groupSize < jobCount ? groupStart + groupSize : jobCount;
+			Execute([=] {
+				for (uint32_t i = groupStart; i < groupEnd; ++i)
+				{
+					job(i);
+				}
+			});
+		}
+	}
+
+	void Dispatch(Counter& counter, uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t)>& job)
+	{
+		if (jobCount == 0)
+		{
+			return;
+		}
+		if (groupSize == 0)
+		{
+			groupSize = 1;
+		}
+
+		for (uint32_t groupStart = 0; groupStart < jobCount; groupStart += groupSize)
+		{
+			uint32_t groupEnd = groupStart + groupSize < jobCount ? groupStart + groupSize : jobCount;
+			Execute(counter, [=] {
+				for (uint32_t i = groupStart; i < groupEnd; ++i)
+				{
+					job(i);
+				}
+			});
+		}
+	}
+
+	void Split(Counter& counter, uint32_t begin, uint32_t end, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& body)
+	{
+		// The upper halves are left for the thieves, the lower half is executed right away:
+		while (end - begin > grainSize)
+		{
+			uint32_t middle = begin + (end - begin) / 2;
+			uint32_t upperEnd = end;
+			Execute(counter, [&counter, &body, middle, upperEnd, grainSize] {
+				Split(counter, middle, upperEnd, grainSize, body);
+			});
+			end = middle;
+		}
+		body(begin, end);
+	}
+
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& body)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		if (grainSize == 0)
+		{
+			// A few chunks per worker, so that the uneven ones can be balanced:
+			grainSize = count / (GetWorkerCount() * 4);
+			grainSize = grainSize < 1 ? 1 : grainSize;
+		}
+
+		Counter counter;
+		Split(counter, 0, count, grainSize, body);
+		Wait(counter);
+	}
+
+	bool IsBusy()
+	{
+		return pendingJobs.load() > 0;
+	}
+
+	// Executes jobs until done() returns true. When there is no job to execute, the rest are being executed by the workers,
+	//	then the thread sleeps until a job finishes or a new one is added:
+	template<typename Done>
+	void HelpUntil(Done done)
+	{
+		while (!done())
+		{
+			if (RunOne())
+			{
+				continue;
+			}
+
+			unique_lock<mutex> lock(waitLocker);
+			waitingThreads++;
+			while (!done() && queuedJobs.load() == 0)
+			{
+				jobsChanged.wait(lock);
+			}
+			waitingThreads--;
+		}
+	}
+
+	void Wait()
+	{
+		HelpUntil([] { return pendingJobs.load() == 0; });
+	}
+
+	void Wait(Counter& counter)
+	{
+		HelpUntil([&counter] { return counter.pending.load() == 0; });
+
+		// The last job could still be releasing the continuations:
+		lock_guard<mutex> lock(counter.locker);
+	}
+}
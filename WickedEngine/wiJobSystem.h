@@ -0,0 +1,67 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Runs jobs on a pool of worker threads, one per hardware thread.
+//	Every worker has its own job queue: jobs added by a worker go to its own queue and it executes them in LIFO order,
+//	idle workers steal the oldest jobs from the other queues. Threads that wait for jobs also execute them.
+namespace wiJobSystem
+{
+	struct Counter;
+	struct Job
+	{
+		std::function<void()> task;
+		Counter* counter;
+	};
+
+	// Tracks the completion of a group of jobs. Pass it when adding the jobs and wait for them with Wait(counter).
+	//	A counter must not be destroyed while it has unfinished jobs.
+	struct Counter
+	{
+		std::atomic<uint32_t> pending;
+		std::mutex locker;
+		std::vector<Job> continuations;	// jobs that start when pending reaches zero
+
+		Counter() :pending(0) {}
+		bool IsBusy() const { return pending.load() > 0; }
+	};
+
+	// Creates the worker threads. workerCount includes the thread calling Wait(), so 1 means that jobs run serially
+	//	inside Wait(). 0 means one worker per hardware thread. Calling it again recreates the workers with the new count.
+	//	It is called with the default parameter on the first use if it wasn't called before.
+	void Initialize(uint32_t workerCount = 0);
+	// Waits for the jobs and stops the worker threads
+	void CleanUp();
+
+	uint32_t GetWorkerCount();
+
+	// Adds a job to the queue
+	void Execute(const std::function<void()>& job);
+	// Adds a job that is tracked by the counter
+	void Execute(Counter& counter, const std::function<void()>& job);
+	// Adds a job that starts when every job of the dependency is finished. The job is tracked by the counter,
+	//	so jobs can be chained. No jobs should be added to the dependency after it finished if it has continuations.
+	void ExecuteAfter(Counter& dependency, Counter& counter, const std::function<void()>& job);
+	// Runs job(index) for every index in [0, jobCount). Every groupSize consecutive indices are executed by one job.
+	void Dispatch(uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t)>& job);
+	void Dispatch(Counter& counter, uint32_t jobCount, uint32_t groupSize, const std::function<void(uint32_t)>& job);
+	// Runs body(begin, end) for subranges of [0, count) and waits for them. The range is split in halves until the
+	//	subranges are not larger than grainSize, so idle workers can steal large chunks. 0 chooses the grain size from the worker count.
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& body);
+
+	// Are there unfinished jobs?
+	bool IsBusy();
+	// Executes jobs on the calling thread until all of them are finished. Must not be called from a job.
+	//	The waits sleep instead of spinning when the remaining jobs are all being executed by other threads.
+	void Wait();
+	// Executes jobs on the calling thread until the jobs of the counter are finished. Can be called from jobs.
+	void Wait(Counter& counter);
+	// Executes one queued job on the calling thread, returns false if there was none. Threads that wait for something
+	//	that a job finishes (a future for example) should call this in their wait loop, so they don't block the workers.
+	bool RunOne();
+};
+
@@ -0,0 +1,215 @@
+#include "wiLZ4.h"
+
+#include <vector>
+
+using namespace std;
+
+namespace wiLZ4
+{
+	static const size_t MINMATCH = 4;
+	static const size_t LASTLITERALS = 5;	// the last bytes of a block are always literals
+	static const size_t MFLIMIT = 12;		// the last match must start at least this far from the end
+	static const size_t MAXOFFSET = 65535;
+	static const int HASH_LOG = 14;
+
+	inline uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+	inline uint32_t Hash(uint32_t value)
+	{
+		return (value * 2654435761u) >> (32 - HASH_LOG);
+	}
+	inline uint8_t* WriteLength(uint8_t* op, size_t length)
+	{
+		while (length >= 255)
+		{
+			*op++ = 255;
+			length -= 255;
+		}
+		*op++ = (uint8_t)length;
+		return op;
+	}
+	inline uint8_t* WriteSequence(uint8_t* op, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		uint8_t* token = op++;
+		*token = (uint8_t)((literalCount < 15 ? literalCount : 15) << 4);
+		if (literalCount >= 15)
+		{
+			op = WriteLength(op, literalCount - 15);
+		}
+		memcpy(op, literals, literalCount);
+		op += literalCount;
+
+		if (offset > 0)
+		{
+			*op++ = (uint8_t)(offset & 0xFF);
+			*op++ = (uint8_t)(offset >> 8);
+			matchLength -= MINMATCH;
+			*token |= (uint8_t)(matchLength < 15 ? matchLength : 15);
+			if (matchLength >= 15)
+			{
+				op = WriteLength(op, matchLength - 15);
+			}
+		}
+		return op;
+	}
+
+	size_t GetMaxCompressedSize(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	size_t Compress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+	{
+		if (outputSize < GetMaxCompressedSize(size))
+		{
+			return 0;
+		}
+
+		const uint8_t* ip = data;
+		const uint8_t* anchor = data;
+		const uint8_t* const iend = data + size;
+		uint8_t* op = output;
+
+		if (size > MFLIMIT)
+		{
+			const uint8_t* const mflimit = iend - MFLIMIT;
+			const uint8_t* const matchlimit = iend - LASTLITERALS;
+
+			// Positions of the last occurrences of 4 byte sequences:
+			vector<uint32_t> table(1 << HASH_LOG, 0);
+
+			while (ip < mflimit)
+			{
+				uint32_t sequence = Read32(ip);
+				uint32_t& entry = table[Hash(sequence)];
+				const uint8_t* ref = data + entry;
+				entry = (uint32_t)(ip - data);
+
+				if (ref >= ip || (size_t)(ip - ref) > MAXOFFSET || Read32(ref) != sequence)
+				{
+					// Incompressible data is stepped over faster the longer it lasts:
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				while (ip > anchor && ref > data && ip[-1] == ref[-1])
+				{
+					ip--;
+					ref--;
+				}
+				const uint8_t* p = ip + MINMATCH;
+				const uint8_t* r = ref + MINMATCH;
+				while (p < matchlimit && *p == *r)
+				{
+					p++;
+					r++;
+				}
+
+				op = WriteSequence(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(p - ip));
+				ip = p;
+				anchor = ip;
+
+				if (ip < mflimit)
+				{
+					table[Hash(Read32(ip - 2))] = (uint32_t)(ip - 2 - data);
+				}
+			}
+		}
+
+		op = WriteSequence(op, anchor, (size_t)(iend - anchor), 0, 0);
+		return (size_t)(op - output);
+	}
+
+	bool Decompress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+	{
+		const uint8_t* ip = data;
+		const uint8_t* const iend = data + size;
+		uint8_t* op = output;
+		uint8_t* const oend = output + outputSize;
+
+		while (ip < iend)
+		{
+			const uint8_t token = *ip++;
+
+			size_t literalCount = token >> 4;
+			if (literalCount == 15)
+			{
+				uint8_t b;
+				do
+				{
+					if (ip >= iend)
+					{
+						return false;
+					}
+					b = *ip++;
+					literalCount += b;
+				} while (b == 255);
+			}
+			if (literalCount > (size_t)(iend - ip) || literalCount > (size_t)(oend - op))
+			{
+				return false;
+			}
+			memcpy(op, ip, literalCount);
+			op += literalCount;
+			ip += literalCount;
+
+			if (ip == iend)
+			{
+				// The last sequence has only literals
+				break;
+			}
+
+			if (iend - ip < 2)
+			{
+				return false;
+			}
+			const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - output))
+			{
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15)
+			{
+				uint8_t b;
+				do
+				{
+					if (ip >= iend)
+					{
+						return false;
+					}
+					b = *ip++;
+					matchLength += b;
+				} while (b == 255);
+			}
+			matchLength += MINMATCH;
+			if (matchLength > (size_t)(oend - op))
+			{
+				return false;
+			}
+
+			const uint8_t* match = op - offset;
+			if (offset >= matchLength)
+			{
+				memcpy(op, match, matchLength);
+				op += matchLength;
+			}
+			else
+			{
+				// Overlapping match, repeats the last offset bytes:
+				for (size_t i = 0; i < matchLength; ++i)
+				{
+					*op++ = *match++;
+				}
+			}
+		}
+
+		return op == oend;
+	}
+}
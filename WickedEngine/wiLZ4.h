@@ -0,0 +1,15 @@
+#pragma once
+#include "CommonInclude.h"
+
+// Compressor and decompressor for the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+//	Blocks are independent and are compatible with the reference implementation. The decompressor checks every
+//	length and offset, so corrupted data is reported instead of reading or writing out of bounds.
+namespace wiLZ4
+{
+	// The largest possible compressed size of size bytes, the compression output must be at least this large
+	size_t GetMaxCompressedSize(size_t size);
+	// Returns the compressed size, or 0 if the output is smaller than GetMaxCompressedSize(size)
+	size_t Compress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize);
+	// Decompresses exactly outputSize bytes, returns false if the data is corrupted
+	bool Decompress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize);
+};
@@ -10,12 +10,19 @@
 #include "wiTextureHelper.h"
 #include "wiPHYSICS.h"
 #include "wiArchive.h"
+#include "wiJobSystem.h"
+#include "wiIndexCodec.h"
+#include "wiTimer.h"
+#include "wiBackLog.h"
 
 #define FORSYTH_IMPLEMENTATION
 #include "wiMeshOptimizer.h"
 
 #include <algorithm>
 #include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
 
 using namespace std;
 using namespace wiGraphicsTypes;
@@ -1313,9 +1320,32 @@ void Cullable::Serialize(wiArchive& archive)
 Streamable::Streamable():directory(""),meshfile(""),materialfile(""),loaded(false),mesh(nullptr){}
 void Streamable::StreamIn()
 {
+	if (loaded || mesh == nullptr || directory.empty())
+	{
+		return;
+	}
+
+	wiArchive archive(directory + meshfile + ".wichunk", true);
+	if (archive.IsOpen())
+	{
+		Mesh payload;
+		payload.Serialize(archive);
+		payload.Optimize();
+		payload.CreateVertexArrays();
+		mesh->SwapPayload(payload);
+		mesh->CreateBuffers(dynamic_cast<Object*>(this));
+		loaded = true;
+	}
 }
 void Streamable::StreamOut()
 {
+	if (!loaded || mesh == nullptr || directory.empty())
+	{
+		return;
+	}
+
+	mesh->ReleasePayload();
+	loaded = false;
 }
 void Streamable::Serialize(wiArchive& archive)
 {
@@ -1350,6 +1380,8 @@ Material::~Material() {
 	normalMap = nullptr;
 	displacementMap = nullptr;
 	specularMap = nullptr;
+
+	wiRenderer::UnregisterMaterial(this);
 }
 void Material::init()
 {
@@ -1403,13 +1435,24 @@ void Material::init()
 	userStencilRef = 0x00;
 
 
-	// constant buffer creation
+	// the table entry is written before the first use, because a new material is dirty:
+	dirty = false;
+	tableIndex = wiRenderer::RegisterMaterial(this);
+	SetDirty();
+
+	// constant buffer creation, it only holds the table index so it never has to be updated
+	MaterialCB mcb;
+	ZeroMemory(&mcb, sizeof(mcb));
+	mcb.materialIndex = tableIndex;
+
 	GPUBufferDesc bd;
 	bd.BindFlags = BIND_CONSTANT_BUFFER;
-	bd.Usage = USAGE_DEFAULT; // try to keep it in default memory because it will probably be updated non frequently!
+	bd.Usage = USAGE_IMMUTABLE;
 	bd.CPUAccessFlags = 0;
 	bd.ByteWidth = sizeof(MaterialCB);
-	wiRenderer::GetDevice()->CreateBuffer(&bd, nullptr, &constantBuffer);
+	SubresourceData initData;
+	initData.pSysMem = &mcb;
+	wiRenderer::GetDevice()->CreateBuffer(&bd, &initData, &constantBuffer);
 }
 void Material::ConvertToPhysicallyBasedMaterial()
 {
@@ -1418,6 +1461,64 @@ void Material::ConvertToPhysicallyBasedMaterial()
 	metalness = 0.0f;
 	reflectance = (specular.x + specular.y + specular.z) / 3.0f * specular.w;
 	normalMapStrength = 1.0f;
+	SetDirty();
+}
+void Material::SetDirty()
+{
+	wiRenderer::MarkMaterialDirty(this);
+}
+void Material::CreateShaderMaterial(ShaderMaterial& dest) const
+{
+	dest.baseColor = XMFLOAT4(baseColor.x, baseColor.y, baseColor.z, alpha);
+	dest.texMulAdd = texMulAdd;
+	dest.roughness = roughness;
+	dest.reflectance = reflectance;
+	dest.metalness = metalness;
+	dest.emissive = emissive;
+	dest.refractionIndex = refractionIndex;
+	dest.subsurfaceScattering = subsurfaceScattering;
+	dest.normalMapStrength = (normalMap == nullptr ? 0 : normalMapStrength);
+	dest.parallaxOcclusionMapping = parallaxOcclusionMapping;
+}
+bool Material::IsEquivalent(const Material& other) const
+{
+	auto equal3 = [](const XMFLOAT3& a, const XMFLOAT3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+	auto equal4 = [](const XMFLOAT4& a, const XMFLOAT4& b) { return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w; };
+
+	// Textures are compared by resource, because the names are relative to the model directories:
+	return
+		refMap == other.refMap &&
+		texture == other.texture &&
+		normalMap == other.normalMap &&
+		displacementMap == other.displacementMap &&
+		specularMap == other.specularMap &&
+		premultipliedTexture == other.premultipliedTexture &&
+		blendFlag == other.blendFlag &&
+		equal3(diffuseColor, other.diffuseColor) &&
+		toonshading == other.toonshading &&
+		water == other.water &&
+		shadeless == other.shadeless &&
+		enviroReflection == other.enviroReflection &&
+		equal4(specular, other.specular) &&
+		specular_power == other.specular_power &&
+		equal3(movingTex, other.movingTex) &&
+		equal4(texMulAdd, other.texMulAdd) &&
+		isSky == other.isSky &&
+		cast_shadow == other.cast_shadow &&
+		equal3(baseColor, other.baseColor) &&
+		alpha == other.alpha &&
+		roughness == other.roughness &&
+		reflectance == other.reflectance &&
+		metalness == other.metalness &&
+		emissive == other.emissive &&
+		refractionIndex == other.refractionIndex &&
+		subsurfaceScattering == other.subsurfaceScattering &&
+		normalMapStrength == other.normalMapStrength &&
+		parallaxOcclusionMapping == other.parallaxOcclusionMapping &&
+		planar_reflections == other.planar_reflections &&
+		alphaRef == other.alphaRef &&
+		engineStencilRef == other.engineStencilRef &&
+		userStencilRef == other.userStencilRef;
 }
 const Texture2D* Material::GetBaseColorMap() const
 {
@@ -1527,6 +1628,8 @@ void Material::Serialize(wiArchive& archive)
 			specularMapName = texturesDir + specularMapName;
 			specularMap = (Texture2D*)wiResourceManager::GetGlobal()->add(specularMapName);
 		}
+
+		SetDirty();
 	}
 	else
 	{
@@ -1570,19 +1673,15 @@ void Material::Serialize(wiArchive& archive)
 wiGraphicsTypes::GPUBuffer* Material::constantBuffer_Impostor = nullptr;
 void Material::CreateImpostorMaterialCB()
 {
-	// imposor material constantbuffer is always the same, because every param is baked into the textures
+	// imposor material is always the same, because every param is baked into the textures. Its entry is reserved in the
+	//	material table, see wiRenderer::UpdateMaterialTable
 	if (constantBuffer_Impostor == nullptr)
 	{
 		constantBuffer_Impostor = new wiGraphicsTypes::GPUBuffer;
 
 		MaterialCB mcb;
 		ZeroMemory(&mcb, sizeof(mcb));
-		mcb.baseColor = XMFLOAT4(1, 1, 1, 1);
-		mcb.texMulAdd = XMFLOAT4(1, 1, 0, 0);
-		mcb.normalMapStrength = 1.0f;
-		mcb.roughness = 1.0f;
-		mcb.reflectance = 1.0f;
-		mcb.metalness = 1.0f;
+		mcb.materialIndex = MATERIALARRAY_INDEX_IMPOSTOR;
 
 		GPUBufferDesc bd;
 		bd.BindFlags = BIND_CONSTANT_BUFFER;
@@ -1595,19 +1694,6 @@ void Material::CreateImpostorMaterialCB()
 	}
 }
 
-void MaterialCB::Create(const Material& mat)
-{
-	baseColor = XMFLOAT4(mat.baseColor.x, mat.baseColor.y, mat.baseColor.z, mat.alpha);
-	texMulAdd = mat.texMulAdd;
-	roughness = mat.roughness;
-	reflectance = mat.reflectance;
-	metalness = mat.metalness;
-	emissive = mat.emissive;
-	refractionIndex = mat.refractionIndex;
-	subsurfaceScattering = mat.subsurfaceScattering;
-	normalMapStrength = (mat.normalMap == nullptr ? 0 : mat.normalMapStrength);
-	parallaxOcclusionMapping = mat.parallaxOcclusionMapping;
-}
 #pragma endregion
 
 #pragma region MESHSUBSET
@@ -1615,7 +1701,8 @@ void MaterialCB::Create(const Material& mat)
 MeshSubset::MeshSubset()
 {
 	material = nullptr;
-	indexBufferOffset = 0;
+	indexOffset = 0;
+	indexCount = 0;
 }
 MeshSubset::~MeshSubset()
 {
@@ -2051,26 +2138,10 @@ void Mesh::CreateBuffers(Object* object)
 		wiRenderer::GetDevice()->CreateBuffer(&bd, &InitData, &vertexBuffer_TEX);
 
 
-		//PHYSICALMAPPING
-		if (!physicsverts.empty() && physicalmapGP.empty())
-		{
-			for (unsigned int i = 0; i < vertices_POS.size(); ++i) {
-				for (unsigned int j = 0; j < physicsverts.size(); ++j) {
-					if (fabs(vertices_POS[i].pos.x - physicsverts[j].x) < FLT_EPSILON
-						&&	fabs(vertices_POS[i].pos.y - physicsverts[j].y) < FLT_EPSILON
-						&&	fabs(vertices_POS[i].pos.z - physicsverts[j].z) < FLT_EPSILON
-						)
-					{
-						physicalmapGP.push_back(j);
-						break;
-					}
-				}
-			}
-		}
+		CreatePhysicalMapping();
 
 
-		// Remap index buffer to be continuous across subsets and create gpu buffer data:
-		uint32_t counter = 0;
+		// Create gpu index buffer data. The indices are relative to the base vertex of their draw range:
 		uint8_t stride;
 		void* gpuIndexData;
 		if (GetIndexFormat() == INDEXFORMAT_16BIT)
@@ -2086,28 +2157,23 @@ void Mesh::CreateBuffers(Object* object)
 
 		for (MeshSubset& subset : subsets)
 		{
-			if (subset.subsetIndices.empty())
-			{
-				continue;
-			}
-			subset.indexBufferOffset = counter;
-
-			switch (GetIndexFormat())
+			for (auto& range : subset.drawRanges)
 			{
-			case INDEXFORMAT_16BIT:
-				for (auto& x : subset.subsetIndices)
+				switch (GetIndexFormat())
 				{
-					static_cast<uint16_t*>(gpuIndexData)[counter] = static_cast<uint16_t>(x);
-					counter++;
-				}
-				break;
-			default:
-				for (auto& x : subset.subsetIndices)
-				{
-					static_cast<uint32_t*>(gpuIndexData)[counter] = static_cast<uint32_t>(x);
-					counter++;
+				case INDEXFORMAT_16BIT:
+					for (UINT i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+					{
+						static_cast<uint16_t*>(gpuIndexData)[i] = static_cast<uint16_t>(indices[i] - range.baseVertex);
+					}
+					break;
+				default:
+					for (UINT i = range.indexOffset; i < range.indexOffset + range.indexCount; ++i)
+					{
+						static_cast<uint32_t*>(gpuIndexData)[i] = indices[i] - range.baseVertex;
+					}
+					break;
 				}
-				break;
 			}
 		}
 
@@ -2129,6 +2195,125 @@ void Mesh::CreateBuffers(Object* object)
 	}
 
 }
+void Mesh::CreatePhysicalMapping()
+{
+	//PHYSICALMAPPING
+	if (!physicsverts.empty() && physicalmapGP.empty())
+	{
+		for (unsigned int i = 0; i < vertices_POS.size(); ++i) {
+			for (unsigned int j = 0; j < physicsverts.size(); ++j) {
+				if (fabs(vertices_POS[i].pos.x - physicsverts[j].x) < FLT_EPSILON
+					&&	fabs(vertices_POS[i].pos.y - physicsverts[j].y) < FLT_EPSILON
+					&&	fabs(vertices_POS[i].pos.z - physicsverts[j].z) < FLT_EPSILON
+					)
+				{
+					physicalmapGP.push_back(j);
+					break;
+				}
+			}
+		}
+	}
+}
+void Mesh::CreateDrawRanges(bool allowSplit)
+{
+	const uint32_t vertexCount = (uint32_t)vertices_POS.size();
+	const bool split = vertexCount > 65536;
+
+	indexFormat = INDEXFORMAT_16BIT;
+	size_t rangeCount = 0;
+	bool fallback = split && !allowSplit;
+
+	for (MeshSubset& subset : subsets)
+	{
+		if (fallback)
+		{
+			break;
+		}
+
+		subset.drawRanges.clear();
+		if (subset.indexCount == 0)
+		{
+			continue;
+		}
+
+		MeshSubset::DrawRange range;
+		range.indexOffset = subset.indexOffset;
+		range.indexCount = split ? 0 : subset.indexCount;
+		range.baseVertex = 0;
+		if (!split)
+		{
+			subset.drawRanges.push_back(range);
+			rangeCount++;
+			continue;
+		}
+
+		// Add triangles to the range while every vertex they reference is within 65536 vertices of the others:
+		uint32_t rangeMin = UINT32_MAX, rangeMax = 0;
+		for (UINT i = subset.indexOffset; i < subset.indexOffset + subset.indexCount; i += 3)
+		{
+			uint32_t triangleMin = min(indices[i], min(indices[i + 1], indices[i + 2]));
+			uint32_t triangleMax = max(indices[i], max(indices[i + 1], indices[i + 2]));
+			if (triangleMax - triangleMin > 65535)
+			{
+				fallback = true;
+				break;
+			}
+
+			uint32_t newMin = min(rangeMin, triangleMin);
+			uint32_t newMax = max(rangeMax, triangleMax);
+			if (newMax - newMin > 65535)
+			{
+				range.baseVertex = rangeMin;
+				subset.drawRanges.push_back(range);
+				rangeCount++;
+
+				range.indexOffset = i;
+				range.indexCount = 0;
+				newMin = triangleMin;
+				newMax = triangleMax;
+			}
+			rangeMin = newMin;
+			rangeMax = newMax;
+			range.indexCount += 3;
+		}
+		range.baseVertex = rangeMin;
+		subset.drawRanges.push_back(range);
+		rangeCount++;
+	}
+
+	// Every draw range is a separate draw call, so if the triangles are scattered over the vertices, 32-bit indices are better:
+	const size_t maxRangeCount = subsets.size() + 4 * (vertexCount / 65536);
+	if (fallback || rangeCount > maxRangeCount)
+	{
+		indexFormat = INDEXFORMAT_32BIT;
+		for (MeshSubset& subset : subsets)
+		{
+			subset.drawRanges.clear();
+			if (subset.indexCount > 0)
+			{
+				MeshSubset::DrawRange range;
+				range.indexOffset = subset.indexOffset;
+				range.indexCount = subset.indexCount;
+				range.baseVertex = 0;
+				subset.drawRanges.push_back(range);
+			}
+		}
+	}
+}
+bool Mesh::HasSplitDrawRanges() const
+{
+	for (const MeshSubset& subset : subsets)
+	{
+		for (auto& range : subset.drawRanges)
+		{
+			if (range.baseVertex > 0)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
 void Mesh::CreateImpostorVB()
 {
 	if (!impostorVB_POS.IsValid())
@@ -2361,32 +2546,232 @@ void Mesh::CreateVertexArrays()
 	vertices_Transformed_NOR = vertices_NOR;
 	vertices_Transformed_PRE = vertices_POS; // pre <- pos!!
 
-	// Map subset indices:
-	for (size_t i = 0; i < indices.size(); ++i)
+	// Group the triangles by subset while keeping their optimized order, so every subset is a continuous index range:
 	{
-		unsigned int index = indices[i];
-		const XMFLOAT4& tex = vertices_FULL[index].tex;
-		unsigned int materialIndex = (unsigned int)floor(tex.z);
+		const size_t triangleCount = indices.size() / 3;
+		vector<uint32_t> triangleSubsets(triangleCount);
+		for (auto& subset : subsets)
+		{
+			subset.indexCount = 0;
+		}
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			const XMFLOAT4& tex = vertices_FULL[indices[i * 3]].tex;
+			unsigned int materialIndex = (unsigned int)floor(tex.z);
+
+			assert((materialIndex < (unsigned int)subsets.size()) && "Bad subset index!");
 
-		assert((materialIndex < (unsigned int)subsets.size()) && "Bad subset index!");
+			triangleSubsets[i] = materialIndex;
+			subsets[materialIndex].indexCount += 3;
+		}
 
-		MeshSubset& subset = subsets[materialIndex];
-		subset.subsetIndices.push_back(index);
+		vector<UINT> cursors(subsets.size());
+		UINT offset = 0;
+		for (size_t i = 0; i < subsets.size(); ++i)
+		{
+			subsets[i].indexOffset = offset;
+			cursors[i] = offset;
+			offset += subsets[i].indexCount;
+		}
 
-		if (index >= 65536)
+		vector<uint32_t> groupedIndices(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount; ++i)
 		{
-			indexFormat = INDEXFORMAT_32BIT;
+			UINT& cursor = cursors[triangleSubsets[i]];
+			groupedIndices[cursor + 0] = indices[i * 3 + 0];
+			groupedIndices[cursor + 1] = indices[i * 3 + 1];
+			groupedIndices[cursor + 2] = indices[i * 3 + 2];
+			cursor += 3;
 		}
+		indices.swap(groupedIndices);
 	}
 
+	CreateDrawRanges();
+
 	if (goalVG >= 0) {
 		goalPositions.resize(vertexGroups[goalVG].vertices.size());
 		goalNormals.resize(vertexGroups[goalVG].vertices.size());
 	}
 
+	UpdateWindAffected();
+
 	arraysComplete = true;
 }
+void Mesh::UpdateWindAffected()
+{
+	windAffected = false;
+	for (auto& x : vertices_FULL)
+	{
+		if (x.pos.w != 0)
+		{
+			windAffected = true;
+			break;
+		}
+	}
+}
+
+size_t Mesh::GetMemorySize() const
+{
+	size_t size = 0;
+
+	size += vertices_FULL.capacity() * sizeof(Vertex_FULL);
+	size += (vertices_POS.capacity() + vertices_Transformed_POS.capacity() + vertices_Transformed_PRE.capacity()) * sizeof(Vertex_POS);
+	size += (vertices_NOR.capacity() + vertices_Transformed_NOR.capacity()) * sizeof(Vertex_NOR);
+	size += vertices_TEX.capacity() * sizeof(Vertex_TEX);
+	size += vertices_BON.capacity() * sizeof(Vertex_BON);
+	size += indices.capacity() * sizeof(uint32_t);
+
+	if (buffersComplete)
+	{
+		size += vertices_POS.size() * (sizeof(Vertex_POS) + sizeof(Vertex_NOR) + sizeof(Vertex_TEX) + sizeof(Vertex_BON));
+		size += indices.size() * (GetIndexFormat() == INDEXFORMAT_16BIT ? sizeof(uint16_t) : sizeof(uint32_t));
+	}
+
+	return size;
+}
+void Mesh::ReleasePayload()
+{
+	vector<Vertex_FULL>().swap(vertices_FULL);
+	vector<Vertex_POS>().swap(vertices_POS);
+	vector<Vertex_NOR>().swap(vertices_NOR);
+	vector<Vertex_TEX>().swap(vertices_TEX);
+	vector<Vertex_BON>().swap(vertices_BON);
+	vector<Vertex_POS>().swap(vertices_Transformed_POS);
+	vector<Vertex_NOR>().swap(vertices_Transformed_NOR);
+	vector<Vertex_POS>().swap(vertices_Transformed_PRE);
+	vector<uint32_t>().swap(indices);
+
+	indexBuffer.Release();
+	vertexBuffer_POS.Release();
+	vertexBuffer_NOR.Release();
+	vertexBuffer_TEX.Release();
+	vertexBuffer_BON.Release();
+	streamoutBuffer_POS.Release();
+	streamoutBuffer_NOR.Release();
+	streamoutBuffer_PRE.Release();
+
+	arraysComplete = false;
+	buffersComplete = false;
+}
+void Mesh::SwapPayload(Mesh& other)
+{
+	vertices_FULL.swap(other.vertices_FULL);
+	vertices_POS.swap(other.vertices_POS);
+	vertices_NOR.swap(other.vertices_NOR);
+	vertices_TEX.swap(other.vertices_TEX);
+	vertices_BON.swap(other.vertices_BON);
+	vertices_Transformed_POS.swap(other.vertices_Transformed_POS);
+	vertices_Transformed_NOR.swap(other.vertices_Transformed_NOR);
+	vertices_Transformed_PRE.swap(other.vertices_Transformed_PRE);
+	indices.swap(other.indices);
+	for (size_t i = 0; i < subsets.size() && i < other.subsets.size(); ++i)
+	{
+		std::swap(subsets[i].indexOffset, other.subsets[i].indexOffset);
+		std::swap(subsets[i].indexCount, other.subsets[i].indexCount);
+		subsets[i].drawRanges.swap(other.subsets[i].drawRanges);
+	}
+
+	std::swap(indexFormat, other.indexFormat);
+	std::swap(arraysComplete, other.arraysComplete);
+	std::swap(windAffected, other.windAffected);
+	std::swap(optimized, other.optimized);
+}
+bool Mesh::IsShareable() const
+{
+	return armatureName.empty() && armature == nullptr && !softBody;
+}
+uint64_t Mesh::GetGeometryHash() const
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto hashBytes = [&](const void* data, size_t size) {
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= (uint64_t)bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	size_t counts[] = { vertices_FULL.size(), indices.size(), subsets.size(), physicsverts.size(), vertexGroups.size() };
+	hashBytes(counts, sizeof(counts));
+	hashBytes(vertices_FULL.data(), vertices_FULL.size() * sizeof(Vertex_FULL));
+	hashBytes(indices.data(), indices.size() * sizeof(uint32_t));
+	hashBytes(&doubleSided, sizeof(doubleSided));
+	hashBytes(&isBillboarded, sizeof(isBillboarded));
+	hashBytes(&tessellationFactor, sizeof(tessellationFactor));
+
+	return hash;
+}
+bool Mesh::IsIdentical(const Mesh& other) const
+{
+	if (vertices_FULL.size() != other.vertices_FULL.size() ||
+		indices.size() != other.indices.size() ||
+		subsets.size() != other.subsets.size() ||
+		physicsverts.size() != other.physicsverts.size() ||
+		physicsindices.size() != other.physicsindices.size() ||
+		vertexGroups.size() != other.vertexGroups.size())
+	{
+		return false;
+	}
+
+	if (renderable != other.renderable ||
+		doubleSided != other.doubleSided ||
+		isBillboarded != other.isBillboarded ||
+		billboardAxis.x != other.billboardAxis.x || billboardAxis.y != other.billboardAxis.y || billboardAxis.z != other.billboardAxis.z ||
+		trailInfo.base != other.trailInfo.base || trailInfo.tip != other.trailInfo.tip ||
+		impostorDistance != other.impostorDistance ||
+		tessellationFactor != other.tessellationFactor ||
+		calculatedAO != other.calculatedAO)
+	{
+		return false;
+	}
+
+	// The hash can collide, so the data is compared too:
+	if (memcmp(vertices_FULL.data(), other.vertices_FULL.data(), vertices_FULL.size() * sizeof(Vertex_FULL)) != 0 ||
+		memcmp(indices.data(), other.indices.data(), indices.size() * sizeof(uint32_t)) != 0 ||
+		memcmp(physicsverts.data(), other.physicsverts.data(), physicsverts.size() * sizeof(XMFLOAT3)) != 0 ||
+		memcmp(physicsindices.data(), other.physicsindices.data(), physicsindices.size() * sizeof(uint32_t)) != 0)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < vertexGroups.size(); ++i)
+	{
+		if (vertexGroups[i].name.compare(other.vertexGroups[i].name) || vertexGroups[i].vertices != other.vertexGroups[i].vertices)
+		{
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < subsets.size(); ++i)
+	{
+		const Material* a = subsets[i].material;
+		const Material* b = other.subsets[i].material;
+		if (a != b && (a == nullptr || b == nullptr || !a->IsEquivalent(*b)))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
 
+// Meshes shared between models by geometry hash. Models can be loaded from multiple threads (ModelCooker), so it is locked:
+static unordered_multimap<uint64_t, Mesh*> sharedMeshes;
+static mutex sharedMeshesLock;
+static Mesh::SharingStats sharingStats;
+
+Mesh::SharingStats Mesh::GetSharingStats()
+{
+	lock_guard<mutex> lock(sharedMeshesLock);
+	return sharingStats;
+}
+static bool indexCompression = false;
+void Mesh::SetIndexCompressionEnabled(bool value)
+{
+	indexCompression = value;
+}
 void Mesh::Serialize(wiArchive& archive)
 {
 	if (archive.IsReadMode())
@@ -2396,46 +2781,77 @@ void Mesh::Serialize(wiArchive& archive)
 
 		// vertices
 		{
-			size_t vertexCount;
-			archive >> vertexCount;
-			vertices_FULL.resize(vertexCount);
-			for (size_t i = 0; i < vertexCount; ++i)
-			{
-				archive >> vertices_FULL[i].pos;
-				archive >> vertices_FULL[i].nor;
-				archive >> vertices_FULL[i].tex;
-				archive >> vertices_FULL[i].ind;
-				archive >> vertices_FULL[i].wei;
+			// The vertex fields were always written back to back, so every version has the same layout as the array:
+			static_assert(sizeof(Vertex_FULL) == sizeof(XMFLOAT4) * 5, "Vertex_FULL must not be padded!");
+			archive.ReadArray(vertices_FULL);
 
-				if (archive.GetVersion() < 8)
+			if (archive.GetVersion() < 8)
+			{
+				for (auto& x : vertices_FULL)
 				{
-					vertices_FULL[i].pos.w = vertices_FULL[i].tex.w;
+					x.pos.w = x.tex.w;
 				}
 			}
+			// Cooked meshes don't go through CreateVertexArrays():
+			UpdateWindAffected();
 		}
 		// indices
 		{
-			size_t indexCount;
-			archive >> indexCount;
-			unsigned int tempInd;
-			for (size_t i = 0; i < indexCount; ++i)
+			size_t indexCount = 0;
+			bool compressed = false;
+			if (archive.GetVersion() >= 15)
 			{
-				archive >> tempInd;
-				indices.push_back(tempInd);
+				archive >> compressed;
+				if (compressed)
+				{
+					archive >> indexCount;
+				}
+			}
+			else
+			{
+				archive >> indexCount;
+				if (archive.GetVersion() >= 14)
+				{
+					archive >> compressed;
+				}
+			}
+			if (archive.GetVersion() >= 15 && !compressed)
+			{
+				archive.ReadArray(indices);
+			}
+			else if (compressed)
+			{
+				indices.resize(indexCount);
+				// Decoded straight from the archive memory:
+				uint64_t dataSize;
+				archive >> dataSize;
+				const uint8_t* data = (const uint8_t*)archive.ReadView((size_t)dataSize);
+				if (data == nullptr || !wiIndexCodec::Decode(data, (size_t)dataSize, indices.data(), indexCount, vertices_FULL.size()))
+				{
+					// Nothing is drawn from the broken indices:
+					indices.clear();
+					wiHelper::messageBox("Corrupted index data in mesh: " + name, "Error!");
+				}
+			}
+			else
+			{
+				indices.resize(indexCount);
+				for (size_t i = 0; i < indexCount; ++i)
+				{
+					archive >> indices[i];
+				}
 			}
 		}
 		// physicsVerts
 		{
-			size_t physicsVertCount;
-			archive >> physicsVertCount;
-			XMFLOAT3 tempPhysicsVert;
-			for (size_t i = 0; i < physicsVertCount; ++i)
-			{
-				archive >> tempPhysicsVert;
-				physicsverts.push_back(tempPhysicsVert);
-			}
+			archive.ReadArray(physicsverts);
 		}
 		// physicsindices
+		if (archive.GetVersion() >= 15)
+		{
+			archive.ReadArray(physicsindices);
+		}
+		else
 		{
 			size_t physicsIndexCount;
 			archive >> physicsIndexCount;
@@ -2447,6 +2863,11 @@ void Mesh::Serialize(wiArchive& archive)
 			}
 		}
 		// physicalmapGP
+		if (archive.GetVersion() >= 15)
+		{
+			archive.ReadArray(physicalmapGP);
+		}
+		else
 		{
 			size_t physicalmapGPCount;
 			archive >> physicalmapGPCount;
@@ -2513,6 +2934,90 @@ void Mesh::Serialize(wiArchive& archive)
 			archive >> tessellationFactor;
 			archive >> optimized;
 		}
+
+		if (archive.GetVersion() >= 13)
+		{
+			// Cooked meshes store their final vertex arrays, so loading them skips CreateVertexArrays():
+			archive >> arraysComplete;
+			if (arraysComplete)
+			{
+				if (archive.GetVersion() >= 15)
+				{
+					archive.ReadArray(vertices_POS);
+					archive.ReadArray(vertices_NOR);
+					archive.ReadArray(vertices_TEX);
+					archive.ReadArray(vertices_BON);
+				}
+				else
+				{
+					size_t vertexCount;
+					archive >> vertexCount;
+					vertices_POS.resize(vertexCount);
+					vertices_NOR.resize(vertexCount);
+					vertices_TEX.resize(vertexCount);
+					vertices_BON.resize(vertexCount);
+					for (size_t i = 0; i < vertexCount; ++i)
+					{
+						archive >> vertices_POS[i].pos;
+						archive >> vertices_NOR[i].nor;
+						archive >> vertices_TEX[i].tex.v;
+						archive >> vertices_BON[i].ind;
+						archive >> vertices_BON[i].wei;
+					}
+				}
+				if (archive.GetVersion() >= 14)
+				{
+					for (auto& x : subsets)
+					{
+						archive >> x.indexOffset;
+						archive >> x.indexCount;
+						size_t rangeCount;
+						archive >> rangeCount;
+						x.drawRanges.resize(rangeCount);
+						for (auto& range : x.drawRanges)
+						{
+							archive >> range.indexOffset;
+							archive >> range.indexCount;
+							archive >> range.baseVertex;
+						}
+					}
+				}
+				else
+				{
+					// Version 13 stored the subset indices separately, they become the grouped index list:
+					indices.clear();
+					for (auto& x : subsets)
+					{
+						size_t subsetIndexCount;
+						archive >> subsetIndexCount;
+						x.indexOffset = (UINT)indices.size();
+						x.indexCount = (UINT)subsetIndexCount;
+						unsigned int tempInd;
+						for (size_t i = 0; i < subsetIndexCount; ++i)
+						{
+							archive >> tempInd;
+							indices.push_back(tempInd);
+						}
+					}
+					CreateDrawRanges();
+				}
+				int format;
+				archive >> format;
+				if (archive.GetVersion() >= 14)
+				{
+					indexFormat = (INDEXBUFFER_FORMAT)format;
+				}
+
+				vertices_Transformed_POS = vertices_POS;
+				vertices_Transformed_NOR = vertices_NOR;
+				vertices_Transformed_PRE = vertices_POS;
+
+				if (goalVG >= 0) {
+					goalPositions.resize(vertexGroups[goalVG].vertices.size());
+					goalNormals.resize(vertexGroups[goalVG].vertices.size());
+				}
+			}
+		}
 	}
 	else
 	{
@@ -2521,47 +3026,35 @@ void Mesh::Serialize(wiArchive& archive)
 
 		// vertices
 		{
-			archive << vertices_FULL.size();
-			for (size_t i = 0; i < vertices_FULL.size(); ++i)
-			{
-				archive << vertices_FULL[i].pos;
-				archive << vertices_FULL[i].nor;
-				archive << vertices_FULL[i].tex;
-				archive << vertices_FULL[i].ind;
-				archive << vertices_FULL[i].wei;
-			}
+			archive.WriteArray(vertices_FULL);
 		}
 		// indices
 		{
-			archive << indices.size();
-			for (auto& x : indices)
+			bool compressed = indexCompression && !indices.empty();
+			archive << compressed;
+			if (compressed)
 			{
-				archive << x;
+				archive << indices.size();
+				vector<uint8_t> data;
+				wiIndexCodec::Encode(indices.data(), indices.size(), data);
+				archive << data;
+			}
+			else
+			{
+				archive.WriteArray(indices);
 			}
 		}
 		// physicsverts
 		{
-			archive << physicsverts.size();
-			for (auto& x : physicsverts)
-			{
-				archive << x;
-			}
+			archive.WriteArray(physicsverts);
 		}
 		// physicsindices
 		{
-			archive << physicsindices.size();
-			for (auto& x : physicsindices)
-			{
-				archive << x;
-			}
+			archive.WriteArray(physicsindices);
 		}
 		// physicalmapGP
 		{
-			archive << physicalmapGP.size();
-			for (auto& x : physicalmapGP)
-			{
-				archive << x;
-			}
+			archive.WriteArray(physicalmapGP);
 		}
 		// subsets
 		{
@@ -2606,6 +3099,31 @@ void Mesh::Serialize(wiArchive& archive)
 			archive << tessellationFactor;
 			archive << optimized;
 		}
+
+		if (archive.GetVersion() >= 13)
+		{
+			archive << arraysComplete;
+			if (arraysComplete)
+			{
+				archive.WriteArray(vertices_POS);
+				archive.WriteArray(vertices_NOR);
+				archive.WriteArray(vertices_TEX);
+				archive.WriteArray(vertices_BON);
+				for (auto& x : subsets)
+				{
+					archive << x.indexOffset;
+					archive << x.indexCount;
+					archive << x.drawRanges.size();
+					for (auto& range : x.drawRanges)
+					{
+						archive << range.indexOffset;
+						archive << range.indexCount;
+						archive << range.baseVertex;
+					}
+				}
+				archive << (int)indexFormat;
+			}
+		}
 	}
 }
 #pragma endregion
@@ -2641,14 +3159,41 @@ void Model::CleanUp()
 	{
 		SAFE_DELETE(x);
 	}
+
+	// Shared meshes are deleted by the last model holding them:
+	lock_guard<mutex> lock(sharedMeshesLock);
+	for (auto& x : meshes)
+	{
+		Mesh* mesh = x.second;
+		if (mesh->refCount > 0 && --mesh->refCount == 0)
+		{
+			for (auto it = sharedMeshes.begin(); it != sharedMeshes.end(); ++it)
+			{
+				if (it->second == mesh)
+				{
+					sharedMeshes.erase(it);
+					break;
+				}
+			}
+			SAFE_DELETE(mesh);
+		}
+	}
+	meshes.clear();
 }
-void Model::LoadFromDisk(const std::string& dir, const std::string& name, const std::string& identifier)
+void Model::LoadFromDisk(const std::string& dir, const std::string& name, const std::string& identifier, bool legacy)
 {
-	wiArchive archive(dir + name + ".wimf", true);
+	wiArchive archive(legacy ? "" : dir + name + ".wimf", true);
 	if (archive.IsOpen())
 	{
 		// New Import if wimf model is available
 		this->Serialize(archive);
+
+		if (archive.IsFailed())
+		{
+			// Whatever was read before the end of the data is not used:
+			CleanUp();
+			wiHelper::messageBox("The model archive is truncated or corrupted: " + dir + name + ".wimf", "Error!");
+		}
 	}
 	else
 	{
@@ -2704,13 +3249,20 @@ void Model::FinishLoading()
 
 
 	// Match loaded parenting information
+	unordered_multimap<string, Transform*> transformsByName;
 	for (Transform* x : transforms)
 	{
-		if (x->parent == nullptr)
+		transformsByName.insert(make_pair(x->name, x));
+	}
+	for (Transform* x : transforms)
+	{
+		if (x->parent == nullptr && !x->parentName.empty())
 		{
-			for (Transform* y : transforms)
+			auto range = transformsByName.equal_range(x->parentName);
+			for (auto it = range.first; it != range.second; ++it)
 			{
-				if (x != y && !x->parentName.empty() && !x->parentName.compare(y->name))
+				Transform* y = it->second;
+				if (x != y)
 				{
 					Transform* parent = y;
 					string parentName = parent->name;
@@ -2747,7 +3299,45 @@ void Model::FinishLoading()
 	}
 
 
-	// Set up Render data
+	// Set up Render data. The CPU side processing of the meshes is independent, so they are processed in parallel:
+	wiTimer timer;
+	timer.record();
+
+	vector<Mesh*> uniqueMeshes;
+	{
+		unordered_set<Mesh*> visited;
+		for (Object* x : objects)
+		{
+			if (x->mesh != nullptr && visited.insert(x->mesh).second)
+			{
+				uniqueMeshes.push_back(x->mesh);
+			}
+		}
+	}
+	wiJobSystem::Counter counter;
+	wiJobSystem::Dispatch(counter, (uint32_t)uniqueMeshes.size(), 1, [&](uint32_t i) {
+		Mesh* mesh = uniqueMeshes[i];
+
+		// Mesh renderdata setup (optimize first, because subset indices are mapped from the optimized index list)
+		mesh->Optimize();
+		mesh->CreateVertexArrays();
+		mesh->CreatePhysicalMapping();
+	});
+	wiJobSystem::Wait(counter);
+
+	DeduplicateMeshes();
+
+	// Emitters pick triangles from the index buffer on the GPU, so they need absolute vertex indices:
+	for (Object* x : objects)
+	{
+		if (x->mesh != nullptr && !x->eParticleSystems.empty() && x->mesh->HasSplitDrawRanges())
+		{
+			x->mesh->CreateDrawRanges(false);
+		}
+	}
+
+	// GPU resources are created on the calling thread after the processing has finished:
+	unordered_set<Armature*> armaturesWithBuffers;
 	for (Object* x : objects)
 	{
 		if (x->mesh != nullptr)
@@ -2759,17 +3349,47 @@ void Model::FinishLoading()
 				x->trailDistortTex = wiTextureHelper::getInstance()->getNormalMapDefault();
 			}
 
-			// Mesh renderdata setup
-			x->mesh->CreateVertexArrays();
-			x->mesh->Optimize();
 			x->mesh->CreateBuffers(x);
+			x->loaded = true;
 
-			if (x->mesh->armature != nullptr)
+			if (x->mesh->armature != nullptr && armaturesWithBuffers.insert(x->mesh->armature).second)
 			{
 				x->mesh->armature->CreateBuffers();
 			}
 		}
 	}
+
+	stringstream ss("");
+	ss << "Model render data set up: " << uniqueMeshes.size() << " meshes in " << (int)timer.elapsed() << " ms with " << wiJobSystem::GetWorkerCount() << " workers";
+	wiBackLog::post(ss.str().c_str());
+
+	Mesh::SharingStats sharing = Mesh::GetSharingStats();
+	ss.str("");
+	ss << "Mesh deduplication: " << sharing.removedMeshes << " of " << sharing.loadedMeshes << " meshes shared (" << (int)(sharing.GetDeduplicationRatio() * 100) << "%), " << sharing.savedBytes / 1024 << " KB saved";
+	wiBackLog::post(ss.str().c_str());
+}
+void Model::Cook()
+{
+	// Run every load-time processing step offline, so that the serialized model can be loaded without them:
+	for (auto& x : meshes)
+	{
+		Mesh* mesh = x.second;
+
+		mesh->Optimize();
+		mesh->CreateVertexArrays();
+
+		if (!mesh->vertices_POS.empty())
+		{
+			XMFLOAT3 _min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			XMFLOAT3 _max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (auto& v : mesh->vertices_POS)
+			{
+				_min = wiMath::Min(_min, XMFLOAT3(v.pos.x, v.pos.y, v.pos.z));
+				_max = wiMath::Max(_max, XMFLOAT3(v.pos.x, v.pos.y, v.pos.z));
+			}
+			mesh->aabb.create(_min, _max);
+		}
+	}
 }
 void Model::UpdateModel()
 {
@@ -2782,6 +3402,10 @@ void Model::UpdateModel()
 			iMat->texMulAdd.z = fmodf(iMat->texMulAdd.z + iMat->movingTex.x*wiRenderer::GetGameSpeed(), 1);
 			iMat->texMulAdd.w = fmodf(iMat->texMulAdd.w + iMat->movingTex.y*wiRenderer::GetGameSpeed(), 1);
 			iMat->framesToWaitForTexCoordOffset = iMat->movingTex.z*wiRenderer::GetGameSpeed();
+			if (iMat->movingTex.x != 0 || iMat->movingTex.y != 0)
+			{
+				iMat->SetDirty();
+			}
 		}
 	}
 
@@ -2814,14 +3438,18 @@ void Model::UpdateModel()
 		++iter;
 	}
 }
-void Model::Add(Object* value)
+void Model::Add(Object* value, bool share)
 {
 	if (value != nullptr)
 	{
 		objects.push_back(value);
 		if (value->mesh != nullptr)
 		{
-			meshes.insert(pair<string, Mesh*>(value->mesh->name, value->mesh));
+			if (meshes.insert(pair<string, Mesh*>(value->mesh->name, value->mesh)).second && share && value->mesh->refCount > 0)
+			{
+				lock_guard<mutex> lock(sharedMeshesLock);
+				value->mesh->refCount++;
+			}
 			for (auto& x : value->mesh->subsets)
 			{
 				materials.insert(pair<string, Material*>(x.material->name, x.material));
@@ -2858,7 +3486,7 @@ void Model::Add(ForceField* value)
 		forces.push_back(value);
 	}
 }
-void Model::Add(Model* value)
+void Model::Add(Model* value, bool share)
 {
 	if (value != nullptr)
 	{
@@ -2866,9 +3494,109 @@ void Model::Add(Model* value)
 		armatures.insert(armatures.begin(), value->armatures.begin(), value->armatures.end());
 		decals.insert(decals.begin(), value->decals.begin(), value->decals.end());
 		lights.insert(lights.begin(), value->lights.begin(), value->lights.end());
-		meshes.insert(value->meshes.begin(), value->meshes.end());
+		if (!share)
+		{
+			meshes.insert(value->meshes.begin(), value->meshes.end());
+		}
+		else
+		{
+			lock_guard<mutex> lock(sharedMeshesLock);
+			for (auto& x : value->meshes)
+			{
+				if (meshes.insert(x).second && x.second->refCount > 0)
+				{
+					x.second->refCount++;
+				}
+			}
+		}
 		materials.insert(value->materials.begin(), value->materials.end());
 		forces.insert(forces.begin(), value->forces.begin(), value->forces.end());
+
+		if (share)
+		{
+			DeduplicateMeshes();
+		}
+	}
+}
+void Model::DeduplicateMeshes()
+{
+	// Meshes that are not shared yet:
+	vector<Mesh*> candidates;
+	{
+		lock_guard<mutex> lock(sharedMeshesLock);
+		for (auto& x : meshes)
+		{
+			if (x.second->refCount == 0 && x.second->IsShareable() && find(candidates.begin(), candidates.end(), x.second) == candidates.end())
+			{
+				candidates.push_back(x.second);
+			}
+		}
+	}
+	if (candidates.empty())
+	{
+		return;
+	}
+
+	vector<uint64_t> hashes(candidates.size());
+	wiJobSystem::Counter counter;
+	wiJobSystem::Dispatch(counter, (uint32_t)candidates.size(), 1, [&](uint32_t i) {
+		hashes[i] = candidates[i]->GetGeometryHash();
+	});
+	wiJobSystem::Wait(counter);
+
+	lock_guard<mutex> lock(sharedMeshesLock);
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		Mesh* mesh = candidates[i];
+		sharingStats.loadedMeshes++;
+
+		Mesh* shared = nullptr;
+		auto range = sharedMeshes.equal_range(hashes[i]);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second->IsIdentical(*mesh))
+			{
+				shared = it->second;
+				break;
+			}
+		}
+
+		// Objects refer to meshes by name, so the shared mesh is stored by its own name. It can't be shared if that name is taken:
+		MeshCollection::iterator found = shared == nullptr ? meshes.end() : meshes.find(shared->name);
+		if (shared == nullptr || (found != meshes.end() && found->second != shared))
+		{
+			sharedMeshes.insert(make_pair(hashes[i], mesh));
+			mesh->refCount = 1;
+			continue;
+		}
+
+		for (auto it = meshes.begin(); it != meshes.end();)
+		{
+			if (it->second == mesh)
+			{
+				it = meshes.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		if (meshes.insert(pair<string, Mesh*>(shared->name, shared)).second)
+		{
+			shared->refCount++;
+		}
+		for (Object* x : objects)
+		{
+			if (x->mesh == mesh)
+			{
+				x->mesh = shared;
+				x->meshfile = shared->name;
+			}
+		}
+
+		sharingStats.removedMeshes++;
+		sharingStats.savedBytes += mesh->GetMemorySize();
+		SAFE_DELETE(mesh);
 	}
 }
 void Model::Serialize(wiArchive& archive)
@@ -2879,63 +3607,115 @@ void Model::Serialize(wiArchive& archive)
 	{
 		size_t objectsCount, meshCount, materialCount, armaturesCount, lightsCount, decalsCount, forceCount;
 
-		archive >> objectsCount;
+		// Every element reads at least its name, so a corrupted count can't be larger than what the section has left:
+		auto readCount = [&archive](size_t& count) {
+			archive >> count;
+			if (!archive.CheckReadCount((uint64_t)count, sizeof(uint64_t)))
+			{
+				count = 0;
+			}
+		};
+
+		archive.BeginSection("objects");
+		readCount(objectsCount);
 		for (size_t i = 0; i < objectsCount; ++i)
 		{
 			Object* x = new Object;
 			x->Serialize(archive);
 			objects.push_back(x);
 		}
+		archive.EndSection();
 
-		archive >> meshCount;
-		for (size_t i = 0; i < meshCount; ++i)
+		archive.BeginSection("meshes");
+		readCount(meshCount);
+		if (archive.HasSections())
 		{
-			Mesh* x = new Mesh;
-			x->Serialize(archive);
-			meshes.insert(pair<string, Mesh*>(x->name, x));
+			// Every mesh is in its own section, so they are deserialized in parallel:
+			vector<Mesh*> loadedMeshes(meshCount);
+			vector<wiArchive*> readers(meshCount);
+			for (size_t i = 0; i < meshCount; ++i)
+			{
+				loadedMeshes[i] = new Mesh;
+				readers[i] = new wiArchive("", true);
+				archive.ReadSection(*readers[i]);
+			}
+			wiJobSystem::Counter counter;
+			wiJobSystem::Dispatch(counter, (uint32_t)meshCount, 1, [&](uint32_t i) {
+				loadedMeshes[i]->Serialize(*readers[i]);
+			});
+			wiJobSystem::Wait(counter);
+			for (size_t i = 0; i < meshCount; ++i)
+			{
+				meshes.insert(pair<string, Mesh*>(loadedMeshes[i]->name, loadedMeshes[i]));
+				if (readers[i]->IsFailed())
+				{
+					archive.SetFailed();
+				}
+				SAFE_DELETE(readers[i]);
+			}
 		}
+		else
+		{
+			for (size_t i = 0; i < meshCount; ++i)
+			{
+				Mesh* x = new Mesh;
+				x->Serialize(archive);
+				meshes.insert(pair<string, Mesh*>(x->name, x));
+			}
+		}
+		archive.EndSection();
 
-		archive >> materialCount;
+		archive.BeginSection("materials");
+		readCount(materialCount);
 		for (size_t i = 0; i < materialCount; ++i)
 		{
 			Material* x = new Material;
 			x->Serialize(archive);
 			materials.insert(pair<string, Material*>(x->name, x));
 		}
+		archive.EndSection();
 
-		archive >> armaturesCount;
+		archive.BeginSection("armatures");
+		readCount(armaturesCount);
 		for (size_t i = 0; i < armaturesCount; ++i)
 		{
 			Armature* x = new Armature;
 			x->Serialize(archive);
 			armatures.push_back(x);
 		}
+		archive.EndSection();
 
-		archive >> lightsCount;
+		archive.BeginSection("lights");
+		readCount(lightsCount);
 		for (size_t i = 0; i < lightsCount; ++i)
 		{
 			Light* x = new Light;
 			x->Serialize(archive);
 			lights.push_back(x);
 		}
+		archive.EndSection();
 
-		archive >> decalsCount;
+		archive.BeginSection("decals");
+		readCount(decalsCount);
 		for (size_t i = 0; i < decalsCount; ++i)
 		{
 			Decal* x = new Decal;
 			x->Serialize(archive);
 			decals.push_back(x);
 		}
+		archive.EndSection();
 
 		if (archive.GetVersion() >= 10)
 		{
-			archive >> forceCount;
+			archive.BeginSection("forces");
+			readCount(forceCount);
 			for (size_t i = 0; i < forceCount; ++i)
 			{
 				ForceField* x = new ForceField;
 				x->Serialize(archive);
 				forces.push_back(x);
 			}
+			archive.EndSection();
 		}
 
 		// RESOLVE CONNECTIONS
@@ -3005,49 +3785,65 @@ void Model::Serialize(wiArchive& archive)
 	}
 	else
 	{
+		archive.BeginSection("objects");
 		archive << objects.size();
 		for (auto& x : objects)
 		{
 			x->Serialize(archive);
 		}
+		archive.EndSection();
 
+		archive.BeginSection("meshes");
 		archive << meshes.size();
 		for (auto& x : meshes)
 		{
+			archive.BeginSection("mesh");
 			x.second->Serialize(archive);
+			archive.EndSection();
 		}
+		archive.EndSection();
 
+		archive.BeginSection("materials");
 		archive << materials.size();
 		for (auto& x : materials)
 		{
 			x.second->Serialize(archive);
 		}
+		archive.EndSection();
 
+		archive.BeginSection("armatures");
 		archive << armatures.size();
 		for (auto& x : armatures)
 		{
 			x->Serialize(archive);
 		}
+		archive.EndSection();
 
+		archive.BeginSection("lights");
 		archive << lights.size();
 		for (auto& x : lights)
 		{
 			x->Serialize(archive);
 		}
+		archive.EndSection();
 
+		archive.BeginSection("decals");
 		archive << decals.size();
 		for (auto& x : decals)
 		{
 			x->Serialize(archive);
 		}
+		archive.EndSection();
 
 		if (archive.GetVersion() >= 10)
 		{
+			archive.BeginSection("forces");
 			archive << forces.size();
 			for (auto& x : forces)
 			{
 				x->Serialize(archive);
 			}
+			archive.EndSection();
 		}
 	}
 }
@@ -3729,6 +4525,10 @@ Decal::Decal(const XMFLOAT3& tra, const XMFLOAT3& sca, const XMFLOAT4& rot, cons
 
 	color = XMFLOAT4(1, 1, 1, 1);
 	emissive = 0;
+
+	// a zero matrix is never a valid world matrix, so the first query computes the inverse:
+	ZeroMemory(&inverseWorldSource, sizeof(inverseWorldSource));
+	ZeroMemory(&inverseWorldTransposed, sizeof(inverseWorldTransposed));
 }
 Decal::~Decal() {
 	wiResourceManager::GetGlobal()->del(texName);
@@ -3768,6 +4568,15 @@ float Decal::GetOpacity() const
 {
 	return color.w * wiMath::Clamp((life <= -2 ? 1 : life < fadeStart ? life / fadeStart : 1), 0, 1);
 }
+const XMFLOAT4X4& Decal::GetInverseWorldTransposed()
+{
+	if (memcmp(&inverseWorldSource, &world, sizeof(XMFLOAT4X4)) != 0)
+	{
+		inverseWorldSource = world;
+		XMStoreFloat4x4(&inverseWorldTransposed, XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&world))));
+	}
+	return inverseWorldTransposed;
+}
 void Decal::Serialize(wiArchive& archive)
 {
 	Cullable::Serialize(archive);
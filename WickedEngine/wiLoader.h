@@ -46,10 +46,16 @@ GFX_STRUCT Instance
 	}
 	inline void Create(const XMFLOAT4X4& matIn, float dither = 0.0f, const XMFLOAT3& color = XMFLOAT3(1, 1, 1))
 	{
-		mat0 = XMFLOAT4A(matIn._11, matIn._21, matIn._31, matIn._41);
-		mat1 = XMFLOAT4A(matIn._12, matIn._22, matIn._32, matIn._42);
-		mat2 = XMFLOAT4A(matIn._13, matIn._23, matIn._33, matIn._43);
-		color_dither = XMFLOAT4A(color.x, color.y, color.z, dither);
+		Create(XMLoadFloat4x4(&matIn), dither, color);
+	}
+	// Transposes with SIMD shuffles and stores with unaligned stores, so it can write into mapped GPU memory at any offset
+	inline void Create(const XMMATRIX& matIn, float dither = 0.0f, const XMFLOAT3& color = XMFLOAT3(1, 1, 1))
+	{
+		XMMATRIX mat = XMMatrixTranspose(matIn);
+		XMStoreFloat4(&mat0, mat.r[0]);
+		XMStoreFloat4(&mat1, mat.r[1]);
+		XMStoreFloat4(&mat2, mat.r[2]);
+		XMStoreFloat4(&color_dither, XMVectorSet(color.x, color.y, color.z, dither));
 	}
 
 	ALIGN_16
@@ -67,29 +73,22 @@ GFX_STRUCT InstancePrev
 	}
 	inline void Create(const XMFLOAT4X4& matIn)
 	{
-		mat0 = XMFLOAT4A(matIn._11, matIn._21, matIn._31, matIn._41);
-		mat1 = XMFLOAT4A(matIn._12, matIn._22, matIn._32, matIn._42);
-		mat2 = XMFLOAT4A(matIn._13, matIn._23, matIn._33, matIn._43);
+		Create(XMLoadFloat4x4(&matIn));
+	}
+	inline void Create(const XMMATRIX& matIn)
+	{
+		XMMATRIX mat = XMMatrixTranspose(matIn);
+		XMStoreFloat4(&mat0, mat.r[0]);
+		XMStoreFloat4(&mat1, mat.r[1]);
+		XMStoreFloat4(&mat2, mat.r[2]);
 	}
 
 	ALIGN_16
 };
 CBUFFER(MaterialCB, CBSLOT_RENDERER_MATERIAL)
 {
-	XMFLOAT4 baseColor; // + alpha (.w)
-	XMFLOAT4 texMulAdd;
-	float roughness;
-	float reflectance;
-	float metalness;
-	float emissive;
-	float refractionIndex;
-	float subsurfaceScattering;
-	float normalMapStrength;
-	float parallaxOcclusionMapping;
-
-	MaterialCB() {};
-	MaterialCB(const Material& mat) { Create(mat); };
-	void Create(const Material& mat);
+	UINT materialIndex; // into the material table of the renderer
+	UINT padding[3];
 };
 struct Material
 {
@@ -113,7 +112,10 @@ struct Material
 	std::string specularMapName;
 	wiGraphicsTypes::Texture2D* specularMap;
 
-	MaterialCB gpuData;
+	// The properties used by the shaders are in the material table of the renderer, the constant buffer only holds the
+	//	index of the entry and never changes. The entry is only written again when the material is marked dirty
+	UINT tableIndex;
+	bool dirty;
 	wiGraphicsTypes::GPUBuffer constantBuffer;
 	static wiGraphicsTypes::GPUBuffer* constantBuffer_Impostor;
 	static void CreateImpostorMaterialCB();
@@ -176,6 +178,12 @@ struct Material
 		return RENDERTYPE_OPAQUE;
 	}
 	void ConvertToPhysicallyBasedMaterial();
+	// Must be called after modifying any of the shader properties, so that the material table is updated
+	void SetDirty();
+	bool IsDirty() const { return dirty; }
+	void CreateShaderMaterial(ShaderMaterial& dest) const;
+	// Does it look the same as the other material? (everything but the name is compared)
+	bool IsEquivalent(const Material& other) const;
 	// User stencil ref could be anything from 0-127, greater will be truncated when using 8 bit stencil buffer!
 	void SetUserStencilRef(uint8_t value)
 	{
@@ -235,9 +243,20 @@ struct VertexGroup{
 struct MeshSubset
 {
 	Material* material;
-	UINT indexBufferOffset;
 
-	std::vector<uint32_t> subsetIndices;
+	// The triangles of the subset are a continuous range of Mesh::indices (and the index buffer):
+	UINT indexOffset;
+	UINT indexCount;
+
+	// Parts of the index range that are drawn with one call. The GPU indices are relative to the base vertex,
+	//	so a range addresses at most 65536 vertices with 16-bit indices:
+	struct DrawRange
+	{
+		UINT indexOffset;
+		UINT indexCount;
+		UINT baseVertex;
+	};
+	std::vector<DrawRange> drawRanges;
 
 	MeshSubset();
 	~MeshSubset();
@@ -410,7 +429,8 @@ public:
 	wiGraphicsTypes::GPUBuffer	streamoutBuffer_NOR;
 	wiGraphicsTypes::GPUBuffer	streamoutBuffer_PRE;
 
-	// Dynamic vertexbuffers write into a global pool, these will be the offsets into that:
+	// Dynamic vertexbuffers write into the upload allocator of the renderer, these will be the page and the offsets into that:
+	wiGraphicsTypes::GPUBuffer* dynamicVertexBuffer;
 	UINT bufferOffset_POS;
 	UINT bufferOffset_NOR;
 	UINT bufferOffset_PRE;
@@ -418,6 +438,8 @@ public:
 	wiGraphicsTypes::INDEXBUFFER_FORMAT indexFormat;
 
 	bool renderable,doubleSided;
+	// Some vertices have wind weights, so the wind animates the mesh in the shaders (set when the vertices are loaded)
+	bool windAffected;
 
 	bool calculatedAO;
 
@@ -448,6 +470,9 @@ public:
 
 	bool optimized;
 
+	// Number of models holding this mesh while it is shared (0 means that the mesh is not shared)
+	uint32_t refCount;
+
 	Mesh(){
 		init();
 	}
@@ -465,12 +490,22 @@ public:
 	static void CreateImpostorVB();
 	bool arraysComplete;
 	void CreateVertexArrays();
+	// Sets windAffected from the vertices
+	void UpdateWindAffected();
+	// Maps the render vertices to the physics vertices (needs the vertex arrays, doesn't need the GPU)
+	void CreatePhysicalMapping();
+	// Splits the subsets into draw ranges that can use 16-bit indices. If that would need too many draw calls,
+	//	or allowSplit is false, every subset is one range with 32-bit indices instead (if the mesh has more than 65536 vertices)
+	void CreateDrawRanges(bool allowSplit = true);
+	// Are there draw ranges with base vertex offsets? (then the GPU indices are relative)
+	bool HasSplitDrawRanges() const;
 	void init()
 	{
 		parent="";
 		indices.resize(0);
 		renderable=false;
 		doubleSided=false;
+		windAffected=false;
 		aabb=AABB();
 		trailInfo=RibbonTrail();
 		armature=nullptr;
@@ -491,10 +526,12 @@ public:
 		impostorDistance = 100.0f;
 		tessellationFactor = 0.0f;
 		optimized = false;
+		dynamicVertexBuffer = nullptr;
 		bufferOffset_POS = 0;
 		bufferOffset_NOR = 0;
 		bufferOffset_PRE = 0;
 		indexFormat = wiGraphicsTypes::INDEXFORMAT_16BIT;
+		refCount = 0;
 	}
 	
 	bool hasArmature() const { return armature != nullptr; }
@@ -502,6 +539,32 @@ public:
 	bool hasDynamicVB() const { return softBody; }
 	float getTessellationFactor() { return tessellationFactor; }
 	wiGraphicsTypes::INDEXBUFFER_FORMAT GetIndexFormat() const { return indexFormat; }
+	// CPU and GPU memory of the vertex and index data in bytes
+	size_t GetMemorySize() const;
+	// Frees the vertex and index data and GPU buffers (used by streaming)
+	void ReleasePayload();
+	// Exchanges the vertex and index data with an other instance of the same mesh (used by streaming)
+	void SwapPayload(Mesh& other);
+
+	// Skinned and soft body meshes are deformed per object, so they can't be shared
+	bool IsShareable() const;
+	// Hash of the vertices, indices and render properties for finding identical meshes
+	uint64_t GetGeometryHash() const;
+	// Is the geometry equal and are the materials equivalent?
+	bool IsIdentical(const Mesh& other) const;
+
+	struct SharingStats
+	{
+		uint32_t loadedMeshes;	// shareable meshes that went through deduplication
+		uint32_t removedMeshes;	// meshes that were replaced by an identical shared mesh
+		size_t savedBytes;		// vertex and index memory of the removed meshes
+
+		SharingStats() :loadedMeshes(0), removedMeshes(0), savedBytes(0) {}
+		float GetDeduplicationRatio() const { return loadedMeshes > 0 ? (float)removedMeshes / (float)loadedMeshes : 0.0f; }
+	};
+	static SharingStats GetSharingStats();
+	// Write the indices with wiIndexCodec in Serialize() (default: off)
+	static void SetIndexCompressionEnabled(bool value);
 	void Serialize(wiArchive& archive);
 };
 struct Cullable
@@ -929,7 +992,13 @@ struct Decal : public Cullable, public Transform
 	virtual void UpdateTransform();
 	void UpdateDecal();
 	float GetOpacity() const;
+	// The transposed inverse world matrix used by the shaders to project the decal, only computed again when the world matrix changed
+	const XMFLOAT4X4& GetInverseWorldTransposed();
 	void Serialize(wiArchive& archive);
+
+private:
+	XMFLOAT4X4 inverseWorldTransposed;
+	XMFLOAT4X4 inverseWorldSource;	// the world matrix that inverseWorldTransposed was computed from
 };
 struct WorldInfo{
 	XMFLOAT3 horizon;
@@ -1199,16 +1268,23 @@ struct Model : public Transform
 	Model();
 	virtual ~Model();
 	void CleanUp();
-	void LoadFromDisk(const std::string& dir, const std::string& name, const std::string& identifier);
+	// The cooked .wimf archive is loaded if it exists, unless legacy is true: then the legacy files are loaded (for cooking them)
+	void LoadFromDisk(const std::string& dir, const std::string& name, const std::string& identifier, bool legacy = false);
 	void FinishLoading();
+	// Prepare the model for offline serialization (vertex arrays, optimization, bounds)
+	void Cook();
 	void UpdateModel();
-	void Add(Object* value);
+	// Without share, the mesh is only referenced like in the merge below
+	void Add(Object* value, bool share = true);
 	void Add(Armature* value);
 	void Add(Light* value);
 	void Add(Decal* value);
 	void Add(ForceField* value);
-	// merge
-	void Add(Model* value);
+	// merge. Without share, the meshes are only referenced: their refCounts are untouched and they are not deduplicated,
+	//	for temporary models that are cleared instead of cleaned up (e.g. for saving the scene)
+	void Add(Model* value, bool share = true);
+	// Replaces the meshes with identical meshes that other models already loaded, so the copies can be instanced together
+	void DeduplicateMeshes();
 	void Serialize(wiArchive& archive);
 };
 
@@ -1619,6 +1619,7 @@ int Material_BindLua::SetAlpha(lua_State* L)
 	if (argc > 0)
 	{
 		material->alpha = wiLua::SGetFloat(L, 1);
+		material->SetDirty();
 	}
 	else
 		wiLua::SError(L, "SetTransparency(float alpha) not enough arguments!");
@@ -1635,6 +1636,7 @@ int Material_BindLua::SetRefractionIndex(lua_State* L)
 	if (argc > 0)
 	{
 		material->refractionIndex = wiLua::SGetFloat(L, 1);
+		material->SetDirty();
 	}
 	else
 		wiLua::SError(L, "SetRefractionIndex(float alpha) not enough arguments!");
@@ -155,6 +155,15 @@ void wiProfiler::DrawData(int x, int y, GRAPHICSTHREAD threadID)
 		ss << endl;
 	}
 
+	if (!counters.empty())
+	{
+		ss << "Counters:" << endl << "----------------------------" << endl;
+		for (auto& x : counters)
+		{
+			ss << x.first << ": " << fixed << x.second << endl;
+		}
+	}
+
 	wiFont(ss.str(), wiFontProps(x, y, -1, WIFALIGN_LEFT, WIFALIGN_TOP, 2, 1, wiColor(255,255,255,255), wiColor(0,0,0,255))).Draw(threadID);
 }
 
@@ -39,6 +39,10 @@ public:
 	float GetRangeTime(const std::string& name) { return ranges[name]->time; }
 	const std::unordered_map<std::string, Range*>& GetRanges() { return ranges; }
 
+	// Counters are arbitrary values published by the subsystems (resource memory, cache hits...), they are displayed after the ranges
+	void SetCounter(const std::string& name, double value) { counters[name] = value; }
+	const std::unordered_map<std::string, double>& GetCounters() { return counters; }
+
 	// Renders a basic text of the Profiling results to the (x,y) screen coordinate
 	void DrawData(int x, int y, GRAPHICSTHREAD threadID);
 
@@ -49,6 +53,7 @@ private:
 	~wiProfiler();
 
 	std::unordered_map<std::string, Range*> ranges;
+	std::unordered_map<std::string, double> counters;
 	std::stack<std::string> rangeStack;
 	wiGraphicsTypes::GPUQuery disjoint;
 };
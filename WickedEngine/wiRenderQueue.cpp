@@ -0,0 +1,62 @@
+#include "wiRenderQueue.h"
+
+using namespace std;
+
+void wiRenderQueue::Sort()
+{
+	const size_t count = packets.size();
+	if (count < 2)
+	{
+		return;
+	}
+	sortBuffer.resize(count);
+
+	// Histogram every byte of the key in one pass over the packets:
+	uint32_t histograms[8][256] = {};
+	for (const auto& packet : packets)
+	{
+		for (int byte = 0; byte < 8; ++byte)
+		{
+			histograms[byte][(packet.key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		uint32_t* histogram = histograms[byte];
+
+		// Every key has the same value in this byte, the pass wouldn't change the order:
+		if (histogram[(packets[0].key >> (byte * 8)) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			uint32_t bucket = histogram[i];
+			histogram[i] = offset;
+			offset += bucket;
+		}
+
+		for (const auto& packet : packets)
+		{
+			sortBuffer[histogram[(packet.key >> (byte * 8)) & 0xFF]++] = packet;
+		}
+		packets.swap(sortBuffer);
+	}
+}
+
+uint64_t wiRenderQueue::QuantizeDistance(float distance, float maxDistance, int bits)
+{
+	const uint64_t maxValue = (1ull << bits) - 1;
+	if (distance <= 0 || maxDistance <= 0)
+	{
+		return 0;
+	}
+	if (distance >= maxDistance)
+	{
+		return maxValue;
+	}
+	return (uint64_t)(distance / maxDistance * (float)maxValue);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <vector>
+
+// A draw of a mesh subset, the key decides the submission order
+struct wiRenderPacket
+{
+	uint64_t key;
+	uint32_t batch;		// index of the instanced mesh batch
+	uint16_t subset;	// subset of the mesh
+	uint16_t pipeline;	// index of the pipeline state combination
+};
+
+// Collects draw packets and sorts them by their 64-bit key, so that the draws that share their state are submitted
+//	together and the state only has to be bound when it changes between two neighbours.
+class wiRenderQueue
+{
+private:
+	std::vector<wiRenderPacket> packets;
+	std::vector<wiRenderPacket> sortBuffer;
+public:
+	void Clear() { packets.clear(); }
+	void Add(const wiRenderPacket& packet) { packets.push_back(packet); }
+	bool IsEmpty() const { return packets.empty(); }
+	size_t GetCount() const { return packets.size(); }
+
+	// Stable LSD radix sort by the key, one byte per pass. Passes are skipped for the bytes that are the same in every key,
+	//	so keys that only use a few of their bits are sorted in a few passes.
+	void Sort();
+
+	std::vector<wiRenderPacket>& GetPackets() { return packets; }
+	const std::vector<wiRenderPacket>& GetPackets() const { return packets; }
+
+	// Quantizes a distance to the given number of bits, in the [0, maxDistance] range
+	static uint64_t QuantizeDistance(float distance, float maxDistance, int bits);
+};
+
@@ -20,12 +20,20 @@
 #include "wiRandom.h"
 #include "wiFont.h"
 #include "wiGraphicsDevice_DX11.h"
+#include "wiGraphicsDevice_Null.h"
 #include "wiTranslator.h"
 #include "wiRectPacker.h"
 #include "wiBackLog.h"
 #include "wiProfiler.h"
+#include "wiStreaming.h"
+#include "wiJobSystem.h"
+#include "wiShaderCache.h"
+#include "wiTimer.h"
 
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <DirectXCollision.h>
 
@@ -50,7 +58,7 @@ GPUBuffer			*wiRenderer::resourceBuffers[RBTYPE_LAST];
 Texture				*wiRenderer::textures[TEXTYPE_LAST];
 Sampler				*wiRenderer::customsamplers[SSTYPE_LAST];
 
-GPURingBuffer		*wiRenderer::dynamicVertexBufferPool;
+wiUploadAllocator	wiRenderer::uploadAllocator;
 
 float wiRenderer::GAMMA = 2.2f;
 int wiRenderer::SHADOWRES_2D = 1024, wiRenderer::SHADOWRES_CUBE = 256, wiRenderer::SHADOWCOUNT_2D = 5 + 3 + 3, wiRenderer::SHADOWCOUNT_CUBE = 5, wiRenderer::SOFTSHADOWQUALITY_2D = 2;
@@ -63,18 +71,21 @@ float wiRenderer::renderTime = 0, wiRenderer::renderTime_Prev = 0, wiRenderer::d
 XMFLOAT2 wiRenderer::temporalAAJitter = XMFLOAT2(0, 0), wiRenderer::temporalAAJitterPrev = XMFLOAT2(0, 0);
 float wiRenderer::RESOLUTIONSCALE = 1.0f;
 GPUQuery wiRenderer::occlusionQueries[];
-UINT wiRenderer::entityArrayOffset_ForceFields = 0, wiRenderer::entityArrayCount_ForceFields = 0;
 
 Texture2D* wiRenderer::enviroMap,*wiRenderer::colorGrading;
 float wiRenderer::GameSpeed=1,wiRenderer::overrideGameSpeed=1;
 bool wiRenderer::debugLightCulling = false;
 bool wiRenderer::occlusionCulling = false;
+bool wiRenderer::renderQueueSorting = true;
+bool wiRenderer::parallelRecording = true;
+bool wiRenderer::shadowMapSkipping = true;
+bool wiRenderer::meshStreaming = true;
 bool wiRenderer::temporalAA = false, wiRenderer::temporalAADEBUG = false;
 EnvironmentProbe* wiRenderer::globalEnvProbes[] = { nullptr,nullptr };
 wiRenderer::VoxelizedSceneData wiRenderer::voxelSceneData = VoxelizedSceneData();
 int wiRenderer::visibleCount;
 wiRenderTarget wiRenderer::normalMapRT, wiRenderer::imagesRT, wiRenderer::imagesRTAdd;
-Camera *wiRenderer::cam = nullptr, *wiRenderer::refCam = nullptr, *wiRenderer::prevFrameCam = nullptr;
+Camera *wiRenderer::cam = nullptr, *wiRenderer::refCam = nullptr;
 PHYSICS* wiRenderer::physicsEngine = nullptr;
 
 string wiRenderer::SHADERPATH = "shaders/";
@@ -102,6 +113,24 @@ std::vector<wiTranslator*> wiRenderer::renderableTranslators;
 std::vector<pair<XMFLOAT4X4, XMFLOAT4>> wiRenderer::renderableBoxes;
 
 std::unordered_map<Camera*, wiRenderer::FrameCulling> wiRenderer::frameCullings;
+wiRenderer::RenderQueueContext wiRenderer::renderQueueContexts[GRAPHICSTHREAD_COUNT];
+std::unordered_map<size_t, wiRenderer::ShadowView> wiRenderer::shadowViews;
+std::atomic<uint64_t> wiRenderer::sceneEpoch(0);
+std::vector<Object*> wiRenderer::dynamicObjects;
+wiRenderer::ShadowCullingStats wiRenderer::shadowCullingStats;
+wiRenderer::MaterialTable wiRenderer::materialTable;
+wiRenderer::MaterialTableStats wiRenderer::materialTableStats;
+wiRenderer::EntityArrayContext wiRenderer::entityArrayContext;
+wiRenderer::FramePacket wiRenderer::framePackets[2];
+UINT wiRenderer::framePacketIndex = 0;
+std::vector<wiRenderer::ShaderRequest*> wiRenderer::shaderRequests;
+wiRenderer::ShaderRequest* wiRenderer::pixelShaderPermutations[PSTYPE_LAST] = {};
+PSTYPES wiRenderer::pixelShaderFallbacks[PSTYPE_LAST];
+bool wiRenderer::lazyShaderPermutations = true;
+wiRenderer::ShaderLoadingStats wiRenderer::shaderLoadingStats;
+std::atomic<UINT> wiRenderer::pendingShaders(0);
+double wiRenderer::shaderLoadingStart = 0;
+bool wiRenderer::shaderStartupPending = false;
 
 wiWaterPlane wiRenderer::waterPlane;
 
@@ -117,6 +146,11 @@ void wiRenderer::InitDevice(wiWindowRegistration::window_type window, bool fulls
 	SAFE_DELETE(graphicsDevice);
 	graphicsDevice = new GraphicsDevice_DX11(window, fullscreen);
 }
+void wiRenderer::InitNullDevice(int width, int height)
+{
+	SAFE_DELETE(graphicsDevice);
+	graphicsDevice = new GraphicsDevice_Null(width, height);
+}
 
 void wiRenderer::Present(function<void()> drawToScreen1,function<void()> drawToScreen2,function<void()> drawToScreen3)
 {
@@ -133,7 +167,8 @@ void wiRenderer::Present(function<void()> drawToScreen1,function<void()> drawToS
 
 	OcclusionCulling_Read();
 
-	*prevFrameCam = *cam;
+	// The shaders that finished loading are used from the next frame:
+	UpdateShaders();
 
 	wiFrameRate::Frame();
 
@@ -212,7 +247,13 @@ void wiRenderer::SetUpStaticComponents()
 	cam->SetUp((float)GetInternalResolution().x, (float)GetInternalResolution().y, 0.1f, 800);
 	refCam = new Camera();
 	refCam->SetUp((float)GetInternalResolution().x, (float)GetInternalResolution().y, 0.1f, 800);
-	prevFrameCam = new Camera;
+	for (auto& packet : framePackets)
+	{
+		packet.camera = new Camera;
+		packet.reflectionCamera = new Camera;
+		packet.entityArray = (ShaderEntityType*)_mm_malloc(sizeof(ShaderEntityType)*MAX_SHADER_ENTITY_COUNT, 16);
+		packet.matrixArray = (XMMATRIX*)_mm_malloc(sizeof(XMMATRIX)*MATRIXARRAY_COUNT, 16);
+	}
 	
 
 	wireRender=false;
@@ -224,6 +265,11 @@ void wiRenderer::SetUpStaticComponents()
 	wiHairParticle::SetUpStatic();
 	wiEmittedParticle::SetUpStatic();
 
+	if (meshStreaming)
+	{
+		wiStreaming::Initialize();
+	}
+
 	GameSpeed=1;
 
 	resetVertexCount();
@@ -260,11 +306,25 @@ void wiRenderer::SetUpStaticComponents()
 	SetShadowPropsCube(SHADOWRES_CUBE, SHADOWCOUNT_CUBE);
 
 	Material::CreateImpostorMaterialCB();
+
+	// The shaders were loading while the rest was set up. The first frame needs them, only the permutations stay lazy:
+	WaitForShaders();
 }
 void wiRenderer::CleanUpStatic()
 {
+	WaitForShaders();
+	for (ShaderRequest* request : shaderRequests)
+	{
+		delete request;
+	}
+	shaderRequests.clear();
+	for (int i = 0; i < PSTYPE_LAST; ++i)
+	{
+		pixelShaderPermutations[i] = nullptr;
+	}
 
 
+	wiStreaming::CleanUp();
 	wiHairParticle::CleanUpStatic();
 	wiEmittedParticle::CleanUpStatic();
 	Cube::CleanUpStatic();
@@ -332,8 +392,18 @@ void wiRenderer::CleanUpStatic()
 		SAFE_DELETE(customsamplers[i]);
 	}
 
-	SAFE_DELETE(dynamicVertexBufferPool);
+	uploadAllocator.Release();
 
+	for (auto& packet : framePackets)
+	{
+		SAFE_DELETE(packet.camera);
+		SAFE_DELETE(packet.reflectionCamera);
+		_mm_free(packet.entityArray);
+		_mm_free(packet.matrixArray);
+		packet = FramePacket();
+	}
+
+	EndPhysicsStep();
 	if (physicsEngine) physicsEngine->CleanUp();
 
 	SAFE_DELETE(graphicsDevice);
@@ -341,7 +411,8 @@ void wiRenderer::CleanUpStatic()
 void wiRenderer::ClearWorld()
 {
 	emitterSystems.clear();
-	
+
+	EndPhysicsStep();
 	if (physicsEngine)
 		physicsEngine->ClearWorld();
 
@@ -360,6 +431,10 @@ void wiRenderer::ClearWorld()
 	SAFE_DELETE(spTree);
 	SAFE_DELETE(spTree_lights);
 
+	shadowViews.clear();
+	dynamicObjects.clear();
+	sceneEpoch++;
+
 	for (auto& x : frameCullings)
 	{
 		FrameCulling& culling = x.second;
@@ -557,14 +632,8 @@ void wiRenderer::LoadBuffers()
 {
 	GPUBufferDesc bd;
 
-	// Ring buffer allows fast allocation of dynamic buffers for one frame:
-	dynamicVertexBufferPool = new GPURingBuffer;
-	bd.BindFlags = BIND_VERTEX_BUFFER;
-	bd.ByteWidth = 1024 * 1024 * 64;
-	bd.Usage = USAGE_DYNAMIC;
-	bd.CPUAccessFlags = CPU_ACCESS_WRITE;
-	bd.MiscFlags = 0;
-	GetDevice()->CreateBuffer(&bd, nullptr, dynamicVertexBufferPool);
+	// Pages of dynamic vertex buffers for the data that is written every frame:
+	uploadAllocator.Initialize(GetDevice(), BIND_VERTEX_BUFFER);
 
 
 	for (int i = 0; i < CBTYPE_LAST; ++i)
@@ -644,21 +713,212 @@ void wiRenderer::LoadBuffers()
 	GetDevice()->CreateBuffer(&bd, nullptr, resourceBuffers[RBTYPE_MATRIXARRAY]);
 
 	SAFE_DELETE(resourceBuffers[RBTYPE_VOXELSCENE]); // lazy init on request
+	SAFE_DELETE(resourceBuffers[RBTYPE_MATERIALARRAY]); // created by the first ExtractMaterialTable(), then grows with the table
+	materialTable.gpuCapacity = 0;
+}
+
+void wiRenderer::StartShaderRequest(ShaderRequest* request)
+{
+	int expected = ShaderRequest::IDLE;
+	if (!request->state.compare_exchange_strong(expected, ShaderRequest::STARTING))
+	{
+		return;
+	}
+	pendingShaders++;
+	request->loading = wiResourceManager::GetShaderManager()->addAsync(request->name, request->type,
+		request->vertexLayout.empty() ? nullptr : request->vertexLayout.data(), (UINT)request->vertexLayout.size());
+	request->state.store(ShaderRequest::LOADING);
+}
+// Adds a shader to the tables, a lazy one is only loaded when StartShaderRequest() is called for it:
+static wiRenderer::ShaderRequest* AddShaderRequest(const string& name, wiResourceManager::Data_Type type, const function<void(void*)>& store,
+	bool lazy = false, const VertexLayoutDesc* vertexLayout = nullptr, UINT elementCount = 0)
+{
+	wiRenderer::ShaderRequest* request = new wiRenderer::ShaderRequest;
+	request->name = name;
+	request->type = type;
+	if (vertexLayout != nullptr && elementCount > 0)
+	{
+		request->vertexLayout.assign(vertexLayout, vertexLayout + elementCount);
+	}
+	request->store = store;
+	request->lazy = lazy;
+	wiRenderer::shaderRequests.push_back(request);
+	if (!lazy)
+	{
+		wiRenderer::StartShaderRequest(request);
+	}
+	return request;
+}
+template<typename T>
+static void LoadShader(T*& slot, const string& name, wiResourceManager::Data_Type type)
+{
+	slot = nullptr;
+	T** target = &slot;
+	AddShaderRequest(name, type, [target](void* data) {
+		*target = static_cast<T*>(data);
+	});
+}
+static void LoadVertexShader(VSTYPES vs, const string& name, VLTYPES vl = VLTYPE_LAST, const VertexLayoutDesc* layout = nullptr, UINT elementCount = 0)
+{
+	wiRenderer::vertexShaders[vs] = nullptr;
+	if (vl != VLTYPE_LAST)
+	{
+		wiRenderer::vertexLayouts[vl] = nullptr;
+	}
+	AddShaderRequest(name, wiResourceManager::VERTEXSHADER, [vs, vl](void* data) {
+		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(data);
+		if (vsinfo != nullptr)
+		{
+			wiRenderer::vertexShaders[vs] = vsinfo->vertexShader;
+			if (vl != VLTYPE_LAST)
+			{
+				wiRenderer::vertexLayouts[vl] = vsinfo->vertexLayout;
+			}
+		}
+	}, false, layout, elementCount);
+}
+// An object pixel shader permutation, the fallback is bound in its place until it is loaded:
+static void LoadPixelShaderPermutation(PSTYPES ps, const string& name, PSTYPES fallback)
+{
+	wiRenderer::pixelShaders[ps] = nullptr;
+	wiRenderer::pixelShaderFallbacks[ps] = fallback;
+	wiRenderer::pixelShaderPermutations[ps] = AddShaderRequest(name, wiResourceManager::PIXELSHADER, [ps](void* data) {
+		wiRenderer::pixelShaders[ps] = static_cast<PixelShader*>(data);
+	}, wiRenderer::GetLazyShaderPermutations());
+}
+PixelShader* wiRenderer::GetObjectPixelShader(PSTYPES ps)
+{
+	PixelShader* shader = pixelShaders[ps];
+	if (shader == nullptr && pixelShaderPermutations[ps] != nullptr)
+	{
+		StartShaderRequest(pixelShaderPermutations[ps]);
+		shader = pixelShaders[pixelShaderFallbacks[ps]];
+	}
+	return shader;
+}
+void wiRenderer::UpdateShaders()
+{
+	if (pendingShaders.load() == 0)
+	{
+		return;
+	}
+
+	UINT requested = 0;
+	UINT permutations = 0;
+	UINT pending = 0;
+	UINT startupPending = 0;
+	for (ShaderRequest* request : shaderRequests)
+	{
+		int state = request->state.load();
+		if (state == ShaderRequest::LOADING && request->loading.wait_for(chrono::seconds(0)) == future_status::ready)
+		{
+			void* data = request->loading.get();
+			request->store(data);
+			if (data == nullptr)
+			{
+				shaderLoadingStats.failed++;
+			}
+			state = ShaderRequest::STORED;
+			request->state.store(state);
+			pendingShaders--;
+		}
+		if (state == ShaderRequest::IDLE)
+		{
+			continue;
+		}
+		requested++;
+		if (request->lazy)
+		{
+			permutations++;
+		}
+		if (state != ShaderRequest::STORED)
+		{
+			pending++;
+			if (!request->lazy)
+			{
+				startupPending++;
+			}
+		}
+	}
+	shaderLoadingStats.requested = requested;
+	shaderLoadingStats.permutations = permutations;
+	shaderLoadingStats.pending = pending;
+
+	if (shaderStartupPending && startupPending == 0)
+	{
+		shaderStartupPending = false;
+		shaderLoadingStats.startupTime = (float)(wiTimer::TotalTime() - shaderLoadingStart);
+	}
+
+	// The bytecode that was read from the shader files since the last save is added to the cache file:
+	if (pending == 0)
+	{
+		wiShaderCache::GetGlobal()->Save();
+	}
+}
+void wiRenderer::WaitForShaders(bool allPermutations)
+{
+	if (allPermutations)
+	{
+		for (ShaderRequest* request : shaderRequests)
+		{
+			StartShaderRequest(request);
+		}
+	}
+	if (pendingShaders.load() == 0)
+	{
+		return;
+	}
+
+	// The shaders are loaded by jobs, WaitForLoad() helps with them while it waits. Only the shader loads are waited for,
+	//	not the unrelated jobs of the job system:
+	for (ShaderRequest* request : shaderRequests)
+	{
+		// A render thread could be starting the request, that only takes until the load is queued:
+		while (request->state.load() == ShaderRequest::STARTING)
+		{
+			this_thread::yield();
+		}
+		if (request->state.load() == ShaderRequest::LOADING)
+		{
+			wiResourceManager::WaitForLoad(request->loading);
+		}
+	}
+	UpdateShaders();
 }
 
 void wiRenderer::LoadShaders()
 {
+	// The shaders of an earlier call must not be stored into the tables after this:
+	WaitForShaders();
+	for (ShaderRequest* request : shaderRequests)
+	{
+		delete request;
+	}
+	shaderRequests.clear();
+	for (int i = 0; i < PSTYPE_LAST; ++i)
+	{
+		pixelShaderPermutations[i] = nullptr;
+		pixelShaderFallbacks[i] = (PSTYPES)i;
+	}
+	shaderLoadingStats = ShaderLoadingStats();
+	shaderLoadingStart = wiTimer::TotalTime();
+	shaderStartupPending = true;
+
+	// The bytecode is read through the cache file of the shader directory, so a warm start doesn't open every shader file:
+	const string shaderCacheName = SHADERPATH + "shaders.wicache";
+	if (wiShaderCache::GetGlobal()->GetFileName().compare(shaderCacheName))
+	{
+		wiShaderCache::GetGlobal()->Open(shaderCacheName);
+	}
+
 	{
 		VertexLayoutDesc layout[] =
 		{
 			{ "POSITION",		0, Mesh::Vertex_POS::FORMAT, 0, APPEND_ALIGNED_ELEMENT, INPUT_PER_VERTEX_DATA, 0 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_debug.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_OBJECT_DEBUG] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_OBJECT_DEBUG] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_OBJECT_DEBUG, SHADERPATH + "objectVS_debug.cso", VLTYPE_OBJECT_DEBUG, layout, numElements);
 	}
 	{
 		VertexLayoutDesc layout[] =
@@ -677,11 +937,7 @@ void wiRenderer::LoadShaders()
 			{ "MATIPREV",		2, FORMAT_R32G32B32A32_FLOAT, 5, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_common.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr){
-			vertexShaders[VSTYPE_OBJECT_COMMON] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_OBJECT_ALL] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_OBJECT_COMMON, SHADERPATH + "objectVS_common.cso", VLTYPE_OBJECT_ALL, layout, numElements);
 	}
 	{
 		VertexLayoutDesc layout[] =
@@ -694,11 +950,7 @@ void wiRenderer::LoadShaders()
 			{ "COLOR_DITHER",	0, FORMAT_R32G32B32A32_FLOAT, 1, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_positionstream.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_OBJECT_POSITIONSTREAM] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_OBJECT_POS] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_OBJECT_POSITIONSTREAM, SHADERPATH + "objectVS_positionstream.cso", VLTYPE_OBJECT_POS, layout, numElements);
 	}
 	{
 		VertexLayoutDesc layout[] =
@@ -712,11 +964,7 @@ void wiRenderer::LoadShaders()
 			{ "COLOR_DITHER",	0, FORMAT_R32G32B32A32_FLOAT, 2, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_simple.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr){
-			vertexShaders[VSTYPE_OBJECT_SIMPLE] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_OBJECT_POS_TEX] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_OBJECT_SIMPLE, SHADERPATH + "objectVS_simple.cso", VLTYPE_OBJECT_POS_TEX, layout, numElements);
 	}
 	{
 		VertexLayoutDesc layout[] =
@@ -729,11 +977,7 @@ void wiRenderer::LoadShaders()
 			{ "COLOR_DITHER",	0, FORMAT_R32G32B32A32_FLOAT, 1, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowVS.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_SHADOW] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_SHADOW_POS] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_SHADOW, SHADERPATH + "shadowVS.cso", VLTYPE_SHADOW_POS, layout, numElements);
 	}
 	{
 		VertexLayoutDesc layout[] =
@@ -747,11 +991,7 @@ void wiRenderer::LoadShaders()
 			{ "COLOR_DITHER",	0, FORMAT_R32G32B32A32_FLOAT, 2, APPEND_ALIGNED_ELEMENT, INPUT_PER_INSTANCE_DATA, 1 },
 		};
 		UINT numElements = ARRAYSIZE(layout);
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowVS_alphatest.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_SHADOW_ALPHATEST] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_SHADOW_POS_TEX] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_SHADOW_ALPHATEST, SHADERPATH + "shadowVS_alphatest.cso", VLTYPE_SHADOW_POS_TEX, layout, numElements);
 	}
 
 	{
@@ -762,11 +1002,7 @@ void wiRenderer::LoadShaders()
 		};
 		UINT numElements = ARRAYSIZE(layout);
 
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "linesVS.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_LINE] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_LINE] = vsinfo->vertexLayout;
-		}
+		LoadVertexShader(VSTYPE_LINE, SHADERPATH + "linesVS.cso", VLTYPE_LINE, layout, numElements);
 	}
 
 	{
@@ -778,141 +1014,137 @@ void wiRenderer::LoadShaders()
 		};
 		UINT numElements = ARRAYSIZE(layout);
 
-		VertexShaderInfo* vsinfo = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "trailVS.cso", wiResourceManager::VERTEXSHADER, layout, numElements));
-		if (vsinfo != nullptr) {
-			vertexShaders[VSTYPE_TRAIL] = vsinfo->vertexShader;
-			vertexLayouts[VLTYPE_TRAIL] = vsinfo->vertexLayout;
-		}
-	}
-
-
-
-	vertexShaders[VSTYPE_OBJECT_COMMON_TESSELLATION] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_common_tessellation.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_OBJECT_SIMPLE_TESSELLATION] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_simple_tessellation.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_DIRLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "dirLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_POINTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "pointLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SPOTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "spotLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMESPOTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vSpotLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMEPOINTLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vPointLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMESPHERELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vSphereLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMEDISCLIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vDiscLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMERECTANGLELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vRectangleLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOLUMETUBELIGHT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "vTubeLightVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_DECAL] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "decalVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_ENVMAP] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_ENVMAP_SKY] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SPHERE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sphereVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_CUBE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SHADOWCUBEMAPRENDER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowVS_alphatest.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_SKY] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skyVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_WATER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "waterVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOXELIZER] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectVS_voxelizer.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_VOXEL] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_FORCEFIELDVISUALIZER_POINT] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldPointVisualizerVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-	vertexShaders[VSTYPE_FORCEFIELDVISUALIZER_PLANE] = static_cast<VertexShaderInfo*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldPlaneVisualizerVS.cso", wiResourceManager::VERTEXSHADER))->vertexShader;
-
-
-	pixelShaders[PSTYPE_OBJECT_DEFERRED] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_normalmap.cso", wiResourceManager::PIXELSHADER));	
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_DEFERRED_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_deferred_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
+		LoadVertexShader(VSTYPE_TRAIL, SHADERPATH + "trailVS.cso", VLTYPE_TRAIL, layout, numElements);
+	}
+
+
+
+	LoadVertexShader(VSTYPE_OBJECT_COMMON_TESSELLATION, SHADERPATH + "objectVS_common_tessellation.cso");
+	LoadVertexShader(VSTYPE_OBJECT_SIMPLE_TESSELLATION, SHADERPATH + "objectVS_simple_tessellation.cso");
+	LoadVertexShader(VSTYPE_DIRLIGHT, SHADERPATH + "dirLightVS.cso");
+	LoadVertexShader(VSTYPE_POINTLIGHT, SHADERPATH + "pointLightVS.cso");
+	LoadVertexShader(VSTYPE_SPOTLIGHT, SHADERPATH + "spotLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMESPOTLIGHT, SHADERPATH + "vSpotLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMEPOINTLIGHT, SHADERPATH + "vPointLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMESPHERELIGHT, SHADERPATH + "vSphereLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMEDISCLIGHT, SHADERPATH + "vDiscLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMERECTANGLELIGHT, SHADERPATH + "vRectangleLightVS.cso");
+	LoadVertexShader(VSTYPE_VOLUMETUBELIGHT, SHADERPATH + "vTubeLightVS.cso");
+	LoadVertexShader(VSTYPE_DECAL, SHADERPATH + "decalVS.cso");
+	LoadVertexShader(VSTYPE_ENVMAP, SHADERPATH + "envMapVS.cso");
+	LoadVertexShader(VSTYPE_ENVMAP_SKY, SHADERPATH + "envMap_skyVS.cso");
+	LoadVertexShader(VSTYPE_SPHERE, SHADERPATH + "sphereVS.cso");
+	LoadVertexShader(VSTYPE_CUBE, SHADERPATH + "cubeVS.cso");
+	LoadVertexShader(VSTYPE_SHADOWCUBEMAPRENDER, SHADERPATH + "cubeShadowVS.cso");
+	LoadVertexShader(VSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST, SHADERPATH + "cubeShadowVS_alphatest.cso");
+	LoadVertexShader(VSTYPE_SKY, SHADERPATH + "skyVS.cso");
+	LoadVertexShader(VSTYPE_WATER, SHADERPATH + "waterVS.cso");
+	LoadVertexShader(VSTYPE_VOXELIZER, SHADERPATH + "objectVS_voxelizer.cso");
+	LoadVertexShader(VSTYPE_VOXEL, SHADERPATH + "voxelVS.cso");
+	LoadVertexShader(VSTYPE_FORCEFIELDVISUALIZER_POINT, SHADERPATH + "forceFieldPointVisualizerVS.cso");
+	LoadVertexShader(VSTYPE_FORCEFIELDVISUALIZER_PLANE, SHADERPATH + "forceFieldPlaneVisualizerVS.cso");
+
+
+	LoadShader(pixelShaders[PSTYPE_OBJECT_DEFERRED], SHADERPATH + "objectPS_deferred.cso", wiResourceManager::PIXELSHADER);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_DEFERRED_NORMALMAP, SHADERPATH + "objectPS_deferred_normalmap.cso", PSTYPE_OBJECT_DEFERRED);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_DEFERRED_POM, SHADERPATH + "objectPS_deferred_pom.cso", PSTYPE_OBJECT_DEFERRED);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_DEFERRED_NORMALMAP_POM, SHADERPATH + "objectPS_deferred_normalmap_pom.cso", PSTYPE_OBJECT_DEFERRED);
 	
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_WATER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_forward_dirlight_water.cso", wiResourceManager::PIXELSHADER));
-
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap_planarreflection.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_POM] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_transparent_normalmap_pom.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_WATER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_tiledforward_water.cso", wiResourceManager::PIXELSHADER));
-
-	pixelShaders[PSTYPE_OBJECT_DEBUG] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_debug.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_SIMPLEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_simplest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_BLACKOUT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_blackout.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_TEXTUREONLY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_textureonly.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_OBJECT_ALPHATESTONLY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_alphatestonly.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVIRONMENTALLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "environmentalLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DIRLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "dirLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DIRLIGHT_SOFT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "dirLightSoftPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_POINTLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "pointLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SPOTLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "spotLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SPHERELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sphereLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DISCLIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "discLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_RECTANGLELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "rectangleLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_TUBELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "tubeLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOLUMELIGHT] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "volumeLightPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_DECAL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "decalPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_ENVMAP_SKY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_CAPTUREIMPOSTOR] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "captureImpostorPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_CUBEMAP] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubemapPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_LINE] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "linesPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SKY] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skyPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SUN] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "sunPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOW_ALPHATEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "shadowPS_alphatest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowPS_alphatest.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_TRAIL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "trailPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOXELIZER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectPS_voxelizer.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_VOXEL] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelPS.cso", wiResourceManager::PIXELSHADER));
-	pixelShaders[PSTYPE_FORCEFIELDVISUALIZER] = static_cast<PixelShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "forceFieldVisualizerPS.cso", wiResourceManager::PIXELSHADER));
-
-
-	geometryShaders[GSTYPE_ENVMAP] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMapGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_ENVMAP_SKY] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "envMap_skyGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowGS.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "cubeShadowGS_alphatest.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_VOXELIZER] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectGS_voxelizer.cso", wiResourceManager::GEOMETRYSHADER));
-	geometryShaders[GSTYPE_VOXEL] = static_cast<GeometryShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelGS.cso", wiResourceManager::GEOMETRYSHADER));
-
-
-	computeShaders[CSTYPE_LUMINANCE_PASS1] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "luminancePass1CS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_LUMINANCE_PASS2] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "luminancePass2CS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEFRUSTUMS] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "tileFrustumsCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_ADVANCED] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_ADVANCED.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_DEBUG] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_DEBUG.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_ADVANCED_DEBUG] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_ADVANCED_DEBUG.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_DEFERRED.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_ADVANCED] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_DEFERRED_ADVANCED.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_DEBUG] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_DEFERRED_DEBUG.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_ADVANCED_DEBUG] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "lightCullingCS_DEFERRED_ADVANCED_DEBUG.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_RESOLVEMSAADEPTHSTENCIL] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "resolveMSAADepthStencilCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELSCENECOPYCLEAR] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelSceneCopyClearCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelSceneCopyClear_TemporalSmoothing.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELRADIANCESECONDARYBOUNCE] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelRadianceSecondaryBounceCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_VOXELCLEARONLYNORMAL] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "voxelClearOnlyNormalCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN2D_SIMPLEFILTER] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain2D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN2D_GAUSSIAN] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain2D_GaussianCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN3D_SIMPLEFILTER] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain3D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_GENERATEMIPCHAIN3D_GAUSSIAN] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "generateMIPChain3D_GaussianCS.cso", wiResourceManager::COMPUTESHADER));
-	computeShaders[CSTYPE_SKINNING] = static_cast<ComputeShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "skinningCS.cso", wiResourceManager::COMPUTESHADER));
-
-
-	hullShaders[HSTYPE_OBJECT] = static_cast<HullShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectHS.cso", wiResourceManager::HULLSHADER));
-
-
-	domainShaders[DSTYPE_OBJECT] = static_cast<DomainShader*>(wiResourceManager::GetShaderManager()->add(SHADERPATH + "objectDS.cso", wiResourceManager::DOMAINSHADER));
+	LoadShader(pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT], SHADERPATH + "objectPS_forward_dirlight.cso", wiResourceManager::PIXELSHADER);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP, SHADERPATH + "objectPS_forward_dirlight_normalmap.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT], SHADERPATH + "objectPS_forward_dirlight_transparent.cso", wiResourceManager::PIXELSHADER);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP, SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_PLANARREFLECTION, SHADERPATH + "objectPS_forward_dirlight_planarreflection.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP_PLANARREFLECTION, SHADERPATH + "objectPS_forward_dirlight_normalmap_planarreflection.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_PLANARREFLECTION, SHADERPATH + "objectPS_forward_dirlight_transparent_planarreflection.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP_PLANARREFLECTION, SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap_planarreflection.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_POM, SHADERPATH + "objectPS_forward_dirlight_pom.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_NORMALMAP_POM, SHADERPATH + "objectPS_forward_dirlight_normalmap_pom.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_POM, SHADERPATH + "objectPS_forward_dirlight_transparent_pom.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT_NORMALMAP_POM, SHADERPATH + "objectPS_forward_dirlight_transparent_normalmap_pom.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_FORWARD_DIRLIGHT_WATER, SHADERPATH + "objectPS_forward_dirlight_water.cso", PSTYPE_OBJECT_FORWARD_DIRLIGHT_TRANSPARENT);
+
+	LoadShader(pixelShaders[PSTYPE_OBJECT_TILEDFORWARD], SHADERPATH + "objectPS_tiledforward.cso", wiResourceManager::PIXELSHADER);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP, SHADERPATH + "objectPS_tiledforward_normalmap.cso", PSTYPE_OBJECT_TILEDFORWARD);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT], SHADERPATH + "objectPS_tiledforward_transparent.cso", wiResourceManager::PIXELSHADER);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP, SHADERPATH + "objectPS_tiledforward_transparent_normalmap.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_PLANARREFLECTION, SHADERPATH + "objectPS_tiledforward_planarreflection.cso", PSTYPE_OBJECT_TILEDFORWARD);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_PLANARREFLECTION, SHADERPATH + "objectPS_tiledforward_normalmap_planarreflection.cso", PSTYPE_OBJECT_TILEDFORWARD);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_PLANARREFLECTION, SHADERPATH + "objectPS_tiledforward_transparent_planarreflection.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_PLANARREFLECTION, SHADERPATH + "objectPS_tiledforward_transparent_normalmap_planarreflection.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_POM, SHADERPATH + "objectPS_tiledforward_pom.cso", PSTYPE_OBJECT_TILEDFORWARD);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_NORMALMAP_POM, SHADERPATH + "objectPS_tiledforward_normalmap_pom.cso", PSTYPE_OBJECT_TILEDFORWARD);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_POM, SHADERPATH + "objectPS_tiledforward_transparent_pom.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT_NORMALMAP_POM, SHADERPATH + "objectPS_tiledforward_transparent_normalmap_pom.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+	LoadPixelShaderPermutation(PSTYPE_OBJECT_TILEDFORWARD_WATER, SHADERPATH + "objectPS_tiledforward_water.cso", PSTYPE_OBJECT_TILEDFORWARD_TRANSPARENT);
+
+	LoadShader(pixelShaders[PSTYPE_OBJECT_DEBUG], SHADERPATH + "objectPS_debug.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_SIMPLEST], SHADERPATH + "objectPS_simplest.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_BLACKOUT], SHADERPATH + "objectPS_blackout.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_TEXTUREONLY], SHADERPATH + "objectPS_textureonly.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_OBJECT_ALPHATESTONLY], SHADERPATH + "objectPS_alphatestonly.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_ENVIRONMENTALLIGHT], SHADERPATH + "environmentalLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_DIRLIGHT], SHADERPATH + "dirLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_DIRLIGHT_SOFT], SHADERPATH + "dirLightSoftPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_POINTLIGHT], SHADERPATH + "pointLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SPOTLIGHT], SHADERPATH + "spotLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SPHERELIGHT], SHADERPATH + "sphereLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_DISCLIGHT], SHADERPATH + "discLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_RECTANGLELIGHT], SHADERPATH + "rectangleLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_TUBELIGHT], SHADERPATH + "tubeLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_VOLUMELIGHT], SHADERPATH + "volumeLightPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_DECAL], SHADERPATH + "decalPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_ENVMAP], SHADERPATH + "envMapPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_ENVMAP_SKY], SHADERPATH + "envMap_skyPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_CAPTUREIMPOSTOR], SHADERPATH + "captureImpostorPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_CUBEMAP], SHADERPATH + "cubemapPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_LINE], SHADERPATH + "linesPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SKY], SHADERPATH + "skyPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SUN], SHADERPATH + "sunPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SHADOW_ALPHATEST], SHADERPATH + "shadowPS_alphatest.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER], SHADERPATH + "cubeShadowPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST], SHADERPATH + "cubeShadowPS_alphatest.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_TRAIL], SHADERPATH + "trailPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_VOXELIZER], SHADERPATH + "objectPS_voxelizer.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_VOXEL], SHADERPATH + "voxelPS.cso", wiResourceManager::PIXELSHADER);
+	LoadShader(pixelShaders[PSTYPE_FORCEFIELDVISUALIZER], SHADERPATH + "forceFieldVisualizerPS.cso", wiResourceManager::PIXELSHADER);
+
+
+	LoadShader(geometryShaders[GSTYPE_ENVMAP], SHADERPATH + "envMapGS.cso", wiResourceManager::GEOMETRYSHADER);
+	LoadShader(geometryShaders[GSTYPE_ENVMAP_SKY], SHADERPATH + "envMap_skyGS.cso", wiResourceManager::GEOMETRYSHADER);
+	LoadShader(geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER], SHADERPATH + "cubeShadowGS.cso", wiResourceManager::GEOMETRYSHADER);
+	LoadShader(geometryShaders[GSTYPE_SHADOWCUBEMAPRENDER_ALPHATEST], SHADERPATH + "cubeShadowGS_alphatest.cso", wiResourceManager::GEOMETRYSHADER);
+	LoadShader(geometryShaders[GSTYPE_VOXELIZER], SHADERPATH + "objectGS_voxelizer.cso", wiResourceManager::GEOMETRYSHADER);
+	LoadShader(geometryShaders[GSTYPE_VOXEL], SHADERPATH + "voxelGS.cso", wiResourceManager::GEOMETRYSHADER);
+
+
+	LoadShader(computeShaders[CSTYPE_LUMINANCE_PASS1], SHADERPATH + "luminancePass1CS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_LUMINANCE_PASS2], SHADERPATH + "luminancePass2CS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEFRUSTUMS], SHADERPATH + "tileFrustumsCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING], SHADERPATH + "lightCullingCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_ADVANCED], SHADERPATH + "lightCullingCS_ADVANCED.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_DEBUG], SHADERPATH + "lightCullingCS_DEBUG.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_ADVANCED_DEBUG], SHADERPATH + "lightCullingCS_ADVANCED_DEBUG.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED], SHADERPATH + "lightCullingCS_DEFERRED.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_ADVANCED], SHADERPATH + "lightCullingCS_DEFERRED_ADVANCED.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_DEBUG], SHADERPATH + "lightCullingCS_DEFERRED_DEBUG.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_TILEDLIGHTCULLING_DEFERRED_ADVANCED_DEBUG], SHADERPATH + "lightCullingCS_DEFERRED_ADVANCED_DEBUG.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_RESOLVEMSAADEPTHSTENCIL], SHADERPATH + "resolveMSAADepthStencilCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_VOXELSCENECOPYCLEAR], SHADERPATH + "voxelSceneCopyClearCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_VOXELSCENECOPYCLEAR_TEMPORALSMOOTHING], SHADERPATH + "voxelSceneCopyClear_TemporalSmoothing.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_VOXELRADIANCESECONDARYBOUNCE], SHADERPATH + "voxelRadianceSecondaryBounceCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_VOXELCLEARONLYNORMAL], SHADERPATH + "voxelClearOnlyNormalCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_GENERATEMIPCHAIN2D_SIMPLEFILTER], SHADERPATH + "generateMIPChain2D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_GENERATEMIPCHAIN2D_GAUSSIAN], SHADERPATH + "generateMIPChain2D_GaussianCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_GENERATEMIPCHAIN3D_SIMPLEFILTER], SHADERPATH + "generateMIPChain3D_SimpleFilterCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_GENERATEMIPCHAIN3D_GAUSSIAN], SHADERPATH + "generateMIPChain3D_GaussianCS.cso", wiResourceManager::COMPUTESHADER);
+	LoadShader(computeShaders[CSTYPE_SKINNING], SHADERPATH + "skinningCS.cso", wiResourceManager::COMPUTESHADER);
+
+
+	LoadShader(hullShaders[HSTYPE_OBJECT], SHADERPATH + "objectHS.cso", wiResourceManager::HULLSHADER);
+
+
+	LoadShader(domainShaders[DSTYPE_OBJECT], SHADERPATH + "objectDS.cso", wiResourceManager::DOMAINSHADER);
 
 
 
@@ -928,6 +1160,8 @@ void wiRenderer::ReloadShaders(const std::string& path)
 
 	GetDevice()->LOCK();
 
+	// The shaders that are still loading are finished before the shader manager destroys them:
+	WaitForShaders();
 	wiResourceManager::GetShaderManager()->CleanUp();
 	LoadShaders();
 	wiHairParticle::LoadShaders();
@@ -936,6 +1170,9 @@ void wiRenderer::ReloadShaders(const std::string& path)
 	wiImage::LoadShaders();
 	wiLensFlare::LoadShaders();
 
+	// The next frame must not draw with the slots that were reset:
+	WaitForShaders();
+
 	GetDevice()->UNLOCK();
 }
 
@@ -1468,6 +1705,11 @@ void wiRenderer::BindPersistentState(GRAPHICSTHREAD threadID)
 
 	GetDevice()->BindConstantBufferVS(constantBuffers[CBTYPE_API], CB_GETBINDSLOT(APICB), threadID);
 	GetDevice()->BindConstantBufferPS(constantBuffers[CBTYPE_API], CB_GETBINDSLOT(APICB), threadID);
+
+	if (resourceBuffers[RBTYPE_MATERIALARRAY] != nullptr)
+	{
+		GetDevice()->BindResourcePS(resourceBuffers[RBTYPE_MATERIALARRAY], SBSLOT_MATERIALARRAY, threadID);
+	}
 }
 
 Transform* wiRenderer::getTransformByName(const std::string& get)
@@ -1654,6 +1896,13 @@ void wiRenderer::UpdatePerFrameData(float dt)
 	}
 	wiProfiler::GetInstance().EndRange(); // SPTree Update
 
+	UpdateDynamicObjects();
+
+	wiStreaming::Update(GetScene(), getCamera()->translation, dt);
+
+	// Unreferenced resources are evicted when the memory budget is exceeded:
+	wiResourceManager::GetGlobal()->Update();
+
 	// Environment probe sorting:
 	{
 		ZeroMemory(globalEnvProbes, sizeof(globalEnvProbes));
@@ -1853,109 +2102,419 @@ void wiRenderer::UpdatePerFrameData(float dt)
 	renderTime = (float)((wiTimer::TotalTime()) / 1000.0 * GameSpeed);
 	deltaTime = dt;
 }
-void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
+UINT wiRenderer::RegisterMaterial(Material* material)
 {
-	UpdateWorldCB(threadID); // only commits when parameters are changed
-	UpdateFrameCB(threadID);
-	BindPersistentState(threadID);
+	materialTable.lock.lock();
 
-	ManageDecalAtlas(threadID);
+	if (materialTable.entries.empty())
+	{
+		// The impostor material, every param is baked into the impostor textures:
+		ShaderMaterial impostor;
+		ZeroMemory(&impostor, sizeof(impostor));
+		impostor.baseColor = XMFLOAT4(1, 1, 1, 1);
+		impostor.texMulAdd = XMFLOAT4(1, 1, 0, 0);
+		impostor.normalMapStrength = 1.0f;
+		impostor.roughness = 1.0f;
+		impostor.reflectance = 1.0f;
+		impostor.metalness = 1.0f;
+		materialTable.entries.push_back(impostor);
+		materialTable.dirtyIndices.push_back(MATERIALARRAY_INDEX_IMPOSTOR);
+	}
 
-	const FrameCulling& mainCameraCulling = frameCullings[getCamera()];
+	UINT index;
+	if (!materialTable.freeIndices.empty())
+	{
+		index = materialTable.freeIndices.back();
+		materialTable.freeIndices.pop_back();
+	}
+	else
+	{
+		index = (UINT)materialTable.entries.size();
+		materialTable.entries.emplace_back();
+	}
 
-	// Fill Light Array with lights + decals in the frustum:
+	materialTable.lock.unlock();
+	return index;
+}
+void wiRenderer::UnregisterMaterial(Material* material)
+{
+	materialTable.lock.lock();
+	if (material->dirty)
+	{
+		auto& dirtyMaterials = materialTable.dirtyMaterials;
+		dirtyMaterials.erase(remove(dirtyMaterials.begin(), dirtyMaterials.end(), material), dirtyMaterials.end());
+		material->dirty = false;
+	}
+	materialTable.freeIndices.push_back(material->tableIndex);
+	materialTable.lock.unlock();
+}
+void wiRenderer::MarkMaterialDirty(Material* material)
+{
+	materialTable.lock.lock();
+	if (!material->dirty)
+	{
+		material->dirty = true;
+		materialTable.dirtyMaterials.push_back(material);
+	}
+	// The shadow maps that were rendered with the old material can't be reused:
+	sceneEpoch++;
+	materialTable.lock.unlock();
+}
+void wiRenderer::ExtractMaterialTable()
+{
+	wiTimer timer;
+	materialTableStats = MaterialTableStats();
+
+	FramePacket& packet = framePackets[framePacketIndex];
+	packet.materialRanges.clear();
+	packet.materials.clear();
+
+	materialTable.lock.lock();
+
+	vector<UINT>& dirtyIndices = materialTable.dirtyIndices;
+	for (Material* material : materialTable.dirtyMaterials)
 	{
-		const CulledList& culledLights = mainCameraCulling.culledLights;
+		material->CreateShaderMaterial(materialTable.entries[material->tableIndex]);
+		material->dirty = false;
+		dirtyIndices.push_back(material->tableIndex);
+	}
+	materialTableStats.updatedMaterials = (UINT)materialTable.dirtyMaterials.size();
+	materialTable.dirtyMaterials.clear();
 
-		static ShaderEntityType* entityArray = (ShaderEntityType*)_mm_malloc(sizeof(ShaderEntityType)*MAX_SHADER_ENTITY_COUNT, 16);
-		static XMMATRIX* matrixArray = (XMMATRIX*)_mm_malloc(sizeof(XMMATRIX)*MATRIXARRAY_COUNT, 16);
+	// The indices that were not uploaded yet are kept, they are copied into this packet again:
+	sort(dirtyIndices.begin(), dirtyIndices.end());
+	dirtyIndices.erase(unique(dirtyIndices.begin(), dirtyIndices.end()), dirtyIndices.end());
+	packet.materialExtraction = ++materialTable.extractionCount;
+	packet.materialIndexCount = (UINT)dirtyIndices.size();
 
-		const XMMATRIX viewMatrix = cam->GetView();
+	const UINT count = (UINT)materialTable.entries.size();
+	materialTableStats.materials = count - (UINT)materialTable.freeIndices.size() - (count > 0 ? 1 : 0);
 
-		UINT entityCounter = 0;
-		UINT matrixCounter = 0;
+	if (count > materialTable.gpuCapacity || resourceBuffers[RBTYPE_MATERIALARRAY] == nullptr)
+	{
+		// The table outgrew the buffer, so it is created again with the whole table in it. This is done here on the main
+		//	thread, because the render tasks bind the buffer while the material table is uploaded:
+		UINT capacity = max(materialTable.gpuCapacity, (UINT)MATERIALARRAY_INITIAL_COUNT);
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
 
-		entityArrayOffset_ForceFields = 0;
-		entityArrayCount_ForceFields = 0;
+		GPUBufferDesc bd;
+		bd.Usage = USAGE_DEFAULT;
+		bd.CPUAccessFlags = 0;
+		bd.ByteWidth = sizeof(ShaderMaterial) * capacity;
+		bd.BindFlags = BIND_SHADER_RESOURCE;
+		bd.MiscFlags = RESOURCE_MISC_BUFFER_STRUCTURED;
+		bd.StructureByteStride = sizeof(ShaderMaterial);
+		SAFE_DELETE(resourceBuffers[RBTYPE_MATERIALARRAY]);
+		resourceBuffers[RBTYPE_MATERIALARRAY] = new GPUBuffer;
+		GetDevice()->CreateBuffer(&bd, nullptr, resourceBuffers[RBTYPE_MATERIALARRAY]);
+		materialTable.gpuCapacity = capacity;
 
-		for (Cullable* c : culledLights)
+		if (count > 0)
 		{
-			if (entityCounter == MAX_SHADER_ENTITY_COUNT)
-			{
-				assert(0); // too many entities!
-				entityCounter--;
-				break;
-			}
+			const UINT size = sizeof(ShaderMaterial) * count;
+			GetDevice()->UpdateBufferRange(resourceBuffers[RBTYPE_MATERIALARRAY], materialTable.entries.data(), 0, size, GRAPHICSTHREAD_IMMEDIATE);
+			materialTableStats.uploads++;
+			materialTableStats.uploadedBytes += size;
+		}
 
-			Light* l = (Light*)c;
-			if (!l->IsActive())
+		// Nothing is pending anymore:
+		dirtyIndices.clear();
+		packet.materialIndexCount = 0;
+	}
+	else if (!dirtyIndices.empty())
+	{
+		// The dirty entries are uploaded in contiguous ranges. Ranges with only a few clean entries between them are merged,
+		//	because uploading those entries again is cheaper than issuing one more update:
+		static const UINT mergeDistance = 16;
+		size_t i = 0;
+		while (i < dirtyIndices.size())
+		{
+			const UINT first = dirtyIndices[i];
+			UINT last = first;
+			while (i < dirtyIndices.size() && dirtyIndices[i] <= last + mergeDistance)
 			{
-				continue;
+				last = max(last, dirtyIndices[i]);
+				++i;
 			}
+			packet.materialRanges.push_back(make_pair(first, last - first + 1));
+			packet.materials.insert(packet.materials.end(), materialTable.entries.begin() + first, materialTable.entries.begin() + last + 1);
+		}
+	}
 
-			const int shadowIndex = l->shadowMap_index;
-
-			entityArray[entityCounter].type = l->GetType();
-			entityArray[entityCounter].positionWS = l->translation;
-			XMStoreFloat3(&entityArray[entityCounter].positionVS, XMVector3TransformCoord(XMLoadFloat3(&entityArray[entityCounter].positionWS), viewMatrix));
-			entityArray[entityCounter].range = l->enerDis.y;
-			entityArray[entityCounter].color = wiMath::CompressColor(l->color);
-			entityArray[entityCounter].energy = l->enerDis.x;
-			entityArray[entityCounter].shadowBias = l->shadowBias;
-			entityArray[entityCounter].additionalData_index = shadowIndex;
-			switch (l->GetType())
-			{
-			case Light::DIRECTIONAL:
-			{
-				entityArray[entityCounter].directionWS = l->GetDirection();
-				entityArray[entityCounter].shadowKernel = 1.0f / SHADOWRES_2D;
+	materialTable.lock.unlock();
 
-				if (shadowIndex >= 0)
-				{
-					matrixArray[shadowIndex + 0] = l->shadowCam_dirLight[0].getVP();
-					matrixArray[shadowIndex + 1] = l->shadowCam_dirLight[1].getVP();
-					matrixArray[shadowIndex + 2] = l->shadowCam_dirLight[2].getVP();
-					matrixCounter = max(matrixCounter, (UINT)shadowIndex + 2);
-				}
-			}
-			break;
-			case Light::SPOT:
-			{
-				entityArray[entityCounter].coneAngleCos = cosf(l->enerDis.z * 0.5f);
-				entityArray[entityCounter].directionWS = l->GetDirection();
-				XMStoreFloat3(&entityArray[entityCounter].directionVS, XMVector3TransformNormal(XMLoadFloat3(&entityArray[entityCounter].directionWS), viewMatrix));
-				entityArray[entityCounter].shadowKernel = 1.0f / SHADOWRES_2D;
+	materialTableStats.updateTime = (float)timer.elapsed();
+}
+void wiRenderer::UpdateMaterialTable(GRAPHICSTHREAD threadID)
+{
+	wiTimer timer;
+
+	const FramePacket& packet = GetFramePacket();
+
+	const ShaderMaterial* data = packet.materials.data();
+	for (auto& range : packet.materialRanges)
+	{
+		const UINT size = sizeof(ShaderMaterial) * range.second;
+		GetDevice()->UpdateBufferRange(resourceBuffers[RBTYPE_MATERIALARRAY], data, sizeof(ShaderMaterial) * range.first, size, threadID);
+		data += range.second;
+		materialTableStats.uploads++;
+		materialTableStats.uploadedBytes += size;
+	}
+
+	// The uploaded indices are not pending anymore. If a later packet was extracted already, it holds them too, so they are
+	//	left for that one. Indices that were added since the extraction follow the ones of the packet:
+	materialTable.lock.lock();
+	if (packet.materialExtraction == materialTable.extractionCount && packet.materialExtraction != materialTable.uploadedExtraction)
+	{
+		vector<UINT>& dirtyIndices = materialTable.dirtyIndices;
+		dirtyIndices.erase(dirtyIndices.begin(), dirtyIndices.begin() + min((size_t)packet.materialIndexCount, dirtyIndices.size()));
+		materialTable.uploadedExtraction = packet.materialExtraction;
+	}
+	materialTable.lock.unlock();
+
+	if (resourceBuffers[RBTYPE_MATERIALARRAY] != nullptr)
+	{
+		GetDevice()->BindResourcePS(resourceBuffers[RBTYPE_MATERIALARRAY], SBSLOT_MATERIALARRAY, threadID);
+	}
 
-				if (l->shadow && shadowIndex >= 0 && !l->shadowCam_spotLight.empty())
+	materialTableStats.updateTime += (float)timer.elapsed();
+}
+UINT wiRenderer::BuildEntityArray(const CulledList& lights, const list<Decal*>& decals, const XMMATRIX& viewMatrix,
+	ShaderEntityType* entityArray, UINT entityCapacity, XMMATRIX* matrixArray, UINT matrixCapacity, UINT& matrixCount)
+{
+	// Below this count the entities are built on the calling thread, because that is cheaper than waking up the workers:
+	static const UINT parallelThreshold = 256;
+	auto forEach = [](UINT count, const function<void(UINT)>& body) {
+		if (count < parallelThreshold)
+		{
+			for (UINT i = 0; i < count; ++i)
+			{
+				body(i);
+			}
+		}
+		else
+		{
+			wiJobSystem::ParallelFor(count, 0, [&](UINT begin, UINT end) {
+				for (UINT i = begin; i < end; ++i)
 				{
-					matrixArray[shadowIndex + 0] = l->shadowCam_spotLight[0].getVP();
-					matrixCounter = max(matrixCounter, (UINT)shadowIndex + 2);
+					body(i);
 				}
-			}
+			});
+		}
+	};
+
+	EntityArrayContext& context = entityArrayContext;
+	context.lights.clear();
+	context.decals.clear();
+	for (auto& bucket : context.lightsByType)
+	{
+		bucket.clear();
+	}
+
+	// The shadow matrices are at the shadow map indices of the lights, the decal matrices follow them:
+	UINT shadowMatrixCount = 0;
+	for (Cullable* c : lights)
+	{
+		if (context.lights.size() == entityCapacity)
+		{
+			assert(0); // too many entities!
 			break;
-			case Light::POINT:
+		}
+
+		Light* l = (Light*)c;
+		if (!l->IsActive())
+		{
+			continue;
+		}
+
+		const int shadowIndex = l->shadowMap_index;
+		if (shadowIndex >= 0)
+		{
+			if (l->GetType() == Light::DIRECTIONAL && l->shadowCam_dirLight.size() >= 3)
 			{
-				entityArray[entityCounter].shadowKernel = 1.0f / SHADOWRES_CUBE;
+				shadowMatrixCount = max(shadowMatrixCount, (UINT)shadowIndex + 3);
 			}
-			break;
-			case Light::SPHERE:
-			case Light::DISC:
-			case Light::RECTANGLE:
-			case Light::TUBE:
+			else if (l->GetType() == Light::SPOT && l->shadow && !l->shadowCam_spotLight.empty())
 			{
-				XMMATRIX lightMat = XMLoadFloat4x4(&l->world);
-				// Note: area lights are facing back by default
-				XMStoreFloat3(&entityArray[entityCounter].directionWS, XMVector3TransformNormal(XMVectorSet(-1, 0, 0, 0), lightMat)); // right dir
-				XMStoreFloat3(&entityArray[entityCounter].directionVS, XMVector3TransformNormal(XMVectorSet(0, 1, 0, 0), lightMat)); // up dir
-				XMStoreFloat3(&entityArray[entityCounter].positionVS, XMVector3TransformNormal(XMVectorSet(0, 0, -1, 0), lightMat)); // front dir
-				entityArray[entityCounter].texMulAdd = XMFLOAT4(l->radius, l->width, l->height, 0);
+				shadowMatrixCount = max(shadowMatrixCount, (UINT)shadowIndex + 1);
 			}
+		}
+		assert(shadowMatrixCount <= matrixCapacity);
+
+		context.lightsByType[l->GetType()].push_back((UINT)context.lights.size());
+		context.lights.push_back(l);
+	}
+	const UINT lightCount = (UINT)context.lights.size();
+
+	for (Decal* decal : decals)
+	{
+		if (lightCount + context.decals.size() == entityCapacity)
+		{
+			assert(0); // too many entities!
 			break;
-			}
+		}
+		if (shadowMatrixCount + context.decals.size() == matrixCapacity)
+		{
+			assert(0); // too many decals, can't upload the rest to matrixarray!
+			break;
+		}
+		context.decals.push_back(decal);
+	}
+	const UINT decalCount = (UINT)context.decals.size();
+	const UINT entityCount = lightCount + decalCount;
+	matrixCount = shadowMatrixCount + decalCount;
+
+	// Transform the positions into view space four at a time:
+	const UINT paddedCount = (entityCount + 3) & ~3u;
+	context.positionX.resize(paddedCount);
+	context.positionY.resize(paddedCount);
+	context.positionZ.resize(paddedCount);
+	context.positionVSX.resize(paddedCount);
+	context.positionVSY.resize(paddedCount);
+	context.positionVSZ.resize(paddedCount);
+	for (UINT i = 0; i < paddedCount; ++i)
+	{
+		const XMFLOAT3 position = i < lightCount ? context.lights[i]->translation : i < entityCount ? context.decals[i - lightCount]->translation : XMFLOAT3(0, 0, 0);
+		context.positionX[i] = position.x;
+		context.positionY[i] = position.y;
+		context.positionZ[i] = position.z;
+	}
+
+	const XMVECTOR m11 = XMVectorSplatX(viewMatrix.r[0]), m12 = XMVectorSplatY(viewMatrix.r[0]), m13 = XMVectorSplatZ(viewMatrix.r[0]), m14 = XMVectorSplatW(viewMatrix.r[0]);
+	const XMVECTOR m21 = XMVectorSplatX(viewMatrix.r[1]), m22 = XMVectorSplatY(viewMatrix.r[1]), m23 = XMVectorSplatZ(viewMatrix.r[1]), m24 = XMVectorSplatW(viewMatrix.r[1]);
+	const XMVECTOR m31 = XMVectorSplatX(viewMatrix.r[2]), m32 = XMVectorSplatY(viewMatrix.r[2]), m33 = XMVectorSplatZ(viewMatrix.r[2]), m34 = XMVectorSplatW(viewMatrix.r[2]);
+	const XMVECTOR m41 = XMVectorSplatX(viewMatrix.r[3]), m42 = XMVectorSplatY(viewMatrix.r[3]), m43 = XMVectorSplatZ(viewMatrix.r[3]), m44 = XMVectorSplatW(viewMatrix.r[3]);
+	forEach(paddedCount / 4, [&](UINT group) {
+		const UINT i = group * 4;
+		const XMVECTOR x = XMLoadFloat4((const XMFLOAT4*)&context.positionX[i]);
+		const XMVECTOR y = XMLoadFloat4((const XMFLOAT4*)&context.positionY[i]);
+		const XMVECTOR z = XMLoadFloat4((const XMFLOAT4*)&context.positionZ[i]);
+		const XMVECTOR w = XMVectorMultiplyAdd(x, m14, XMVectorMultiplyAdd(y, m24, XMVectorMultiplyAdd(z, m34, m44)));
+		XMStoreFloat4((XMFLOAT4*)&context.positionVSX[i], XMVectorDivide(XMVectorMultiplyAdd(x, m11, XMVectorMultiplyAdd(y, m21, XMVectorMultiplyAdd(z, m31, m41))), w));
+		XMStoreFloat4((XMFLOAT4*)&context.positionVSY[i], XMVectorDivide(XMVectorMultiplyAdd(x, m12, XMVectorMultiplyAdd(y, m22, XMVectorMultiplyAdd(z, m32, m42))), w));
+		XMStoreFloat4((XMFLOAT4*)&context.positionVSZ[i], XMVectorDivide(XMVectorMultiplyAdd(x, m13, XMVectorMultiplyAdd(y, m23, XMVectorMultiplyAdd(z, m33, m43))), w));
+	});
 
-			entityCounter++;
+	auto writeLight = [&](UINT index) -> ShaderEntityType& {
+		const Light* l = context.lights[index];
+		ShaderEntityType& entity = entityArray[index];
+		entity.type = l->GetType();
+		entity.positionWS = l->translation;
+		entity.positionVS = XMFLOAT3(context.positionVSX[index], context.positionVSY[index], context.positionVSZ[index]);
+		entity.range = l->enerDis.y;
+		entity.color = wiMath::CompressColor(l->color);
+		entity.energy = l->enerDis.x;
+		entity.shadowBias = l->shadowBias;
+		entity.additionalData_index = l->shadowMap_index;
+		return entity;
+	};
+
+	const vector<UINT>& directionalLights = context.lightsByType[Light::DIRECTIONAL];
+	forEach((UINT)directionalLights.size(), [&](UINT i) {
+		const UINT index = directionalLights[i];
+		Light* l = context.lights[index];
+		ShaderEntityType& entity = writeLight(index);
+		entity.directionWS = l->GetDirection();
+		entity.shadowKernel = 1.0f / SHADOWRES_2D;
+
+		const int shadowIndex = l->shadowMap_index;
+		if (shadowIndex >= 0 && l->shadowCam_dirLight.size() >= 3)
+		{
+			matrixArray[shadowIndex + 0] = l->shadowCam_dirLight[0].getVP();
+			matrixArray[shadowIndex + 1] = l->shadowCam_dirLight[1].getVP();
+			matrixArray[shadowIndex + 2] = l->shadowCam_dirLight[2].getVP();
 		}
-		for (Decal* decal : mainCameraCulling.culledDecals)
+	});
+
+	const vector<UINT>& spotLights = context.lightsByType[Light::SPOT];
+	forEach((UINT)spotLights.size(), [&](UINT i) {
+		const UINT index = spotLights[i];
+		Light* l = context.lights[index];
+		ShaderEntityType& entity = writeLight(index);
+		entity.coneAngleCos = cosf(l->enerDis.z * 0.5f);
+		entity.directionWS = l->GetDirection();
+		XMStoreFloat3(&entity.directionVS, XMVector3TransformNormal(XMLoadFloat3(&entity.directionWS), viewMatrix));
+		entity.shadowKernel = 1.0f / SHADOWRES_2D;
+
+		const int shadowIndex = l->shadowMap_index;
+		if (l->shadow && shadowIndex >= 0 && !l->shadowCam_spotLight.empty())
+		{
+			matrixArray[shadowIndex + 0] = l->shadowCam_spotLight[0].getVP();
+		}
+	});
+
+	const vector<UINT>& pointLights = context.lightsByType[Light::POINT];
+	forEach((UINT)pointLights.size(), [&](UINT i) {
+		ShaderEntityType& entity = writeLight(pointLights[i]);
+		entity.shadowKernel = 1.0f / SHADOWRES_CUBE;
+	});
+
+	for (int type : { Light::SPHERE, Light::DISC, Light::RECTANGLE, Light::TUBE })
+	{
+		const vector<UINT>& areaLights = context.lightsByType[type];
+		forEach((UINT)areaLights.size(), [&](UINT i) {
+			const UINT index = areaLights[i];
+			const Light* l = context.lights[index];
+			ShaderEntityType& entity = writeLight(index);
+			XMMATRIX lightMat = XMLoadFloat4x4(&l->world);
+			// Note: area lights are facing back by default
+			XMStoreFloat3(&entity.directionWS, XMVector3TransformNormal(XMVectorSet(-1, 0, 0, 0), lightMat)); // right dir
+			XMStoreFloat3(&entity.directionVS, XMVector3TransformNormal(XMVectorSet(0, 1, 0, 0), lightMat)); // up dir
+			XMStoreFloat3(&entity.positionVS, XMVector3TransformNormal(XMVectorSet(0, 0, -1, 0), lightMat)); // front dir
+			entity.texMulAdd = XMFLOAT4(l->radius, l->width, l->height, 0);
+		});
+	}
+
+	forEach(decalCount, [&](UINT i) {
+		Decal* decal = context.decals[i];
+		const UINT index = lightCount + i;
+		const UINT matrixIndex = shadowMatrixCount + i;
+		ShaderEntityType& entity = entityArray[index];
+		entity.type = ENTITY_TYPE_DECAL;
+		entity.positionWS = decal->translation;
+		entity.positionVS = XMFLOAT3(context.positionVSX[index], context.positionVSY[index], context.positionVSZ[index]);
+		entity.range = max(decal->scale.x, max(decal->scale.y, decal->scale.z)) * 2;
+		entity.texMulAdd = decal->atlasMulAdd;
+		entity.color = wiMath::CompressColor(XMFLOAT4(decal->color.x, decal->color.y, decal->color.z, decal->GetOpacity()));
+		entity.energy = decal->emissive;
+
+		entity.additionalData_index = matrixIndex;
+		matrixArray[matrixIndex] = XMLoadFloat4x4(&decal->GetInverseWorldTransposed());
+	});
+
+	return entityCount;
+}
+void wiRenderer::ExtractFramePacket()
+{
+	wiProfiler::GetInstance().BeginRange("Frame Packet", wiProfiler::DOMAIN_CPU);
+
+	framePacketIndex ^= 1;
+	FramePacket& packet = framePackets[framePacketIndex];
+	packet.frame = GetDevice()->GetFrameCount();
+
+	// The cameras are copied without their place in the scene graph:
+	*packet.camera = *cam;
+	*packet.reflectionCamera = *refCam;
+	for (Camera* camera : { packet.camera, packet.reflectionCamera })
+	{
+		camera->parent = nullptr;
+		camera->children.clear();
+	}
+
+	// Fill Light Array with lights + decals in the frustum:
+	const FrameCulling& mainCameraCulling = frameCullings[cam];
+	UINT entityCounter = BuildEntityArray(mainCameraCulling.culledLights, mainCameraCulling.culledDecals, cam->GetView(),
+		packet.entityArray, MAX_SHADER_ENTITY_COUNT, packet.matrixArray, MATRIXARRAY_COUNT, packet.matrixCount);
+	packet.decals = entityArrayContext.decals;
+	packet.decalOffset = entityCounter - (UINT)packet.decals.size();
+
+	packet.forceFieldOffset = entityCounter;
+	for (auto& model : GetScene().models)
+	{
+		for (ForceField* force : model->forces)
 		{
 			if (entityCounter == MAX_SHADER_ENTITY_COUNT)
 			{
@@ -1963,54 +2522,48 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 				entityCounter--;
 				break;
 			}
-			if (matrixCounter >= MATRIXARRAY_COUNT)
-			{
-				assert(0); // too many decals, can't upload the rest to matrixarray!
-				matrixCounter--;
-				break;
-			}
-			entityArray[entityCounter].type = ENTITY_TYPE_DECAL;
-			entityArray[entityCounter].positionWS = decal->translation;
-			XMStoreFloat3(&entityArray[entityCounter].positionVS, XMVector3TransformCoord(XMLoadFloat3(&decal->translation), viewMatrix));
-			entityArray[entityCounter].range = max(decal->scale.x, max(decal->scale.y, decal->scale.z)) * 2;
-			entityArray[entityCounter].texMulAdd = decal->atlasMulAdd;
-			entityArray[entityCounter].color = wiMath::CompressColor(XMFLOAT4(decal->color.x, decal->color.y, decal->color.z, decal->GetOpacity()));
-			entityArray[entityCounter].energy = decal->emissive;
-
-			entityArray[entityCounter].additionalData_index = matrixCounter;
-			matrixArray[matrixCounter] = XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&decal->world)));
-			matrixCounter++;
+
+			ShaderEntityType& entity = packet.entityArray[entityCounter];
+			entity.type = force->type;
+			entity.positionWS = force->translation;
+			entity.energy = force->gravity;
+			entity.range = 1.0f / max(0.0001f, force->range); // avoid division in shader
+			entity.coneAngleCos = force->range; // this will be the real range in the less common shaders...
+			// The default planar force field is facing upwards, and thus the pull direction is downwards:
+			XMStoreFloat3(&entity.directionWS, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0, -1, 0, 0), XMLoadFloat4x4(&force->world))));
 
 			entityCounter++;
 		}
+	}
+	packet.forceFieldCount = entityCounter - packet.forceFieldOffset;
+	packet.entityCount = entityCounter;
 
-		entityArrayOffset_ForceFields = entityCounter;
-		for (auto& model : GetScene().models)
-		{
-			for (ForceField* force : model->forces)
-			{
-				if (entityCounter == MAX_SHADER_ENTITY_COUNT)
-				{
-					assert(0); // too many entities!
-					entityCounter--;
-					break;
-				}
+	ExtractMaterialTable();
 
-				entityArray[entityCounter].type = force->type;
-				entityArray[entityCounter].positionWS = force->translation;
-				entityArray[entityCounter].energy = force->gravity;
-				entityArray[entityCounter].range = 1.0f / max(0.0001f, force->range); // avoid division in shader
-				entityArray[entityCounter].coneAngleCos = force->range; // this will be the real range in the less common shaders...
-				// The default planar force field is facing upwards, and thus the pull direction is downwards:
-				XMStoreFloat3(&entityArray[entityCounter].directionWS, XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(0, -1, 0, 0), XMLoadFloat4x4(&force->world))));
+	wiProfiler::GetInstance().EndRange(); // Frame Packet
+}
+void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
+{
+	UpdateWorldCB(threadID); // only commits when parameters are changed
+	UpdateFrameCB(threadID);
+	BindPersistentState(threadID);
 
-				entityCounter++;
-			}
+	ManageDecalAtlas(threadID);
+
+	const FrameCulling& mainCameraCulling = frameCullings[getCamera()];
+
+	// Upload the light array of the frame packet:
+	{
+		FramePacket& packet = framePackets[framePacketIndex];
+
+		// The decal atlas is only packed here, so the decals get their atlas rectangles now:
+		for (size_t i = 0; i < packet.decals.size(); ++i)
+		{
+			packet.entityArray[packet.decalOffset + i].texMulAdd = packet.decals[i]->atlasMulAdd;
 		}
-		entityArrayCount_ForceFields = entityCounter - entityArrayOffset_ForceFields;
 
-		GetDevice()->UpdateBuffer(resourceBuffers[RBTYPE_ENTITYARRAY], entityArray, threadID, sizeof(ShaderEntityType)*entityCounter);
-		GetDevice()->UpdateBuffer(resourceBuffers[RBTYPE_MATRIXARRAY], matrixArray, threadID, sizeof(XMMATRIX)*matrixCounter);
+		GetDevice()->UpdateBuffer(resourceBuffers[RBTYPE_ENTITYARRAY], packet.entityArray, threadID, sizeof(ShaderEntityType)*packet.entityCount);
+		GetDevice()->UpdateBuffer(resourceBuffers[RBTYPE_MATRIXARRAY], packet.matrixArray, threadID, sizeof(XMMATRIX)*packet.matrixCount);
 
 		const GPUResource* resources[] = {
 			resourceBuffers[RBTYPE_ENTITYARRAY],
@@ -2021,6 +2574,8 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 		GetDevice()->BindResourcesCS(resources, SBSLOT_ENTITYARRAY, ARRAYSIZE(resources), threadID);
 	}
 
+	UpdateMaterialTable(threadID);
+
 	wiProfiler::GetInstance().BeginRange("Skinning", wiProfiler::DOMAIN_GPU, threadID);
 	GetDevice()->EventBegin("Skinning", threadID);
 	{
@@ -2028,20 +2583,6 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 
 		for (Model* model : GetScene().models)
 		{
-			// Update material constant buffers:
-			MaterialCB materialGPUData;
-			for (auto& it : model->materials)
-			{
-				Material* material = it.second;
-				materialGPUData.Create(*material);
-				// These will probably not change every time so only issue a GPU memory update if it is necessary:
-				if (memcmp(&material->gpuData, &materialGPUData, sizeof(MaterialCB)) != 0)
-				{
-					material->gpuData = materialGPUData;
-					GetDevice()->UpdateBuffer(&material->constantBuffer, &materialGPUData, threadID);
-				}
-			}
-
 			// Skinning:
 			for (MeshCollection::iterator iter = model->meshes.begin(); iter != model->meshes.end(); ++iter)
 			{
@@ -2095,10 +2636,24 @@ void wiRenderer::UpdateRenderData(GRAPHICSTHREAD threadID)
 				}
 				else if (mesh->hasDynamicVB())
 				{
-					// Upload CPU skinned vertex buffer (Soft body VB)
-					mesh->bufferOffset_POS = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, mesh->vertices_Transformed_POS.data(), sizeof(Mesh::Vertex_POS)*mesh->vertices_Transformed_POS.size(), threadID);
-					mesh->bufferOffset_NOR = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, mesh->vertices_Transformed_NOR.data(), sizeof(Mesh::Vertex_NOR)*mesh->vertices_Transformed_NOR.size(), threadID);
-					mesh->bufferOffset_PRE = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, mesh->vertices_Transformed_PRE.data(), sizeof(Mesh::Vertex_POS)*mesh->vertices_Transformed_PRE.size(), threadID);
+					// Upload CPU skinned vertex buffer (Soft body VB), the three streams in one allocation:
+					const size_t sizePOS = sizeof(Mesh::Vertex_POS)*mesh->vertices_Transformed_POS.size();
+					const size_t sizeNOR = sizeof(Mesh::Vertex_NOR)*mesh->vertices_Transformed_NOR.size();
+					const size_t sizePRE = sizeof(Mesh::Vertex_POS)*mesh->vertices_Transformed_PRE.size();
+					wiUploadAllocator::Allocation allocation = uploadAllocator.Allocate(sizePOS + sizeNOR + sizePRE, threadID);
+					if (allocation.IsValid())
+					{
+						uint8_t* data = reinterpret_cast<uint8_t*>(allocation.data);
+						memcpy(data, mesh->vertices_Transformed_POS.data(), sizePOS);
+						memcpy(data + sizePOS, mesh->vertices_Transformed_NOR.data(), sizeNOR);
+						memcpy(data + sizePOS + sizeNOR, mesh->vertices_Transformed_PRE.data(), sizePRE);
+						uploadAllocator.Unmap(allocation, threadID);
+
+						mesh->dynamicVertexBuffer = allocation.buffer;
+						mesh->bufferOffset_POS = allocation.offset;
+						mesh->bufferOffset_NOR = allocation.offset + (UINT)sizePOS;
+						mesh->bufferOffset_PRE = allocation.offset + (UINT)(sizePOS + sizeNOR);
+					}
 				}
 			}
 		}
@@ -2169,7 +2724,7 @@ void wiRenderer::OcclusionCulling_Render(GRAPHICSTHREAD threadID)
 		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter)
 		{
 			Mesh* mesh = iter->first;
-			if (!mesh->renderable)
+			if (!mesh->renderable || !mesh->buffersComplete) // not resident (streamed out)
 			{
 				continue;
 			}
@@ -2203,7 +2758,7 @@ void wiRenderer::OcclusionCulling_Render(GRAPHICSTHREAD threadID)
 					queryID++;
 
 					// previous frame view*projection because these are drawn against the previous depth buffer:
-					cb.mTransform = XMMatrixTranspose(instance->GetOBB()*prevFrameCam->GetViewProjection()); 
+					cb.mTransform = XMMatrixTranspose(instance->GetOBB()*GetPrevFramePacket().camera->GetViewProjection()); 
 					GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_MISC], &cb, threadID);
 
 					// render bounding box to later read the occlusion status
@@ -2238,7 +2793,7 @@ void wiRenderer::OcclusionCulling_Read()
 		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter)
 		{
 			Mesh* mesh = iter->first;
-			if (!mesh->renderable || mesh->softBody) // todo: correct softbody
+			if (!mesh->renderable || !mesh->buffersComplete || mesh->softBody) // todo: correct softbody
 			{
 				continue;
 			}
@@ -2792,7 +3347,13 @@ void wiRenderer::DrawDebugEmitters(Camera* camera, GRAPHICSTHREAD threadID)
 				GetDevice()->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, nullptr, threadID);
 				GetDevice()->BindIndexBuffer(&x->object->mesh->indexBuffer, x->object->mesh->GetIndexFormat(), 0, threadID);
 
-				GetDevice()->DrawIndexed((int)x->object->mesh->indices.size(), 0, 0, threadID);
+				for (auto& subset : x->object->mesh->subsets)
+				{
+					for (auto& range : subset.drawRanges)
+					{
+						GetDevice()->DrawIndexed((int)range.indexCount, range.indexOffset, range.baseVertex, threadID);
+					}
+				}
 			}
 		}
 
@@ -2929,16 +3490,16 @@ void wiRenderer::DrawTrails(GRAPHICSTHREAD threadID, Texture2D* refracRes)
 			}
 			if (!trails.empty())
 			{
-				UINT trailOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, trails.data(), sizeof(RibbonVertex)*trails.size(), threadID);
+				const wiUploadAllocator::Allocation trailAllocation = uploadAllocator.Upload(trails.data(), sizeof(RibbonVertex)*trails.size(), threadID);
 
 				const GPUBuffer* vbs[] = {
-					dynamicVertexBufferPool
+					trailAllocation.buffer
 				};
 				const UINT strides[] = {
 					sizeof(RibbonVertex)
 				};
 				const UINT offsets[] = {
-					trailOffset
+					trailAllocation.offset
 				};
 				GetDevice()->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
 				GetDevice()->Draw((int)trails.size(), 0, threadID);
@@ -3364,6 +3925,150 @@ void wiRenderer::SetShadowPropsCube(int resolution, int count)
 	desc.MiscFlags = RESOURCE_MISC_TEXTURECUBE;
 	GetDevice()->CreateTexture2D(&desc, nullptr, &Light::shadowMapArray_Cube);
 }
+void wiRenderer::RecordParallel(const vector<function<void(GRAPHICSTHREAD)>>& items, GRAPHICSTHREAD threadID)
+{
+	GraphicsDevice* device = GetDevice();
+
+	if (!parallelRecording || items.size() < 2 || threadID >= GRAPHICSTHREAD_WORKER0 ||
+		!device->CheckCapability(GraphicsDevice::GRAPHICSDEVICE_CAPABILITY_MULTITHREADED_RENDERING))
+	{
+		for (auto& item : items)
+		{
+			item(threadID);
+		}
+		return;
+	}
+
+	// Every item of a round gets its own worker thread, the rounds are executed in order:
+	for (size_t first = 0; first < items.size(); first += GRAPHICSTHREAD_WORKER_COUNT)
+	{
+		const size_t count = min(items.size() - first, (size_t)GRAPHICSTHREAD_WORKER_COUNT);
+
+		wiJobSystem::Counter counter;
+		for (size_t i = 0; i < count; ++i)
+		{
+			wiJobSystem::Execute(counter, [&items, device, first, i] {
+				const GRAPHICSTHREAD worker = (GRAPHICSTHREAD)(GRAPHICSTHREAD_WORKER0 + i);
+				BindPersistentState(worker);
+				items[first + i](worker);
+				device->FinishCommandList(worker);
+			});
+		}
+		wiJobSystem::Wait(counter);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			device->ExecuteCommandList((GRAPHICSTHREAD)(GRAPHICSTHREAD_WORKER0 + i), threadID);
+		}
+	}
+}
+
+void wiRenderer::UpdateDynamicObjects()
+{
+	dynamicObjects.clear();
+	for (Model* model : GetScene().models)
+	{
+		for (Object* object : model->objects)
+		{
+			if (object->isDynamic())
+			{
+				dynamicObjects.push_back(object);
+			}
+			else if (memcmp(&object->world, &object->worldPrev, sizeof(XMFLOAT4X4)) != 0)
+			{
+				// A static object moved, so it can have entered or left any shadow view:
+				sceneEpoch++;
+			}
+		}
+	}
+}
+bool wiRenderer::UpdateShadowView(ShadowView& view, const XMFLOAT4X4& volume, const XMFLOAT4& volumeParams, int shadowMapIndex,
+	const function<void(CulledList&)>& cullStatic, const function<bool(const AABB&)>& intersects)
+{
+	const uint64_t frame = GetDevice()->GetFrameCount();
+	shadowCullingStats.views++;
+
+	// Read once, the materials can be changed by other threads meanwhile:
+	const uint64_t epoch = sceneEpoch.load();
+	const bool volumeChanged = view.epoch != epoch ||
+		memcmp(&view.volume, &volume, sizeof(volume)) != 0 || memcmp(&view.volumeParams, &volumeParams, sizeof(volumeParams)) != 0;
+	if (volumeChanged)
+	{
+		CulledList culledObjects;
+		cullStatic(culledObjects);
+		view.staticCasters.clear();
+		for (Cullable* x : culledObjects)
+		{
+			Object* object = (Object*)x;
+			if (object->IsCastingShadow() && !object->isDynamic())
+			{
+				view.staticCasters.push_back(object);
+			}
+		}
+		view.volume = volume;
+		view.volumeParams = volumeParams;
+		view.epoch = epoch;
+		shadowCullingStats.viewsCulled++;
+	}
+	else
+	{
+		shadowCullingStats.viewsReused++;
+	}
+
+	view.dynamicCasters.clear();
+	for (Object* object : dynamicObjects)
+	{
+		if (object->IsCastingShadow() && intersects(object->bounds))
+		{
+			view.dynamicCasters.push_back(object);
+		}
+	}
+	const bool hasDynamicCasters = !view.dynamicCasters.empty();
+
+	// Streaming can make casters appear or disappear without changing the scene:
+	UINT residentCasters = 0;
+	// Casters with wind weights are animated by the shadow vertex shaders while the wind blows:
+	const XMFLOAT3& windDirection = GetScene().wind.direction;
+	const bool windy = windDirection.x != 0 || windDirection.y != 0 || windDirection.z != 0;
+	bool hasWindCasters = false;
+	for (Object* object : view.staticCasters)
+	{
+		if (object->mesh->renderable && object->mesh->buffersComplete)
+		{
+			residentCasters++;
+		}
+		hasWindCasters = hasWindCasters || (windy && object->mesh->windAffected);
+	}
+
+	const bool unchanged = !volumeChanged && !hasDynamicCasters && !view.hadDynamicCasters && !hasWindCasters && !view.hadWindCasters &&
+		residentCasters == view.residentCasters;
+	const bool sliceValid = view.shadowMapIndex == shadowMapIndex && view.frame + 1 == frame;
+
+	if (!unchanged)
+	{
+		view.culledRenderer.clear();
+		for (Object* object : view.staticCasters)
+		{
+			view.culledRenderer[object->mesh].push_front(object);
+		}
+		for (Object* object : view.dynamicCasters)
+		{
+			view.culledRenderer[object->mesh].push_front(object);
+		}
+	}
+	view.hadDynamicCasters = hasDynamicCasters;
+	view.hadWindCasters = hasWindCasters;
+	view.residentCasters = residentCasters;
+	view.shadowMapIndex = shadowMapIndex;
+	view.frame = frame;
+
+	if (shadowMapSkipping && unchanged && sliceValid)
+	{
+		shadowCullingStats.viewsSkipped++;
+		return false;
+	}
+	return !view.culledRenderer.empty();
+}
 void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 {
 	if (wireRender)
@@ -3381,57 +4086,33 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 		const FrameCulling& culling = frameCullings[getCamera()];
 		const CulledList& culledLights = culling.culledLights;
 
-		ViewPort vp;
-
 		if (!culledLights.empty())
 		{
 			GetDevice()->UnBindResources(TEXSLOT_SHADOWARRAY_2D, 2, threadID);
 
-			GetDevice()->BindPrimitiveTopology(TRIANGLELIST, threadID);
-
-			GetDevice()->BindBlendState(blendStates[BSTYPE_COLORWRITEDISABLE], threadID);
+			// Every shadow map slice is an item that can be recorded on its own thread. The culling is done here,
+			//	the items only render the casters that the shadow views keep in place until they are recorded:
+			vector<function<void(GRAPHICSTHREAD)>> items;
+
+			shadowCullingStats = ShadowCullingStats();
+			wiTimer cullingTimer;
+			wiProfiler::GetInstance().BeginRange("Shadow Culling", wiProfiler::DOMAIN_CPU);
+
+			auto bindViewport = [](float resolution, GRAPHICSTHREAD threadID) {
+				ViewPort vp;
+				vp.TopLeftX = 0;
+				vp.TopLeftY = 0;
+				vp.Width = resolution;
+				vp.Height = resolution;
+				vp.MinDepth = 0.0f;
+				vp.MaxDepth = 1.0f;
+				GetDevice()->BindViewports(1, &vp, threadID);
+			};
 
 			int shadowCounter_2D = 0;
 			int shadowCounter_Cube = 0;
 			for (int type = 0; type < Light::LIGHTTYPE_COUNT; ++type)
 			{
-				switch (type)
-				{
-				case Light::DIRECTIONAL:
-				case Light::SPOT:
-				{
-					vp.TopLeftX = 0;
-					vp.TopLeftY = 0;
-					vp.Width = (float)SHADOWRES_2D;
-					vp.Height = (float)SHADOWRES_2D;
-					vp.MinDepth = 0.0f;
-					vp.MaxDepth = 1.0f;
-					GetDevice()->BindViewports(1, &vp, threadID);
-					break;
-				}
-				break;
-				case Light::POINT:
-				case Light::SPHERE:
-				case Light::DISC:
-				case Light::RECTANGLE:
-				case Light::TUBE:
-				{
-					vp.TopLeftX = 0;
-					vp.TopLeftY = 0;
-					vp.Width = (float)SHADOWRES_CUBE;
-					vp.Height = (float)SHADOWRES_CUBE;
-					vp.MinDepth = 0.0f;
-					vp.MaxDepth = 1.0f;
-					GetDevice()->BindViewports(1, &vp, threadID);
-
-					GetDevice()->BindConstantBufferGS(constantBuffers[CBTYPE_CUBEMAPRENDER], CB_GETBINDSLOT(CubeMapRenderCB), threadID);
-					break;
-				}
-				break;
-				default:
-					break;
-				}
-
 				for (Cullable* c : culledLights)
 				{
 					Light* l = (Light*)c;
@@ -3456,27 +4137,25 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 							boundingbox.createFromHalfWidth(XMFLOAT3(0, 0, 0), XMFLOAT3(siz, f, siz));
 							if (spTree != nullptr)
 							{
-								CulledList culledObjects;
-								CulledCollection culledRenderer;
-								spTree->getVisible(boundingbox.get(XMMatrixInverse(0, XMLoadFloat4x4(&l->shadowCam_dirLight[index].View))), culledObjects);
-								for (Cullable* x : culledObjects)
-								{
-									Object* object = (Object*)x;
-									if (object->IsCastingShadow())
-									{
-										culledRenderer[object->mesh].push_front(object);
-									}
-								}
-								if (!culledRenderer.empty())
+								AABB volume = boundingbox.get(XMMatrixInverse(0, XMLoadFloat4x4(&l->shadowCam_dirLight[index].View)));
+								ShadowView& view = shadowViews[(size_t)l + index];
+								const bool render = UpdateShadowView(view, l->shadowCam_dirLight[index].View, XMFLOAT4(siz, f, 0, 0), l->shadowMap_index + index,
+									[&](CulledList& culledObjects) { spTree->getVisible(volume, culledObjects); },
+									[&](const AABB& bounds) { return volume.intersects(bounds) != AABB::OUTSIDE; });
+								const CulledCollection& culledRenderer = view.culledRenderer;
+								if (render)
 								{
-									GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_2D, threadID, l->shadowMap_index + index);
-									GetDevice()->ClearDepthStencil(Light::shadowMapArray_2D, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index + index);
+									items.push_back([l, index, &culledRenderer, bindViewport](GRAPHICSTHREAD threadID) {
+										bindViewport((float)SHADOWRES_2D, threadID);
+										GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_2D, threadID, l->shadowMap_index + index);
+										GetDevice()->ClearDepthStencil(Light::shadowMapArray_2D, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index + index);
 
-									CameraCB cb;
-									cb.mVP = l->shadowCam_dirLight[index].getVP();
-									GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CAMERA], &cb, threadID);
+										CameraCB cb;
+										cb.mVP = l->shadowCam_dirLight[index].getVP();
+										GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CAMERA], &cb, threadID);
 
-									RenderMeshes(l->shadowCam_dirLight[index].Eye, culledRenderer, SHADERTYPE_SHADOW, RENDERTYPE_OPAQUE, threadID);
+										RenderMeshes(l->shadowCam_dirLight[index].Eye, culledRenderer, SHADERTYPE_SHADOW, RENDERTYPE_OPAQUE, threadID);
+									});
 								}
 							}
 						}
@@ -3492,27 +4171,26 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 						frustum.ConstructFrustum(l->shadowCam_spotLight[0].farplane, l->shadowCam_spotLight[0].realProjection, l->shadowCam_spotLight[0].View);
 						if (spTree != nullptr)
 						{
-							CulledList culledObjects;
-							CulledCollection culledRenderer;
-							spTree->getVisible(frustum, culledObjects);
-							for (Cullable* x : culledObjects)
-							{
-								Object* object = (Object*)x;
-								if (object->IsCastingShadow())
-								{
-									culledRenderer[object->mesh].push_front(object);
-								}
-							}
-							if (!culledRenderer.empty())
+							XMFLOAT4X4 volume;
+							XMStoreFloat4x4(&volume, l->shadowCam_spotLight[0].getVP());
+							ShadowView& view = shadowViews[(size_t)l];
+							const bool render = UpdateShadowView(view, volume, XMFLOAT4(l->shadowCam_spotLight[0].farplane, 0, 0, 0), l->shadowMap_index,
+								[&](CulledList& culledObjects) { spTree->getVisible(frustum, culledObjects); },
+								[&](const AABB& bounds) { return frustum.CheckBox(bounds) != 0; });
+							const CulledCollection& culledRenderer = view.culledRenderer;
+							if (render)
 							{
-								GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_2D, threadID, l->shadowMap_index);
-								GetDevice()->ClearDepthStencil(Light::shadowMapArray_2D, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index);
+								items.push_back([l, &culledRenderer, bindViewport](GRAPHICSTHREAD threadID) {
+									bindViewport((float)SHADOWRES_2D, threadID);
+									GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_2D, threadID, l->shadowMap_index);
+									GetDevice()->ClearDepthStencil(Light::shadowMapArray_2D, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index);
 
-								CameraCB cb;
-								cb.mVP = l->shadowCam_spotLight[0].getVP();
-								GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CAMERA], &cb, threadID);
+									CameraCB cb;
+									cb.mVP = l->shadowCam_spotLight[0].getVP();
+									GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CAMERA], &cb, threadID);
 
-								RenderMeshes(l->translation, culledRenderer, SHADERTYPE_SHADOW, RENDERTYPE_OPAQUE, threadID);
+									RenderMeshes(l->translation, culledRenderer, SHADERTYPE_SHADOW, RENDERTYPE_OPAQUE, threadID);
+								});
 							}
 						}
 					}
@@ -3529,33 +4207,33 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 
 						if (spTree != nullptr)
 						{
-							CulledList culledObjects;
-							CulledCollection culledRenderer;
-							spTree->getVisible(l->bounds, culledObjects);
-							for (Cullable* x : culledObjects)
+							// One view for the whole cube, its faces are rendered in one pass:
+							AABB volume = l->bounds;
+							ShadowView& view = shadowViews[(size_t)l];
+							const bool render = UpdateShadowView(view, l->world, XMFLOAT4(l->GetRange(), 0, 0, 0), l->shadowMap_index,
+								[&](CulledList& culledObjects) { spTree->getVisible(volume, culledObjects); },
+								[&](const AABB& bounds) { return volume.intersects(bounds) != AABB::OUTSIDE; });
+							const CulledCollection& culledRenderer = view.culledRenderer;
+							if (render)
 							{
-								Object* object = (Object*)x;
-								if (object->IsCastingShadow())
-								{
-									culledRenderer[object->mesh].push_front(object);
-								}
-							}
-							if (!culledRenderer.empty())
-							{
-								GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_Cube, threadID, l->shadowMap_index);
-								GetDevice()->ClearDepthStencil(Light::shadowMapArray_Cube, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index);
+								items.push_back([l, &culledRenderer, bindViewport](GRAPHICSTHREAD threadID) {
+									bindViewport((float)SHADOWRES_CUBE, threadID);
+									GetDevice()->BindConstantBufferGS(constantBuffers[CBTYPE_CUBEMAPRENDER], CB_GETBINDSLOT(CubeMapRenderCB), threadID);
+									GetDevice()->BindRenderTargets(0, nullptr, Light::shadowMapArray_Cube, threadID, l->shadowMap_index);
+									GetDevice()->ClearDepthStencil(Light::shadowMapArray_Cube, CLEAR_DEPTH, 0.0f, 0, threadID, l->shadowMap_index);
 
-								MiscCB miscCb;
-								miscCb.mColor = XMFLOAT4(l->translation.x, l->translation.y, l->translation.z, 1.0f / l->GetRange()); // reciprocal range, to avoid division in shader
-								GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_MISC], &miscCb, threadID);
+									MiscCB miscCb;
+									miscCb.mColor = XMFLOAT4(l->translation.x, l->translation.y, l->translation.z, 1.0f / l->GetRange()); // reciprocal range, to avoid division in shader
+									GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_MISC], &miscCb, threadID);
 
-								CubeMapRenderCB cb;
-								for (unsigned int shcam = 0; shcam < l->shadowCam_pointLight.size(); ++shcam)
-									cb.mViewProjection[shcam] = l->shadowCam_pointLight[shcam].getVP();
+									CubeMapRenderCB cb;
+									for (unsigned int shcam = 0; shcam < l->shadowCam_pointLight.size(); ++shcam)
+										cb.mViewProjection[shcam] = l->shadowCam_pointLight[shcam].getVP();
 
-								GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CUBEMAPRENDER], &cb, threadID);
+									GetDevice()->UpdateBuffer(constantBuffers[CBTYPE_CUBEMAPRENDER], &cb, threadID);
 
-								RenderMeshes(l->translation, culledRenderer, SHADERTYPE_SHADOWCUBE, RENDERTYPE_OPAQUE, threadID);
+									RenderMeshes(l->translation, culledRenderer, SHADERTYPE_SHADOWCUBE, RENDERTYPE_OPAQUE, threadID);
+								});
 							}
 						}
 					}
@@ -3565,6 +4243,11 @@ void wiRenderer::DrawForShadowMap(GRAPHICSTHREAD threadID)
 
 			}
 
+			wiProfiler::GetInstance().EndRange(); // Shadow Culling
+			shadowCullingStats.cullingTime = (float)cullingTimer.elapsed();
+
+			RecordParallel(items, threadID);
+
 			GetDevice()->BindGS(nullptr, threadID);
 			GetDevice()->BindRenderTargets(0, nullptr, nullptr, threadID);
 		}
@@ -4002,6 +4685,78 @@ PSTYPES GetPSTYPE(SHADERTYPE shaderType, const Material* const material, bool di
 
 	return realPS;
 }
+wiRenderer::InstanceAllocation wiRenderer::AllocateInstances(Mesh* mesh, bool impostor, bool prevRequested, GRAPHICSTHREAD threadID)
+{
+	GraphicsDevice* device = GetDevice();
+	RenderQueueContext& context = renderQueueContexts[threadID];
+	const auto& visibleInstances = context.visibleInstances;
+	const UINT count = (UINT)visibleInstances.size();
+
+	// Identify the instance set by the mesh, the instances and their dither:
+	uint64_t hash = 14695981039346656037ull;
+	hash = (hash ^ (uint64_t)(size_t)mesh) * 1099511628211ull;
+	hash = (hash ^ (impostor ? 1ull : 0ull)) * 1099511628211ull;
+	for (auto& x : visibleInstances)
+	{
+		uint32_t dither;
+		memcpy(&dither, &x.second, sizeof(dither));
+		hash = (hash ^ (uint64_t)(size_t)x.first) * 1099511628211ull;
+		hash = (hash ^ dither) * 1099511628211ull;
+	}
+
+	// The allocations are only kept for the frame. A deferred thread discards its upload page in every new command list
+	//	(the parallel recording rounds), so they are only kept for its command list too:
+	if (context.instanceCacheFrame != device->GetFrameCount() || context.instanceCacheCommandList != device->GetCommandListCount(threadID))
+	{
+		context.instanceCache.clear();
+		context.instanceCacheFrame = device->GetFrameCount();
+		context.instanceCacheCommandList = device->GetCommandListCount(threadID);
+	}
+
+	auto it = context.instanceCache.find(hash);
+	if (it != context.instanceCache.end() && it->second.mesh == mesh && it->second.count == count && (it->second.hasPrev || !prevRequested))
+	{
+		return it->second;
+	}
+
+	// The instances and the previous transforms are written in one allocation, straight into the mapped buffer:
+	const size_t instanceSize = sizeof(Instance) * count;
+	const size_t dataSize = instanceSize + (prevRequested ? sizeof(InstancePrev) * count : 0);
+	const wiUploadAllocator::Allocation upload = uploadAllocator.Allocate(dataSize, threadID);
+	uint8_t* data = reinterpret_cast<uint8_t*>(upload.data);
+
+	InstanceAllocation allocation;
+	allocation.mesh = mesh;
+	allocation.buffer = upload.buffer;
+	allocation.count = count;
+	allocation.offset = upload.offset;
+	allocation.prevOffset = prevRequested ? upload.offset + (UINT)instanceSize : 0;
+	allocation.hasPrev = prevRequested;
+
+	Instance* instances = reinterpret_cast<Instance*>(data);
+	InstancePrev* instancesPrev = reinterpret_cast<InstancePrev*>(data + instanceSize);
+	const XMMATRIX boxMat = impostor ? mesh->aabb.getAsBoxMatrix() : XMMatrixIdentity();
+	const bool identity = mesh->softBody && !impostor; // soft bodies are simulated in world space
+	for (UINT i = 0; i < count; ++i)
+	{
+		const Object* instance = visibleInstances[i].first;
+
+		XMMATRIX world = identity ? XMMatrixIdentity() : XMLoadFloat4x4(&instance->world);
+		instances[i].Create(impostor ? boxMat * world : world, visibleInstances[i].second, instance->color);
+
+		if (prevRequested)
+		{
+			XMMATRIX worldPrev = identity ? XMMatrixIdentity() : XMLoadFloat4x4(&instance->worldPrev);
+			instancesPrev[i].Create(impostor ? boxMat * worldPrev : worldPrev);
+		}
+	}
+	uploadAllocator.Unmap(upload, threadID);
+
+	context.instanceCache[hash] = allocation;
+
+	return allocation;
+}
+
 void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culledRenderer, SHADERTYPE shaderType, UINT renderTypeFlags, GRAPHICSTHREAD threadID,
 	bool tessellation, bool occlusionCulling)
 {
@@ -4022,11 +4777,8 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 		UINT prevStencilRef = STENCILREF_DEFAULT;
 		device->BindDepthStencilState(depthStencils[targetDepthStencilState], prevStencilRef, threadID);
 
-		const XMFLOAT4X4 __identityMat = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
-		XMFLOAT4X4 tempMat;
-
-		Instance instances[1024];
-		InstancePrev instancesPrev[1024];
+		RenderQueueContext& context = renderQueueContexts[threadID];
+		auto& visibleInstances = context.visibleInstances;
 
 		if (shaderType == SHADERTYPE_DEPTHONLY || shaderType == SHADERTYPE_SHADOW || shaderType == SHADERTYPE_SHADOWCUBE)
 		{
@@ -4054,6 +4806,13 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 			shaderType != SHADERTYPE_SHADOWCUBE && 
 			shaderType != SHADERTYPE_ENVMAPCAPTURE;
 
+		// The depth prepass also writes the previous transforms, so that the main pass can reuse its instances:
+		const bool instancePrevRequested = 
+			shaderType == SHADERTYPE_FORWARD || 
+			shaderType == SHADERTYPE_TILEDFORWARD || 
+			shaderType == SHADERTYPE_DEFERRED || 
+			shaderType == SHADERTYPE_DEPTHONLY;
+
 		// Render impostors:
 		if (impostorRequest)
 		{
@@ -4102,16 +4861,12 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 					device->BindRasterizerState(wireRender ? rasterizers[RSTYPE_WIRE] : rasterizers[RSTYPE_FRONT], threadID);
 					device->BindVertexLayout(vertexLayouts[realVL], threadID);
 					device->BindVS(vertexShaders[realVS], threadID);
-					device->BindPS(pixelShaders[realPS], threadID);
+					device->BindPS(GetObjectPixelShader(realPS), threadID);
 					SetAlphaRef(0.75f, threadID);
 				}
 
-				const CulledObjectList& visibleInstances = iter->second;
-
-				bool instancePrevUpdated = false;
-
-				int k = 0;
-				for (const Object* instance : visibleInstances)
+				visibleInstances.clear();
+				for (const Object* instance : iter->second)
 				{
 					if (instance->emitterType == Object::EmitterType::EMITTER_INVISIBLE || (occlusionCulling && instance->IsOccluded()))
 						continue;
@@ -4123,38 +4878,22 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 					if (dither > 1.0f - FLT_EPSILON)
 						continue;
 
-					assert(k < ARRAYSIZE(instances) && "Instance buffer full!");
-
-					XMMATRIX boxMat = mesh->aabb.getAsBoxMatrix();
-
-					XMStoreFloat4x4(&tempMat, boxMat*XMLoadFloat4x4(&instance->world));
-					instances[k].Create(tempMat, dither, instance->color);
-
-					if (shaderType == SHADERTYPE_FORWARD || shaderType == SHADERTYPE_TILEDFORWARD || shaderType == SHADERTYPE_DEFERRED)
-					{
-						XMStoreFloat4x4(&tempMat, boxMat*XMLoadFloat4x4(&instance->worldPrev));
-						instancesPrev[k].Create(tempMat);
-						instancePrevUpdated = true;
-					}
-
-					++k;
+					visibleInstances.push_back(make_pair(instance, dither));
 				}
-				if (k < 1)
+				if (visibleInstances.empty())
 					continue;
 
-				UINT instanceOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, instances, sizeof(Instance)*k, threadID);
-				UINT instancePrevOffset = 0;
-				if (instancePrevUpdated)
-				{
-					instancePrevOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, instances, sizeof(InstancePrev)*k, threadID);
-				}
+				const InstanceAllocation instanceAllocation = AllocateInstances(mesh, true, instancePrevRequested, threadID);
+				GPUBuffer* instanceBuffer = instanceAllocation.buffer;
+				const UINT instanceOffset = instanceAllocation.offset;
+				const UINT instancePrevOffset = instanceAllocation.prevOffset;
 
 				if (realVL == VLTYPE_OBJECT_POS_TEX)
 				{
 					GPUBuffer* vbs[] = {
 						&Mesh::impostorVB_POS,
 						&Mesh::impostorVB_TEX,
-						dynamicVertexBufferPool
+						instanceBuffer
 					};
 					UINT strides[] = {
 						sizeof(Mesh::Vertex_POS),
@@ -4175,8 +4914,8 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 						&Mesh::impostorVB_NOR,
 						&Mesh::impostorVB_TEX,
 						&Mesh::impostorVB_POS,
-						dynamicVertexBufferPool,
-						dynamicVertexBufferPool
+						instanceBuffer,
+						instanceBuffer
 					};
 					UINT strides[] = {
 						sizeof(Mesh::Vertex_POS),
@@ -4206,53 +4945,45 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 				};
 				device->BindResourcesPS(res, TEXSLOT_ONDEMAND0, (easyTextureBind ? 1 : ARRAYSIZE(res)), threadID);
 
-				device->DrawInstanced(6 * 6, k, 0, 0, threadID); // 6 * 6: see Mesh::CreateImpostorVB function
+				device->DrawInstanced(6 * 6, instanceAllocation.count, 0, 0, threadID); // 6 * 6: see Mesh::CreateImpostorVB function
 
 			}
 		}
 
-		VLTYPES prevVL = VLTYPE_NULL;
-		VSTYPES prevVS = VSTYPE_NULL;
-		GSTYPES prevGS = GSTYPE_NULL;
-		HSTYPES prevHS = HSTYPE_NULL;
-		DSTYPES prevDS = DSTYPE_NULL;
-		PSTYPES prevPS = PSTYPE_NULL;
-		PRIMITIVETOPOLOGY prevTOPOLOGY = TRIANGLELIST;
-		RSTYPES prevRS = RSTYPE_FRONT;
-		device->BindVS(nullptr, threadID);
-		device->BindGS(nullptr, threadID);
-		device->BindHS(nullptr, threadID);
-		device->BindDS(nullptr, threadID);
-		device->BindPS(nullptr, threadID);
-		device->BindPrimitiveTopology(prevTOPOLOGY, threadID);
-		device->BindRasterizerState(rasterizers[prevRS], threadID);
+		enum BOUNDVERTEXBUFFERTYPE
+		{
+			BOUNDVERTEXBUFFERTYPE_NOTHING,
+			BOUNDVERTEXBUFFERTYPE_POSITION,
+			BOUNDVERTEXBUFFERTYPE_POSITION_TEXCOORD,
+			BOUNDVERTEXBUFFERTYPE_EVERYTHING,
+		};
+
+		wiRenderQueue& renderQueue = context.queue;
+		vector<MeshBatch>& batches = context.batches;
+		vector<MeshPipeline>& pipelines = context.pipelines;
+		renderQueue.Clear();
+		batches.clear();
+		pipelines.clear();
+
+		// Opaque draws are sorted by state and front to back, the rest back to front:
+		const bool sortBackToFront = !(renderTypeFlags & RENDERTYPE_OPAQUE);
+		float maxDistance = 0;
 
-		// Render meshes:
+		// Collect the instances of the meshes and a packet for every subset that is drawn:
 		for (CulledCollection::const_iterator iter = culledRenderer.begin(); iter != culledRenderer.end(); ++iter) 
 		{
 			Mesh* mesh = iter->first;
-			if (!mesh->renderable)
+			if (!mesh->renderable || !mesh->buffersComplete) // not resident (streamed out)
 			{
 				continue;
 			}
 
-			const CulledObjectList& visibleInstances = iter->second;
-
 			const float tessF = mesh->getTessellationFactor();
 			const bool tessellatorRequested = tessF > 0 && tessellation;
 
-			PRIMITIVETOPOLOGY realTOPOLOGY = TRIANGLELIST;
+			PRIMITIVETOPOLOGY realTOPOLOGY = tessellatorRequested ? PATCHLIST : TRIANGLELIST;
 			RSTYPES realRS = RSTYPE_FRONT;
 
-			if (tessellatorRequested)
-			{
-				TessellationCB tessCB;
-				tessCB.tessellationFactors = XMFLOAT4(tessF, tessF, tessF, tessF);
-				device->UpdateBuffer(constantBuffers[CBTYPE_TESSELLATION], &tessCB, threadID);
-				device->BindConstantBufferHS(constantBuffers[CBTYPE_TESSELLATION], CBSLOT_RENDERER_TESSELLATION, threadID);
-				realTOPOLOGY = PATCHLIST;
-			}
-
 			if (shaderType == SHADERTYPE_VOXELIZE)
 			{
 				realRS = RSTYPE_VOXELIZE;
@@ -4276,87 +5007,58 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 				}
 			}
 
-			if (prevTOPOLOGY != realTOPOLOGY)
-			{
-				prevTOPOLOGY = realTOPOLOGY;
-				device->BindPrimitiveTopology(realTOPOLOGY, threadID);
-			}
-			if (prevRS != realRS)
-			{
-				prevRS = realRS;
-				device->BindRasterizerState(rasterizers[realRS], threadID);
-			}
-
-
-			bool instancePrevUpdated = false;
 
 			bool forceAlphaTestForDithering = false;
 
-			int k = 0;
-			for (const Object* instance : visibleInstances) 
+			float distance = FLT_MAX;
+
+			visibleInstances.clear();
+			for (const Object* instance : iter->second) 
 			{
 				if (instance->emitterType == Object::EmitterType::EMITTER_INVISIBLE || (occlusionCulling && instance->IsOccluded()))
 					continue;
 
+				const float dist = wiMath::Distance(eye, instance->bounds.getCenter());
 				float dither = instance->transparency;
 				if (impostorRequest)
 				{
 					// fade out to impostor...
 					const float impostorThreshold = instance->bounds.getRadius();
-					float dist = wiMath::Distance(eye, instance->bounds.getCenter());
 					if (mesh->hasImpostor())
 						dither = wiMath::SmoothStep(dither, 1.0f, wiMath::Clamp((dist - impostorThreshold - mesh->impostorDistance) / impostorThreshold, 0, 1));
 				}
 				if (dither > 1.0f - FLT_EPSILON)
 					continue;
 
-				assert(k < ARRAYSIZE(instances) && "Instance buffer full!");
-
 				forceAlphaTestForDithering = forceAlphaTestForDithering || (dither > 0);
+				distance = min(distance, dist);
 
-				if (mesh->softBody)
-					tempMat = __identityMat;
-				else
-					tempMat = instance->world;
-				instances[k].Create(tempMat, dither, instance->color);
-
-				if (shaderType == SHADERTYPE_FORWARD || shaderType == SHADERTYPE_TILEDFORWARD || shaderType == SHADERTYPE_DEFERRED)
-				{
-					if (mesh->softBody)
-						tempMat = __identityMat;
-					else
-						tempMat = instance->worldPrev;
-					instancesPrev[k].Create(tempMat);
-					instancePrevUpdated = true;
-				}
-						
-				++k;
+				visibleInstances.push_back(make_pair(instance, dither));
 			}
-			if (k < 1)
+			if (visibleInstances.empty())
 				continue;
 
-			UINT instanceOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, instances, sizeof(Instance)*k, threadID);
-			UINT instancePrevOffset = 0;
-			if (instancePrevUpdated)
-			{
-				instancePrevOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, instances, sizeof(InstancePrev)*k, threadID);
-			}
-
+			const InstanceAllocation instanceAllocation = AllocateInstances(mesh, false, instancePrevRequested, threadID);
 
-			device->BindIndexBuffer(&mesh->indexBuffer, mesh->GetIndexFormat(), 0, threadID);
+			MeshBatch batch;
+			batch.mesh = mesh;
+			batch.instanceBuffer = instanceAllocation.buffer;
+			batch.instanceCount = instanceAllocation.count;
+			batch.instanceOffset = instanceAllocation.offset;
+			batch.instancePrevOffset = instanceAllocation.prevOffset;
+			batch.tessellationFactor = tessF;
+			batch.tessellatorRequested = tessellatorRequested;
+			batch.forceAlphaTestForDithering = forceAlphaTestForDithering;
+			batch.distance = distance;
+			maxDistance = max(maxDistance, distance);
 
-			enum class BOUNDVERTEXBUFFERTYPE
-			{
-				NOTHING,
-				POSITION,
-				POSITION_TEXCOORD,
-				EVERYTHING,
-			};
-			BOUNDVERTEXBUFFERTYPE boundVBType_Prev = BOUNDVERTEXBUFFERTYPE::NOTHING;
+			const uint32_t batchIndex = (uint32_t)batches.size();
+			batches.push_back(batch);
 
-			for (MeshSubset& subset : mesh->subsets)
+			for (size_t subsetIndex = 0; subsetIndex < mesh->subsets.size(); ++subsetIndex)
 			{
-				if (subset.subsetIndices.empty() || subset.material->isSky)
+				const MeshSubset& subset = mesh->subsets[subsetIndex];
+				if (subset.indexCount == 0 || subset.material->isSky)
 				{
 					continue;
 				}
@@ -4381,197 +5083,317 @@ void wiRenderer::RenderMeshes(const XMFLOAT3& eye, const CulledCollection& culle
 					subsetRenderable = subsetRenderable && material->IsCastingShadow();
 				}
 
-				if (subsetRenderable)
+				if (!subsetRenderable)
 				{
+					continue;
+				}
 
-					BOUNDVERTEXBUFFERTYPE boundVBType;
-					if (!tessellatorRequested && (shaderType == SHADERTYPE_DEPTHONLY || shaderType == SHADERTYPE_TEXTURE || shaderType == SHADERTYPE_SHADOW || shaderType == SHADERTYPE_SHADOWCUBE))
+				MeshPipeline pipeline;
+				if (!tessellatorRequested && (shaderType == SHADERTYPE_DEPTHONLY || shaderType == SHADERTYPE_TEXTURE || shaderType == SHADERTYPE_SHADOW || shaderType == SHADERTYPE_SHADOWCUBE))
+				{
+					// simple vertex buffers are used in some passes (note: tessellator requires more attributes)
+					if ((shaderType == SHADERTYPE_DEPTHONLY || shaderType == SHADERTYPE_SHADOW || shaderType == SHADERTYPE_SHADOWCUBE) && !material->IsAlphaTestEnabled() && !forceAlphaTestForDithering)
 					{
-						// simple vertex buffers are used in some passes (note: tessellator requires more attributes)
-						if ((shaderType == SHADERTYPE_DEPTHONLY || shaderType == SHADERTYPE_SHADOW || shaderType == SHADERTYPE_SHADOWCUBE) && !material->IsAlphaTestEnabled() && !forceAlphaTestForDithering)
-						{
-							// bypass texcoord stream for non alphatested shadows and zprepass
-							boundVBType = BOUNDVERTEXBUFFERTYPE::POSITION;
-						}
-						else
-						{
-							boundVBType = BOUNDVERTEXBUFFERTYPE::POSITION_TEXCOORD;
-						}
+						// bypass texcoord stream for non alphatested shadows and zprepass
+						pipeline.vertexBufferType = BOUNDVERTEXBUFFERTYPE_POSITION;
 					}
 					else
 					{
-						boundVBType = BOUNDVERTEXBUFFERTYPE::EVERYTHING;
+						pipeline.vertexBufferType = BOUNDVERTEXBUFFERTYPE_POSITION_TEXCOORD;
 					}
+				}
+				else
+				{
+					pipeline.vertexBufferType = BOUNDVERTEXBUFFERTYPE_EVERYTHING;
+				}
+				pipeline.vl = GetVLTYPE(shaderType, material, tessellatorRequested, forceAlphaTestForDithering);
+				pipeline.vs = GetVSTYPE(shaderType, material, tessellatorRequested, forceAlphaTestForDithering);
+				pipeline.gs = GetGSTYPE(shaderType, material);
+				pipeline.hs = GetHSTYPE(shaderType, material, tessellatorRequested);
+				pipeline.ds = GetDSTYPE(shaderType, material, tessellatorRequested);
+				pipeline.ps = wireRender ? PSTYPE_OBJECT_SIMPLEST : GetPSTYPE(shaderType, material, forceAlphaTestForDithering);
+				pipeline.rs = realRS;
+				pipeline.topology = realTOPOLOGY;
+
+				// There are only a handful of different combinations in a pass, so a linear search is enough:
+				uint16_t pipelineIndex = 0;
+				while (pipelineIndex < pipelines.size() && !(pipelines[pipelineIndex] == pipeline))
+				{
+					pipelineIndex++;
+				}
+				if (pipelineIndex == pipelines.size())
+				{
+					pipelines.push_back(pipeline);
+				}
 
-					// Only bind vertex buffers when the layout changes
-					if (boundVBType != boundVBType_Prev)
-					{
-						// Assemble the required vertex buffer:
-						switch (boundVBType)
-						{
-						case BOUNDVERTEXBUFFERTYPE::POSITION:
-						{
-							GPUBuffer* vbs[] = {
-								mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
-								dynamicVertexBufferPool
-							};
-							UINT strides[] = {
-								sizeof(Mesh::Vertex_POS),
-								sizeof(Instance)
-							};
-							UINT offsets[] = {
-								mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-								instanceOffset
-							};
-							device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-						}
-						break;
-						case BOUNDVERTEXBUFFERTYPE::POSITION_TEXCOORD:
-						{
-							GPUBuffer* vbs[] = {
-								mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
-								&mesh->vertexBuffer_TEX,
-								dynamicVertexBufferPool
-							};
-							UINT strides[] = {
-								sizeof(Mesh::Vertex_POS),
-								sizeof(Mesh::Vertex_TEX),
-								sizeof(Instance)
-							};
-							UINT offsets[] = {
-								mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-								0,
-								instanceOffset
-							};
-							device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-						}
-						break;
-						case BOUNDVERTEXBUFFERTYPE::EVERYTHING:
-						{
-							GPUBuffer* vbs[] = {
-								mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
-								mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_NOR.IsValid() ? &mesh->streamoutBuffer_NOR : &mesh->vertexBuffer_NOR),
-								&mesh->vertexBuffer_TEX,
-								mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_PRE.IsValid() ? &mesh->streamoutBuffer_PRE : &mesh->vertexBuffer_POS),
-								dynamicVertexBufferPool,
-								dynamicVertexBufferPool
-							};
-							UINT strides[] = {
-								sizeof(Mesh::Vertex_POS),
-								sizeof(Mesh::Vertex_NOR),
-								sizeof(Mesh::Vertex_TEX),
-								sizeof(Mesh::Vertex_POS),
-								sizeof(Instance),
-								sizeof(InstancePrev),
-							};
-							UINT offsets[] = {
-								mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
-								mesh->hasDynamicVB() ? mesh->bufferOffset_NOR : 0,
-								0,
-								mesh->hasDynamicVB() ? mesh->bufferOffset_PRE : 0,
-								instanceOffset,
-								instancePrevOffset
-							};
-							device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
-						}
-						break;
-						default:
-							assert(0);
-							break;
-						}
-					}
-					boundVBType_Prev = boundVBType;
+				UINT stencilRef = material->GetStencilRef();
+				// todo: better
+				if (material->shadeless)
+				{
+					stencilRef = (material->userStencilRef << 4) | STENCILREF_SHADELESS;
+				}
+				else if (material->subsurfaceScattering > 0)
+				{
+					stencilRef = (material->userStencilRef << 4) | STENCILREF_SKIN;
+				}
 
-					device->BindConstantBufferPS(&material->constantBuffer, CB_GETBINDSLOT(MaterialCB), threadID);
+				// Materials are identified by a hash of their address, a collision only costs redundant binds:
+				const uint64_t materialHash = ((uint64_t)(size_t)material * 0x9E3779B97F4A7C15ull) >> 48;
 
-					UINT realStencilRef = material->GetStencilRef();
-					// todo: better
-					if (material->shadeless)
-					{
-						realStencilRef = (material->userStencilRef << 4) | STENCILREF_SHADELESS;
-					}
-					else if (material->subsurfaceScattering > 0)
-					{
-						realStencilRef = (material->userStencilRef << 4) | STENCILREF_SKIN;
-					}
-					if (prevStencilRef != realStencilRef)
-					{
-						prevStencilRef = realStencilRef;
-						device->BindDepthStencilState(depthStencils[targetDepthStencilState], realStencilRef, threadID);
-					}
+				wiRenderPacket packet;
+				if (sortBackToFront)
+				{
+					// [depth:24][pipeline:12][stencil:8][material:16][unused:4]
+					packet.key = ((uint64_t)(pipelineIndex & 0xFFF) << 28) | ((uint64_t)(stencilRef & 0xFF) << 20) | (materialHash << 4);
+				}
+				else
+				{
+					// [pipeline:12][stencil:8][material:16][depth:12][batch:16]
+					//	The batches of a material are drawn front to back, the batch only orders the ones at the same depth
+					packet.key = ((uint64_t)(pipelineIndex & 0xFFF) << 52) | ((uint64_t)(stencilRef & 0xFF) << 44) | (materialHash << 28) | (uint64_t)(batchIndex & 0xFFFF);
+				}
+				packet.batch = batchIndex;
+				packet.subset = (uint16_t)subsetIndex;
+				packet.pipeline = pipelineIndex;
+				renderQueue.Add(packet);
+			}
+		}
 
-					VLTYPES realVL = GetVLTYPE(shaderType, material, tessellatorRequested, forceAlphaTestForDithering);
-					if (prevVL != realVL)
-					{
-						prevVL = realVL;
-						device->BindVertexLayout(vertexLayouts[realVL], threadID);
-					}
+		if (renderQueueSorting)
+		{
+			// Fill in the distance bits now that the range of distances is known:
+			for (wiRenderPacket& packet : renderQueue.GetPackets())
+			{
+				const float distance = batches[packet.batch].distance;
+				if (sortBackToFront)
+				{
+					packet.key |= (0xFFFFFFull - wiRenderQueue::QuantizeDistance(distance, maxDistance, 24)) << 40;
+				}
+				else
+				{
+					packet.key |= wiRenderQueue::QuantizeDistance(distance, maxDistance, 12) << 16;
+				}
+			}
+			renderQueue.Sort();
+		}
 
-					VSTYPES realVS = GetVSTYPE(shaderType, material, tessellatorRequested, forceAlphaTestForDithering);
-					if (prevVS != realVS)
-					{
-						prevVS = realVS;
-						device->BindVS(vertexShaders[realVS], threadID);
-					}
+		// Submit the packets, the state is only bound when it differs from the previous packet:
+		VLTYPES prevVL = VLTYPE_NULL;
+		VSTYPES prevVS = VSTYPE_NULL;
+		GSTYPES prevGS = GSTYPE_NULL;
+		HSTYPES prevHS = HSTYPE_NULL;
+		DSTYPES prevDS = DSTYPE_NULL;
+		PSTYPES prevPS = PSTYPE_NULL;
+		PRIMITIVETOPOLOGY prevTOPOLOGY = TRIANGLELIST;
+		RSTYPES prevRS = RSTYPE_FRONT;
+		device->BindVS(nullptr, threadID);
+		device->BindGS(nullptr, threadID);
+		device->BindHS(nullptr, threadID);
+		device->BindDS(nullptr, threadID);
+		device->BindPS(nullptr, threadID);
+		device->BindPrimitiveTopology(prevTOPOLOGY, threadID);
+		device->BindRasterizerState(rasterizers[prevRS], threadID);
 
-					GSTYPES realGS = GetGSTYPE(shaderType, material);
-					if (prevGS != realGS)
-					{
-						prevGS = realGS;
-						device->BindGS(geometryShaders[realGS], threadID);
-					}
+		uint32_t prevBatch = UINT32_MAX;
+		int prevVBType = BOUNDVERTEXBUFFERTYPE_NOTHING;
+		float prevTessellationFactor = 0;
+		const Material* prevMaterial = nullptr;
+		const Material* prevTexturesMaterial = nullptr;
+		const Material* prevDisplacementMaterial = nullptr;
 
-					HSTYPES realHS = GetHSTYPE(shaderType, material, tessellatorRequested);
-					if (prevHS = realHS)
-					{
-						prevHS = realHS;
-						device->BindHS(hullShaders[realHS], threadID);
-					}
+		for (const wiRenderPacket& packet : renderQueue.GetPackets())
+		{
+			const MeshBatch& batch = batches[packet.batch];
+			const MeshPipeline& pipeline = pipelines[packet.pipeline];
+			Mesh* mesh = batch.mesh;
+			const MeshSubset& subset = mesh->subsets[packet.subset];
+			Material* material = subset.material;
 
-					DSTYPES realDS = GetDSTYPE(shaderType, material, tessellatorRequested);
-					if (prevDS != realDS)
-					{
-						prevDS = realDS;
-						device->BindDS(domainShaders[realDS], threadID);
-					}
-					if(realDS!=DSTYPE_NULL)
-					{
-						device->BindResourceDS(material->GetDisplacementMap(), TEXSLOT_ONDEMAND5, threadID);
-					}
+			if (prevBatch != packet.batch)
+			{
+				prevBatch = packet.batch;
+				prevVBType = BOUNDVERTEXBUFFERTYPE_NOTHING;
 
-					if (wireRender)
-					{
-						prevPS = PSTYPE_OBJECT_SIMPLEST;
-						device->BindPS(pixelShaders[prevPS], threadID);
-					}
-					else
-					{
-						PSTYPES realPS = GetPSTYPE(shaderType, material, forceAlphaTestForDithering);
-						if (prevPS != realPS)
-						{
-							prevPS = realPS;
-							device->BindPS(pixelShaders[realPS], threadID);
-						}
-						if (realPS != PSTYPE_NULL)
-						{
-							const GPUResource* res[] = {
-								static_cast<const GPUResource*>(material->GetBaseColorMap()),
-								static_cast<const GPUResource*>(material->GetNormalMap()),
-								static_cast<const GPUResource*>(material->GetRoughnessMap()),
-								static_cast<const GPUResource*>(material->GetReflectanceMap()),
-								static_cast<const GPUResource*>(material->GetMetalnessMap()),
-								static_cast<const GPUResource*>(material->GetDisplacementMap()),
-							};
-							device->BindResourcesPS(res, TEXSLOT_ONDEMAND0, (easyTextureBind ? 1 : ARRAYSIZE(res)), threadID);
-						}
-					}
+				if (batch.tessellatorRequested && prevTessellationFactor != batch.tessellationFactor)
+				{
+					prevTessellationFactor = batch.tessellationFactor;
+					TessellationCB tessCB;
+					tessCB.tessellationFactors = XMFLOAT4(batch.tessellationFactor, batch.tessellationFactor, batch.tessellationFactor, batch.tessellationFactor);
+					device->UpdateBuffer(constantBuffers[CBTYPE_TESSELLATION], &tessCB, threadID);
+					device->BindConstantBufferHS(constantBuffers[CBTYPE_TESSELLATION], CBSLOT_RENDERER_TESSELLATION, threadID);
+				}
+
+				device->BindIndexBuffer(&mesh->indexBuffer, mesh->GetIndexFormat(), 0, threadID);
+			}
 
-					SetAlphaRef(material->alphaRef, threadID);
+			// Only bind vertex buffers when the mesh or the layout changes
+			if (prevVBType != pipeline.vertexBufferType)
+			{
+				prevVBType = pipeline.vertexBufferType;
 
-					device->DrawIndexedInstanced((int)subset.subsetIndices.size(), k, subset.indexBufferOffset, 0, 0, threadID);
+				// Assemble the required vertex buffer:
+				switch (pipeline.vertexBufferType)
+				{
+				case BOUNDVERTEXBUFFERTYPE_POSITION:
+				{
+					GPUBuffer* vbs[] = {
+						mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
+						batch.instanceBuffer
+					};
+					UINT strides[] = {
+						sizeof(Mesh::Vertex_POS),
+						sizeof(Instance)
+					};
+					UINT offsets[] = {
+						mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+						batch.instanceOffset
+					};
+					device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+				}
+				break;
+				case BOUNDVERTEXBUFFERTYPE_POSITION_TEXCOORD:
+				{
+					GPUBuffer* vbs[] = {
+						mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
+						&mesh->vertexBuffer_TEX,
+						batch.instanceBuffer
+					};
+					UINT strides[] = {
+						sizeof(Mesh::Vertex_POS),
+						sizeof(Mesh::Vertex_TEX),
+						sizeof(Instance)
+					};
+					UINT offsets[] = {
+						mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+						0,
+						batch.instanceOffset
+					};
+					device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+				}
+				break;
+				case BOUNDVERTEXBUFFERTYPE_EVERYTHING:
+				{
+					GPUBuffer* vbs[] = {
+						mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
+						mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_NOR.IsValid() ? &mesh->streamoutBuffer_NOR : &mesh->vertexBuffer_NOR),
+						&mesh->vertexBuffer_TEX,
+						mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_PRE.IsValid() ? &mesh->streamoutBuffer_PRE : &mesh->vertexBuffer_POS),
+						batch.instanceBuffer,
+						batch.instanceBuffer
+					};
+					UINT strides[] = {
+						sizeof(Mesh::Vertex_POS),
+						sizeof(Mesh::Vertex_NOR),
+						sizeof(Mesh::Vertex_TEX),
+						sizeof(Mesh::Vertex_POS),
+						sizeof(Instance),
+						sizeof(InstancePrev),
+					};
+					UINT offsets[] = {
+						mesh->hasDynamicVB() ? mesh->bufferOffset_POS : 0,
+						mesh->hasDynamicVB() ? mesh->bufferOffset_NOR : 0,
+						0,
+						mesh->hasDynamicVB() ? mesh->bufferOffset_PRE : 0,
+						batch.instanceOffset,
+						batch.instancePrevOffset
+					};
+					device->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
+				}
+				break;
+				default:
+					assert(0);
+					break;
 				}
 			}
 
+			if (prevTOPOLOGY != pipeline.topology)
+			{
+				prevTOPOLOGY = pipeline.topology;
+				device->BindPrimitiveTopology(pipeline.topology, threadID);
+			}
+			if (prevRS != pipeline.rs)
+			{
+				prevRS = pipeline.rs;
+				device->BindRasterizerState(rasterizers[pipeline.rs], threadID);
+			}
+
+			UINT realStencilRef = material->GetStencilRef();
+			// todo: better
+			if (material->shadeless)
+			{
+				realStencilRef = (material->userStencilRef << 4) | STENCILREF_SHADELESS;
+			}
+			else if (material->subsurfaceScattering > 0)
+			{
+				realStencilRef = (material->userStencilRef << 4) | STENCILREF_SKIN;
+			}
+			if (prevStencilRef != realStencilRef)
+			{
+				prevStencilRef = realStencilRef;
+				device->BindDepthStencilState(depthStencils[targetDepthStencilState], realStencilRef, threadID);
+			}
+
+			if (prevVL != pipeline.vl)
+			{
+				prevVL = pipeline.vl;
+				device->BindVertexLayout(vertexLayouts[pipeline.vl], threadID);
+			}
+			if (prevVS != pipeline.vs)
+			{
+				prevVS = pipeline.vs;
+				device->BindVS(vertexShaders[pipeline.vs], threadID);
+			}
+			if (prevGS != pipeline.gs)
+			{
+				prevGS = pipeline.gs;
+				device->BindGS(geometryShaders[pipeline.gs], threadID);
+			}
+			if (prevHS != pipeline.hs)
+			{
+				prevHS = pipeline.hs;
+				device->BindHS(hullShaders[pipeline.hs], threadID);
+			}
+			if (prevDS != pipeline.ds)
+			{
+				prevDS = pipeline.ds;
+				device->BindDS(domainShaders[pipeline.ds], threadID);
+			}
+			if (prevPS != pipeline.ps)
+			{
+				prevPS = pipeline.ps;
+				device->BindPS(GetObjectPixelShader(pipeline.ps), threadID);
+			}
+
+			if (prevMaterial != material)
+			{
+				prevMaterial = material;
+				device->BindConstantBufferPS(&material->constantBuffer, CB_GETBINDSLOT(MaterialCB), threadID);
+			}
+			if (pipeline.ds != DSTYPE_NULL && prevDisplacementMaterial != material)
+			{
+				prevDisplacementMaterial = material;
+				device->BindResourceDS(material->GetDisplacementMap(), TEXSLOT_ONDEMAND5, threadID);
+			}
+			if (!wireRender && pipeline.ps != PSTYPE_NULL && prevTexturesMaterial != material)
+			{
+				prevTexturesMaterial = material;
+				const GPUResource* res[] = {
+					static_cast<const GPUResource*>(material->GetBaseColorMap()),
+					static_cast<const GPUResource*>(material->GetNormalMap()),
+					static_cast<const GPUResource*>(material->GetRoughnessMap()),
+					static_cast<const GPUResource*>(material->GetReflectanceMap()),
+					static_cast<const GPUResource*>(material->GetMetalnessMap()),
+					static_cast<const GPUResource*>(material->GetDisplacementMap()),
+				};
+				device->BindResourcesPS(res, TEXSLOT_ONDEMAND0, (easyTextureBind ? 1 : ARRAYSIZE(res)), threadID);
+			}
+
+			SetAlphaRef(material->alphaRef, threadID);
+
+			for (auto& range : subset.drawRanges)
+			{
+				device->DrawIndexedInstanced((int)range.indexCount, batch.instanceCount, range.indexOffset, range.baseVertex, 0, threadID);
+			}
 		}
 
 
@@ -4791,6 +5613,11 @@ void wiRenderer::RefreshEnvProbes(GRAPHICSTHREAD threadID)
 		{
 			continue;
 		}
+		// A probe that is only rendered once waits until the shaders are loaded, otherwise it would keep the placeholders:
+		if (!probe->realTime && pendingShaders.load() > 0)
+		{
+			continue;
+		}
 		if(!probe->realTime)
 		{
 			probe->isUpToDate = true;
@@ -5534,8 +6361,9 @@ void wiRenderer::UpdateFrameCB(GRAPHICSTHREAD threadID)
 	cb.mTime = renderTime;
 	cb.mTimePrev = renderTime_Prev;
 	cb.mDeltaTime = deltaTime;
-	cb.mForceFieldOffset = entityArrayOffset_ForceFields;
-	cb.mForceFieldCount = entityArrayCount_ForceFields;
+	const FramePacket& packet = GetFramePacket();
+	cb.mForceFieldOffset = packet.forceFieldOffset;
+	cb.mForceFieldCount = packet.forceFieldCount;
 	auto& wind = GetScene().wind;
 	cb.mWindRandomness = wind.randomness;
 	cb.mWindWaveSize = wind.waveSize;
@@ -5547,9 +6375,9 @@ void wiRenderer::UpdateFrameCB(GRAPHICSTHREAD threadID)
 	cb.mGlobalEnvMap0 = globalEnvProbes[0] == nullptr ? XMFLOAT3(0, 0, 0) : globalEnvProbes[0]->translation;
 	cb.mGlobalEnvMap1 = globalEnvProbes[1] == nullptr ? XMFLOAT3(0, 0, 0) : globalEnvProbes[1]->translation;
 
-	auto camera = getCamera();
-	auto prevCam = prevFrameCam;
-	auto reflCam = getRefCamera();
+	auto camera = packet.camera;
+	auto prevCam = GetPrevFramePacket().camera;
+	auto reflCam = packet.reflectionCamera;
 
 	cb.mVP = XMMatrixTranspose(camera->GetViewProjection());
 	cb.mView = XMMatrixTranspose(camera->GetView());
@@ -6119,8 +6947,76 @@ Scene& wiRenderer::GetScene()
 	return *scene;
 }
 
+// The physics step runs on its own thread between BeginPhysicsStep() and EndPhysicsStep(). It is not a job, because
+//	the render thread executes jobs while it waits for its own ones, and picking up the step would stall the frame:
+struct PhysicsThread
+{
+	thread worker;
+	mutex locker;
+	condition_variable wakeup;
+	function<void()> task;
+	bool busy = false;
+	bool exiting = false;
+
+	~PhysicsThread()
+	{
+		if (worker.joinable())
+		{
+			{
+				lock_guard<mutex> lock(locker);
+				exiting = true;
+			}
+			wakeup.notify_all();
+			worker.join();
+		}
+	}
+	void Run(const function<void()>& step)
+	{
+		if (!worker.joinable())
+		{
+			worker = thread([this] {
+				unique_lock<mutex> lock(locker);
+				while (true)
+				{
+					wakeup.wait(lock, [this] { return busy || exiting; });
+					if (exiting)
+					{
+						return;
+					}
+					lock.unlock();
+					task();
+					lock.lock();
+					task = nullptr;
+					busy = false;
+					wakeup.notify_all();
+				}
+			});
+		}
+		{
+			lock_guard<mutex> lock(locker);
+			task = step;
+			busy = true;
+		}
+		wakeup.notify_all();
+	}
+	void Wait()
+	{
+		unique_lock<mutex> lock(locker);
+		wakeup.wait(lock, [this] { return !busy; });
+	}
+};
+static PhysicsThread physicsThread;
+static bool physicsStepPending = false;
+
 void wiRenderer::SynchronizeWithPhysicsEngine(float dt)
 {
+	BeginPhysicsStep(dt);
+	EndPhysicsStep();
+}
+void wiRenderer::BeginPhysicsStep(float dt)
+{
+	EndPhysicsStep();
+
 	if (physicsEngine && GetGameSpeed())
 	{
 		physicsEngine->addWind(GetScene().wind.direction);
@@ -6169,9 +7065,23 @@ void wiRenderer::SynchronizeWithPhysicsEngine(float dt)
 			}
 		}
 
-		// Run physics simulation
-		physicsEngine->Update(dt);
+		// Run physics simulation, it only works on the physics world, so the scene can be rendered meanwhile:
+		PHYSICS* engine = physicsEngine;
+		physicsThread.Run([engine, dt] { engine->Update(dt); });
+		physicsStepPending = true;
+	}
+}
+void wiRenderer::EndPhysicsStep()
+{
+	if (!physicsStepPending)
+	{
+		return;
+	}
+	physicsThread.Wait();
+	physicsStepPending = false;
 
+	if (physicsEngine)
+	{
 		// Retrieve physics simulation data
 		for (Model* model : GetScene().models)
 		{
@@ -6208,6 +7118,9 @@ void wiRenderer::PutEnvProbe(const XMFLOAT3& position, int resolution)
 
 void wiRenderer::CreateImpostor(Mesh* mesh)
 {
+	// The impostor is rendered once, it must not be rendered with placeholder shaders:
+	WaitForShaders(true);
+
 	Mesh::CreateImpostorVB();
 
 	static const GRAPHICSTHREAD threadID;
@@ -6233,16 +7146,16 @@ void wiRenderer::CreateImpostor(Mesh* mesh)
 	const XMFLOAT4X4 __identity = XMFLOAT4X4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
 	const Instance instance(__identity);
 	const InstancePrev instancePrev(__identity);
-	const UINT instanceOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, &instance, sizeof(instance), threadID);
-	const UINT instancePrevOffset = GetDevice()->AppendRingBuffer(dynamicVertexBufferPool, &instancePrev, sizeof(instancePrev), threadID);
+	const wiUploadAllocator::Allocation instanceAllocation = uploadAllocator.Upload(&instance, sizeof(instance), threadID);
+	const wiUploadAllocator::Allocation instancePrevAllocation = uploadAllocator.Upload(&instancePrev, sizeof(instancePrev), threadID);
 
 	GPUBuffer* vbs[] = {
-		mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
-		mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_NOR.IsValid() ? &mesh->streamoutBuffer_NOR : &mesh->vertexBuffer_NOR),
+		mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_POS.IsValid() ? &mesh->streamoutBuffer_POS : &mesh->vertexBuffer_POS),
+		mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_NOR.IsValid() ? &mesh->streamoutBuffer_NOR : &mesh->vertexBuffer_NOR),
 		&mesh->vertexBuffer_TEX,
-		mesh->hasDynamicVB() ? dynamicVertexBufferPool : (mesh->streamoutBuffer_PRE.IsValid() ? &mesh->streamoutBuffer_PRE : &mesh->vertexBuffer_POS),
-		dynamicVertexBufferPool,
-		dynamicVertexBufferPool
+		mesh->hasDynamicVB() ? mesh->dynamicVertexBuffer : (mesh->streamoutBuffer_PRE.IsValid() ? &mesh->streamoutBuffer_PRE : &mesh->vertexBuffer_POS),
+		instanceAllocation.buffer,
+		instancePrevAllocation.buffer
 	};
 	UINT strides[] = {
 		sizeof(Mesh::Vertex_POS),
@@ -6257,8 +7170,8 @@ void wiRenderer::CreateImpostor(Mesh* mesh)
 		mesh->hasDynamicVB() ? mesh->bufferOffset_NOR : 0,
 		0,
 		mesh->hasDynamicVB() ? mesh->bufferOffset_PRE : 0,
-		instanceOffset,
-		instancePrevOffset
+		instanceAllocation.offset,
+		instancePrevAllocation.offset
 	};
 	GetDevice()->BindVertexBuffers(vbs, 0, ARRAYSIZE(vbs), strides, offsets, threadID);
 
@@ -6342,7 +7255,7 @@ void wiRenderer::CreateImpostor(Mesh* mesh)
 
 		for (MeshSubset& subset : mesh->subsets)
 		{
-			if (subset.subsetIndices.empty())
+			if (subset.indexCount == 0)
 			{
 				continue;
 			}
@@ -6358,7 +7271,10 @@ void wiRenderer::CreateImpostor(Mesh* mesh)
 				GetDevice()->BindResourcePS(subset.material->GetDisplacementMap(), TEXSLOT_ONDEMAND5, threadID);
 
 
-				GetDevice()->DrawIndexedInstanced((int)subset.subsetIndices.size(), 1, subset.indexBufferOffset, 0, 0, threadID);
+				for (auto& range : subset.drawRanges)
+				{
+					GetDevice()->DrawIndexedInstanced((int)range.indexCount, 1, range.indexOffset, range.baseVertex, 0, threadID);
+				}
 			}
 		}
 
@@ -6443,6 +7359,7 @@ void wiRenderer::Add(const list<Object*>& objects)
 	{
 		GenerateSPTree(spTree, std::vector<Cullable*>(objects.begin(), objects.end()), SPTREE_GENERATE_OCTREE);
 	}
+	sceneEpoch++;
 }
 void wiRenderer::Add(const list<Light*>& lights)
 {
@@ -6482,6 +7399,8 @@ void wiRenderer::Remove(Object* value)
 		}
 		spTree->Remove(value);
 		value->detach();
+		dynamicObjects.erase(remove(dynamicObjects.begin(), dynamicObjects.end(), value), dynamicObjects.end());
+		sceneEpoch++;
 	}
 }
 void wiRenderer::Remove(Light* value)
@@ -6494,6 +7413,10 @@ void wiRenderer::Remove(Light* value)
 		}
 		spTree_lights->Remove(value);
 		value->detach();
+		for (size_t index = 0; index < 3; ++index)
+		{
+			shadowViews.erase((size_t)value + index);
+		}
 	}
 }
 void wiRenderer::Remove(Decal* value)
@@ -6550,6 +7473,19 @@ void wiRenderer::SetOcclusionCullingEnabled(bool value)
 
 	occlusionCulling = value;
 }
+void wiRenderer::SetMeshStreamingEnabled(bool value)
+{
+	meshStreaming = value;
+
+	if (meshStreaming)
+	{
+		wiStreaming::Initialize();
+	}
+	else
+	{
+		wiStreaming::CleanUp();
+	}
+}
 
 bool wiRenderer::GetAdvancedRefractionsEnabled()
 {
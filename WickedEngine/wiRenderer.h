@@ -4,6 +4,10 @@
 #include "wiEnums.h"
 #include "wiGraphicsAPI.h"
 #include "wiSPTree.h"
+#include "wiRenderQueue.h"
+#include "wiResourceManager.h"
+#include "wiSpinLock.h"
+#include "wiUploadAllocator.h"
 #include "wiWindowRegistration.h"
 
 #include <unordered_set>
@@ -55,6 +59,8 @@ public:
 
 
 	static void InitDevice(wiWindowRegistration::window_type window, bool fullscreen = false);
+	// Create a device that presents nothing and records the commands instead, for running the renderer without a window
+	static void InitNullDevice(int width = 1920, int height = 1080);
 	static void Present(std::function<void()> drawToScreen1=nullptr, std::function<void()> drawToScreen2=nullptr, std::function<void()> drawToScreen3=nullptr);
 
 	
@@ -74,7 +80,8 @@ public:
 	static wiGraphicsTypes::Texture				*textures[TEXTYPE_LAST];
 	static wiGraphicsTypes::Sampler				*customsamplers[SSTYPE_LAST];
 
-	static wiGraphicsTypes::GPURingBuffer		*dynamicVertexBufferPool;
+	// The per-frame vertex data (soft body vertices, instances, trails) is allocated from here:
+	static wiUploadAllocator					uploadAllocator;
 	
 	static float GAMMA;
 	static int SHADOWRES_2D, SHADOWRES_CUBE, SHADOWCOUNT_2D, SHADOWCOUNT_CUBE, SOFTSHADOWQUALITY_2D;
@@ -229,6 +236,10 @@ protected:
 
 	static bool debugLightCulling;
 	static bool occlusionCulling;
+	static bool renderQueueSorting;
+	static bool parallelRecording;
+	static bool shadowMapSkipping;
+	static bool meshStreaming;
 	static bool temporalAA, temporalAADEBUG;
 
 	static EnvironmentProbe* globalEnvProbes[2];
@@ -252,8 +263,6 @@ protected:
 
 	static wiGraphicsTypes::GPUQuery occlusionQueries[256];
 
-	static UINT entityArrayOffset_ForceFields, entityArrayCount_ForceFields;
-
 public:
 	static std::string SHADERPATH;
 
@@ -307,6 +316,17 @@ public:
 	static bool GetAdvancedLightCulling() { return advancedLightCulling; }
 	static void SetOcclusionCullingEnabled(bool enabled); // also inits query pool!
 	static bool GetOcclusionCullingEnabled() { return occlusionCulling; }
+	static void SetRenderQueueSortingEnabled(bool enabled) { renderQueueSorting = enabled; }
+	static bool GetRenderQueueSortingEnabled() { return renderQueueSorting; }
+	static void SetParallelRecordingEnabled(bool enabled) { parallelRecording = enabled; }
+	static bool GetParallelRecordingEnabled() { return parallelRecording; }
+	// Shadow maps whose volume didn't change since the last frame are not rendered again
+	static void SetShadowMapSkippingEnabled(bool enabled) { shadowMapSkipping = enabled; }
+	static bool GetShadowMapSkippingEnabled() { return shadowMapSkipping; }
+	// Objects with a streaming directory have their meshes loaded and released by camera distance (see wiStreaming).
+	//	Set it before loading the models: the meshes that are released while it is enabled are not loaded again when disabling it
+	static void SetMeshStreamingEnabled(bool enabled); // also starts/stops the streaming thread!
+	static bool GetMeshStreamingEnabled() { return meshStreaming; }
 	static void SetTemporalAAEnabled(bool enabled) { temporalAA = enabled; }
 	static bool GetTemporalAAEnabled() { return temporalAA; }
 	static void SetTemporalAADebugEnabled(bool enabled) { temporalAADEBUG = enabled; }
@@ -373,6 +393,258 @@ public:
 	};
 	static std::unordered_map<Camera*, FrameCulling> frameCullings;
 
+	// The instanced draw of a mesh in RenderMeshes
+	struct MeshBatch
+	{
+		Mesh* mesh;
+		wiGraphicsTypes::GPUBuffer* instanceBuffer;
+		UINT instanceCount;
+		UINT instanceOffset;
+		UINT instancePrevOffset;
+		float tessellationFactor;
+		float distance; // of the closest instance
+		bool tessellatorRequested;
+		bool forceAlphaTestForDithering;
+	};
+	// The shader and fixed function state combination of a mesh subset draw in RenderMeshes
+	struct MeshPipeline
+	{
+		VLTYPES vl;
+		VSTYPES vs;
+		GSTYPES gs;
+		HSTYPES hs;
+		DSTYPES ds;
+		PSTYPES ps;
+		RSTYPES rs;
+		wiGraphicsTypes::PRIMITIVETOPOLOGY topology;
+		int vertexBufferType;
+
+		bool operator==(const MeshPipeline& other) const
+		{
+			return vl == other.vl && vs == other.vs && gs == other.gs && hs == other.hs && ds == other.ds && ps == other.ps &&
+				rs == other.rs && topology == other.topology && vertexBufferType == other.vertexBufferType;
+		}
+	};
+	// Instance data of a mesh in the upload allocator, the previous transforms follow the instances
+	struct InstanceAllocation
+	{
+		const Mesh* mesh;
+		wiGraphicsTypes::GPUBuffer* buffer;
+		UINT count;
+		UINT offset;
+		UINT prevOffset;
+		bool hasPrev;
+	};
+	// Reused by every RenderMeshes call on the same thread, so that the queue doesn't allocate each time
+	struct RenderQueueContext
+	{
+		wiRenderQueue queue;
+		std::vector<MeshBatch> batches;
+		std::vector<MeshPipeline> pipelines;
+
+		// The instances to be written by AllocateInstances, with their dither values
+		std::vector<std::pair<const Object*, float>> visibleInstances;
+		// The instance data written in the current frame and command list, by the hash of the instance set
+		std::unordered_map<uint64_t, InstanceAllocation> instanceCache;
+		uint64_t instanceCacheFrame;
+		uint64_t instanceCacheCommandList;
+
+		RenderQueueContext() :instanceCacheFrame(0), instanceCacheCommandList(0) {}
+	};
+	static RenderQueueContext renderQueueContexts[GRAPHICSTHREAD_COUNT];
+	// Writes the visibleInstances of the thread's context into the upload allocator, or returns the data written by an
+	//	earlier pass if it had the same instances (for example the depth prepass, the opaque pass and the shadow cascades)
+	static InstanceAllocation AllocateInstances(Mesh* mesh, bool impostor, bool prevRequested, GRAPHICSTHREAD threadID);
+
+	// The shadow casters of a shadow map slice, kept between frames. The static casters are only culled again when the
+	//	volume of the view or the scene changed, the dynamic objects are tested against the volume every frame
+	struct ShadowView
+	{
+		XMFLOAT4X4 volume;
+		XMFLOAT4 volumeParams;
+		uint64_t epoch;
+		uint64_t frame;	// the last frame the view was updated
+		int shadowMapIndex;
+		UINT residentCasters;
+		bool hadDynamicCasters;
+		bool hadWindCasters;	// casters animated by the wind were rendered last time
+		std::vector<Object*> staticCasters;
+		std::vector<Object*> dynamicCasters;
+		CulledCollection culledRenderer;
+
+		ShadowView() :epoch(~0ull), frame(~0ull), shadowMapIndex(-1), residentCasters(0), hadDynamicCasters(false), hadWindCasters(false) {}
+	};
+	// Keyed by the light address plus the index of the view (the shadow cascade)
+	static std::unordered_map<size_t, ShadowView> shadowViews;
+	// Incremented when the static casters can have changed: objects were added, removed, a static object moved or a material changed
+	static std::atomic<uint64_t> sceneEpoch;
+	// The objects that can move every frame without changing the scene epoch
+	static std::vector<Object*> dynamicObjects;
+	// Updates the casters of the view. Returns false if the view doesn't have to be rendered: it has no casters, or
+	//	nothing changed in its volume since the last frame and it is still in the same shadow map slice
+	static bool UpdateShadowView(ShadowView& view, const XMFLOAT4X4& volume, const XMFLOAT4& volumeParams, int shadowMapIndex,
+		const std::function<void(CulledList&)>& cullStatic, const std::function<bool(const AABB&)>& intersects);
+	static void UpdateDynamicObjects();
+
+	// Shadow culling statistics of the last DrawForShadowMap call
+	struct ShadowCullingStats
+	{
+		float cullingTime;	// milliseconds spent on caster culling
+		UINT views;			// shadow views that had a shadow map slice
+		UINT viewsCulled;	// views whose static casters were culled again
+		UINT viewsReused;	// views that reused their cached static casters
+		UINT viewsSkipped;	// views that weren't rendered because nothing changed in them
+
+		ShadowCullingStats() :cullingTime(0), views(0), viewsCulled(0), viewsReused(0), viewsSkipped(0) {}
+	};
+	static ShadowCullingStats shadowCullingStats;
+	static const ShadowCullingStats& GetShadowCullingStats() { return shadowCullingStats; }
+
+	// The shader properties of every material in one structured buffer, indexed by Material::tableIndex. Only the
+	//	entries of the materials that were marked dirty are written and uploaded
+	struct MaterialTable
+	{
+		std::vector<ShaderMaterial> entries;		// copy of the GPU table, the first entry is the impostor material
+		std::vector<UINT> freeIndices;
+		std::vector<Material*> dirtyMaterials;
+		// The entries that were not uploaded yet. They stay here until UpdateMaterialTable() uploads the packet that holds
+		//	them, because the packets of the frames that are not rendered with the scene are never uploaded
+		std::vector<UINT> dirtyIndices;
+		UINT gpuCapacity;
+		UINT extractionCount;
+		UINT uploadedExtraction;	// the extraction whose indices were removed from dirtyIndices
+		wiSpinLock lock;
+
+		MaterialTable() :gpuCapacity(0), extractionCount(0), uploadedExtraction(0) {}
+	};
+	static MaterialTable materialTable;
+	struct MaterialTableStats
+	{
+		float updateTime;		// milliseconds spent in ExtractMaterialTable and UpdateMaterialTable
+		UINT materials;			// materials in the table
+		UINT updatedMaterials;	// dirty materials written in the last update
+		UINT uploads;			// buffer updates issued for them
+		UINT uploadedBytes;
+
+		MaterialTableStats() :updateTime(0), materials(0), updatedMaterials(0), uploads(0), uploadedBytes(0) {}
+	};
+	static MaterialTableStats materialTableStats;
+	static const MaterialTableStats& GetMaterialTableStats() { return materialTableStats; }
+	static const wiUploadAllocator::Stats& GetUploadStats() { return uploadAllocator.GetStats(); }
+	// Returns the table index of the new material
+	static UINT RegisterMaterial(Material* material);
+	static void UnregisterMaterial(Material* material);
+	static void MarkMaterialDirty(Material* material);
+	// Writes the dirty materials into the table and copies the ranges that were not uploaded yet into the frame packet.
+	//	The GPU table is created (or grown) here, on the main thread
+	static void ExtractMaterialTable();
+	// Uploads the changed ranges of the frame packet, then binds the table
+	static void UpdateMaterialTable(GRAPHICSTHREAD threadID);
+
+	// Scratch data of BuildEntityArray, kept between frames so that it doesn't allocate
+	struct EntityArrayContext
+	{
+		std::vector<Light*> lights;		// the active lights in entity array order
+		std::vector<Decal*> decals;
+		std::vector<UINT> lightsByType[ENTITY_TYPE_TUBELIGHT + 1];	// indices into lights, by Light::LightType
+		// World space positions of the lights followed by the decals and their view space transforms, in SoA layout
+		//	padded to a multiple of 4, so that they are transformed four at a time
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> positionVSX, positionVSY, positionVSZ;
+	};
+	static EntityArrayContext entityArrayContext;
+	// Fills the shader entity array with the active lights followed by the decals, and the matrix array with the shadow
+	//	matrices followed by the decal projections. The entities are built in parallel when there are many of them.
+	//	Returns the entity count, matrixCount receives the count of matrices used
+	static UINT BuildEntityArray(const CulledList& lights, const std::list<Decal*>& decals, const XMMATRIX& viewMatrix,
+		ShaderEntityType* entityArray, UINT entityCapacity, XMMATRIX* matrixArray, UINT matrixCapacity, UINT& matrixCount);
+
+	// The state that rendering reads instead of the scene: the cameras, the light array and the material table changes.
+	//	It is extracted at the end of the update, so the next update can change the scene while the frame is rendered.
+	//	There are two packets, the other one keeps the previous frame, whose camera is used for the motion vectors
+	struct FramePacket
+	{
+		uint64_t frame;
+		Camera* camera;
+		Camera* reflectionCamera;
+		ShaderEntityType* entityArray;	// MAX_SHADER_ENTITY_COUNT entities
+		XMMATRIX* matrixArray;			// MATRIXARRAY_COUNT matrices
+		UINT entityCount, matrixCount;
+		UINT decalOffset, forceFieldOffset, forceFieldCount;
+		std::vector<Decal*> decals;		// the decals of the light array, they get their atlas rectangles when rendered
+		std::vector<std::pair<UINT, UINT> > materialRanges;	// first table index and entry count of the changed ranges
+		std::vector<ShaderMaterial> materials;				// the entries of the ranges, one after the other
+		UINT materialExtraction;							// MaterialTable::extractionCount when the ranges were copied
+		UINT materialIndexCount;							// the dirty indices of the table that the ranges hold
+
+		FramePacket() :frame(0), camera(nullptr), reflectionCamera(nullptr), entityArray(nullptr), matrixArray(nullptr),
+			entityCount(0), matrixCount(0), decalOffset(0), forceFieldOffset(0), forceFieldCount(0), materialExtraction(0),
+			materialIndexCount(0) {}
+	};
+	static FramePacket framePackets[2];
+	static UINT framePacketIndex;
+	static const FramePacket& GetFramePacket() { return framePackets[framePacketIndex]; }
+	static const FramePacket& GetPrevFramePacket() { return framePackets[framePacketIndex ^ 1]; }
+	// Call it at the end of the update (after UpdatePerFrameData), the frame is rendered from the extracted state
+	static void ExtractFramePacket();
+
+	// A shader of the tables. It is loaded by the shader manager on the job system, and UpdateShaders() writes it into
+	//	its table slot when it is ready. SetUpStaticComponents() and ReloadShaders() wait for the shaders that are not lazy,
+	//	so only the lazy permutations load while frames are rendered (with their fallback bound meanwhile)
+	struct ShaderRequest
+	{
+		enum STATE
+		{
+			IDLE,		// lazily loaded permutation that was not used yet
+			STARTING,
+			LOADING,
+			STORED,
+		};
+		std::string name;
+		wiResourceManager::Data_Type type;
+		std::vector<wiGraphicsTypes::VertexLayoutDesc> vertexLayout;
+		std::function<void(void*)> store;	// writes the loaded data into the table slot
+		std::shared_future<void*> loading;
+		std::atomic<int> state;
+		bool lazy;
+
+		ShaderRequest() :type(wiResourceManager::DYNAMIC), state(IDLE), lazy(false) {}
+	};
+	static std::vector<ShaderRequest*> shaderRequests;
+	// The object pixel shader permutations are only loaded when a material needs them (the key is the PSTYPE),
+	//	meanwhile the fallback is bound in their place
+	static ShaderRequest* pixelShaderPermutations[PSTYPE_LAST];
+	static PSTYPES pixelShaderFallbacks[PSTYPE_LAST];
+	static bool lazyShaderPermutations;
+	struct ShaderLoadingStats
+	{
+		UINT requested;		// shaders requested since the last LoadShaders()
+		UINT pending;		// requested, but not stored in the tables yet
+		UINT permutations;	// lazily loaded permutations that were requested
+		UINT failed;		// shaders that couldn't be loaded
+		float startupTime;	// milliseconds from LoadShaders() until every shader it requested was stored
+
+		ShaderLoadingStats() :requested(0), pending(0), permutations(0), failed(0), startupTime(0) {}
+	};
+	static ShaderLoadingStats shaderLoadingStats;
+	static std::atomic<UINT> pendingShaders;
+	static double shaderLoadingStart;	// wiTimer::TotalTime() of the last LoadShaders()
+	static bool shaderStartupPending;
+	// Starts loading the shader if it is not requested yet, can be called from any thread
+	static void StartShaderRequest(ShaderRequest* request);
+	// The object pixel shader of the permutation, or its fallback while it is loading
+	static wiGraphicsTypes::PixelShader* GetObjectPixelShader(PSTYPES ps);
+	// Writes the shaders that finished loading into the tables, and saves the shader cache when nothing is pending.
+	//	Called by Present(), it must not run while a frame is being recorded
+	static void UpdateShaders();
+	// Blocks until the requested shaders are stored in the tables. allPermutations: request the unused permutations too,
+	//	so that no fallback is bound afterwards (for baking and benchmarks)
+	static void WaitForShaders(bool allPermutations = false);
+	// Only load the object pixel shader permutations on their first use (default: enabled), takes effect in LoadShaders()
+	static void SetLazyShaderPermutations(bool value) { lazyShaderPermutations = value; }
+	static bool GetLazyShaderPermutations() { return lazyShaderPermutations; }
+	static const ShaderLoadingStats& GetShaderLoadingStats() { return shaderLoadingStats; }
+
 	inline static XMUINT3 GetEntityCullingTileCount()
 	{
 		return XMUINT3(
@@ -398,6 +670,10 @@ public:
 	static void DrawSun(GRAPHICSTHREAD threadID);
 	static void DrawWorld(Camera* camera, bool tessellation, GRAPHICSTHREAD threadID, SHADERTYPE shaderType, wiGraphicsTypes::Texture2D* refRes, bool grass, bool occlusionCulling);
 	static void DrawForShadowMap(GRAPHICSTHREAD threadID);
+	// Records the items on the worker threads in parallel, then executes them on threadID in the order of the items.
+	//	An item must bind every state it relies on, because it doesn't inherit the state of threadID.
+	//	Falls back to recording them on threadID one after the other if parallel recording is not possible.
+	static void RecordParallel(const std::vector<std::function<void(GRAPHICSTHREAD)>>& items, GRAPHICSTHREAD threadID);
 	static void DrawWorldTransparent(Camera* camera, SHADERTYPE shaderType, wiGraphicsTypes::Texture2D* refracRes, wiGraphicsTypes::Texture2D* refRes
 		, wiGraphicsTypes::Texture2D* waterRippleNormals, GRAPHICSTHREAD threadID, bool grass, bool occlusionCulling);
 	void DrawDebugSpheres(Camera* camera, GRAPHICSTHREAD threadID);
@@ -470,7 +746,7 @@ public:
 
 	static wiRenderTarget normalMapRT, imagesRT, imagesRTAdd;
 	
-	static Camera* cam, *refCam, *prevFrameCam;
+	static Camera* cam, *refCam;
 	static Camera* getCamera(){ return cam; }
 	static Camera* getRefCamera(){ return refCam; }
 
@@ -533,6 +809,11 @@ public:
 
 	static PHYSICS* physicsEngine;
 	static void SynchronizeWithPhysicsEngine(float dt = 1.0f / 60.0f);
+	// The same synchronization in two halves, so that the physics step can run on a thread of its own while the frame is
+	//	rendered. BeginPhysicsStep() writes the scene into the physics world and starts the step, EndPhysicsStep() waits
+	//	for it and reads the results back into the scene. Nothing else may use the physics engine between the two
+	static void BeginPhysicsStep(float dt = 1.0f / 60.0f);
+	static void EndPhysicsStep();
 
 	static Model* LoadModel(const std::string& dir, const std::string& name, const XMMATRIX& transform = XMMatrixIdentity(), const std::string& ident = "common");
 	static void LoadWorldInfo(const std::string& dir, const std::string& name);
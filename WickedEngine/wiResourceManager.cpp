@@ -2,6 +2,15 @@
 #include "wiRenderer.h"
 #include "wiSound.h"
 #include "wiHelper.h"
+#include "wiShaderCache.h"
+#include "wiJobSystem.h"
+#include "wiTimer.h"
+#include "wiProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 using namespace wiGraphicsTypes;
@@ -9,7 +18,7 @@ using namespace wiGraphicsTypes;
 wiResourceManager::filetypes wiResourceManager::types;
 wiResourceManager* wiResourceManager::globalResources = nullptr;
 
-wiResourceManager::wiResourceManager():wiThreadSafeManager()
+wiResourceManager::wiResourceManager():wiThreadSafeManager(), memoryBudget(0), gracePeriod(5000)
 {
 }
 wiResourceManager::~wiResourceManager()
@@ -44,267 +53,630 @@ void wiResourceManager::SetUp()
 	types.insert(pair<string, Data_Type>("WAV", SOUND));
 }
 
-const wiResourceManager::Resource* wiResourceManager::get(const wiHashString& name, bool incRefCount)
+bool wiResourceManager::ResolveType(const wiHashString& name, Data_Type newType, Data_Type& type)
 {
-	LOCK();
-	container::iterator it = resources.find(name);
-	if (it != resources.end())
+	if (newType != Data_Type::DYNAMIC)
 	{
-		if(incRefCount)
-			it->second->refCount++;
-		UNLOCK();
-		return it->second;
+		type = newType;
+		return true;
 	}
-
-	UNLOCK();
-	return nullptr;
+	// Loads on several threads can resolve their first type at the same time:
+	static once_flag typesSetUp;
+	call_once(typesSetUp, SetUp);
+	const string& nameStr = name.GetString();
+	if (nameStr.length() < 3)
+		return false;
+	string ext = wiHelper::toUpper(nameStr.substr(nameStr.length() - 3, nameStr.length()));
+	filetypes::iterator it = types.find(ext);
+	if (it == types.end())
+		return false;
+	type = it->second;
+	return true;
 }
 
-void* wiResourceManager::add(const wiHashString& name, Data_Type newType
-	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+std::shared_future<void*> wiResourceManager::Request(const wiHashString& name, Data_Type type, std::promise<void*>& promise, bool& load)
 {
-	if (types.empty())
-		SetUp();
-
-	const Resource* res = get(name,true);
-	if(!res)
-	{
-		string nameStr = name.GetString();
-		string ext = wiHelper::toUpper(nameStr.substr(nameStr.length() - 3, nameStr.length()));
-		Data_Type type;
-#pragma region dynamic type selection
-		if(newType==Data_Type::DYNAMIC){
-			filetypes::iterator it = types.find(ext);
-			if(it!=types.end())
-				type = it->second;
-			else 
-				return nullptr;
-		}
-		else 
-			type = newType;
-#pragma endregion
-		void* success = nullptr;
+	Shard& shard = GetShard(name);
+	lock_guard<mutex> lock(shard.locker);
 
-		LOCK();
+	container::iterator it = shard.resources.find(name);
+	if (it != shard.resources.end())
+	{
+		// Cached resources without references are revived here:
+		Resource* res = it->second;
+		res->refCount++;
+		res->lastUsed = wiTimer::TotalTime();
+		load = false;
+		if (res->data != nullptr)
+			stats.hits++;
+		else
+			stats.sharedLoads++;
+		return res->loading;
+	}
 
-		switch(type){
-		case Data_Type::IMAGE:
+	Resource* res = new Resource(nullptr, type);
+	res->loading = promise.get_future().share();
+	res->lastUsed = wiTimer::TotalTime();
+	shard.resources.insert(pair<wiHashString, Resource*>(name, res));
+	load = true;
+	stats.misses++;
+	return res->loading;
+}
+
+void wiResourceManager::Finish(const wiHashString& name, std::promise<void*>& promise, void* data, size_t size)
+{
+	{
+		Shard& shard = GetShard(name);
+		lock_guard<mutex> lock(shard.locker);
+
+		container::iterator it = shard.resources.find(name);
+		if (it != shard.resources.end())
 		{
-			Texture2D* image=nullptr;
+			if (data != nullptr)
 			{
-				wiRenderer::GetDevice()->CreateTextureFromFile(name.GetString().c_str(), &image, true, GRAPHICSTHREAD_IMMEDIATE);
+				it->second->data = data;
+				it->second->size = size;
+				stats.residentBytes += size;
+				stats.typeBytes[it->second->type] += size;
+			}
+			else
+			{
+				// Failed loads are not kept, so that they can be retried:
+				delete it->second;
+				shard.resources.erase(it);
 			}
-
-			if(image)
-				success=image;
 		}
+	}
+	if (data != nullptr)
+	{
+		stats.loads++;
+	}
+	promise.set_value(data);
+
+	// The new data can push the resident memory over the budget:
+	if (memoryBudget > 0 && stats.residentBytes > memoryBudget)
+	{
+		Trim(false);
+	}
+}
+
+// Approximate video memory of a texture with its mip chain:
+static size_t GetTextureMemorySize(const Texture2D* texture)
+{
+	Texture2DDesc desc = texture->GetDesc();
+
+	// Block compressed formats store 4x4 pixel blocks, the size is in bits per pixel:
+	size_t bitsPerPixel;
+	switch (desc.Format)
+	{
+	case FORMAT_BC1_TYPELESS:
+	case FORMAT_BC1_UNORM:
+	case FORMAT_BC1_UNORM_SRGB:
+	case FORMAT_BC4_TYPELESS:
+	case FORMAT_BC4_UNORM:
+	case FORMAT_BC4_SNORM:
+		bitsPerPixel = 4;
 		break;
-		case Data_Type::IMAGE_STAGING:
+	case FORMAT_BC2_TYPELESS:
+	case FORMAT_BC2_UNORM:
+	case FORMAT_BC2_UNORM_SRGB:
+	case FORMAT_BC3_TYPELESS:
+	case FORMAT_BC3_UNORM:
+	case FORMAT_BC3_UNORM_SRGB:
+	case FORMAT_BC5_TYPELESS:
+	case FORMAT_BC5_UNORM:
+	case FORMAT_BC5_SNORM:
+	case FORMAT_BC6H_TYPELESS:
+	case FORMAT_BC6H_UF16:
+	case FORMAT_BC6H_SF16:
+	case FORMAT_BC7_TYPELESS:
+	case FORMAT_BC7_UNORM:
+	case FORMAT_BC7_UNORM_SRGB:
+	case FORMAT_R8_UNORM:
+		bitsPerPixel = 8;
+		break;
+	case FORMAT_R16G16B16A16_FLOAT:
+	case FORMAT_R16G16B16A16_UNORM:
+	case FORMAT_R32G32_FLOAT:
+		bitsPerPixel = 64;
+		break;
+	case FORMAT_R32G32B32A32_FLOAT:
+		bitsPerPixel = 128;
+		break;
+	default:
+		bitsPerPixel = 32;
+		break;
+	}
+
+	size_t size = 0;
+	UINT width = max(desc.Width, 1u);
+	UINT height = max(desc.Height, 1u);
+	for (UINT mip = 0; mip < max(desc.MipLevels, 1u); ++mip)
+	{
+		size += (size_t)width * (size_t)height * bitsPerPixel / 8;
+		width = max(width / 2, 1u);
+		height = max(height / 2, 1u);
+	}
+	return size * max(desc.ArraySize, 1u);
+}
+
+void* wiResourceManager::Load(const wiHashString& name, Data_Type type, const std::vector<VertexLayoutDesc>& vertexLayout, size_t& size)
+{
+	const string& nameStr = name.GetString();
+	void* success = nullptr;
+	size = 0;
+
+	switch(type){
+	case Data_Type::IMAGE:
+	{
+		Texture2D* image=nullptr;
+		{
+			wiRenderer::GetDevice()->CreateTextureFromFile(nameStr, &image, true, GRAPHICSTHREAD_IMMEDIATE);
+		}
+
+		if(image)
 		{
-			wiHelper::messageBox("IMAGE_STAGING texture loading not implemented in ResourceManager!", "Warning!");
+			success=image;
+			size = GetTextureMemorySize(image);
+		}
+	}
+	break;
+	case Data_Type::IMAGE_STAGING:
+	{
+		wiHelper::messageBox("IMAGE_STAGING texture loading not implemented in ResourceManager!", "Warning!");
+		success = nullptr;
+	}
+	break;
+	case Data_Type::SOUND:
+	{
+		wiSoundEffect* sound = new wiSoundEffect(nameStr);
+		size = sound->GetMemorySize();
+		success = sound;
+	}
+	break;
+	case Data_Type::MUSIC:
+	{
+		wiMusic* music = new wiMusic(nameStr);
+		size = music->GetMemorySize();
+		success = music;
+	}
+	break;
+	case Data_Type::VERTEXSHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)){
+			VertexShaderInfo* vertexShaderInfo = new VertexShaderInfo;
+			vertexShaderInfo->vertexShader = new VertexShader;
+			vertexShaderInfo->vertexLayout = new VertexLayout;
+			wiRenderer::GetDevice()->CreateVertexShader(bytecode.data(), bytecode.size(), vertexShaderInfo->vertexShader);
+			if (!vertexLayout.empty()){
+				wiRenderer::GetDevice()->CreateInputLayout(vertexLayout.data(), (UINT)vertexLayout.size(), bytecode.data(), bytecode.size(), vertexShaderInfo->vertexLayout);
+			}
+			success = vertexShaderInfo;
+			size = bytecode.size();
+		}
+		else{
 			success = nullptr;
 		}
+	}
+	break;
+	case Data_Type::PIXELSHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)){
+			PixelShader* shader = new PixelShader;
+			wiRenderer::GetDevice()->CreatePixelShader(bytecode.data(), bytecode.size(), shader);
+			success = shader;
+			size = bytecode.size();
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::GEOMETRYSHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)){
+			GeometryShader* shader = new GeometryShader;
+			wiRenderer::GetDevice()->CreateGeometryShader(bytecode.data(), bytecode.size(), shader);
+			success = shader;
+			size = bytecode.size();
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::HULLSHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)){
+			HullShader* shader = new HullShader;
+			wiRenderer::GetDevice()->CreateHullShader(bytecode.data(), bytecode.size(), shader);
+			success = shader;
+			size = bytecode.size();
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::DOMAINSHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)){
+			DomainShader* shader = new DomainShader;
+			wiRenderer::GetDevice()->CreateDomainShader(bytecode.data(), bytecode.size(), shader);
+			success = shader;
+			size = bytecode.size();
+		}
+		else{
+			success = nullptr;
+		}
+	}
+	break;
+	case Data_Type::COMPUTESHADER:
+	{
+		vector<BYTE> bytecode;
+		if (wiShaderCache::GetGlobal()->GetBytecode(nameStr, bytecode)) {
+			ComputeShader* shader = new ComputeShader;
+			wiRenderer::GetDevice()->CreateComputeShader(bytecode.data(), bytecode.size(), shader);
+			success = shader;
+			size = bytecode.size();
+		}
+		else {
+			success = nullptr;
+		}
+	}
+	break;
+	default:
+		success=nullptr;
 		break;
-		case Data_Type::SOUND:
+	};
+
+	return success;
+}
+
+const wiResourceManager::Resource* wiResourceManager::get(const wiHashString& name, bool incRefCount)
+{
+	Shard& shard = GetShard(name);
+	shared_future<void*> loading;
+	{
+		lock_guard<mutex> lock(shard.locker);
+		container::iterator it = shard.resources.find(name);
+		if (it == shard.resources.end())
 		{
-			success = new wiSoundEffect(name.GetString());
+			return nullptr;
 		}
-		break;
-		case Data_Type::MUSIC:
+		if (incRefCount)
 		{
-			success = new wiMusic(name.GetString());
+			it->second->refCount++;
+			it->second->lastUsed = wiTimer::TotalTime();
 		}
-		break;
-		case Data_Type::VERTEXSHADER:
+		if (it->second->data != nullptr)
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(name.GetString(), &buffer, bufferSize)){
-				VertexShaderInfo* vertexShaderInfo = new VertexShaderInfo;
-				vertexShaderInfo->vertexShader = new VertexShader;
-				vertexShaderInfo->vertexLayout = new VertexLayout;
-				wiRenderer::GetDevice()->CreateVertexShader(buffer, bufferSize, vertexShaderInfo->vertexShader);
-				if (vertexLayoutDesc != nullptr && elementCount > 0){
-					wiRenderer::GetDevice()->CreateInputLayout(vertexLayoutDesc, elementCount, buffer, bufferSize, vertexShaderInfo->vertexLayout);
-				}
-				success = vertexShaderInfo;
-				delete[] buffer;
-			}
-			else{
-				success = nullptr;
-			}
+			return it->second;
 		}
-		break;
-		case Data_Type::PIXELSHADER:
+		loading = it->second->loading;
+	}
+
+	// In-flight load, the placeholder is removed if it fails:
+	if (WaitForLoad(loading) == nullptr)
+	{
+		return nullptr;
+	}
+	lock_guard<mutex> lock(shard.locker);
+	container::iterator it = shard.resources.find(name);
+	return it != shard.resources.end() ? it->second : nullptr;
+}
+
+void* wiResourceManager::add(const wiHashString& name, Data_Type newType
+	, VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+{
+	Data_Type type;
+	if (!ResolveType(name, newType, type))
+	{
+		const Resource* res = get(name, true);
+		return res != nullptr ? res->data : nullptr;
+	}
+
+	promise<void*> loader;
+	bool load;
+	shared_future<void*> result = Request(name, type, loader, load);
+	if (load)
+	{
+		// Loaded on this thread, so that add() can be used from jobs without waiting for other jobs:
+		vector<VertexLayoutDesc> vertexLayout;
+		if (vertexLayoutDesc != nullptr && elementCount > 0)
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				PixelShader* shader = new PixelShader;
-				wiRenderer::GetDevice()->CreatePixelShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+			vertexLayout.assign(vertexLayoutDesc, vertexLayoutDesc + elementCount);
 		}
-		break;
-		case Data_Type::GEOMETRYSHADER:
+		size_t size;
+		void* data = Load(name, type, vertexLayout, size);
+		Finish(name, loader, data, size);
+	}
+	return WaitForLoad(result);
+}
+
+void* wiResourceManager::WaitForLoad(const std::shared_future<void*>& loading)
+{
+	if (!loading.valid())
+	{
+		return nullptr;
+	}
+	// The load can be queued on the job system behind the waiting job (or on the only worker), so blocking right away could
+	//	deadlock. The queued jobs are run until the load is ready or there is nothing left to run: then the load is already
+	//	running on an other thread (or finished), and the thread blocks instead of polling:
+	while (loading.wait_for(chrono::seconds(0)) != future_status::ready)
+	{
+		if (!wiJobSystem::RunOne())
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				GeometryShader* shader = new GeometryShader;
-				wiRenderer::GetDevice()->CreateGeometryShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+			loading.wait();
+			break;
 		}
-		break;
-		case Data_Type::HULLSHADER:
+	}
+	return loading.get();
+}
+
+std::shared_future<void*> wiResourceManager::addAsync(const wiHashString& name, Data_Type newType
+	, const VertexLayoutDesc* vertexLayoutDesc, UINT elementCount)
+{
+	Data_Type type;
+	if (!ResolveType(name, newType, type))
+	{
+		const Resource* res = get(name, true);
+		promise<void*> result;
+		result.set_value(res != nullptr ? res->data : nullptr);
+		return result.get_future().share();
+	}
+
+	shared_ptr<promise<void*> > loader = make_shared<promise<void*> >();
+	bool load;
+	shared_future<void*> result = Request(name, type, *loader, load);
+	if (load)
+	{
+		vector<VertexLayoutDesc> vertexLayout;
+		if (vertexLayoutDesc != nullptr && elementCount > 0)
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				HullShader* shader = new HullShader;
-				wiRenderer::GetDevice()->CreateHullShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+			vertexLayout.assign(vertexLayoutDesc, vertexLayoutDesc + elementCount);
 		}
-		break;
-		case Data_Type::DOMAINSHADER:
+		wiJobSystem::Execute([=] {
+			size_t size;
+			void* data = Load(name, type, vertexLayout, size);
+			Finish(name, *loader, data, size);
+		});
+	}
+	return result;
+}
+
+bool wiResourceManager::del(const wiHashString& name, bool forceDelete)
+{
+	Shard& shard = GetShard(name);
+	shared_future<void*> loading;
+	{
+		lock_guard<mutex> lock(shard.locker);
+		container::iterator it = shard.resources.find(name);
+		if (it == shard.resources.end())
+			return false;
+		loading = it->second->loading;
+	}
+
+	// An in-flight load is finished before the resource can be released:
+	WaitForLoad(loading);
+
+	Resource* res = nullptr;
+	{
+		lock_guard<mutex> lock(shard.locker);
+		container::iterator it = shard.resources.find(name);
+		if (it == shard.resources.end())
+			return false;
+		res = it->second;
+		res->lastUsed = wiTimer::TotalTime();
+		if (res->refCount > 1 && !forceDelete)
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)){
-				DomainShader* shader = new DomainShader;
-				wiRenderer::GetDevice()->CreateDomainShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else{
-				success = nullptr;
-			}
+			res->refCount--;
+			return false;
 		}
-		break;
-		case Data_Type::COMPUTESHADER:
+		if (memoryBudget > 0 && !forceDelete)
 		{
-			BYTE* buffer;
-			size_t bufferSize;
-			if (wiHelper::readByteData(nameStr, &buffer, bufferSize)) {
-				ComputeShader* shader = new ComputeShader;
-				wiRenderer::GetDevice()->CreateComputeShader(buffer, bufferSize, shader);
-				delete[] buffer;
-				success = shader;
-			}
-			else {
-				success = nullptr;
-			}
+			// Kept for reuse until the budget needs the memory (the data is valid, failed loads are not in the table):
+			res->refCount = 0;
+			return true;
 		}
-		break;
+		shard.resources.erase(it);
+	}
+
+	return Destroy(res);
+}
+
+bool wiResourceManager::Destroy(Resource* res)
+{
+	stats.residentBytes -= res->size;
+	stats.typeBytes[res->type] -= res->size;
+
+	bool success = true;
+
+	if(res->data)
+		switch(res->type){
+		case Data_Type::IMAGE:
+		case Data_Type::IMAGE_STAGING:
+			SAFE_DELETE(reinterpret_cast<Texture2D*&>(res->data));
+			break;
+		case Data_Type::VERTEXSHADER:
+			SAFE_DELETE(reinterpret_cast<VertexShaderInfo*&>(res->data));
+			break;
+		case Data_Type::PIXELSHADER:
+			SAFE_DELETE(reinterpret_cast<PixelShader*&>(res->data));
+			break;
+		case Data_Type::GEOMETRYSHADER:
+			SAFE_DELETE(reinterpret_cast<GeometryShader*&>(res->data));
+			break;
+		case Data_Type::HULLSHADER:
+			SAFE_DELETE(reinterpret_cast<HullShader*&>(res->data));
+			break;
+		case Data_Type::DOMAINSHADER:
+			SAFE_DELETE(reinterpret_cast<DomainShader*&>(res->data));
+			break;
+		case Data_Type::COMPUTESHADER:
+			SAFE_DELETE(reinterpret_cast<ComputeShader*&>(res->data));
+			break;
+		case Data_Type::SOUND:
+		case Data_Type::MUSIC:
+			SAFE_DELETE(reinterpret_cast<wiSound*&>(res->data));
+			break;
 		default:
-			success=nullptr;
+			success=false;
 			break;
 		};
 
-		if(success)
-			resources.insert( pair<wiHashString,Resource*>(name,new Resource(success,type)) );
+	delete res;
+
+	return success;
+}
+
+void wiResourceManager::Trim(bool evictAll)
+{
+	if (!evictAll && (memoryBudget == 0 || stats.residentBytes <= memoryBudget))
+	{
+		return;
+	}
+
+	struct Candidate
+	{
+		wiHashString name;
+		double lastUsed;
+	};
+	vector<Candidate> candidates;
+	const double now = wiTimer::TotalTime();
+	for (auto& shard : shards)
+	{
+		lock_guard<mutex> lock(shard.locker);
+		for (auto& x : shard.resources)
+		{
+			const Resource* res = x.second;
+			if (res->refCount <= 0 && res->data != nullptr && (evictAll || now - res->lastUsed >= gracePeriod))
+			{
+				Candidate candidate;
+				candidate.name = x.first;
+				candidate.lastUsed = res->lastUsed;
+				candidates.push_back(candidate);
+			}
+		}
+	}
+	sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.lastUsed < b.lastUsed;
+	});
+
+	for (auto& x : candidates)
+	{
+		if (!evictAll && stats.residentBytes <= memoryBudget)
+		{
+			break;
+		}
 
-		UNLOCK();
+		// The resource could have been requested again since it was gathered:
+		Resource* res = nullptr;
+		{
+			Shard& shard = GetShard(x.name);
+			lock_guard<mutex> lock(shard.locker);
+			container::iterator it = shard.resources.find(x.name);
+			if (it != shard.resources.end() && it->second->refCount <= 0)
+			{
+				res = it->second;
+				shard.resources.erase(it);
+			}
+		}
+		if (res != nullptr)
+		{
+			Destroy(res);
+			stats.evictions++;
+		}
+	}
+}
 
-		return success;
+void wiResourceManager::SetMemoryBudget(size_t bytes)
+{
+	size_t previous = memoryBudget;
+	memoryBudget = bytes;
+	if (previous > 0 && bytes == 0)
+	{
+		// Without a budget, nothing keeps the unreferenced resources alive:
+		Trim(true);
 	}
+}
 
-	return res->data;
+void wiResourceManager::Update()
+{
+	Trim(false);
+
+	if (this == globalResources)
+	{
+		wiProfiler& profiler = wiProfiler::GetInstance();
+		profiler.SetCounter("Resources: resident MB", (double)stats.residentBytes / (1024.0 * 1024.0));
+		profiler.SetCounter("Resources: budget MB", (double)memoryBudget / (1024.0 * 1024.0));
+		profiler.SetCounter("Resources: textures MB", (double)stats.typeBytes[IMAGE] / (1024.0 * 1024.0));
+		profiler.SetCounter("Resources: sounds MB", (double)(stats.typeBytes[SOUND] + stats.typeBytes[MUSIC]) / (1024.0 * 1024.0));
+		profiler.SetCounter("Resources: hits", (double)stats.hits);
+		profiler.SetCounter("Resources: misses", (double)stats.misses);
+		profiler.SetCounter("Resources: evictions", (double)stats.evictions);
+	}
 }
 
-bool wiResourceManager::del(const wiHashString& name, bool forceDelete)
+bool wiResourceManager::Register(const wiHashString& name, void* data, Data_Type type, size_t size)
 {
-	LOCK();
-	Resource* res = nullptr;
-	container::iterator it = resources.find(name);
-	if (it != resources.end())
-		res = it->second;
-	else
 	{
-		UNLOCK();
-		return false;
+		Shard& shard = GetShard(name);
+		lock_guard<mutex> lock(shard.locker);
+		if (shard.resources.find(name) != shard.resources.end())
+		{
+			return false;
+		}
+		promise<void*> ready;
+		ready.set_value(data);
+		Resource* res = new Resource(data, type);
+		res->loading = ready.get_future().share();
+		res->size = size;
+		res->lastUsed = wiTimer::TotalTime();
+		shard.resources.insert(pair<wiHashString, Resource*>(name, res));
+	}
+	stats.residentBytes += size;
+	stats.typeBytes[type] += size;
+
+	if (memoryBudget > 0 && stats.residentBytes > memoryBudget)
+	{
+		Trim(false);
 	}
-	UNLOCK();
-
-	if(res && (res->refCount<=1 || forceDelete))
-	{
-		LOCK();
-		bool success = true;
-
-		if(res->data)
-			switch(res->type){
-			case Data_Type::IMAGE:
-			case Data_Type::IMAGE_STAGING:
-				SAFE_DELETE(reinterpret_cast<Texture2D*&>(res->data));
-				break;
-			case Data_Type::VERTEXSHADER:
-				SAFE_DELETE(reinterpret_cast<VertexShaderInfo*&>(res->data));
-				break;
-			case Data_Type::PIXELSHADER:
-				SAFE_DELETE(reinterpret_cast<PixelShader*&>(res->data));
-				break;
-			case Data_Type::GEOMETRYSHADER:
-				SAFE_DELETE(reinterpret_cast<GeometryShader*&>(res->data));
-				break;
-			case Data_Type::HULLSHADER:
-				SAFE_DELETE(reinterpret_cast<HullShader*&>(res->data));
-				break;
-			case Data_Type::DOMAINSHADER:
-				SAFE_DELETE(reinterpret_cast<DomainShader*&>(res->data));
-				break;
-			case Data_Type::COMPUTESHADER:
-				SAFE_DELETE(reinterpret_cast<ComputeShader*&>(res->data));
-				break;
-			case Data_Type::SOUND:
-			case Data_Type::MUSIC:
-				SAFE_DELETE(reinterpret_cast<wiSound*&>(res->data));
-				break;
-			default:
-				success=false;
-				break;
-			};
-
-		delete res;
-		resources.erase(name);
-
-		UNLOCK();
-
-		return success;
-	}
-	else if (res)
-	{
-		res->refCount--;
-	}
-	return false;
+	return true;
 }
 
-bool wiResourceManager::CleanUp()
+std::vector<wiHashString> wiResourceManager::GetResourceNames()
 {
-	std::vector<wiHashString>resNames(0);
-	for (auto& x : resources)
+	std::vector<wiHashString> names;
+	for (auto& shard : shards)
 	{
-		resNames.push_back(x.first);
+		lock_guard<mutex> lock(shard.locker);
+		for (auto& x : shard.resources)
+		{
+			names.push_back(x.first);
+		}
 	}
+	return names;
+}
+
+bool wiResourceManager::CleanUp()
+{
+	std::vector<wiHashString>resNames = GetResourceNames();
 	for (auto& x : resNames)
 	{
 		del(x);
 	}
-	LOCK();
-	resources.clear();
-	UNLOCK();
+	// The cached resources are destroyed, the ones that are still referenced are only forgotten:
+	Trim(true);
+	for (auto& shard : shards)
+	{
+		lock_guard<mutex> lock(shard.locker);
+		shard.resources.clear();
+	}
 	return true;
 }
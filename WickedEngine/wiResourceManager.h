@@ -6,6 +6,10 @@
 
 #include <map>
 #include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <future>
+#include <atomic>
 
 class wiSound;
 
@@ -22,6 +26,7 @@ public:
 		HULLSHADER,
 		DOMAINSHADER,
 		COMPUTESHADER,
+		DATA_TYPE_COUNT
 	};
 
 	struct Resource
@@ -29,14 +34,36 @@ public:
 		void* data;
 		Data_Type type;
 		long refCount;
+		size_t size;		// approximate memory usage in bytes
+		double lastUsed;	// time of the last request or release (wiTimer::TotalTime)
+		// Ready when the data is loaded. Resources that are still loading are placeholders in the table, their data is nullptr until then.
+		std::shared_future<void*> loading;
 
-		Resource(void* newData, Data_Type newType) :data(newData), type(newType)
+		Resource(void* newData, Data_Type newType) :data(newData), type(newType), size(0), lastUsed(0)
 		{
 			refCount = 1;
 		};
 	};
 	typedef std::unordered_map<wiHashString, Resource*> container;
-	container resources;
+
+	struct Stats
+	{
+		std::atomic<uint64_t> loads;		// resources that were loaded
+		std::atomic<uint64_t> hits;			// requests for resources that were already loaded (or still cached)
+		std::atomic<uint64_t> misses;		// requests that had to load the resource
+		std::atomic<uint64_t> sharedLoads;	// requests that waited for the load started by an other request
+		std::atomic<uint64_t> evictions;	// unreferenced resources destroyed to stay within the memory budget
+		std::atomic<size_t> residentBytes;
+		std::atomic<size_t> typeBytes[DATA_TYPE_COUNT];	// resident bytes by Data_Type
+
+		Stats() :loads(0), hits(0), misses(0), sharedLoads(0), evictions(0), residentBytes(0)
+		{
+			for (auto& x : typeBytes)
+			{
+				x = 0;
+			}
+		}
+	};
 
 protected:
 typedef std::map<std::string,Data_Type> filetypes;
@@ -44,6 +71,36 @@ static filetypes types;
 static wiResourceManager* globalResources;
 static void SetUp();
 
+	// The table is split by name hash, so that threads working with different resources rarely wait for each other.
+	//	The locks are only held for the table operations, never while loading.
+	static const size_t SHARD_COUNT = 16;
+	struct Shard
+	{
+		std::mutex locker;
+		container resources;
+	};
+	Shard shards[SHARD_COUNT];
+	Stats stats;
+	size_t memoryBudget;
+	double gracePeriod;
+
+	Shard& GetShard(const wiHashString& name) { return shards[name.GetHash() % SHARD_COUNT]; }
+	// Finds the resource type from the extension for DYNAMIC, returns false if it is unknown
+	static bool ResolveType(const wiHashString& name, Data_Type newType, Data_Type& type);
+	// Returns the future of the resource and increments its reference count. If the resource is not in the table,
+	//	a placeholder is inserted with the promise and load is set to true: the caller has to load it and call Finish().
+	std::shared_future<void*> Request(const wiHashString& name, Data_Type type, std::promise<void*>& promise, bool& load);
+	// Creates the resource data from the file
+	//	size receives the approximate memory usage of the data
+	static void* Load(const wiHashString& name, Data_Type type, const std::vector<wiGraphicsTypes::VertexLayoutDesc>& vertexLayout, size_t& size);
+	// Stores the loaded data in the placeholder (or removes it if the load failed) and fulfills the promise
+	void Finish(const wiHashString& name, std::promise<void*>& promise, void* data, size_t size);
+	// Destroys the data of a resource that is already removed from the table and deletes it
+	bool Destroy(Resource* res);
+	// Destroys unreferenced resources in least recently used order while the budget is exceeded.
+	//	evictAll: destroy every unreferenced resource regardless of the budget and grace period
+	void Trim(bool evictAll);
+
 
 public:
 	wiResourceManager();
@@ -51,11 +108,39 @@ public:
 	static wiResourceManager* GetGlobal();
 	static wiResourceManager* GetShaderManager();
 
+	// If the resource is being loaded, this waits for it
 	const Resource* get(const wiHashString& name, bool IncRefCount = false);
 	//specify datatype for shaders
+	// If an other thread is loading the same resource, this waits for that instead of loading it again
 	void* add(const wiHashString& name, Data_Type newType = Data_Type::DYNAMIC
 		, wiGraphicsTypes::VertexLayoutDesc* vertexLayoutDesc = nullptr, UINT elementCount = 0);
+	// Same as add(), but the loading runs on the job system. The future returns the data, or nullptr if the load failed.
+	//	The reference count is incremented immediately, so every call needs a del() like add().
+	std::shared_future<void*> addAsync(const wiHashString& name, Data_Type newType = Data_Type::DYNAMIC
+		, const wiGraphicsTypes::VertexLayoutDesc* vertexLayoutDesc = nullptr, UINT elementCount = 0);
+	// Waits for a future of addAsync() and returns its data. Jobs are executed on the calling thread meanwhile,
+	//	so it can be used from jobs (the future's get() could wait for a load that is queued behind the caller)
+	static void* WaitForLoad(const std::shared_future<void*>& loading);
+	// Waits for the resource if it is being loaded before releasing it
+	//	With a memory budget, the resource stays cached when its last reference is released, until the budget needs the memory
 	bool del(const wiHashString& name, bool forceDelete = false);
 	bool CleanUp();
+	// Adds data that was created outside of the manager, size is its memory usage for the budget.
+	//	Returns false if the name is already used. DYNAMIC data is only forgotten, not destroyed when it is released.
+	bool Register(const wiHashString& name, void* data, Data_Type type, size_t size);
+
+	// Unreferenced resources are kept until the resident memory exceeds this, then the least recently used ones are destroyed.
+	//	0 means no budget: resources are destroyed when their last reference is released (default)
+	void SetMemoryBudget(size_t bytes);
+	size_t GetMemoryBudget() const { return memoryBudget; }
+	// Unreferenced resources are not evicted until this much time (milliseconds) passed since their release (default: 5000)
+	void SetGracePeriod(double milliseconds) { gracePeriod = milliseconds; }
+	double GetGracePeriod() const { return gracePeriod; }
+	// Enforces the memory budget for the resources whose grace period ended and publishes the stats to the profiler. Call once per frame.
+	void Update();
+
+	// Names of the resources in the table, including the ones that are being loaded
+	std::vector<wiHashString> GetResourceNames();
+	const Stats& GetStats() { return stats; }
 };
 
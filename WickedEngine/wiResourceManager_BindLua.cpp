@@ -14,6 +14,9 @@ Luna<wiResourceManager_BindLua>::FunctionType wiResourceManager_BindLua::methods
 	lunamethod(wiResourceManager_BindLua, Add),
 	lunamethod(wiResourceManager_BindLua, Del),
 	lunamethod(wiResourceManager_BindLua, List),
+	lunamethod(wiResourceManager_BindLua, SetMemoryBudget),
+	lunamethod(wiResourceManager_BindLua, SetGracePeriod),
+	lunamethod(wiResourceManager_BindLua, GetStats),
 	{ NULL, NULL }
 };
 Luna<wiResourceManager_BindLua>::PropertyType wiResourceManager_BindLua::properties[] = {
@@ -41,7 +44,7 @@ int wiResourceManager_BindLua::Get(lua_State *L)
 	int argc = wiLua::SGetArgCount(L);
 	if (argc > 0)
 	{
-		string name = wiLua::SGetString(L, 1);
+		wiHashString name = wiLua::SGetString(L, 1);
 		const wiResourceManager::Resource* data = resources->get(name);
 		if (data != nullptr)
 		{
@@ -83,7 +86,7 @@ int wiResourceManager_BindLua::Add(lua_State *L)
 	int argc = wiLua::SGetArgCount(L);
 	if (argc > 0)
 	{
-		string name = wiLua::SGetString(L, 1);
+		wiHashString name = wiLua::SGetString(L, 1);
 		wiResourceManager::Data_Type type = wiResourceManager::Data_Type::DYNAMIC;
 		if (argc > 1) //type info also provided in this case
 		{
@@ -113,7 +116,7 @@ int wiResourceManager_BindLua::Del(lua_State *L)
 	int argc = wiLua::SGetArgCount(L);
 	if (argc > 0)
 	{
-		string name = wiLua::SGetString(L, 1);
+		wiHashString name = wiLua::SGetString(L, 1);
 		wiLua::SSetString(L, (resources->del(name) ? "ok" : "not found"));
 		return 1;
 	}
@@ -131,13 +134,64 @@ int wiResourceManager_BindLua::List(lua_State *L)
 		return 0;
 	}
 	stringstream ss("");
-	for (auto x : resources->resources)
+	for (auto& x : resources->GetResourceNames())
 	{
-		ss << x.first.GetString() << endl;
+		ss << x.GetString() << endl;
 	}
 	wiLua::SSetString(L, ss.str());
 	return 1;
 }
+int wiResourceManager_BindLua::SetMemoryBudget(lua_State *L)
+{
+	if (resources == nullptr)
+	{
+		wiLua::SError(L, "SetMemoryBudget(int megabytes) resources is empty!");
+		return 0;
+	}
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		resources->SetMemoryBudget((size_t)wiLua::SGetLongLong(L, 1) * 1024 * 1024);
+	}
+	else
+	{
+		wiLua::SError(L, "SetMemoryBudget(int megabytes) not enough arguments!");
+	}
+	return 0;
+}
+int wiResourceManager_BindLua::SetGracePeriod(lua_State *L)
+{
+	if (resources == nullptr)
+	{
+		wiLua::SError(L, "SetGracePeriod(float milliseconds) resources is empty!");
+		return 0;
+	}
+	int argc = wiLua::SGetArgCount(L);
+	if (argc > 0)
+	{
+		resources->SetGracePeriod(wiLua::SGetDouble(L, 1));
+	}
+	else
+	{
+		wiLua::SError(L, "SetGracePeriod(float milliseconds) not enough arguments!");
+	}
+	return 0;
+}
+int wiResourceManager_BindLua::GetStats(lua_State *L)
+{
+	if (resources == nullptr)
+	{
+		wiLua::SError(L, "GetStats() resources is empty!");
+		return 0;
+	}
+	const wiResourceManager::Stats& stats = resources->GetStats();
+	wiLua::SSetDouble(L, (double)stats.residentBytes / (1024.0 * 1024.0));
+	wiLua::SSetDouble(L, (double)resources->GetMemoryBudget() / (1024.0 * 1024.0));
+	wiLua::SSetDouble(L, (double)stats.hits);
+	wiLua::SSetDouble(L, (double)stats.misses);
+	wiLua::SSetDouble(L, (double)stats.evictions);
+	return 5;
+}
 
 void wiResourceManager_BindLua::Bind()
 {
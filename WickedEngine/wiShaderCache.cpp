@@ -0,0 +1,190 @@
+#include "wiShaderCache.h"
+#include "wiArchive.h"
+#include "wiHelper.h"
+#include "wiTimer.h"
+
+using namespace std;
+
+static const string SHADERCACHE_MAGIC = "WISHADERCACHE";
+
+wiShaderCache::wiShaderCache() :validation(true), dirty(false)
+{
+}
+
+string wiShaderCache::GetKey(const string& shaderFileName) const
+{
+	if (!directory.empty() && shaderFileName.compare(0, directory.length(), directory) == 0)
+	{
+		return shaderFileName.substr(directory.length());
+	}
+	return shaderFileName;
+}
+
+bool wiShaderCache::Open(const string& fileName)
+{
+	wiTimer timer;
+
+	lock_guard<mutex> lock(locker);
+
+	this->fileName = fileName;
+	directory = wiHelper::GetDirectoryFromPath(fileName);
+	entries.clear();
+	dirty = false;
+
+	bool success = false;
+	{
+		wiArchive archive(fileName, true);
+		if (archive.IsOpen())
+		{
+			string magic;
+			uint64_t version = 0;
+			archive >> magic;
+			if (!magic.compare(SHADERCACHE_MAGIC))
+			{
+				archive >> version;
+			}
+			if (version == VERSION)
+			{
+				uint64_t count;
+				archive >> count;
+				for (uint64_t i = 0; i < count && !archive.IsFailed(); ++i)
+				{
+					string name;
+					archive >> name;
+					Entry& entry = entries[name];
+					archive >> entry.fileSize;
+					archive >> entry.writeTime;
+					archive >> entry.bytecode;
+				}
+				// A truncated cache is not used at all, the shaders are read from their files and the cache is rewritten:
+				success = !archive.IsFailed();
+				if (!success)
+				{
+					entries.clear();
+					dirty = true;
+				}
+			}
+		}
+	}
+
+	stats.entries = (uint32_t)entries.size();
+	stats.openTime = (float)timer.elapsed();
+
+	return success;
+}
+
+bool wiShaderCache::Save()
+{
+	lock_guard<mutex> lock(locker);
+
+	if (!dirty || fileName.empty())
+	{
+		return true;
+	}
+
+	wiArchive archive(fileName, false);
+	if (!archive.IsOpen())
+	{
+		return false;
+	}
+	archive << SHADERCACHE_MAGIC;
+	archive << VERSION;
+	archive << (uint64_t)entries.size();
+	for (auto& x : entries)
+	{
+		archive << x.first;
+		archive << x.second.fileSize;
+		archive << x.second.writeTime;
+		archive << x.second.bytecode;
+	}
+
+	// The shaders are created meanwhile, the file is written in the background:
+	archive.CloseAsync();
+	dirty = false;
+
+	return true;
+}
+
+void wiShaderCache::Clear()
+{
+	lock_guard<mutex> lock(locker);
+
+	dirty = dirty || !entries.empty();
+	entries.clear();
+	stats.entries = 0;
+}
+
+bool wiShaderCache::GetBytecode(const string& shaderFileName, vector<BYTE>& bytecode)
+{
+	const string key = GetKey(shaderFileName);
+
+	// The file is not opened for the validation, only its attributes are read:
+	uint64_t fileSize = 0;
+	uint64_t writeTime = 0;
+	const bool stamped = validation && wiHelper::GetFileStamp(shaderFileName, fileSize, writeTime);
+
+	{
+		lock_guard<mutex> lock(locker);
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			// A missing file can't be validated, then the cached bytecode is used (shipped without the shader files):
+			const Entry& entry = it->second;
+			if (!stamped || (entry.fileSize == fileSize && entry.writeTime == writeTime))
+			{
+				bytecode = entry.bytecode;
+				stats.hits++;
+				stats.hitBytes += bytecode.size();
+				return true;
+			}
+			stats.stale++;
+		}
+		else
+		{
+			stats.misses++;
+		}
+	}
+
+	BYTE* data;
+	size_t dataSize;
+	if (!wiHelper::readByteData(shaderFileName, &data, dataSize))
+	{
+		return false;
+	}
+	bytecode.assign(data, data + dataSize);
+	delete[] data;
+
+	if (!stamped)
+	{
+		wiHelper::GetFileStamp(shaderFileName, fileSize, writeTime);
+	}
+
+	lock_guard<mutex> lock(locker);
+	Entry& entry = entries[key];
+	entry.fileSize = fileSize;
+	entry.writeTime = writeTime;
+	entry.bytecode = bytecode;
+	dirty = true;
+	stats.entries = (uint32_t)entries.size();
+	stats.missBytes += dataSize;
+
+	return true;
+}
+
+wiShaderCache::Stats wiShaderCache::GetStats()
+{
+	lock_guard<mutex> lock(locker);
+	return stats;
+}
+void wiShaderCache::ResetStats()
+{
+	lock_guard<mutex> lock(locker);
+	stats = Stats();
+	stats.entries = (uint32_t)entries.size();
+}
+
+wiShaderCache* wiShaderCache::GetGlobal()
+{
+	static wiShaderCache* globalCache = new wiShaderCache;
+	return globalCache;
+}
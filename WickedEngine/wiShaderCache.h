@@ -0,0 +1,80 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+// Persistent cache of the precompiled shader bytecode. Every shader file that is read through the cache is stored in one
+//	archive together with an index of the file names, sizes and modification times, so a warm start reads that single
+//	file instead of opening every shader file. Entries whose file changed are read again, and Save() rewrites the archive.
+//	It is thread safe, shaders can be read through it from the job system.
+class wiShaderCache
+{
+public:
+	struct Stats
+	{
+		uint32_t entries;		// shaders in the cache
+		uint32_t hits;			// reads served from the cache
+		uint32_t misses;		// reads that had to open the file because it was not in the cache
+		uint32_t stale;			// reads that had to open the file because it changed since it was cached
+		uint64_t hitBytes;		// bytecode served from the cache
+		uint64_t missBytes;		// bytecode read from the files
+		float openTime;			// milliseconds spent reading the archive in the last Open()
+
+		Stats() :entries(0), hits(0), misses(0), stale(0), hitBytes(0), missBytes(0), openTime(0) {}
+	};
+
+private:
+	struct Entry
+	{
+		uint64_t fileSize;
+		uint64_t writeTime;
+		std::vector<BYTE> bytecode;
+	};
+
+	std::string fileName;
+	std::string directory;	// entries in this directory are stored with relative names
+	std::unordered_map<std::string, Entry> entries;
+	bool validation;
+	bool dirty;
+	Stats stats;
+	std::mutex locker;
+
+	std::string GetKey(const std::string& shaderFileName) const;
+
+public:
+	// The current version of the archive content. Archives with an other version are ignored (and overwritten by Save())
+	static const uint64_t VERSION = 1;
+
+	wiShaderCache();
+	wiShaderCache(const wiShaderCache&) = delete;
+	wiShaderCache& operator=(const wiShaderCache&) = delete;
+
+	// Reads the index and the bytecode from the archive, the cache will be saved to this file.
+	//	Returns false if the file doesn't exist or is not a valid cache (or it is truncated), then the cache starts empty.
+	bool Open(const std::string& fileName);
+	// Writes the archive in the background if shaders were added or refreshed since it was opened or saved.
+	//	Returns false if it had to be written, but it couldn't be.
+	bool Save();
+	// Forgets every entry (the file is only changed by the next Save())
+	void Clear();
+	const std::string& GetFileName() const { return fileName; }
+
+	// Gets the bytecode of a shader file from the cache, or reads the file and adds it to the cache.
+	//	Returns false if the shader is neither cached nor readable.
+	bool GetBytecode(const std::string& shaderFileName, std::vector<BYTE>& bytecode);
+
+	// When enabled (default), an entry is only used if the size and the modification time of its file didn't change.
+	//	Without it, the shader files are not touched at all when the cache has them (for builds with fixed shaders).
+	void SetValidationEnabled(bool value) { validation = value; }
+	bool IsValidationEnabled() const { return validation; }
+
+	Stats GetStats();
+	void ResetStats();
+
+	// The cache that the shader manager reads the shaders through
+	static wiShaderCache* GetGlobal();
+};
+
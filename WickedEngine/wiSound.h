@@ -66,6 +66,8 @@ public:
 	HRESULT Load(std::string);
 	virtual HRESULT Play(DWORD delay = 0) = 0;
 	void Stop();
+	// Size of the loaded wave data in bytes
+	size_t GetMemorySize() const { return (size_t)buffer.AudioBytes; }
 };
 
 class wiSoundEffect : public wiSound
@@ -0,0 +1,87 @@
+#include "wiSpinLock.h"
+#include "CommonInclude.h"
+
+#include <thread>
+
+#if defined(_WIN32)
+#if (_WIN32_WINNT >= 0x0602 /*_WIN32_WINNT_WIN8*/)
+#define WISPINLOCK_WAITONADDRESS
+#pragma comment(lib,"Synchronization.lib")
+#endif
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Spinning rounds before parking, the pause count doubles every round up to MAX_BACKOFF:
+static const int SPIN_ROUNDS = 12;
+static const uint32_t MAX_BACKOFF = 64;
+
+static inline void Pause()
+{
+#if defined(_WIN32)
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+// Sleeps while the value at the address equals the compared value (it can return spuriously)
+static inline void Park(atomic<uint32_t>* address, uint32_t compare)
+{
+#if defined(WISPINLOCK_WAITONADDRESS)
+	WaitOnAddress(address, &compare, sizeof(compare), INFINITE);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAIT_PRIVATE, compare, nullptr, nullptr, 0);
+#else
+	this_thread::yield();
+#endif
+}
+
+static inline void WakeOne(atomic<uint32_t>* address)
+{
+#if defined(WISPINLOCK_WAITONADDRESS)
+	WakeByAddressSingle(address);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+void wiSpinLock::lockContended()
+{
+	stats.contended.fetch_add(1, memory_order_relaxed);
+
+	uint32_t backoff = 1;
+	for (int round = 0; round < SPIN_ROUNDS; ++round)
+	{
+		for (uint32_t i = 0; i < backoff; ++i)
+		{
+			Pause();
+		}
+		backoff = backoff < MAX_BACKOFF ? backoff * 2 : MAX_BACKOFF;
+
+		// Only try the atomic exchange when it can succeed, so that the cache line isn't stolen from the owner:
+		uint32_t expected = UNLOCKED;
+		if (state.load(memory_order_relaxed) == UNLOCKED && state.compare_exchange_weak(expected, LOCKED, memory_order_acquire))
+		{
+			stats.spinAcquired.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	// Mark the lock as having waiters before sleeping. The lock taken this way also stays marked, because
+	//	there is no way to know if other threads are still parked:
+	while (state.exchange(LOCKED_WAITERS, memory_order_acquire) != UNLOCKED)
+	{
+		stats.parked.fetch_add(1, memory_order_relaxed);
+		Park(&state, LOCKED_WAITERS);
+	}
+}
+
+void wiSpinLock::wakeWaiter()
+{
+	WakeOne(&state);
+}
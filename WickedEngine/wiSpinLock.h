@@ -1,22 +1,63 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
 
+// Lock for short critical sections. An uncontended lock() is a single atomic operation. A contended lock() spins
+//	for a while with exponential backoff, because the owner is likely to release it soon. After that the thread is
+//	parked in the kernel until the owner wakes it, so waiting threads don't burn a core and don't starve the owner
+//	on oversubscribed machines.
 class wiSpinLock
 {
+public:
+	// Only updated on the contended path, so they don't cost anything for uncontended locking
+	struct Stats
+	{
+		std::atomic<uint64_t> contended;	// lock() calls that found the lock taken
+		std::atomic<uint64_t> spinAcquired;	// contended lock() calls that got the lock while spinning
+		std::atomic<uint64_t> parked;		// times a waiting thread went to sleep
+
+		Stats() :contended(0), spinAcquired(0), parked(0) {}
+	};
+
 private:
-	std::atomic_flag lck = ATOMIC_FLAG_INIT;
+	enum STATE
+	{
+		UNLOCKED,
+		LOCKED,
+		LOCKED_WAITERS,	// there may be parked threads that have to be woken when unlocking
+	};
+	std::atomic<uint32_t> state;
+	Stats stats;
+
+	void lockContended();
+	void wakeWaiter();
+
 public:
+	wiSpinLock() :state(UNLOCKED) {}
+	wiSpinLock(const wiSpinLock&) = delete;
+	wiSpinLock& operator=(const wiSpinLock&) = delete;
+
 	void lock()
 	{
-		while (!try_lock()){}
+		uint32_t expected = UNLOCKED;
+		if (!state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire))
+		{
+			lockContended();
+		}
 	}
 	bool try_lock()
 	{
-		return !lck.test_and_set(std::memory_order_acquire);
+		uint32_t expected = UNLOCKED;
+		return state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
 	}
 
 	void unlock()
 	{
-		lck.clear(std::memory_order_release);
+		if (state.exchange(UNLOCKED, std::memory_order_release) == LOCKED_WAITERS)
+		{
+			wakeWaiter();
+		}
 	}
+
+	const Stats& GetStats() const { return stats; }
 };
@@ -0,0 +1,431 @@
+#include "wiStreaming.h"
+#include "wiLoader.h"
+#include "wiArchive.h"
+#include "wiTimer.h"
+#include "wiMath.h"
+#include "wiProfiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <algorithm>
+
+using namespace std;
+
+namespace wiStreaming
+{
+	enum MESH_STATE
+	{
+		MESH_RESIDENT,
+		MESH_NONRESIDENT,
+		MESH_QUEUED,	// waiting in the request queue
+		MESH_LOADING,	// the I/O thread works on it or it is waiting to be picked up
+	};
+	struct MeshStreamingState
+	{
+		MESH_STATE state;
+		Object* user;			// any object that uses the mesh (needed for GPU buffer creation)
+		string fileName;
+		float distance;			// closest distance of any object using the mesh to the (predicted) camera
+		bool locked;			// an object uses the mesh in a way that needs it resident (physics, skinning, particles)
+		uint64_t lastUsedFrame;	// last frame when it was inside the stream in distance
+		uint64_t seenFrame;		// last frame when an object referenced it
+		double requestTime;
+
+		MeshStreamingState() :state(MESH_RESIDENT), user(nullptr), distance(FLT_MAX), locked(false), lastUsedFrame(0), seenFrame(0), requestTime(0) {}
+	};
+	struct Request
+	{
+		Mesh* mesh;
+		string fileName;
+	};
+	struct Result
+	{
+		Mesh* mesh;
+		Mesh* payload;
+	};
+
+	unordered_map<Mesh*, MeshStreamingState> meshes;
+	uint64_t frame = 0;
+	XMFLOAT3 prevEye = XMFLOAT3(0, 0, 0);
+	Stats stats;
+
+	size_t memoryBudget = 512 * 1024 * 1024;
+	float streamInDistance = 200.0f;
+	float streamOutDistance = 300.0f;
+	float predictionTime = 1.0f;
+	uint32_t maxUploadsPerFrame = 4;
+
+	// Shared with the I/O thread:
+	thread ioThread;
+	mutex locker;
+	condition_variable wakeup;
+	bool running = false;
+	deque<Request> requests;
+	vector<Result> results;
+
+	void IOThreadFunc()
+	{
+		while (true)
+		{
+			Request request;
+			{
+				unique_lock<mutex> lock(locker);
+				while (running && requests.empty())
+				{
+					wakeup.wait(lock);
+				}
+				if (!running)
+				{
+					return;
+				}
+				request = requests.front();
+				requests.pop_front();
+			}
+
+			// Everything that doesn't need the GPU is done here, off the render thread:
+			Mesh* payload = nullptr;
+			wiArchive archive(request.fileName, true);
+			if (archive.IsOpen())
+			{
+				payload = new Mesh;
+				payload->Serialize(archive);
+				if (archive.IsFailed())
+				{
+					// Handled like a missing chunk:
+					SAFE_DELETE(payload);
+				}
+				else
+				{
+					payload->Optimize();
+					payload->CreateVertexArrays();
+				}
+			}
+
+			{
+				lock_guard<mutex> lock(locker);
+				Result result;
+				result.mesh = request.mesh;
+				result.payload = payload;
+				results.push_back(result);
+			}
+		}
+	}
+
+	void Initialize()
+	{
+		if (running)
+		{
+			return;
+		}
+		running = true;
+		ioThread = thread(IOThreadFunc);
+	}
+	void CleanUp()
+	{
+		{
+			lock_guard<mutex> lock(locker);
+			running = false;
+			requests.clear();
+		}
+		wakeup.notify_all();
+		if (ioThread.joinable())
+		{
+			ioThread.join();
+		}
+		for (auto& x : results)
+		{
+			SAFE_DELETE(x.payload);
+		}
+		results.clear();
+		meshes.clear();
+	}
+
+	bool IsStreamable(const Object* object)
+	{
+		return !object->directory.empty() && object->mesh != nullptr && object->mesh->renderable;
+	}
+	bool IsLocking(const Object* object)
+	{
+		return object->isDynamic() || object->mesh->hasArmature() || !object->eParticleSystems.empty() || !object->hParticleSystems.empty();
+	}
+
+	void CreateChunks(Model* model, const std::string& directory)
+	{
+		for (Object* object : model->objects)
+		{
+			if (object->mesh == nullptr || !object->mesh->renderable || IsLocking(object))
+			{
+				continue;
+			}
+
+			string fileName = directory + object->mesh->name + ".wichunk";
+			if (object->directory.compare(directory))
+			{
+				wiArchive archive(fileName, false);
+				object->mesh->Serialize(archive);
+			}
+
+			object->directory = directory;
+			object->meshfile = object->mesh->name;
+		}
+	}
+
+	void Update(Scene& scene, const XMFLOAT3& eye, float dt)
+	{
+		if (!running)
+		{
+			return;
+		}
+
+		wiProfiler::GetInstance().BeginRange("Streaming", wiProfiler::DOMAIN_CPU);
+
+		frame++;
+
+		// Predict where the camera will be:
+		XMVECTOR E = XMLoadFloat3(&eye);
+		XMVECTOR V = dt > 0 ? (E - XMLoadFloat3(&prevEye)) / dt : XMVectorZero();
+		XMFLOAT3 predictedEye;
+		XMStoreFloat3(&predictedEye, E + V * predictionTime);
+		prevEye = eye;
+
+		// Gather streamable meshes and their priorities:
+		for (auto& x : meshes)
+		{
+			x.second.distance = FLT_MAX;
+			x.second.locked = false;
+		}
+		for (Model* model : scene.models)
+		{
+			for (Object* object : model->objects)
+			{
+				if (!IsStreamable(object))
+				{
+					continue;
+				}
+
+				MeshStreamingState& state = meshes[object->mesh];
+				if (state.seenFrame == 0)
+				{
+					state.state = object->mesh->buffersComplete ? MESH_RESIDENT : MESH_NONRESIDENT;
+				}
+				state.seenFrame = frame;
+				state.user = object;
+				state.fileName = object->directory + object->meshfile + ".wichunk";
+				state.locked = state.locked || IsLocking(object);
+
+				const float radius = object->bounds.getRadius();
+				const XMFLOAT3 center = object->bounds.getCenter();
+				float distance = min(wiMath::Distance(eye, center), wiMath::Distance(predictedEye, center));
+				distance = max(0.0f, distance - radius);
+				state.distance = min(state.distance, distance);
+			}
+		}
+
+		// Forget meshes that are no longer in the scene:
+		for (auto it = meshes.begin(); it != meshes.end();)
+		{
+			if (it->second.seenFrame != frame)
+			{
+				it = meshes.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		// Pick up the finished loads:
+		vector<Result> finished;
+		{
+			lock_guard<mutex> lock(locker);
+			size_t count = min((size_t)maxUploadsPerFrame, results.size());
+			finished.insert(finished.end(), results.begin(), results.begin() + count);
+			results.erase(results.begin(), results.begin() + count);
+		}
+		for (auto& x : finished)
+		{
+			auto it = meshes.find(x.mesh);
+			// The request might have been taken by the I/O thread after the last update, so it can still be marked as queued:
+			if (it != meshes.end() && (it->second.state == MESH_LOADING || it->second.state == MESH_QUEUED))
+			{
+				MeshStreamingState& state = it->second;
+				if (x.payload != nullptr && state.distance < streamOutDistance)
+				{
+					x.mesh->SwapPayload(*x.payload);
+					x.mesh->CreateBuffers(state.user);
+					state.state = MESH_RESIDENT;
+
+					stats.streamedIn++;
+					stats.lastLatency = wiTimer::TotalTime() - state.requestTime;
+					stats.maxLatency = max(stats.maxLatency, stats.lastLatency);
+					stats.averageLatency += (stats.lastLatency - stats.averageLatency) / (double)stats.streamedIn;
+				}
+				else
+				{
+					// Went out of range while loading, or the chunk is missing:
+					state.state = MESH_NONRESIDENT;
+					stats.cancelled++;
+				}
+			}
+			SAFE_DELETE(x.payload);
+		}
+
+		// Release the meshes that are out of range:
+		for (auto& x : meshes)
+		{
+			MeshStreamingState& state = x.second;
+			if (state.distance < streamInDistance)
+			{
+				state.lastUsedFrame = frame;
+			}
+			if (state.state == MESH_RESIDENT && !state.locked && state.distance > streamOutDistance)
+			{
+				x.first->ReleasePayload();
+				state.state = MESH_NONRESIDENT;
+				stats.streamedOut++;
+			}
+		}
+
+		// Enforce the memory budget, least recently used first:
+		size_t residentBytes = 0;
+		vector<pair<uint64_t, Mesh*> > evictable;
+		for (auto& x : meshes)
+		{
+			if (x.second.state == MESH_RESIDENT)
+			{
+				residentBytes += x.first->GetMemorySize();
+				if (!x.second.locked && x.second.lastUsedFrame != frame)
+				{
+					evictable.push_back(make_pair(x.second.lastUsedFrame, x.first));
+				}
+			}
+		}
+		if (residentBytes > memoryBudget)
+		{
+			sort(evictable.begin(), evictable.end());
+			for (auto& x : evictable)
+			{
+				if (residentBytes <= memoryBudget)
+				{
+					break;
+				}
+				residentBytes -= x.second->GetMemorySize();
+				x.second->ReleasePayload();
+				meshes[x.second].state = MESH_NONRESIDENT;
+				stats.streamedOut++;
+			}
+		}
+
+		// Rebuild the request queue by priority. Queued requests that are no longer needed are cancelled:
+		vector<pair<float, Mesh*> > wanted;
+		for (auto& x : meshes)
+		{
+			MeshStreamingState& state = x.second;
+			bool needed = state.distance < streamInDistance;
+			if (state.state == MESH_QUEUED && !needed)
+			{
+				state.state = MESH_NONRESIDENT;
+				stats.cancelled++;
+			}
+			else if (needed && (state.state == MESH_NONRESIDENT || state.state == MESH_QUEUED))
+			{
+				if (state.state == MESH_NONRESIDENT)
+				{
+					state.requestTime = wiTimer::TotalTime();
+					state.state = MESH_QUEUED;
+				}
+				wanted.push_back(make_pair(state.distance, x.first));
+			}
+		}
+		sort(wanted.begin(), wanted.end());
+		{
+			lock_guard<mutex> lock(locker);
+
+			// Queued meshes that are no longer in the queue were taken by the I/O thread:
+			unordered_set<Mesh*> queued;
+			for (auto& x : requests)
+			{
+				queued.insert(x.mesh);
+			}
+			for (auto& x : meshes)
+			{
+				if (x.second.state == MESH_QUEUED && queued.count(x.first) == 0)
+				{
+					x.second.state = MESH_LOADING;
+				}
+			}
+
+			requests.clear();
+			for (auto& x : wanted)
+			{
+				if (meshes[x.second].state != MESH_QUEUED)
+				{
+					continue;
+				}
+				Request request;
+				request.mesh = x.second;
+				request.fileName = meshes[x.second].fileName;
+				requests.push_back(request);
+			}
+			stats.pendingRequests = (uint32_t)requests.size();
+		}
+		wakeup.notify_one();
+
+		stats.residentMeshes = 0;
+		for (auto& x : meshes)
+		{
+			if (x.second.state == MESH_RESIDENT)
+			{
+				stats.residentMeshes++;
+			}
+		}
+
+		// Update the object residency flags:
+		for (Model* model : scene.models)
+		{
+			for (Object* object : model->objects)
+			{
+				if (IsStreamable(object))
+				{
+					object->loaded = meshes[object->mesh].state == MESH_RESIDENT;
+				}
+			}
+		}
+
+		stats.residentBytes = residentBytes;
+		stats.budgetBytes = memoryBudget;
+		stats.streamableMeshes = (uint32_t)meshes.size();
+
+		wiProfiler::GetInstance().EndRange(); // Streaming
+	}
+
+	void SetMemoryBudget(size_t bytes)
+	{
+		memoryBudget = bytes;
+	}
+	void SetStreamInDistance(float value)
+	{
+		streamInDistance = value;
+	}
+	void SetStreamOutDistance(float value)
+	{
+		streamOutDistance = value;
+	}
+	void SetPredictionTime(float value)
+	{
+		predictionTime = value;
+	}
+	void SetMaxUploadsPerFrame(uint32_t value)
+	{
+		maxUploadsPerFrame = value;
+	}
+
+	const Stats& GetStats()
+	{
+		return stats;
+	}
+}
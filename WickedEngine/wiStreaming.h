@@ -0,0 +1,59 @@
+#pragma once
+#include "CommonInclude.h"
+
+#include <string>
+
+struct Scene;
+struct Model;
+
+// Distance based mesh streaming for Streamable objects.
+//	Objects with a non-empty streaming directory have their mesh payload (vertex and index data, GPU buffers)
+//	loaded from per-mesh chunk archives on a background I/O thread, and released when they are far away or
+//	when the memory budget is exceeded.
+namespace wiStreaming
+{
+	struct Stats
+	{
+		size_t residentBytes;	// memory of the resident streamable meshes
+		size_t budgetBytes;
+		uint32_t residentMeshes;
+		uint32_t streamableMeshes;
+		uint32_t pendingRequests;
+		uint64_t streamedIn;
+		uint64_t streamedOut;
+		uint64_t cancelled;
+		double lastLatency;		// milliseconds between the request and the mesh becoming renderable
+		double averageLatency;
+		double maxLatency;
+
+		Stats() :residentBytes(0), budgetBytes(0), residentMeshes(0), streamableMeshes(0), pendingRequests(0),
+			streamedIn(0), streamedOut(0), cancelled(0), lastLatency(0), averageLatency(0), maxLatency(0) {}
+	};
+
+	// Starts the I/O thread
+	void Initialize();
+	// Stops the I/O thread and discards unfinished requests
+	void CleanUp();
+
+	// Writes every streamable mesh of the model into its own chunk archive in the directory
+	//	and enables streaming for the objects using them
+	void CreateChunks(Model* model, const std::string& directory);
+
+	// Prioritizes requests by camera distance, picks up finished loads and evicts meshes. Call once per frame.
+	//	eye: camera position, dt: elapsed time since the last update (for motion prediction) in seconds
+	void Update(Scene& scene, const XMFLOAT3& eye, float dt);
+
+	// Resident streamable mesh memory is kept under this (default: 512 MB)
+	void SetMemoryBudget(size_t bytes);
+	// Meshes closer than this will be requested
+	void SetStreamInDistance(float value);
+	// Meshes further than this will be released (should be larger than the stream in distance)
+	void SetStreamOutDistance(float value);
+	// Requests are prioritized by the camera position predicted this far ahead (seconds)
+	void SetPredictionTime(float value);
+	// Limits the GPU buffer creation for finished meshes per Update()
+	void SetMaxUploadsPerFrame(uint32_t value);
+
+	const Stats& GetStats();
+};
+
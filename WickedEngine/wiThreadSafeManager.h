@@ -18,6 +18,9 @@ public:
 	bool TRY_LOCK();
 	void UNLOCK();
 
+	// Contention of the instance lock
+	const wiSpinLock::Stats& GetLockStats() const { return spinlock.GetStats(); }
+
 	static void LOCK_STATIC();
 	static void UNLOCK_STATIC();
 };
@@ -0,0 +1,174 @@
+#include "wiUploadAllocator.h"
+#include "wiGraphicsDevice.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+using namespace std;
+using namespace wiGraphicsTypes;
+
+wiUploadAllocator::wiUploadAllocator() :device(nullptr), bindFlags(0), pageSize(0), frameLatency(1), currentFrame(0), currentFramePages(0)
+{
+}
+wiUploadAllocator::~wiUploadAllocator()
+{
+	Release();
+}
+
+void wiUploadAllocator::Initialize(GraphicsDevice* device, UINT bindFlags, size_t pageSize, uint64_t frameLatency)
+{
+	Release();
+
+	this->device = device;
+	this->bindFlags = bindFlags;
+	this->pageSize = max(pageSize, ALIGNMENT);
+	// A page used in this frame can't be taken again in the same frame, another thread could still be writing it:
+	this->frameLatency = max(frameLatency, (uint64_t)1);
+	currentFrame = device->GetFrameCount();
+}
+void wiUploadAllocator::Release()
+{
+	for (Page* page : pages)
+	{
+		SAFE_DELETE(page->buffer);
+		delete page;
+	}
+	pages.clear();
+	for (auto& thread : threads)
+	{
+		thread = ThreadState();
+	}
+	currentFramePages = 0;
+	stats = Stats();
+}
+
+void wiUploadAllocator::BeginFrame(uint64_t frame)
+{
+	if (frame == currentFrame)
+	{
+		return;
+	}
+
+	// The threads only allocate for the new frame after they got a page here, so their counters belong to the last frame:
+	uint64_t bytes = 0;
+	UINT allocations = 0;
+	for (auto& thread : threads)
+	{
+		bytes += thread.bytes;
+		allocations += thread.allocations;
+		thread.bytes = 0;
+		thread.allocations = 0;
+	}
+	if (allocations > 0)
+	{
+		stats.frameBytes = bytes;
+		stats.frameAllocations = allocations;
+		stats.framePages = currentFramePages;
+		stats.highWaterMark = max(stats.highWaterMark, bytes);
+	}
+	currentFramePages = 0;
+	currentFrame = frame;
+}
+
+wiUploadAllocator::Page* wiUploadAllocator::AcquirePage(size_t dataSize, uint64_t frame)
+{
+	Page* best = nullptr;
+	for (Page* page : pages)
+	{
+		// The ring buffer needs the data to be strictly smaller than the buffer:
+		if (page->held || page->frame + frameLatency > frame || page->size <= dataSize)
+		{
+			continue;
+		}
+		if (best == nullptr || page->size < best->size)
+		{
+			best = page;
+		}
+	}
+
+	if (best == nullptr)
+	{
+		GPUBufferDesc desc;
+		desc.ByteWidth = (UINT)max(pageSize, dataSize + ALIGNMENT);
+		desc.Usage = USAGE_DYNAMIC;
+		desc.BindFlags = bindFlags;
+		desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+		desc.MiscFlags = 0;
+
+		best = new Page;
+		best->buffer = new GPURingBuffer;
+		best->size = desc.ByteWidth;
+		HRESULT hr = device->CreateBuffer(&desc, nullptr, best->buffer);
+		assert(SUCCEEDED(hr) && "Upload page creation failed!");
+		pages.push_back(best);
+
+		stats.pages++;
+		stats.pageBytes += best->size;
+		stats.pagesCreated++;
+	}
+
+	// The ring buffer starts over (and is discarded) on its first mapping in a frame, the page does the same:
+	best->held = true;
+	best->frame = frame;
+	best->used = 0;
+	currentFramePages++;
+	return best;
+}
+
+wiUploadAllocator::Allocation wiUploadAllocator::Allocate(size_t dataSize, GRAPHICSTHREAD threadID)
+{
+	Allocation allocation;
+	if (dataSize == 0 || device == nullptr)
+	{
+		return allocation;
+	}
+
+	const size_t size = (dataSize + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	const uint64_t frame = device->GetFrameCount();
+
+	// Only the thread itself uses its page, so the bump allocation doesn't need the lock:
+	ThreadState& thread = threads[threadID];
+	Page* page = thread.page;
+	if (page == nullptr || page->frame != frame || page->used + size >= page->size)
+	{
+		lock.lock();
+		BeginFrame(frame);
+		if (page != nullptr)
+		{
+			page->held = false;
+		}
+		page = AcquirePage(size, frame);
+		lock.unlock();
+		thread.page = page;
+	}
+
+	allocation.buffer = page->buffer;
+	allocation.data = device->AllocateFromRingBuffer(page->buffer, size, allocation.offset, threadID);
+	assert(allocation.offset == page->used);
+	page->used += size;
+
+	thread.bytes += size;
+	thread.allocations++;
+
+	return allocation;
+}
+void wiUploadAllocator::Unmap(const Allocation& allocation, GRAPHICSTHREAD threadID)
+{
+	if (allocation.IsValid())
+	{
+		device->InvalidateBufferAccess(allocation.buffer, threadID);
+	}
+}
+wiUploadAllocator::Allocation wiUploadAllocator::Upload(const void* data, size_t dataSize, GRAPHICSTHREAD threadID)
+{
+	Allocation allocation = Allocate(dataSize, threadID);
+	if (allocation.IsValid())
+	{
+		memcpy(allocation.data, data, dataSize);
+		Unmap(allocation, threadID);
+		allocation.data = nullptr;
+	}
+	return allocation;
+}
+
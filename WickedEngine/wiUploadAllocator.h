@@ -0,0 +1,103 @@
+#pragma once
+#include "CommonInclude.h"
+#include "wiEnums.h"
+#include "wiSpinLock.h"
+
+#include <vector>
+
+namespace wiGraphicsTypes
+{
+	class GraphicsDevice;
+	class GPUBuffer;
+	class GPURingBuffer;
+}
+
+// Sub-allocates the CPU to GPU uploads of a frame linearly from large dynamic buffer pages. Every graphics thread fills
+//	its own page, so threads recording in parallel don't contend, and a full page is replaced by a free or a new one.
+//	A page is only reused when the frames that wrote it are no longer in flight, so an allocation never overwrites data
+//	that the GPU can still read, and the allocator grows when a frame needs more pages than it has.
+class wiUploadAllocator
+{
+public:
+	static const size_t ALIGNMENT = 16;
+
+	struct Allocation
+	{
+		wiGraphicsTypes::GPUBuffer* buffer;
+		UINT offset;
+		void* data;	// mapped for writing until Unmap()
+
+		Allocation() :buffer(nullptr), offset(0), data(nullptr) {}
+		bool IsValid() const { return buffer != nullptr; }
+	};
+
+	struct Stats
+	{
+		uint64_t frameBytes;		// bytes allocated in the last finished frame (that allocated anything)
+		UINT frameAllocations;		// allocations in that frame
+		UINT framePages;			// pages taken by threads in that frame
+		uint64_t highWaterMark;		// most bytes allocated in a frame
+		UINT pages;					// pages of the allocator
+		uint64_t pageBytes;			// memory of the pages
+		UINT pagesCreated;			// pages created since the allocator was initialized
+
+		Stats() :frameBytes(0), frameAllocations(0), framePages(0), highWaterMark(0), pages(0), pageBytes(0), pagesCreated(0) {}
+	};
+
+private:
+	struct Page
+	{
+		wiGraphicsTypes::GPURingBuffer* buffer;
+		size_t size;
+		size_t used;
+		uint64_t frame;	// the last frame that allocated from the page
+		bool held;		// it is the current page of a thread
+	};
+	struct ThreadState
+	{
+		Page* page;
+		uint64_t bytes;
+		UINT allocations;
+
+		ThreadState() :page(nullptr), bytes(0), allocations(0) {}
+	};
+
+	wiGraphicsTypes::GraphicsDevice* device;
+	UINT bindFlags;
+	size_t pageSize;
+	uint64_t frameLatency;
+
+	std::vector<Page*> pages;
+	ThreadState threads[GRAPHICSTHREAD_COUNT];
+	uint64_t currentFrame;
+	UINT currentFramePages;
+	Stats stats;
+	wiSpinLock lock;
+
+	// These are called with the lock held:
+	// Moves the counters of the threads into the statistics when the first allocation of a new frame is made
+	void BeginFrame(uint64_t frame);
+	// Returns the smallest free page that has room for dataSize bytes, or creates a new one
+	Page* AcquirePage(size_t dataSize, uint64_t frame);
+
+public:
+	wiUploadAllocator();
+	~wiUploadAllocator();
+	wiUploadAllocator(const wiUploadAllocator&) = delete;
+	wiUploadAllocator& operator=(const wiUploadAllocator&) = delete;
+
+	// The pages are dynamic buffers with the bind flags. An allocation that doesn't fit into pageSize gets a page of its own
+	//	size. A page written in frame N can be taken again in frame N + frameLatency
+	void Initialize(wiGraphicsTypes::GraphicsDevice* device, UINT bindFlags, size_t pageSize = 4 * 1024 * 1024, uint64_t frameLatency = 2);
+	// Frees every page, the GPU must not be using them anymore
+	void Release();
+
+	// Reserves dataSize bytes for the current frame and maps them for writing, Unmap() must be called before the buffer is used
+	Allocation Allocate(size_t dataSize, GRAPHICSTHREAD threadID);
+	void Unmap(const Allocation& allocation, GRAPHICSTHREAD threadID);
+	// Allocates and copies the data, the returned allocation is already unmapped
+	Allocation Upload(const void* data, size_t dataSize, GRAPHICSTHREAD threadID);
+
+	const Stats& GetStats() const { return stats; }
+};
+